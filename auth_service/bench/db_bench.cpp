@@ -0,0 +1,274 @@
+// Query latency of the auth Database under concurrency, against a seeded local Postgres.
+//
+//   auth_db_bench --seed [--users 10000] [--revoked 100000]
+//   auth_db_bench [-t 1,4,16] [-d 5] [--connections 1] [--cases a,b] [--json results.json]
+//
+// --db (default: DATABASE_URL) must point at a schema from init/ with bootstrap_admin.sql applied
+// (roles and permissions). Seeding is idempotent and only adds bench rows: bench-user-N@bench.local
+// accounts (one in 100 is an admin) and revoked jtis bench-jti-N spread over the last 30 days.
+// messaging_db_bench seeds the same accounts, so either can run first.
+//
+// Each case runs for -d seconds at every concurrency of -t; threads share --connections Database
+// instances (1 = the service: one connection behind one recursive mutex). The Database methods
+// report failures through their return values, so a query error shows up as a latency, not in
+// "errors". The JSON output can be diffed between commits (same seed, same machine).
+#include "Database.h"
+
+#include <pqxx/pqxx>
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <fstream>
+#include <functional>
+#include <iostream>
+#include <memory>
+#include <random>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace {
+using Clock = std::chrono::steady_clock;
+
+struct Config {
+    std::string db;
+    bool seed = false;
+    int users = 10000;
+    int revoked = 100000;
+    std::vector<int> threads{1, 4, 16};
+    int seconds = 5;
+    int connections = 1;
+    std::vector<std::string> cases;
+    std::string jsonPath;
+};
+
+std::vector<std::string> split(const std::string& s, char sep) {
+    std::vector<std::string> out;
+    std::stringstream in(s);
+    std::string item;
+    while (std::getline(in, item, sep)) {
+        if (!item.empty()) out.push_back(item);
+    }
+    return out;
+}
+
+void seed(const Config& cfg) {
+    pqxx::connection conn(cfg.db);
+    const auto step = [&](const char* what, const std::string& sql) {
+        const auto start = Clock::now();
+        pqxx::work tx(conn);
+        const auto r = tx.exec(sql);
+        tx.commit();
+        std::fprintf(stderr, "seed: %-16s %8ld rows  %6.1f s\n", what, static_cast<long>(r.affected_rows()),
+                     std::chrono::duration<double>(Clock::now() - start).count());
+    };
+    step("users",
+         "INSERT INTO users(full_name, email, password_hash, role_id) "
+         "SELECT 'Bench User ' || i, 'bench-user-' || i || '@bench.local', 'bench', "
+         "(SELECT id_roles FROM roles WHERE name = CASE WHEN i % 100 = 0 THEN 'admin' ELSE 'user' END) "
+         "FROM generate_series(0, " + std::to_string(cfg.users) + " - 1) AS i ON CONFLICT (email) DO NOTHING");
+    step("revoked tokens",
+         "INSERT INTO tokens_revoked(token_jti, revoked_at) "
+         "SELECT 'bench-jti-' || i, CURRENT_TIMESTAMP - (i % 30) * interval '1 day' "
+         "FROM generate_series(0, " + std::to_string(cfg.revoked) + " - 1) AS i ON CONFLICT DO NOTHING");
+    step("analyze", "ANALYZE users, roles, role_permission, permissions, tokens_revoked");
+}
+
+struct Result {
+    std::string name;
+    int threads = 0;
+    std::uint64_t ops = 0;
+    std::uint64_t errors = 0;
+    double seconds = 0;
+    double p50 = 0, p90 = 0, p99 = 0, p999 = 0, max = 0;  // µs
+};
+
+double percentile(const std::vector<std::uint32_t>& sorted, double q) {
+    if (sorted.empty()) return 0;
+    const size_t rank = static_cast<size_t>(std::ceil(q * static_cast<double>(sorted.size())));
+    return sorted[std::min(sorted.size() - 1, rank == 0 ? 0 : rank - 1)];
+}
+
+// op(db, rng) runs one call; every thread calls it in a loop for cfg.seconds.
+Result run_case(const Config& cfg, const std::string& name, int threads, std::vector<std::unique_ptr<Database>>& dbs,
+                const std::function<void(Database&, std::mt19937_64&)>& op) {
+    std::vector<std::vector<std::uint32_t>> lat(static_cast<size_t>(threads));
+    std::vector<std::uint64_t> errors(static_cast<size_t>(threads));
+    const auto end = Clock::now() + std::chrono::seconds(cfg.seconds);
+    std::vector<std::thread> pool;
+    for (int t = 0; t < threads; ++t) {
+        pool.emplace_back([&, t]() {
+            Database& db = *dbs[static_cast<size_t>(t) % dbs.size()];
+            std::mt19937_64 rng(static_cast<unsigned long long>(t) * 0x9E3779B97F4A7C15ull + 1);
+            auto& mine = lat[static_cast<size_t>(t)];
+            mine.reserve(1 << 16);
+            for (;;) {
+                const auto start = Clock::now();
+                if (start >= end) break;
+                try {
+                    op(db, rng);
+                } catch (const std::exception&) {
+                    ++errors[static_cast<size_t>(t)];
+                }
+                mine.push_back(static_cast<std::uint32_t>(
+                    std::chrono::duration_cast<std::chrono::microseconds>(Clock::now() - start).count()));
+            }
+        });
+    }
+    const auto begin = Clock::now();
+    for (auto& th : pool) th.join();
+
+    Result r;
+    r.name = name;
+    r.threads = threads;
+    r.seconds = std::chrono::duration<double>(Clock::now() - begin).count();
+    std::vector<std::uint32_t> all;
+    for (auto& v : lat) all.insert(all.end(), v.begin(), v.end());
+    for (const auto e : errors) r.errors += e;
+    std::sort(all.begin(), all.end());
+    r.ops = all.size();
+    r.p50 = percentile(all, 0.5);
+    r.p90 = percentile(all, 0.9);
+    r.p99 = percentile(all, 0.99);
+    r.p999 = percentile(all, 0.999);
+    r.max = all.empty() ? 0 : all.back();
+    return r;
+}
+
+bool parse_args(int argc, char** argv, Config* cfg) {
+    if (const char* url = std::getenv("DATABASE_URL")) cfg->db = url;
+    for (int i = 1; i < argc; ++i) {
+        const std::string a = argv[i];
+        const auto value = [&]() -> std::string { return i + 1 < argc ? argv[++i] : ""; };
+        if (a == "--db") cfg->db = value();
+        else if (a == "--seed") cfg->seed = true;
+        else if (a == "--users") cfg->users = std::max(1, std::atoi(value().c_str()));
+        else if (a == "--revoked") cfg->revoked = std::max(1, std::atoi(value().c_str()));
+        else if (a == "-t") {
+            cfg->threads.clear();
+            for (const auto& t : split(value(), ',')) cfg->threads.push_back(std::max(1, std::atoi(t.c_str())));
+        } else if (a == "-d") cfg->seconds = std::max(1, std::atoi(value().c_str()));
+        else if (a == "--connections") cfg->connections = std::max(1, std::atoi(value().c_str()));
+        else if (a == "--cases") cfg->cases = split(value(), ',');
+        else if (a == "--json") cfg->jsonPath = value();
+        else {
+            std::cerr << "unknown argument: " << a << "\n";
+            return false;
+        }
+    }
+    if (cfg->db.empty()) {
+        std::cerr << "no database: --db <url> or DATABASE_URL\n";
+        return false;
+    }
+    return !cfg->threads.empty();
+}
+}  // namespace
+
+int main(int argc, char** argv) {
+    Config cfg;
+    if (!parse_args(argc, argv, &cfg)) return 1;
+
+    try {
+        if (cfg.seed) {
+            seed(cfg);
+            return 0;
+        }
+
+        std::vector<int> userIds;
+        std::vector<std::string> emails;
+        int revoked = 0;
+        {
+            pqxx::connection conn(cfg.db);
+            pqxx::work tx(conn);
+            for (const auto& row : tx.exec("SELECT id_users, email FROM users "
+                                           "WHERE email LIKE 'bench-user-%@bench.local' ORDER BY id_users")) {
+                userIds.push_back(row[0].as<int>());
+                emails.push_back(row[1].as<std::string>());
+            }
+            revoked = tx.exec("SELECT count(*) FROM tokens_revoked WHERE token_jti LIKE 'bench-jti-%'")[0][0].as<int>();
+            tx.commit();
+        }
+        if (userIds.empty() || revoked == 0) {
+            std::cerr << "no bench data: run with --seed first\n";
+            return 1;
+        }
+
+        std::vector<std::unique_ptr<Database>> dbs;
+        for (int c = 0; c < cfg.connections; ++c) dbs.push_back(std::make_unique<Database>(cfg.db));
+
+        const auto index = [](size_t n, std::mt19937_64& rng) { return std::uniform_int_distribution<size_t>(0, n - 1)(rng); };
+        const auto revokedJti = [&](std::mt19937_64& rng) {
+            return "bench-jti-" + std::to_string(index(static_cast<size_t>(revoked), rng));
+        };
+
+        const std::vector<std::pair<std::string, std::function<void(Database&, std::mt19937_64&)>>> cases = {
+            {"getUserByEmail", [&](Database& db, std::mt19937_64& rng) { db.getUserByEmail(emails[index(emails.size(), rng)]); }},
+            {"getUserById", [&](Database& db, std::mt19937_64& rng) { db.getUserById(userIds[index(userIds.size(), rng)]); }},
+            {"getUserPermissions",
+             [&](Database& db, std::mt19937_64& rng) { db.getUserPermissions(userIds[index(userIds.size(), rng)]); }},
+            {"isTokenRevoked", [&](Database& db, std::mt19937_64& rng) { db.isTokenRevoked(revokedJti(rng)); }},
+            // The common case on a request path: a live token.
+            {"isTokenRevoked_miss",
+             [&](Database& db, std::mt19937_64& rng) { db.isTokenRevoked("bench-live-" + std::to_string(rng())); }},
+            {"userExists", [&](Database& db, std::mt19937_64& rng) { db.userExists(emails[index(emails.size(), rng)]); }},
+            {"isUserAdmin", [&](Database& db, std::mt19937_64& rng) { db.isUserAdmin(emails[index(emails.size(), rng)]); }},
+            {"getUserTokenJti",
+             [&](Database& db, std::mt19937_64& rng) { db.getUserTokenJti(userIds[index(userIds.size(), rng)]); }},
+            // Login writes the new jti.
+            {"setUserTokenJti", [&](Database& db, std::mt19937_64& rng) {
+                 db.setUserTokenJti(userIds[index(userIds.size(), rng)], "bench-session-" + std::to_string(rng()));
+             }},
+            {"getUsersByEmails", [&](Database& db, std::mt19937_64& rng) {
+                 std::vector<std::string> batch;
+                 for (int i = 0; i < 20; ++i) batch.push_back(emails[index(emails.size(), rng)]);
+                 db.getUsersByEmails(batch);
+             }},
+            {"getDataVersion", [&](Database& db, std::mt19937_64&) { db.getDataVersion("directory"); }},
+            {"listUsers", [&](Database& db, std::mt19937_64&) { db.listUsers(); }},
+        };
+
+        std::vector<Result> results;
+        std::fprintf(stderr, "%-22s %7s %10s %10s %9s %9s %9s %9s %9s %7s\n", "case", "threads", "ops", "ops/s",
+                     "p50 us", "p90 us", "p99 us", "p999 us", "max us", "errors");
+        for (const auto& [name, op] : cases) {
+            if (!cfg.cases.empty() && std::find(cfg.cases.begin(), cfg.cases.end(), name) == cfg.cases.end()) continue;
+            for (const int threads : cfg.threads) {
+                const Result r = run_case(cfg, name, threads, dbs, op);
+                std::fprintf(stderr, "%-22s %7d %10llu %10.0f %9.0f %9.0f %9.0f %9.0f %9.0f %7llu\n", r.name.c_str(),
+                             r.threads, static_cast<unsigned long long>(r.ops), static_cast<double>(r.ops) / r.seconds,
+                             r.p50, r.p90, r.p99, r.p999, r.max, static_cast<unsigned long long>(r.errors));
+                results.push_back(r);
+            }
+        }
+
+        std::ostringstream json;
+        json << "{\"service\":\"auth\",\"connections\":" << cfg.connections << ",\"seconds\":" << cfg.seconds
+             << ",\"dataset\":{\"users\":" << userIds.size() << ",\"revoked\":" << revoked << "},\"results\":[";
+        for (size_t i = 0; i < results.size(); ++i) {
+            const auto& r = results[i];
+            char buf[384];
+            std::snprintf(buf, sizeof(buf),
+                          "%s{\"case\":\"%s\",\"threads\":%d,\"ops\":%llu,\"errors\":%llu,\"ops_per_s\":%.1f,"
+                          "\"p50_us\":%.0f,\"p90_us\":%.0f,\"p99_us\":%.0f,\"p999_us\":%.0f,\"max_us\":%.0f}",
+                          i ? "," : "", r.name.c_str(), r.threads, static_cast<unsigned long long>(r.ops),
+                          static_cast<unsigned long long>(r.errors), static_cast<double>(r.ops) / r.seconds, r.p50,
+                          r.p90, r.p99, r.p999, r.max);
+            json << buf;
+        }
+        json << "]}\n";
+        if (cfg.jsonPath.empty()) {
+            std::cout << json.str();
+        } else {
+            std::ofstream(cfg.jsonPath) << json.str();
+        }
+    } catch (const std::exception& e) {
+        std::cerr << "error: " << e.what() << "\n";
+        return 1;
+    }
+    return 0;
+}
@@ -0,0 +1,95 @@
+// Per-call cost of logging on a request path: the asynchronous logger (common/logging/Logger.h) against the
+// synchronous `std::cout << ... << std::endl` it replaces.
+//
+//   auth_log_bench [-t threads] [-n calls_per_thread] > /dev/null
+//
+// Log lines go to stdout (redirect them); the results are printed on stderr. Cases:
+//   endl     std::cout << ... << std::endl, a flushed write per line
+//   async    logging::info with two fields (enqueue only; the sink thread writes)
+//   sampled  logging::debug behind a 1/100 Sampler, debug enabled
+//   off      logging::debug with LOG_LEVEL=info (the level check alone)
+#include "Logger.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace {
+using Clock = std::chrono::steady_clock;
+
+struct Config {
+    int threads = 4;
+    int calls = 200000;
+};
+
+template <typename Fn>
+double run_threads(const Config& cfg, Fn fn) {
+    const auto start = Clock::now();
+    std::vector<std::thread> threads;
+    for (int t = 0; t < cfg.threads; ++t) {
+        threads.emplace_back([&cfg, &fn, t]() {
+            for (int i = 0; i < cfg.calls; ++i) fn(t, i);
+        });
+    }
+    for (auto& th : threads) th.join();
+    const double ns = std::chrono::duration<double, std::nano>(Clock::now() - start).count();
+    return ns / (static_cast<double>(cfg.calls) * cfg.threads);
+}
+
+void report(const char* name, double nsPerCall, const Config& cfg) {
+    std::fprintf(stderr, "%-8s %9.1f ns/call (wall, %d threads)\n", name, nsPerCall, cfg.threads);
+}
+}  // namespace
+
+int main(int argc, char** argv) {
+    Config cfg;
+    for (int i = 1; i + 1 < argc; i += 2) {
+        if (std::strcmp(argv[i], "-t") == 0) cfg.threads = std::max(1, std::atoi(argv[i + 1]));
+        else if (std::strcmp(argv[i], "-n") == 0) cfg.calls = std::max(1, std::atoi(argv[i + 1]));
+    }
+    const std::string email = "alice@example.com";
+
+    // Smaller run: a flushed write per line is orders of magnitude slower.
+    Config endlCfg = cfg;
+    endlCfg.calls = std::max(1, cfg.calls / 20);
+    const double endl = run_threads(endlCfg, [&](int, int i) {
+        std::cout << "[AuthService] Login: email=" << email << " attempt=" << i << std::endl;
+    });
+    report("endl", endl, endlCfg);
+
+    logging::setLevel(logging::Level::Info);
+    logging::info("AuthService", "bench", {{"threads", cfg.threads}});  // ring allocated and sink started
+    logging::flush();
+    const double async = run_threads(cfg, [&](int, int i) {
+        logging::info("AuthService", "Login", {{"email", email}, {"attempt", i}});
+    });
+    logging::flush();
+    report("async", async, cfg);
+
+    logging::setLevel(logging::Level::Debug);
+    logging::Sampler sample(100);
+    const double sampled = run_threads(cfg, [&](int, int i) {
+        if (logging::enabled(logging::Level::Debug) && sample.take()) {
+            logging::debug("AuthService", "ValidateToken", {{"attempt", i}});
+        }
+    });
+    logging::flush();
+    report("sampled", sampled, cfg);
+
+    logging::setLevel(logging::Level::Info);
+    const double off = run_threads(cfg, [&](int, int i) {
+        logging::debug("AuthService", "ValidateToken", {{"attempt", i}});
+    });
+    report("off", off, cfg);
+
+    const auto stats = logging::stats();
+    std::fprintf(stderr, "written=%llu dropped=%llu\n", static_cast<unsigned long long>(stats.written),
+                 static_cast<unsigned long long>(stats.dropped));
+    return 0;
+}
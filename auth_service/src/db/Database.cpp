@@ -1,31 +1,41 @@
 #include "Database.h"
-#include <iostream>
+#include "Logger.h"
+#include "Metrics.h"
+#include "Tracing.h"
+
+namespace {
+// db_query_duration_seconds{method}: durée d'une méthode, attente du verrou de connexion comprise.
+metrics::Histogram& query_latency(const char* method) {
+    return metrics::registry().histogram("db_query_duration_seconds",
+                                         "Database method latency, including the wait for the connection lock",
+                                         {{"method", method}});
+}
+}  // namespace
 
 Database::Database(const std::string& connStr)
     : connStr_(connStr), conn(connStr) {}
 
 void Database::ensureConnection() {
-    std::lock_guard<std::recursive_mutex> lock(mutex_);
+    std::lock_guard<metrics::RecursiveMutex> lock(mutex_);
     if (!conn.is_open()) {
-        std::cerr << "[Database] Connection closed. Attempting reconnect..." << std::endl;
+        logging::warn("Database", "Reconnect", {{"reason", "connection closed"}});
         conn = pqxx::connection(connStr_);
-        if (conn.is_open()) {
-            std::cerr << "[Database] Reconnection successful." << std::endl;
-        } else {
-            std::cerr << "[Database] Reconnection failed." << std::endl;
-        }
+        logging::warn("Database", "Reconnect", {{"result", conn.is_open() ? "success" : "failed"}});
     }
 }
 
 bool Database::userExists(const std::string& email) {
-    std::lock_guard<std::recursive_mutex> lock(mutex_);
+    static auto& latency = query_latency("userExists");
+    const metrics::Timer timer(latency);
+    const tracing::ScopedSpan span("Database::userExists", tracing::Kind::Client);
+    std::lock_guard<metrics::RecursiveMutex> lock(mutex_);
     ensureConnection();
     try {
         pqxx::work txn(conn);
         pqxx::result r = txn.exec_params("SELECT id_users FROM users WHERE email = $1", email);
         return !r.empty();
     } catch (const pqxx::broken_connection& bc) {
-        std::cerr << "[Database] broken_connection in userExists: " << bc.what() << std::endl;
+        logging::warn("Database", "BrokenConnection", {{"method", "userExists"}, {"error", bc.what()}});
         // tentative unique de reconnexion
         ensureConnection();
         try {
@@ -39,7 +49,10 @@ bool Database::userExists(const std::string& email) {
 }
 
 void Database::registerUser(const std::string& fullName, const std::string& email, const std::string& hashedPassword) {
-    std::lock_guard<std::recursive_mutex> lock(mutex_);
+    static auto& latency = query_latency("registerUser");
+    const metrics::Timer timer(latency);
+    const tracing::ScopedSpan span("Database::registerUser", tracing::Kind::Client);
+    std::lock_guard<metrics::RecursiveMutex> lock(mutex_);
     ensureConnection();
     try {
         pqxx::work txn(conn);
@@ -49,7 +62,7 @@ void Database::registerUser(const std::string& fullName, const std::string& emai
         );
         txn.commit();
     } catch (const pqxx::broken_connection& bc) {
-        std::cerr << "[Database] broken_connection in registerUser: " << bc.what() << std::endl;
+        logging::warn("Database", "BrokenConnection", {{"method", "registerUser"}, {"error", bc.what()}});
         ensureConnection();
         pqxx::work retryTxn(conn);
         retryTxn.exec_params(
@@ -61,27 +74,28 @@ void Database::registerUser(const std::string& fullName, const std::string& emai
 }
 
 void Database::registerUserWithRole(const std::string& fullName, const std::string& email, const std::string& hashedPassword, const std::string& roleName) {
-    std::lock_guard<std::recursive_mutex> lock(mutex_);
+    static auto& latency = query_latency("registerUserWithRole");
+    const metrics::Timer timer(latency);
+    const tracing::ScopedSpan span("Database::registerUserWithRole", tracing::Kind::Client);
+    std::lock_guard<metrics::RecursiveMutex> lock(mutex_);
     ensureConnection();
     try {
         pqxx::work txn(conn);
         
         // Récupérer l'ID du rôle
-        std::cout << "[Database] Recherche du rôle: " << roleName << std::endl;
         pqxx::result role_r = txn.exec_params("SELECT id_roles FROM roles WHERE name = $1", roleName);
         int role_id = 0;
         if (!role_r.empty()) {
             role_id = role_r[0]["id_roles"].as<int>();
-            std::cout << "[Database] Rôle trouvé, ID: " << role_id << std::endl;
         } else {
-            std::cout << "[Database] ❌ Rôle '" << roleName << "' non trouvé !" << std::endl;
+            logging::warn("Database", "RoleNotFound", {{"role", roleName}});
             // Créer le rôle "user" s'il n'existe pas
             if (roleName == "user") {
                 txn.exec_params("INSERT INTO roles (name, description) VALUES ('user', 'Utilisateur standard') ON CONFLICT (name) DO NOTHING");
                 pqxx::result retry_role_r = txn.exec_params("SELECT id_roles FROM roles WHERE name = $1", roleName);
                 if (!retry_role_r.empty()) {
                     role_id = retry_role_r[0]["id_roles"].as<int>();
-                    std::cout << "[Database] Rôle 'user' créé avec ID: " << role_id << std::endl;
+                    logging::info("Database", "RoleCreated", {{"role", roleName}, {"role_id", role_id}});
                 }
             }
         }
@@ -92,17 +106,17 @@ void Database::registerUserWithRole(const std::string& fullName, const std::stri
                 "INSERT INTO users (full_name, email, password_hash, role_id) VALUES ($1, $2, $3, $4)",
                 fullName, email, hashedPassword, role_id
             );
-            std::cout << "[Database] Utilisateur inséré avec role_id: " << role_id << std::endl;
+            logging::debug("Database", "UserInserted", {{"role_id", role_id}});
         } else {
             txn.exec_params(
                 "INSERT INTO users (full_name, email, password_hash) VALUES ($1, $2, $3)",
                 fullName, email, hashedPassword
             );
-            std::cout << "[Database] Utilisateur inséré SANS rôle (role_id=NULL)" << std::endl;
+            logging::warn("Database", "UserInserted", {{"role_id", "null"}});
         }
         txn.commit();
     } catch (const pqxx::broken_connection& bc) {
-        std::cerr << "[Database] broken_connection in registerUserWithRole: " << bc.what() << std::endl;
+        logging::warn("Database", "BrokenConnection", {{"method", "registerUserWithRole"}, {"error", bc.what()}});
         ensureConnection();
         // Retry logic similar to above
         pqxx::work retryTxn(conn);
@@ -128,7 +142,10 @@ void Database::registerUserWithRole(const std::string& fullName, const std::stri
 }
 
 std::optional<UserRecord> Database::getUserByEmail(const std::string& email) {
-    std::lock_guard<std::recursive_mutex> lock(mutex_);
+    static auto& latency = query_latency("getUserByEmail");
+    const metrics::Timer timer(latency);
+    const tracing::ScopedSpan span("Database::getUserByEmail", tracing::Kind::Client);
+    std::lock_guard<metrics::RecursiveMutex> lock(mutex_);
     ensureConnection();
     try {
         pqxx::work txn(conn);
@@ -149,7 +166,7 @@ std::optional<UserRecord> Database::getUserByEmail(const std::string& email) {
         };
         return user;
     } catch (const pqxx::broken_connection& bc) {
-        std::cerr << "[Database] broken_connection in getUserByEmail: " << bc.what() << std::endl;
+        logging::warn("Database", "BrokenConnection", {{"method", "getUserByEmail"}, {"error", bc.what()}});
         ensureConnection();
         pqxx::work retryTxn(conn);
         pqxx::result r = retryTxn.exec_params(
@@ -170,7 +187,10 @@ std::optional<UserRecord> Database::getUserByEmail(const std::string& email) {
 }
 
 std::optional<UserRecord> Database::getUserById(int user_id) {
-    std::lock_guard<std::recursive_mutex> lock(mutex_);
+    static auto& latency = query_latency("getUserById");
+    const metrics::Timer timer(latency);
+    const tracing::ScopedSpan span("Database::getUserById", tracing::Kind::Client);
+    std::lock_guard<metrics::RecursiveMutex> lock(mutex_);
     ensureConnection();
     try {
         pqxx::work txn(conn);
@@ -191,7 +211,7 @@ std::optional<UserRecord> Database::getUserById(int user_id) {
         };
         return user;
     } catch (const pqxx::broken_connection& bc) {
-        std::cerr << "[Database] broken_connection in getUserById: " << bc.what() << std::endl;
+        logging::warn("Database", "BrokenConnection", {{"method", "getUserById"}, {"error", bc.what()}});
         ensureConnection();
         pqxx::work retryTxn(conn);
         pqxx::result r = retryTxn.exec_params(
@@ -212,7 +232,10 @@ std::optional<UserRecord> Database::getUserById(int user_id) {
 }
 
 bool Database::deleteUserById(int user_id) {
-    std::lock_guard<std::recursive_mutex> lock(mutex_);
+    static auto& latency = query_latency("deleteUserById");
+    const metrics::Timer timer(latency);
+    const tracing::ScopedSpan span("Database::deleteUserById", tracing::Kind::Client);
+    std::lock_guard<metrics::RecursiveMutex> lock(mutex_);
     ensureConnection();
     try {
         pqxx::work txn(conn);
@@ -237,7 +260,7 @@ bool Database::deleteUserById(int user_id) {
 
         return r.affected_rows() > 0;
     } catch (const pqxx::broken_connection& bc) {
-        std::cerr << "[Database] broken_connection in deleteUserById: " << bc.what() << std::endl;
+        logging::warn("Database", "BrokenConnection", {{"method", "deleteUserById"}, {"error", bc.what()}});
         ensureConnection();
 
         pqxx::work retryTxn(conn);
@@ -262,7 +285,10 @@ bool Database::deleteUserById(int user_id) {
 }
 
 bool Database::updateUserPasswordHash(int user_id, const std::string& new_hashed_password) {
-    std::lock_guard<std::recursive_mutex> lock(mutex_);
+    static auto& latency = query_latency("updateUserPasswordHash");
+    const metrics::Timer timer(latency);
+    const tracing::ScopedSpan span("Database::updateUserPasswordHash", tracing::Kind::Client);
+    std::lock_guard<metrics::RecursiveMutex> lock(mutex_);
     ensureConnection();
     try {
         pqxx::work txn(conn);
@@ -272,7 +298,7 @@ bool Database::updateUserPasswordHash(int user_id, const std::string& new_hashed
         txn.commit();
         return true;
     } catch (const pqxx::broken_connection& bc) {
-        std::cerr << "[Database] broken_connection in updateUserPasswordHash: " << bc.what() << std::endl;
+        logging::warn("Database", "BrokenConnection", {{"method", "updateUserPasswordHash"}, {"error", bc.what()}});
         ensureConnection();
         try {
             pqxx::work retryTxn(conn);
@@ -282,17 +308,20 @@ bool Database::updateUserPasswordHash(int user_id, const std::string& new_hashed
             retryTxn.commit();
             return true;
         } catch (const std::exception& e) {
-            std::cerr << "[Database] Error updating password hash: " << e.what() << std::endl;
+            logging::error("Database", "QueryFailed", {{"method", "updateUserPasswordHash"}, {"error", e.what()}});
             return false;
         }
     } catch (const std::exception& e) {
-        std::cerr << "[Database] Error updating password hash: " << e.what() << std::endl;
+        logging::error("Database", "QueryFailed", {{"method", "updateUserPasswordHash"}, {"error", e.what()}});
         return false;
     }
 }
 
 std::optional<std::string> Database::getUserTokenJti(int user_id) {
-    std::lock_guard<std::recursive_mutex> lock(mutex_);
+    static auto& latency = query_latency("getUserTokenJti");
+    const metrics::Timer timer(latency);
+    const tracing::ScopedSpan span("Database::getUserTokenJti", tracing::Kind::Client);
+    std::lock_guard<metrics::RecursiveMutex> lock(mutex_);
     ensureConnection();
     try {
         pqxx::work txn(conn);
@@ -304,7 +333,7 @@ std::optional<std::string> Database::getUserTokenJti(int user_id) {
         }
         return r[0]["token_jti"].as<std::string>();
     } catch (const pqxx::broken_connection& bc) {
-        std::cerr << "[Database] broken_connection in getUserTokenJti: " << bc.what() << std::endl;
+        logging::warn("Database", "BrokenConnection", {{"method", "getUserTokenJti"}, {"error", bc.what()}});
         ensureConnection();
         pqxx::work retryTxn(conn);
         pqxx::result r = retryTxn.exec_params(
@@ -318,7 +347,10 @@ std::optional<std::string> Database::getUserTokenJti(int user_id) {
 }
 
 bool Database::setUserTokenJti(int user_id, const std::string& token_jti) {
-    std::lock_guard<std::recursive_mutex> lock(mutex_);
+    static auto& latency = query_latency("setUserTokenJti");
+    const metrics::Timer timer(latency);
+    const tracing::ScopedSpan span("Database::setUserTokenJti", tracing::Kind::Client);
+    std::lock_guard<metrics::RecursiveMutex> lock(mutex_);
     ensureConnection();
     try {
         pqxx::work txn(conn);
@@ -335,7 +367,7 @@ bool Database::setUserTokenJti(int user_id, const std::string& token_jti) {
         txn.commit();
         return true;
     } catch (const pqxx::broken_connection& bc) {
-        std::cerr << "[Database] broken_connection in setUserTokenJti: " << bc.what() << std::endl;
+        logging::warn("Database", "BrokenConnection", {{"method", "setUserTokenJti"}, {"error", bc.what()}});
         ensureConnection();
         try {
             pqxx::work retryTxn(conn);
@@ -352,17 +384,20 @@ bool Database::setUserTokenJti(int user_id, const std::string& token_jti) {
             retryTxn.commit();
             return true;
         } catch (const std::exception& e) {
-            std::cerr << "[Database] Error in setUserTokenJti retry: " << e.what() << std::endl;
+            logging::error("Database", "QueryFailed", {{"method", "setUserTokenJti"}, {"retry", true}, {"error", e.what()}});
             return false;
         }
     } catch (const std::exception& e) {
-        std::cerr << "[Database] Error in setUserTokenJti: " << e.what() << std::endl;
+        logging::error("Database", "QueryFailed", {{"method", "setUserTokenJti"}, {"error", e.what()}});
         return false;
     }
 }
 
 bool Database::isTokenRevoked(const std::string& token_jti) {
-    std::lock_guard<std::recursive_mutex> lock(mutex_);
+    static auto& latency = query_latency("isTokenRevoked");
+    const metrics::Timer timer(latency);
+    const tracing::ScopedSpan span("Database::isTokenRevoked", tracing::Kind::Client);
+    std::lock_guard<metrics::RecursiveMutex> lock(mutex_);
     if (token_jti.empty()) return false;
     ensureConnection();
     try {
@@ -372,7 +407,7 @@ bool Database::isTokenRevoked(const std::string& token_jti) {
             token_jti);
         return !r.empty();
     } catch (const pqxx::broken_connection& bc) {
-        std::cerr << "[Database] broken_connection in isTokenRevoked: " << bc.what() << std::endl;
+        logging::warn("Database", "BrokenConnection", {{"method", "isTokenRevoked"}, {"error", bc.what()}});
         ensureConnection();
         pqxx::work retryTxn(conn);
         pqxx::result r = retryTxn.exec_params(
@@ -380,14 +415,17 @@ bool Database::isTokenRevoked(const std::string& token_jti) {
             token_jti);
         return !r.empty();
     } catch (const std::exception& e) {
-        std::cerr << "[Database] Error in isTokenRevoked: " << e.what() << std::endl;
+        logging::error("Database", "QueryFailed", {{"method", "isTokenRevoked"}, {"error", e.what()}});
         // Fail open would be unsafe; treat as revoked when DB errors.
         return true;
     }
 }
 
 bool Database::revokeTokenJti(const std::string& token_jti) {
-    std::lock_guard<std::recursive_mutex> lock(mutex_);
+    static auto& latency = query_latency("revokeTokenJti");
+    const metrics::Timer timer(latency);
+    const tracing::ScopedSpan span("Database::revokeTokenJti", tracing::Kind::Client);
+    std::lock_guard<metrics::RecursiveMutex> lock(mutex_);
     if (token_jti.empty()) return true;
     ensureConnection();
     try {
@@ -398,7 +436,7 @@ bool Database::revokeTokenJti(const std::string& token_jti) {
         txn.commit();
         return true;
     } catch (const pqxx::broken_connection& bc) {
-        std::cerr << "[Database] broken_connection in revokeTokenJti: " << bc.what() << std::endl;
+        logging::warn("Database", "BrokenConnection", {{"method", "revokeTokenJti"}, {"error", bc.what()}});
         ensureConnection();
         pqxx::work retryTxn(conn);
         retryTxn.exec_params(
@@ -407,13 +445,44 @@ bool Database::revokeTokenJti(const std::string& token_jti) {
         retryTxn.commit();
         return true;
     } catch (const std::exception& e) {
-        std::cerr << "[Database] Error in revokeTokenJti: " << e.what() << std::endl;
+        logging::error("Database", "QueryFailed", {{"method", "revokeTokenJti"}, {"error", e.what()}});
         return false;
     }
 }
 
+std::vector<std::string> Database::listRevokedJtisSince(int max_age_days) {
+    static auto& latency = query_latency("listRevokedJtisSince");
+    const metrics::Timer timer(latency);
+    const tracing::ScopedSpan span("Database::listRevokedJtisSince", tracing::Kind::Client);
+    std::lock_guard<metrics::RecursiveMutex> lock(mutex_);
+    ensureConnection();
+    const auto run = [&](pqxx::work& txn) {
+        pqxx::result r = txn.exec_params(
+            "SELECT token_jti FROM tokens_revoked WHERE revoked_at > NOW() - make_interval(days => $1)",
+            max_age_days);
+        std::vector<std::string> out;
+        out.reserve(r.size());
+        for (const auto& row : r) {
+            out.push_back(row[0].as<std::string>());
+        }
+        return out;
+    };
+    try {
+        pqxx::work txn(conn);
+        return run(txn);
+    } catch (const pqxx::broken_connection& bc) {
+        logging::warn("Database", "BrokenConnection", {{"method", "listRevokedJtisSince"}, {"error", bc.what()}});
+        ensureConnection();
+        pqxx::work retryTxn(conn);
+        return run(retryTxn);
+    }
+}
+
 std::vector<UserRecord> Database::listUsers() {
-    std::lock_guard<std::recursive_mutex> lock(mutex_);
+    static auto& latency = query_latency("listUsers");
+    const metrics::Timer timer(latency);
+    const tracing::ScopedSpan span("Database::listUsers", tracing::Kind::Client);
+    std::lock_guard<metrics::RecursiveMutex> lock(mutex_);
     ensureConnection();
     std::vector<UserRecord> users;
     try {
@@ -436,14 +505,77 @@ std::vector<UserRecord> Database::listUsers() {
             });
         }
     } catch (const std::exception& e) {
-        std::cerr << "[Database] Error listing users: " << e.what() << std::endl;
+        logging::error("Database", "QueryFailed", {{"method", "listUsers"}, {"error", e.what()}});
     }
     return users;
 }
 
+std::vector<UserRecord> Database::getUsersByEmails(const std::vector<std::string>& emails) {
+    static auto& latency = query_latency("getUsersByEmails");
+    const metrics::Timer timer(latency);
+    const tracing::ScopedSpan span("Database::getUsersByEmails", tracing::Kind::Client);
+    std::lock_guard<metrics::RecursiveMutex> lock(mutex_);
+    if (emails.empty()) return {};
+    ensureConnection();
+    const auto run = [&](pqxx::work& txn) {
+        pqxx::result r = txn.exec_params(
+            "SELECT u.id_users, u.email, u.password_hash, u.full_name, u.role_id, r.name as role_name "
+            "FROM users u LEFT JOIN roles r ON u.role_id = r.id_roles WHERE u.email = ANY($1::text[])",
+            emails);
+        std::vector<UserRecord> users;
+        users.reserve(r.size());
+        for (const auto& row : r) {
+            users.push_back(UserRecord{
+                row["id_users"].as<int>(),
+                row["email"].as<std::string>(),
+                row["password_hash"].as<std::string>(),
+                row["full_name"].as<std::string>(),
+                row["role_id"].is_null() ? 0 : row["role_id"].as<int>(),
+                row["role_name"].is_null() ? "" : row["role_name"].as<std::string>()
+            });
+        }
+        return users;
+    };
+    try {
+        pqxx::work txn(conn);
+        return run(txn);
+    } catch (const pqxx::broken_connection& bc) {
+        logging::warn("Database", "BrokenConnection", {{"method", "getUsersByEmails"}, {"error", bc.what()}});
+        ensureConnection();
+        pqxx::work retryTxn(conn);
+        return run(retryTxn);
+    }
+}
+
+long long Database::getDataVersion(const std::string& name) {
+    static auto& latency = query_latency("getDataVersion");
+    const metrics::Timer timer(latency);
+    const tracing::ScopedSpan span("Database::getDataVersion", tracing::Kind::Client);
+    std::lock_guard<metrics::RecursiveMutex> lock(mutex_);
+    ensureConnection();
+    const auto run = [&](pqxx::work& txn) {
+        pqxx::result r = txn.exec_params(
+            "SELECT version FROM data_versions WHERE name = $1",
+            name);
+        return r.empty() ? 0LL : r[0][0].as<long long>();
+    };
+    try {
+        pqxx::work txn(conn);
+        return run(txn);
+    } catch (const pqxx::broken_connection& bc) {
+        logging::warn("Database", "BrokenConnection", {{"method", "getDataVersion"}, {"error", bc.what()}});
+        ensureConnection();
+        pqxx::work retryTxn(conn);
+        return run(retryTxn);
+    }
+}
+
 // RBAC Methods Implementation
 std::vector<std::string> Database::getUserPermissions(int user_id) {
-    std::lock_guard<std::recursive_mutex> lock(mutex_);
+    static auto& latency = query_latency("getUserPermissions");
+    const metrics::Timer timer(latency);
+    const tracing::ScopedSpan span("Database::getUserPermissions", tracing::Kind::Client);
+    std::lock_guard<metrics::RecursiveMutex> lock(mutex_);
     ensureConnection();
     std::vector<std::string> permissions;
     try {
@@ -460,13 +592,16 @@ std::vector<std::string> Database::getUserPermissions(int user_id) {
             permissions.push_back(row["name"].as<std::string>());
         }
     } catch (const std::exception& e) {
-        std::cerr << "[Database] Error getting user permissions: " << e.what() << std::endl;
+        logging::error("Database", "QueryFailed", {{"method", "getUserPermissions"}, {"error", e.what()}});
     }
     return permissions;
 }
 
 bool Database::isUserAdmin(const std::string& email) {
-    std::lock_guard<std::recursive_mutex> lock(mutex_);
+    static auto& latency = query_latency("isUserAdmin");
+    const metrics::Timer timer(latency);
+    const tracing::ScopedSpan span("Database::isUserAdmin", tracing::Kind::Client);
+    std::lock_guard<metrics::RecursiveMutex> lock(mutex_);
     ensureConnection();
     try {
         pqxx::work txn(conn);
@@ -481,13 +616,16 @@ bool Database::isUserAdmin(const std::string& email) {
             return role_name == "admin";
         }
     } catch (const std::exception& e) {
-        std::cerr << "[Database] Error checking admin status: " << e.what() << std::endl;
+        logging::error("Database", "QueryFailed", {{"method", "isUserAdmin"}, {"error", e.what()}});
     }
     return false;
 }
 
 bool Database::assignRoleToUser(int user_id, int role_id) {
-    std::lock_guard<std::recursive_mutex> lock(mutex_);
+    static auto& latency = query_latency("assignRoleToUser");
+    const metrics::Timer timer(latency);
+    const tracing::ScopedSpan span("Database::assignRoleToUser", tracing::Kind::Client);
+    std::lock_guard<metrics::RecursiveMutex> lock(mutex_);
     ensureConnection();
     try {
         pqxx::work txn(conn);
@@ -495,13 +633,16 @@ bool Database::assignRoleToUser(int user_id, int role_id) {
         txn.commit();
         return true;
     } catch (const std::exception& e) {
-        std::cerr << "[Database] Error assigning role: " << e.what() << std::endl;
+        logging::error("Database", "QueryFailed", {{"method", "assignRoleToUser"}, {"error", e.what()}});
         return false;
     }
 }
 
 RoleRecord Database::getRole(int role_id) {
-    std::lock_guard<std::recursive_mutex> lock(mutex_);
+    static auto& latency = query_latency("getRole");
+    const metrics::Timer timer(latency);
+    const tracing::ScopedSpan span("Database::getRole", tracing::Kind::Client);
+    std::lock_guard<metrics::RecursiveMutex> lock(mutex_);
     ensureConnection();
     try {
         pqxx::work txn(conn);
@@ -529,13 +670,16 @@ RoleRecord Database::getRole(int role_id) {
             return role;
         }
     } catch (const std::exception& e) {
-        std::cerr << "[Database] Error getting role: " << e.what() << std::endl;
+        logging::error("Database", "QueryFailed", {{"method", "getRole"}, {"error", e.what()}});
     }
     return RoleRecord{0, "", "", {}};
 }
 
 std::optional<int> Database::getRoleIdByName(const std::string& role_name) {
-    std::lock_guard<std::recursive_mutex> lock(mutex_);
+    static auto& latency = query_latency("getRoleIdByName");
+    const metrics::Timer timer(latency);
+    const tracing::ScopedSpan span("Database::getRoleIdByName", tracing::Kind::Client);
+    std::lock_guard<metrics::RecursiveMutex> lock(mutex_);
     ensureConnection();
     try {
         pqxx::work txn(conn);
@@ -545,13 +689,16 @@ std::optional<int> Database::getRoleIdByName(const std::string& role_name) {
         if (r.empty()) return std::nullopt;
         return r[0]["id_roles"].as<int>();
     } catch (const std::exception& e) {
-        std::cerr << "[Database] Error getting role id by name: " << e.what() << std::endl;
+        logging::error("Database", "QueryFailed", {{"method", "getRoleIdByName"}, {"error", e.what()}});
         return std::nullopt;
     }
 }
 
 bool Database::createRole(const std::string& name, const std::string& description) {
-    std::lock_guard<std::recursive_mutex> lock(mutex_);
+    static auto& latency = query_latency("createRole");
+    const metrics::Timer timer(latency);
+    const tracing::ScopedSpan span("Database::createRole", tracing::Kind::Client);
+    std::lock_guard<metrics::RecursiveMutex> lock(mutex_);
     ensureConnection();
     try {
         pqxx::work txn(conn);
@@ -561,13 +708,16 @@ bool Database::createRole(const std::string& name, const std::string& descriptio
         txn.commit();
         return true;
     } catch (const std::exception& e) {
-        std::cerr << "[Database] Error creating role: " << e.what() << std::endl;
+        logging::error("Database", "QueryFailed", {{"method", "createRole"}, {"error", e.what()}});
         return false;
     }
 }
 
 std::vector<RoleRecord> Database::listRoles() {
-    std::lock_guard<std::recursive_mutex> lock(mutex_);
+    static auto& latency = query_latency("listRoles");
+    const metrics::Timer timer(latency);
+    const tracing::ScopedSpan span("Database::listRoles", tracing::Kind::Client);
+    std::lock_guard<metrics::RecursiveMutex> lock(mutex_);
     ensureConnection();
     std::vector<RoleRecord> roles;
     try {
@@ -595,13 +745,16 @@ std::vector<RoleRecord> Database::listRoles() {
             roles.push_back(role);
         }
     } catch (const std::exception& e) {
-        std::cerr << "[Database] Error listing roles: " << e.what() << std::endl;
+        logging::error("Database", "QueryFailed", {{"method", "listRoles"}, {"error", e.what()}});
     }
     return roles;
 }
 
 bool Database::addPermissionToRole(int role_id, const std::string& permission) {
-    std::lock_guard<std::recursive_mutex> lock(mutex_);
+    static auto& latency = query_latency("addPermissionToRole");
+    const metrics::Timer timer(latency);
+    const tracing::ScopedSpan span("Database::addPermissionToRole", tracing::Kind::Client);
+    std::lock_guard<metrics::RecursiveMutex> lock(mutex_);
     ensureConnection();
     try {
         pqxx::work txn(conn);
@@ -620,7 +773,7 @@ bool Database::addPermissionToRole(int role_id, const std::string& permission) {
                 "SELECT id_permissions FROM permissions WHERE name = $1",
                 permission);
             if (perm_r.empty()) {
-                std::cerr << "[Database] Permission not found and could not be created: " << permission << std::endl;
+                logging::error("Database", "PermissionNotCreated", {{"permission", permission}});
                 return false;
             }
         }
@@ -637,7 +790,7 @@ bool Database::addPermissionToRole(int role_id, const std::string& permission) {
         txn.commit();
         return true;
     } catch (const std::exception& e) {
-        std::cerr << "[Database] Error adding permission to role: " << e.what() << std::endl;
+        logging::error("Database", "QueryFailed", {{"method", "addPermissionToRole"}, {"error", e.what()}});
         return false;
     }
 }
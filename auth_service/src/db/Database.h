@@ -5,6 +5,8 @@
 #include <vector>
 #include <mutex>
 
+#include "ProfiledMutex.h"
+
 struct UserRecord {
     int id;                 // maps to users.id_users
     std::string email;      // users.email
@@ -28,7 +30,7 @@ private:
 
     // pqxx::connection / transactions are not thread-safe.
     // gRPC handlers can run concurrently, so serialize DB access.
-    mutable std::recursive_mutex mutex_;
+    mutable metrics::RecursiveMutex mutex_{"Database::mutex_"};
 
     // Assure qu'une connexion ouverte est disponible, sinon tente une reconnexion.
     void ensureConnection();
@@ -47,8 +49,14 @@ public:
     bool setUserTokenJti(int user_id, const std::string& token_jti);
     bool isTokenRevoked(const std::string& token_jti);
     bool revokeTokenJti(const std::string& token_jti);
+    // Revocations still relevant (younger than the longest token lifetime), for WatchRevocations snapshots.
+    std::vector<std::string> listRevokedJtisSince(int max_age_days);
 
     std::vector<UserRecord> listUsers();
+    // Utilisateurs dont l'email figure dans la liste (email = ANY($1), index unique sur email).
+    std::vector<UserRecord> getUsersByEmails(const std::vector<std::string>& emails);
+    // Compteur data_versions.version (0 si absent), incrémenté par trigger à chaque changement.
+    long long getDataVersion(const std::string& name);
 
     // Admin helpers
     bool deleteUserById(int user_id);
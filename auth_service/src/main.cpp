@@ -1,11 +1,17 @@
+#include <cstdlib>
 #include <iostream>
 #include <memory>
 #include <string>
+#include <vector>
 #include <grpcpp/grpcpp.h>
+#include <grpcpp/health_check_service_interface.h>
 #include "service/AuthServiceImpl.h"
 #include "core/AuthManager.h"
 #include "db/Database.h"
 #include "utils/EnvLoader.h"
+#include "GrpcMetrics.h"
+#include "GrpcTracing.h"
+#include "Logger.h"
 #if defined(_WIN32)
 #include <windows.h>
 #endif
@@ -15,6 +21,13 @@ using grpc::ServerBuilder;
 using grpc::ServerContext;
 using grpc::Status;
 
+// Métriques puis traces, pour chaque RPC.
+static std::vector<std::unique_ptr<grpc::experimental::ServerInterceptorFactoryInterface>> server_interceptors() {
+    auto interceptors = metrics::serverInterceptors();
+    interceptors.push_back(tracing::serverInterceptorFactory());
+    return interceptors;
+}
+
 void RunServer() {
     // Charger les variables d'environnement (.env)
     // 1) Dossier courant
@@ -93,11 +106,27 @@ void RunServer() {
     // Créer l’implémentation du service
     AuthServiceImpl service(authManager, database);
 
+    // grpc.health.v1: le gateway retire de la rotation une réplique qui ne répond plus SERVING
+    grpc::EnableDefaultHealthCheckService(true);
+
+    // GET /metrics sur un port annexe (METRICS_PORT, 0 pour désactiver)
+    if (const int metricsPort = metrics::serveFromEnv(9101)) {
+        logging::info("auth-service", "Metrics", {{"port", metricsPort}});
+    } else {
+        logging::warn("auth-service", "Metrics", {{"result", "disabled_or_bind_failed"}});
+    }
+
+    // Traces OTLP/JSON (TRACE_EXPORT_FILE, TRACE_SAMPLE_RATIO)
+    if (tracing::initFromEnv("auth-service")) {
+        logging::info("auth-service", "Tracing", {{"file", std::getenv("TRACE_EXPORT_FILE")}});
+    }
+
     // Configurer et lancer le serveur avec vérification du port
     ServerBuilder builder;
     int boundPort = 0;
     builder.AddListeningPort(serverAddress, grpc::InsecureServerCredentials(), &boundPort);
     builder.RegisterService(&service);
+    builder.experimental().SetInterceptorCreators(server_interceptors());
 
     if (boundPort == 0) {
         std::cerr << "❌ Échec de binding sur " << serverAddress << " (port occupé?). Tentative fallback..." << std::endl;
@@ -109,6 +138,7 @@ void RunServer() {
             std::string addr = (p == 0) ? std::string("0.0.0.0:0") : ("0.0.0.0:" + std::to_string(p));
             retryBuilder.AddListeningPort(addr, grpc::InsecureServerCredentials(), &retryPort);
             retryBuilder.RegisterService(&service);
+            retryBuilder.experimental().SetInterceptorCreators(server_interceptors());
             auto retryServer = retryBuilder.BuildAndStart();
             if (retryServer && retryPort != 0) {
                 std::cout << "✅ Serveur lancé sur port fallback " << retryPort << std::endl;
@@ -1,8 +1,8 @@
 #include "service/AuthServiceImpl.h"
-#include <iostream>
 #include <stdexcept>
 #include <pqxx/pqxx>
 #include "core/PasswordHasher.h"
+#include "Logger.h"
 #include <random>
 
 namespace {
@@ -42,6 +42,9 @@ std::string random_hex(size_t bytes) {
     return out;
 }
 
+// Longest token lifetime: older revocations can't match a token that still verifies.
+constexpr int kRefreshTtlDays = 30;
+
 std::optional<int> parse_int(const std::string& s) {
     if (s.empty()) return std::nullopt;
     try {
@@ -84,7 +87,7 @@ Status AuthServiceImpl::RegisterUser(ServerContext* context,
             return Status(StatusCode::PERMISSION_DENIED, "Missing admin token");
         }
 
-        std::cout << "[AuthService] RegisterUser: email=" << email << std::endl;
+        logging::info("AuthService", "RegisterUser", {{"email", email}});
 
         // Validation basique des champs requis
         if (fullName.empty() || email.empty() || password.empty()) {
@@ -95,7 +98,7 @@ Status AuthServiceImpl::RegisterUser(ServerContext* context,
 
         // Vérifie si l'utilisateur existe déjà
         if (database_->userExists(email)) {
-            std::cout << "[AuthService] RegisterUser: already exists" << std::endl;
+            logging::info("AuthService", "RegisterUser", {{"email", email}, {"result", "already_exists"}});
             response->set_success(false);
             response->set_message("Utilisateur déjà existant.");
             return Status(StatusCode::ALREADY_EXISTS, "User already exists");
@@ -109,12 +112,12 @@ Status AuthServiceImpl::RegisterUser(ServerContext* context,
         try {
             database_->registerUserWithRole(fullName, email, hashedPassword, roleName);
         } catch (const pqxx::sql_error& se) {
-            std::cerr << "[AuthService] RegisterUser SQL error: " << se.what() << std::endl;
+            logging::error("AuthService", "RegisterUser", {{"email", email}, {"sql_error", se.what()}});
             response->set_success(false);
             response->set_message("Erreur SQL lors de l'inscription.");
             return Status(StatusCode::INTERNAL, "DB error");
         } catch (const std::exception& e) {
-            std::cerr << "[AuthService] RegisterUser error: " << e.what() << std::endl;
+            logging::error("AuthService", "RegisterUser", {{"email", email}, {"error", e.what()}});
             response->set_success(false);
             response->set_message("Erreur lors de l'inscription.");
             return Status(StatusCode::INTERNAL, e.what());
@@ -122,10 +125,10 @@ Status AuthServiceImpl::RegisterUser(ServerContext* context,
 
         response->set_success(true);
         response->set_message("Utilisateur créé avec succès.");
-        std::cout << "[AuthService] RegisterUser: success" << std::endl;
+        logging::info("AuthService", "RegisterUser", {{"email", email}, {"result", "success"}});
         return Status::OK;
     } catch (const std::exception& e) {
-        std::cerr << "[AuthService] RegisterUser exception: " << e.what() << std::endl;
+        logging::error("AuthService", "RegisterUser", {{"error", e.what()}});
         return Status(StatusCode::INTERNAL, e.what());
     }
 }
@@ -142,18 +145,17 @@ Status AuthServiceImpl::Login(ServerContext* context,
         std::string email = request->username();
         std::string password = request->password();
 
-        std::cout << "[AuthService] Login: email=" << email << std::endl;
 
         auto userOpt = database_->getUserByEmail(email);
         if (!userOpt.has_value()) {
-            std::cout << "[AuthService] Login: user not found" << std::endl;
+            logging::info("AuthService", "Login", {{"email", email}, {"result", "user_not_found"}});
             return Status(StatusCode::NOT_FOUND, "Utilisateur introuvable");
         }
 
         auto user = userOpt.value();
         const bool password_ok = PasswordHasher::verifyPassword(password, user.password_hash);
         if (!password_ok) {
-            std::cout << "[AuthService] Login: wrong password" << std::endl;
+            logging::info("AuthService", "Login", {{"email", email}, {"result", "wrong_password"}});
             return Status(StatusCode::UNAUTHENTICATED, "Mot de passe incorrect");
         }
 
@@ -162,14 +164,12 @@ Status AuthServiceImpl::Login(ServerContext* context,
             try {
                 const std::string new_hash = PasswordHasher::hashPassword(password);
                 if (!database_->updateUserPasswordHash(user.id, new_hash)) {
-                    std::cerr << "[AuthService] Login: failed to upgrade legacy password hash for user_id="
-                              << user.id << std::endl;
+                    logging::error("AuthService", "PasswordHashUpgrade", {{"user_id", user.id}, {"result", "failed"}});
                 } else {
-                    std::cout << "[AuthService] Login: upgraded legacy password hash for user_id="
-                              << user.id << std::endl;
+                    logging::info("AuthService", "PasswordHashUpgrade", {{"user_id", user.id}, {"result", "success"}});
                 }
             } catch (const std::exception& e) {
-                std::cerr << "[AuthService] Login: password hash upgrade exception: " << e.what() << std::endl;
+                logging::error("AuthService", "PasswordHashUpgrade", {{"user_id", user.id}, {"error", e.what()}});
             }
         }
 
@@ -180,13 +180,14 @@ Status AuthServiceImpl::Login(ServerContext* context,
         const auto previousJti = database_->getUserTokenJti(user.id);
         if (previousJti.has_value() && !previousJti->empty()) {
             (void)database_->revokeTokenJti(*previousJti);
+            revocations_.publish(std::to_string(user.id), *previousJti);
         }
         const std::string jti = random_hex(16);
         (void)database_->setUserTokenJti(user.id, jti);
 
         // Générer un access token enrichi + un refresh token
         const int accessTtlSeconds = 3600; // 1h
-        const int refreshTtlSeconds = 30 * 86400; // 30j
+        const int refreshTtlSeconds = kRefreshTtlDays * 86400; // 30j
         std::string token = authManager_->generateAccessToken(
             std::to_string(user.id),
             user.email,
@@ -212,11 +213,14 @@ Status AuthServiceImpl::Login(ServerContext* context,
             response->add_permissions(perm);
         }
         
-        std::cout << "[AuthService] Login: success, role=" << user.role_name 
-                  << ", permissions=" << permissions.size() << std::endl;
+        logging::info("AuthService", "Login",
+                      {{"email", email},
+                       {"result", "success"},
+                       {"role", user.role_name},
+                       {"permissions", permissions.size()}});
         return Status::OK;
     } catch (const std::exception& e) {
-        std::cerr << "[AuthService] Login exception: " << e.what() << std::endl;
+        logging::error("AuthService", "Login", {{"error", e.what()}});
         return Status(StatusCode::INTERNAL, e.what());
     }
 }
@@ -230,7 +234,6 @@ Status AuthServiceImpl::ValidateToken(ServerContext* context,
     try {
     (void)context;
         const std::string token = request->access_token();
-        std::cout << "[AuthService] ValidateToken: verifying" << std::endl;
         const auto info = authManager_->decodeToken(token);
         bool valid = info.valid;
         if (valid && !info.jti.empty()) {
@@ -256,10 +259,14 @@ Status AuthServiceImpl::ValidateToken(ServerContext* context,
                 response->add_permissions(perm);
             }
         }
-        std::cout << "[AuthService] ValidateToken: valid=" << (info.valid ? "true" : "false") << std::endl;
+        // Appel le plus fréquent: journal de debug échantillonné.
+        static logging::Sampler sample(100);
+        if (logging::enabled(logging::Level::Debug) && sample.take()) {
+            logging::debug("AuthService", "ValidateToken", {{"valid", valid}, {"user_id", info.userId}});
+        }
         return Status::OK;
     } catch (const std::exception& e) {
-        std::cerr << "[AuthService] ValidateToken exception: " << e.what() << std::endl;
+        logging::error("AuthService", "ValidateToken", {{"error", e.what()}});
         return Status(StatusCode::INTERNAL, e.what());
     }
 }
@@ -290,7 +297,52 @@ Status AuthServiceImpl::ListUsers(ServerContext*,
         }
         return Status::OK;
     } catch (const std::exception& e) {
-        std::cerr << "[AuthService] ListUsers exception: " << e.what() << std::endl;
+        logging::error("AuthService", "ListUsers", {{"error", e.what()}});
+        return Status(StatusCode::INTERNAL, e.what());
+    }
+}
+
+Status AuthServiceImpl::GetDirectoryVersion(ServerContext*,
+                                           const securecloud::auth::DirectoryVersionRequest* request,
+                                           securecloud::auth::DirectoryVersionResponse* response) {
+    try {
+        const auto info = authManager_->decodeToken(request->access_token());
+        if (!info.valid) {
+            return Status(StatusCode::UNAUTHENTICATED, "Invalid token");
+        }
+        response->set_version(database_->getDataVersion("directory"));
+        return Status::OK;
+    } catch (const std::exception& e) {
+        logging::error("AuthService", "GetDirectoryVersion", {{"error", e.what()}});
+        return Status(StatusCode::INTERNAL, e.what());
+    }
+}
+
+Status AuthServiceImpl::ResolveUsersByEmail(ServerContext*,
+                                           const securecloud::auth::ResolveUsersByEmailRequest* request,
+                                           securecloud::auth::ResolveUsersByEmailResponse* response) {
+    // Borne la taille du tableau envoyé à Postgres (un salon ne compte pas des milliers de membres).
+    constexpr int kMaxEmails = 1000;
+    try {
+        const auto info = authManager_->decodeToken(request->access_token());
+        if (!info.valid) {
+            return Status(StatusCode::UNAUTHENTICATED, "Invalid token");
+        }
+        if (request->emails_size() > kMaxEmails) {
+            return Status(StatusCode::INVALID_ARGUMENT, "Too many emails");
+        }
+
+        const std::vector<std::string> emails(request->emails().begin(), request->emails().end());
+        for (const auto& u : database_->getUsersByEmails(emails)) {
+            auto* out = response->add_users();
+            out->set_user_id(std::to_string(u.id));
+            out->set_full_name(u.full_name);
+            out->set_email(u.email);
+            out->set_role(u.role_name);
+        }
+        return Status::OK;
+    } catch (const std::exception& e) {
+        logging::error("AuthService", "ResolveUsersByEmail", {{"error", e.what()}});
         return Status(StatusCode::INTERNAL, e.what());
     }
 }
@@ -357,7 +409,7 @@ Status AuthServiceImpl::RefreshToken(ServerContext* context,
         response->set_expires_in(accessTtlSeconds);
         return Status::OK;
     } catch (const std::exception& e) {
-        std::cerr << "[AuthService] RefreshToken exception: " << e.what() << std::endl;
+        logging::error("AuthService", "RefreshToken", {{"error", e.what()}});
         return Status(StatusCode::INTERNAL, e.what());
     }
 }
@@ -413,12 +465,70 @@ Status AuthServiceImpl::RevokeTokens(ServerContext* context,
             (void)database_->revokeTokenJti(*currentJti);
         }
         (void)database_->setUserTokenJti(*uid, std::string()); // clear
+        revocations_.publish(targetUserId, currentJti.value_or(std::string()));
         response->set_success(true);
         return Status::OK;
     } catch (const std::exception& e) {
-        std::cerr << "[AuthService] RevokeTokens exception: " << e.what() << std::endl;
+        logging::error("AuthService", "RevokeTokens", {{"error", e.what()}});
+        return Status(StatusCode::INTERNAL, e.what());
+    }
+}
+
+// ----------------------------
+// Flux des révocations
+// ----------------------------
+Status AuthServiceImpl::WatchRevocations(ServerContext* context,
+                                         const securecloud::auth::WatchRevocationsRequest* request,
+                                         grpc::ServerWriter<securecloud::auth::RevocationEvent>* writer) {
+    if (!context || !writer) {
+        return Status(StatusCode::INTERNAL, "Internal error");
+    }
+    logging::info("AuthService", "WatchRevocations",
+                  {{"subscriber", request && !request->client_id().empty() ? request->client_id() : std::string("?")}});
+
+    // Every reset (stream start, or events lost by a slow subscriber) is followed by a snapshot
+    // of the still-relevant revoked jtis and a synced marker, so the subscriber can rebuild its
+    // revocation set and check tokens locally without missing anything.
+    std::uint64_t seq = 0;
+    const auto sendSnapshot = [&]() {
+        seq = revocations_.currentSequence();
+        securecloud::auth::RevocationEvent ev;
+        ev.set_sequence(seq);
+        ev.set_reset(true);
+        if (!writer->Write(ev)) return false;
+        ev.set_reset(false);
+        for (const auto& jti : database_->listRevokedJtisSince(kRefreshTtlDays + 1)) {
+            ev.set_jti(jti);
+            if (!writer->Write(ev)) return false;
+        }
+        ev.clear_jti();
+        ev.set_synced(true);
+        return writer->Write(ev);
+    };
+
+    try {
+        if (!sendSnapshot()) return Status::CANCELLED;
+        while (!context->IsCancelled()) {
+            bool gap = false;
+            const auto events = revocations_.waitAfter(seq, std::chrono::seconds(1), &gap);
+            if (gap) {
+                if (!sendSnapshot()) break;
+                continue;
+            }
+            for (const auto& e : events) {
+                securecloud::auth::RevocationEvent out;
+                out.set_sequence(e.sequence);
+                out.set_user_id(e.userId);
+                out.set_jti(e.jti);
+                if (!writer->Write(out)) return Status::CANCELLED;
+                seq = e.sequence;
+            }
+        }
+    } catch (const std::exception& e) {
+        logging::error("AuthService", "WatchRevocations", {{"error", e.what()}});
         return Status(StatusCode::INTERNAL, e.what());
     }
+    return Status::OK;
 }
 
 Status AuthServiceImpl::DeleteUser(ServerContext* context,
@@ -458,6 +568,9 @@ Status AuthServiceImpl::DeleteUser(ServerContext* context,
             return Status(StatusCode::INVALID_ARGUMENT, "Invalid user_id");
         }
 
+        // Revoke the live session first: gateways verifying tokens locally only know about jtis.
+        const auto currentJti = database_->getUserTokenJti(*uid);
+
         const bool ok = database_->deleteUserById(*uid);
         if (!ok) {
             response->set_success(false);
@@ -465,11 +578,15 @@ Status AuthServiceImpl::DeleteUser(ServerContext* context,
             return Status(StatusCode::NOT_FOUND, "User not found");
         }
 
+        if (currentJti.has_value() && !currentJti->empty()) {
+            (void)database_->revokeTokenJti(*currentJti);
+        }
+        revocations_.publish(targetUserId, currentJti.value_or(std::string()));
         response->set_success(true);
         response->set_message("Utilisateur supprimé.");
         return Status::OK;
     } catch (const std::exception& e) {
-        std::cerr << "[AuthService] DeleteUser exception: " << e.what() << std::endl;
+        logging::error("AuthService", "DeleteUser", {{"error", e.what()}});
         if (response) {
             response->set_success(false);
             response->set_message("Erreur interne.");
@@ -516,7 +633,7 @@ Status AuthServiceImpl::AssignRole(ServerContext* context,
         response->set_message(ok ? "Rôle assigné avec succès." : "Erreur lors de l'assignation du rôle.");
         return ok ? Status::OK : Status(StatusCode::INTERNAL, "Failed to assign role");
     } catch (const std::exception& e) {
-        std::cerr << "[AuthService] AssignRole exception: " << e.what() << std::endl;
+        logging::error("AuthService", "AssignRole", {{"error", e.what()}});
         response->set_success(false);
         response->set_message("Erreur interne.");
         return Status(StatusCode::INTERNAL, e.what());
@@ -569,7 +686,7 @@ Status AuthServiceImpl::CreateRole(ServerContext* context,
         response->set_message("Rôle créé avec succès.");
         return Status::OK;
     } catch (const std::exception& e) {
-        std::cerr << "[AuthService] CreateRole exception: " << e.what() << std::endl;
+        logging::error("AuthService", "CreateRole", {{"error", e.what()}});
         response->set_success(false);
         response->set_message("Erreur interne.");
         return Status(StatusCode::INTERNAL, e.what());
@@ -597,7 +714,7 @@ Status AuthServiceImpl::ListRoles(ServerContext* context,
 
         return Status::OK;
     } catch (const std::exception& e) {
-        std::cerr << "[AuthService] ListRoles exception: " << e.what() << std::endl;
+        logging::error("AuthService", "ListRoles", {{"error", e.what()}});
         return Status(StatusCode::INTERNAL, e.what());
     }
 }
@@ -629,7 +746,7 @@ Status AuthServiceImpl::GetUserPermissions(ServerContext* context,
 
         return Status::OK;
     } catch (const std::exception& e) {
-        std::cerr << "[AuthService] GetUserPermissions exception: " << e.what() << std::endl;
+        logging::error("AuthService", "GetUserPermissions", {{"error", e.what()}});
         return Status(StatusCode::INTERNAL, e.what());
     }
 }
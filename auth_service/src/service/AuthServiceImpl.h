@@ -3,6 +3,7 @@
 #include "../build/generated/auth.grpc.pb.h"
 #include "../db/Database.h"
 #include "../core/AuthManager.h"
+#include "RevocationHub.h"
 
 using grpc::Server;
 using grpc::ServerBuilder;
@@ -14,6 +15,7 @@ class AuthServiceImpl final : public securecloud::auth::AuthService::Service {
 private:
     std::shared_ptr<Database> database_;
     std::shared_ptr<AuthManager> authManager_;
+    RevocationHub revocations_;
 
 public:
     AuthServiceImpl(std::shared_ptr<AuthManager> auth, std::shared_ptr<Database> db);
@@ -34,6 +36,14 @@ public:
                         const securecloud::auth::ListUsersRequest* request,
                         securecloud::auth::ListUsersResponse* response) override;
 
+    Status GetDirectoryVersion(ServerContext* context,
+                              const securecloud::auth::DirectoryVersionRequest* request,
+                              securecloud::auth::DirectoryVersionResponse* response) override;
+
+    Status ResolveUsersByEmail(ServerContext* context,
+                              const securecloud::auth::ResolveUsersByEmailRequest* request,
+                              securecloud::auth::ResolveUsersByEmailResponse* response) override;
+
     Status RefreshToken(ServerContext* context,
                        const securecloud::auth::RefreshTokenRequest* request,
                        securecloud::auth::RefreshTokenResponse* response) override;
@@ -42,6 +52,10 @@ public:
                        const securecloud::auth::RevokeTokensRequest* request,
                        securecloud::auth::RevokeTokensResponse* response) override;
 
+    Status WatchRevocations(ServerContext* context,
+                           const securecloud::auth::WatchRevocationsRequest* request,
+                           grpc::ServerWriter<securecloud::auth::RevocationEvent>* writer) override;
+
     Status DeleteUser(ServerContext* context,
                      const securecloud::auth::DeleteUserRequest* request,
                      securecloud::auth::DeleteUserResponse* response) override;
@@ -0,0 +1,38 @@
+#include "service/RevocationHub.h"
+#include "Metrics.h"
+
+void RevocationHub::publish(const std::string& userId, const std::string& jti) {
+    static auto& published = metrics::registry().counter("auth_revocations_published_total",
+                                                         "Revocations broadcast to WatchRevocations subscribers");
+    published.inc();
+    {
+        std::lock_guard<std::mutex> lk(m_);
+        backlog_.push_back(Event{++sequence_, userId, jti});
+        if (backlog_.size() > kBacklog) backlog_.pop_front();
+    }
+    cv_.notify_all();
+}
+
+std::uint64_t RevocationHub::currentSequence() {
+    std::lock_guard<std::mutex> lk(m_);
+    return sequence_;
+}
+
+std::vector<RevocationHub::Event> RevocationHub::waitAfter(std::uint64_t afterSequence,
+                                                           std::chrono::milliseconds timeout,
+                                                           bool* gap) {
+    static auto& waiting = metrics::registry().gauge("auth_revocation_waiters",
+                                                     "WatchRevocations streams waiting for the next revocation");
+    waiting.add(1);
+    std::unique_lock<std::mutex> lk(m_);
+    cv_.wait_for(lk, timeout, [&] { return sequence_ > afterSequence; });
+    waiting.add(-1);
+
+    if (gap) *gap = !backlog_.empty() && backlog_.front().sequence > afterSequence + 1;
+
+    std::vector<Event> out;
+    for (const auto& e : backlog_) {
+        if (e.sequence > afterSequence) out.push_back(e);
+    }
+    return out;
+}
@@ -0,0 +1,36 @@
+#pragma once
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <mutex>
+#include <string>
+#include <vector>
+
+// Diffusion en mémoire des révocations vers les abonnés WatchRevocations.
+// Les derniers événements sont conservés pour qu'un abonné un peu en retard ne perde rien ;
+// au-delà, il reçoit un événement reset.
+class RevocationHub {
+public:
+    struct Event {
+        std::uint64_t sequence = 0;
+        std::string userId;
+        std::string jti;
+    };
+
+    void publish(const std::string& userId, const std::string& jti);
+
+    std::uint64_t currentSequence();
+
+    // Events with sequence > afterSequence, waiting up to timeout for the first one.
+    // *gap is set when some of them were already dropped from the backlog.
+    std::vector<Event> waitAfter(std::uint64_t afterSequence, std::chrono::milliseconds timeout, bool* gap);
+
+private:
+    static constexpr size_t kBacklog = 1024;
+
+    std::mutex m_;
+    std::condition_variable cv_;
+    std::deque<Event> backlog_;
+    std::uint64_t sequence_ = 0;
+};
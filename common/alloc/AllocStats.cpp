@@ -0,0 +1,39 @@
+#include "AllocStats.h"
+
+#include <cstdlib>
+#include <new>
+
+namespace {
+thread_local std::uint64_t t_allocations = 0;
+thread_local std::uint64_t t_bytes = 0;
+
+void* counted_alloc(std::size_t size) {
+    ++t_allocations;
+    t_bytes += size;
+    return std::malloc(size == 0 ? 1 : size);
+}
+}
+
+namespace AllocStats {
+Snapshot thread_snapshot() {
+    return Snapshot{t_allocations, t_bytes};
+}
+}
+
+// The array, nothrow and sized forms of the default library all funnel into these.
+void* operator new(std::size_t size) {
+    if (void* p = counted_alloc(size)) return p;
+    throw std::bad_alloc();
+}
+
+void* operator new(std::size_t size, const std::nothrow_t&) noexcept {
+    return counted_alloc(size);
+}
+
+void operator delete(void* p) noexcept {
+    std::free(p);
+}
+
+void operator delete(void* p, std::size_t) noexcept {
+    std::free(p);
+}
@@ -0,0 +1,31 @@
+#pragma once
+
+#include <cstdint>
+
+// Heap allocation counters. AllocStats.cpp replaces the global operator new/delete and counts
+// per thread (no shared cache line on the hot path), which is exactly what a request handler
+// running on one thread needs to measure its own cost.
+namespace AllocStats {
+
+struct Snapshot {
+    std::uint64_t allocations = 0;
+    std::uint64_t bytes = 0;
+};
+
+// Totals for the calling thread since it started.
+Snapshot thread_snapshot();
+
+// Allocations made by the calling thread between construction and delta().
+class Scope {
+public:
+    Scope() : start_(thread_snapshot()) {}
+    Snapshot delta() const {
+        const Snapshot now = thread_snapshot();
+        return Snapshot{now.allocations - start_.allocations, now.bytes - start_.bytes};
+    }
+
+private:
+    Snapshot start_;
+};
+
+}
@@ -0,0 +1,325 @@
+#include "Logger.h"
+
+#include <algorithm>
+#include <charconv>
+#include <chrono>
+#include <condition_variable>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <ctime>
+#include <memory>
+#include <mutex>
+#include <thread>
+
+namespace logging {
+
+namespace detail {
+std::atomic<int> minLevel{-1};
+
+int initLevel() {
+    const char* env = std::getenv("LOG_LEVEL");
+    const Level level = parseLevel(env ? env : "", Level::Info);
+    int expected = -1;
+    minLevel.compare_exchange_strong(expected, static_cast<int>(level), std::memory_order_relaxed);
+    return minLevel.load(std::memory_order_relaxed);
+}
+}  // namespace detail
+
+namespace {
+
+constexpr size_t kTextBytes = 480;
+constexpr size_t kBatchRecords = 1024;
+
+// One line, formatted by the caller except for the timestamp and level.
+struct Slot {
+    // Vyukov's bounded queue: == position when free, position + 1 once published.
+    std::atomic<std::uint64_t> seq{0};
+    std::int64_t timeUs = 0;
+    Level level = Level::Info;
+    std::uint16_t len = 0;
+    char text[kTextBytes];
+};
+
+size_t records_from_env() {
+    size_t records = 8192;
+    if (const char* v = std::getenv("LOG_BUFFER_RECORDS"); v && *v) {
+        const long long n = std::atoll(v);
+        if (n > 0) records = static_cast<size_t>(n);
+    }
+    size_t pow2 = 64;
+    while (pow2 < records && pow2 < (size_t{1} << 24)) pow2 <<= 1;
+    return pow2;
+}
+
+const char* level_name(Level level) {
+    switch (level) {
+    case Level::Debug: return "DEBUG";
+    case Level::Info: return "INFO";
+    case Level::Warn: return "WARN";
+    case Level::Error: return "ERROR";
+    default: return "";
+    }
+}
+
+// Appends into a fixed buffer, silently truncating.
+struct LineWriter {
+    char* data;
+    size_t cap;
+    size_t len = 0;
+
+    void put(char c) {
+        if (len < cap) data[len++] = c;
+    }
+    void put(std::string_view s) {
+        const size_t n = std::min(s.size(), cap - len);
+        std::memcpy(data + len, s.data(), n);
+        len += n;
+    }
+    void value(std::string_view v) {
+        const bool quote = v.empty() || std::any_of(v.begin(), v.end(), [](char c) {
+            return c == ' ' || c == '"' || c == '=' || static_cast<unsigned char>(c) < 0x20;
+        });
+        if (!quote) {
+            put(v);
+            return;
+        }
+        put('"');
+        for (const char c : v) {
+            if (c == '"' || c == '\\') {
+                put('\\');
+                put(c);
+            } else if (c == '\n') {
+                put("\\n");
+            } else if (static_cast<unsigned char>(c) < 0x20) {
+                put(' ');
+            } else {
+                put(c);
+            }
+        }
+        put('"');
+    }
+};
+
+class Logger {
+public:
+    Logger() : capacity_(records_from_env()), mask_(capacity_ - 1), slots_(new Slot[capacity_]) {
+        for (size_t i = 0; i < capacity_; ++i) slots_[i].seq.store(i, std::memory_order_relaxed);
+        std::thread([this]() { run(); }).detach();
+    }
+
+    void write(Level level, std::string_view component, std::string_view event, std::initializer_list<Field> fields) {
+        std::uint64_t pos = tail_.load(std::memory_order_relaxed);
+        Slot* slot = nullptr;
+        for (;;) {
+            slot = &slots_[pos & mask_];
+            const std::uint64_t seq = slot->seq.load(std::memory_order_acquire);
+            const auto diff = static_cast<std::int64_t>(seq - pos);
+            if (diff == 0) {
+                if (tail_.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed)) break;
+            } else if (diff < 0) {
+                dropped_.fetch_add(1, std::memory_order_relaxed);  // full: never wait for the sink
+                return;
+            } else {
+                pos = tail_.load(std::memory_order_relaxed);
+            }
+        }
+
+        slot->timeUs = std::chrono::duration_cast<std::chrono::microseconds>(
+                           std::chrono::system_clock::now().time_since_epoch())
+                           .count();
+        slot->level = level;
+        LineWriter line{slot->text, kTextBytes};
+        line.put(component);
+        line.put(' ');
+        line.put(event);
+        for (const auto& f : fields) {
+            line.put(' ');
+            line.put(f.key());
+            line.put('=');
+            if (f.isInt()) {
+                char digits[24];
+                const auto r = std::to_chars(digits, digits + sizeof(digits), f.integer());
+                line.put(std::string_view(digits, static_cast<size_t>(r.ptr - digits)));
+            } else {
+                line.value(f.text());
+            }
+        }
+        slot->len = static_cast<std::uint16_t>(line.len);
+        slot->seq.store(pos + 1, std::memory_order_release);
+
+        // Highest published position + 1, for flush(): tail_ also counts slots still being filled.
+        std::uint64_t published = published_.load(std::memory_order_relaxed);
+        while (published < pos + 1 &&
+               !published_.compare_exchange_weak(published, pos + 1, std::memory_order_release,
+                                                 std::memory_order_relaxed)) {
+        }
+
+        if (level >= Level::Error) wake_.notify_one();
+    }
+
+    // Every line whose write() returned before the call sits below published_; slots reserved
+    // above it by writers still formatting (or descheduled, or the caller itself from a signal
+    // handler) are not waited for.
+    void flush() {
+        const std::uint64_t target = published_.load(std::memory_order_acquire);
+        std::unique_lock<std::mutex> lk(m_);
+        flushRequested_ = true;
+        wake_.notify_one();
+        flushed_.wait(lk, [&]() { return consumed_ >= target; });
+    }
+
+    Stats stats() const {
+        Stats s;
+        s.written = written_.load(std::memory_order_relaxed);
+        s.dropped = dropped_.load(std::memory_order_relaxed);
+        return s;
+    }
+
+private:
+    void run() {
+        std::string out;
+        std::string err;
+        out.reserve(64 * 1024);
+        err.reserve(16 * 1024);
+        auto idle = std::chrono::milliseconds(1);
+        for (;;) {
+            const size_t n = drain(out, err);
+            reportDrops(err);
+            if (!out.empty()) {
+                std::fwrite(out.data(), 1, out.size(), stdout);
+                std::fflush(stdout);
+                out.clear();
+            }
+            if (!err.empty()) {
+                std::fwrite(err.data(), 1, err.size(), stderr);
+                std::fflush(stderr);
+                err.clear();
+            }
+            written_.fetch_add(n, std::memory_order_relaxed);
+
+            std::unique_lock<std::mutex> lk(m_);
+            consumed_ = head_;
+            flushed_.notify_all();
+            if (n > 0) {
+                idle = std::chrono::milliseconds(1);
+                continue;
+            }
+            if (!flushRequested_) {
+                // No notification from writers on the hot path: poll, backing off while idle.
+                wake_.wait_for(lk, idle);
+                idle = std::min(idle * 2, std::chrono::milliseconds(50));
+            }
+            flushRequested_ = false;
+        }
+    }
+
+    size_t drain(std::string& out, std::string& err) {
+        size_t n = 0;
+        for (; n < kBatchRecords; ++n) {
+            Slot& slot = slots_[head_ & mask_];
+            if (slot.seq.load(std::memory_order_acquire) != head_ + 1) break;
+            std::string& dst = slot.level >= Level::Warn ? err : out;
+            appendTimestamp(dst, slot.timeUs);
+            dst += ' ';
+            dst += level_name(slot.level);
+            dst += ' ';
+            dst.append(slot.text, slot.len);
+            dst += '\n';
+            slot.seq.store(head_ + capacity_, std::memory_order_release);
+            ++head_;
+        }
+        return n;
+    }
+
+    void reportDrops(std::string& err) {
+        const std::uint64_t dropped = dropped_.load(std::memory_order_relaxed);
+        if (dropped == reportedDrops_) return;
+        const auto now = std::chrono::duration_cast<std::chrono::microseconds>(
+                             std::chrono::system_clock::now().time_since_epoch())
+                             .count();
+        appendTimestamp(err, now);
+        err += " WARN logging dropped count=" + std::to_string(dropped - reportedDrops_) + "\n";
+        reportedDrops_ = dropped;
+    }
+
+    // 2026-01-31T12:00:00.123456Z; the date part is formatted once per second.
+    void appendTimestamp(std::string& dst, std::int64_t timeUs) {
+        const std::int64_t seconds = timeUs / 1000000;
+        if (seconds != cachedSecond_) {
+            const std::time_t t = static_cast<std::time_t>(seconds);
+            std::tm tm{};
+#if defined(_WIN32)
+            gmtime_s(&tm, &t);
+#else
+            gmtime_r(&t, &tm);
+#endif
+            std::strftime(cachedDate_, sizeof(cachedDate_), "%Y-%m-%dT%H:%M:%S", &tm);
+            cachedSecond_ = seconds;
+        }
+        char frac[16];
+        std::snprintf(frac, sizeof(frac), ".%06dZ", static_cast<int>(timeUs % 1000000));
+        dst += cachedDate_;
+        dst += frac;
+    }
+
+    const size_t capacity_;
+    const size_t mask_;
+    const std::unique_ptr<Slot[]> slots_;
+    alignas(64) std::atomic<std::uint64_t> tail_{0};
+    alignas(64) std::atomic<std::uint64_t> published_{0};
+    alignas(64) std::atomic<std::uint64_t> dropped_{0};
+    std::atomic<std::uint64_t> written_{0};
+
+    // Sink thread only.
+    std::uint64_t head_ = 0;
+    std::uint64_t reportedDrops_ = 0;
+    std::int64_t cachedSecond_ = -1;
+    char cachedDate_[32] = {};
+
+    std::mutex m_;
+    std::condition_variable wake_;
+    std::condition_variable flushed_;
+    std::uint64_t consumed_ = 0;  // under m_
+    bool flushRequested_ = false;
+};
+
+// Never destroyed: the sink thread outlives static destructors that may still log; exit() flushes.
+Logger& instance() {
+    static Logger* logger = [] {
+        auto* l = new Logger();
+        std::atexit([] { instance().flush(); });
+        return l;
+    }();
+    return *logger;
+}
+
+}  // namespace
+
+void write(Level level, std::string_view component, std::string_view event, std::initializer_list<Field> fields) {
+    if (level >= Level::Off) return;
+    instance().write(level, component, event, fields);
+}
+
+void setLevel(Level level) {
+    detail::minLevel.store(static_cast<int>(level), std::memory_order_relaxed);
+}
+
+Level parseLevel(std::string_view name, Level fallback) {
+    if (name == "debug") return Level::Debug;
+    if (name == "info") return Level::Info;
+    if (name == "warn" || name == "warning") return Level::Warn;
+    if (name == "error") return Level::Error;
+    if (name == "off") return Level::Off;
+    return fallback;
+}
+
+void flush() {
+    instance().flush();
+}
+
+Stats stats() {
+    return instance().stats();
+}
+
+}  // namespace logging
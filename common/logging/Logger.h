@@ -0,0 +1,98 @@
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+#include <initializer_list>
+#include <string>
+#include <string_view>
+#include <type_traits>
+
+// Asynchronous structured logging.
+// A call formats its line into a slot of a lock-free ring buffer and returns; a background thread
+// timestamps, batches and writes the lines (one write per batch instead of a flushed std::endl per
+// line). When the ring is full, lines are dropped and counted instead of blocking the caller.
+//
+//   2026-01-31T12:00:00.123456Z INFO AuthService Login email=a@b.c result=success
+//
+// LOG_LEVEL=debug|info|warn|error|off (default info), LOG_BUFFER_RECORDS (default 8192).
+// Warnings and errors go to stderr, the rest to stdout.
+namespace logging {
+
+enum class Level : int { Debug = 0, Info, Warn, Error, Off };
+
+// key=value; the value is quoted when it contains spaces, quotes or '='.
+class Field {
+public:
+    Field(std::string_view key, std::string_view value) : key_(key), text_(value) {}
+    Field(std::string_view key, const char* value) : key_(key), text_(value ? value : "") {}
+    Field(std::string_view key, const std::string& value) : key_(key), text_(value) {}
+    Field(std::string_view key, bool value) : key_(key), text_(value ? "true" : "false") {}
+    template <typename T, std::enable_if_t<std::is_integral_v<T> && !std::is_same_v<T, bool>, int> = 0>
+    Field(std::string_view key, T value) : key_(key), isInt_(true), int_(static_cast<long long>(value)) {}
+
+    std::string_view key() const { return key_; }
+    bool isInt() const { return isInt_; }
+    std::string_view text() const { return text_; }
+    long long integer() const { return int_; }
+
+private:
+    std::string_view key_;
+    std::string_view text_;
+    bool isInt_ = false;
+    long long int_ = 0;
+};
+
+namespace detail {
+extern std::atomic<int> minLevel;  // -1 until read from LOG_LEVEL
+int initLevel();
+}  // namespace detail
+
+inline bool enabled(Level level) {
+    int min = detail::minLevel.load(std::memory_order_relaxed);
+    if (min < 0) min = detail::initLevel();
+    return static_cast<int>(level) >= min;
+}
+
+// Never blocks on I/O. Lines longer than a ring slot are truncated.
+void write(Level level, std::string_view component, std::string_view event, std::initializer_list<Field> fields = {});
+
+inline void debug(std::string_view component, std::string_view event, std::initializer_list<Field> fields = {}) {
+    if (enabled(Level::Debug)) write(Level::Debug, component, event, fields);
+}
+inline void info(std::string_view component, std::string_view event, std::initializer_list<Field> fields = {}) {
+    if (enabled(Level::Info)) write(Level::Info, component, event, fields);
+}
+inline void warn(std::string_view component, std::string_view event, std::initializer_list<Field> fields = {}) {
+    if (enabled(Level::Warn)) write(Level::Warn, component, event, fields);
+}
+inline void error(std::string_view component, std::string_view event, std::initializer_list<Field> fields = {}) {
+    if (enabled(Level::Error)) write(Level::Error, component, event, fields);
+}
+
+void setLevel(Level level);
+// "debug", "info", "warn"/"warning", "error", "off"; anything else gives `fallback`.
+Level parseLevel(std::string_view name, Level fallback);
+
+// Waits until every line logged before the call has been written (shutdown, benchmarks).
+void flush();
+
+struct Stats {
+    std::uint64_t written = 0;
+    std::uint64_t dropped = 0;
+};
+Stats stats();
+
+// Lets one call in `everyN` through, for debug logs on hot paths:
+//   static logging::Sampler sample(100);
+//   if (logging::enabled(logging::Level::Debug) && sample.take()) logging::debug(...);
+class Sampler {
+public:
+    explicit Sampler(std::uint32_t everyN) : everyN_(everyN == 0 ? 1 : everyN) {}
+    bool take() { return everyN_ == 1 || counter_.fetch_add(1, std::memory_order_relaxed) % everyN_ == 0; }
+
+private:
+    const std::uint32_t everyN_;
+    std::atomic<std::uint32_t> counter_{0};
+};
+
+}  // namespace logging
@@ -0,0 +1,137 @@
+#pragma once
+
+#include "Metrics.h"
+
+#include <grpcpp/grpcpp.h>
+#include <grpcpp/support/server_interceptor.h>
+
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <iterator>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+// Per-RPC metrics for every handler of a gRPC server, as a server interceptor:
+//   grpc_server_started_total{grpc_service, grpc_method}
+//   grpc_server_handled_total{grpc_service, grpc_method, grpc_code}
+//   grpc_server_handling_seconds{grpc_service, grpc_method}   (histogram)
+//   grpc_server_active_streams{grpc_service, grpc_method}     (streaming RPCs in progress)
+//
+//   grpc::ServerBuilder builder;
+//   builder.experimental().SetInterceptorCreators(metrics::serverInterceptors());
+namespace metrics {
+
+namespace detail {
+
+inline const char* grpc_code_name(grpc::StatusCode code) {
+    static constexpr const char* kNames[] = {
+        "OK",          "CANCELLED",          "UNKNOWN",      "INVALID_ARGUMENT", "DEADLINE_EXCEEDED",
+        "NOT_FOUND",   "ALREADY_EXISTS",     "PERMISSION_DENIED", "RESOURCE_EXHAUSTED",
+        "FAILED_PRECONDITION", "ABORTED",    "OUT_OF_RANGE", "UNIMPLEMENTED",    "INTERNAL",
+        "UNAVAILABLE", "DATA_LOSS",          "UNAUTHENTICATED"};
+    const auto i = static_cast<size_t>(code);
+    return i < std::size(kNames) ? kNames[i] : "UNKNOWN";
+}
+
+struct RpcSeries {
+    Labels labels;
+    Counter* started = nullptr;
+    Histogram* handling = nullptr;
+    Gauge* activeStreams = nullptr;
+    std::array<std::atomic<Counter*>, 17> handled{};  // by status code, resolved on first use
+};
+
+// `method` is "/package.Service/Method"; gRPC keeps the string alive for the server's lifetime,
+// so its address is a stable key. Series live as long as the process (an RPC may finish on
+// another thread than the one that started it); each thread caches the lookup.
+inline RpcSeries& rpc_series(const char* method) {
+    thread_local std::unordered_map<const char*, RpcSeries*> local;
+    RpcSeries*& cached = local[method];
+    if (cached) return *cached;
+
+    static std::mutex m;
+    static auto* all = new std::unordered_map<const char*, std::unique_ptr<RpcSeries>>();
+    std::lock_guard<std::mutex> lk(m);
+    auto& slot = (*all)[method];
+    if (!slot) {
+        const std::string full = method ? method : "";
+        const auto slash = full.find('/', 1);
+        std::string service = slash == std::string::npos ? full : full.substr(1, slash - 1);
+        std::string name = slash == std::string::npos ? full : full.substr(slash + 1);
+        slot = std::make_unique<RpcSeries>();
+        slot->labels = {{"grpc_service", service}, {"grpc_method", name}};
+        auto& r = registry();
+        slot->started = &r.counter("grpc_server_started_total", "RPCs started on the server", slot->labels);
+        slot->handling = &r.histogram("grpc_server_handling_seconds",
+                                      "Time from the start of an RPC to its status being sent", slot->labels);
+        slot->activeStreams = &r.gauge("grpc_server_active_streams", "Streaming RPCs in progress", slot->labels);
+    }
+    cached = slot.get();
+    return *cached;
+}
+
+class ServerInterceptor final : public grpc::experimental::Interceptor {
+public:
+    explicit ServerInterceptor(grpc::experimental::ServerRpcInfo* info)
+        : series_(rpc_series(info->method())),
+          streaming_(info->type() != grpc::experimental::ServerRpcInfo::Type::UNARY),
+          start_(std::chrono::steady_clock::now()) {
+        series_.started->inc();
+        if (streaming_) series_.activeStreams->add(1);
+    }
+
+    ~ServerInterceptor() override {
+        if (!done_) finish(grpc::StatusCode::CANCELLED);  // torn down without a status
+        if (streaming_) series_.activeStreams->add(-1);
+    }
+
+    void Intercept(grpc::experimental::InterceptorBatchMethods* methods) override {
+        if (methods->QueryInterceptionHookPoint(grpc::experimental::InterceptionHookPoints::PRE_SEND_STATUS)) {
+            finish(methods->GetSendStatus().error_code());
+        }
+        methods->Proceed();
+    }
+
+private:
+    void finish(grpc::StatusCode code) {
+        done_ = true;
+        series_.handling->observe(std::chrono::steady_clock::now() - start_);
+        const auto i = static_cast<size_t>(code);
+        if (i >= series_.handled.size()) return;
+        Counter* handled = series_.handled[i].load(std::memory_order_acquire);
+        if (!handled) {
+            // Racing threads get the same series from the registry.
+            Labels labels = series_.labels;
+            labels.emplace_back("grpc_code", grpc_code_name(code));
+            handled = &registry().counter("grpc_server_handled_total", "RPCs completed on the server", labels);
+            series_.handled[i].store(handled, std::memory_order_release);
+        }
+        handled->inc();
+    }
+
+    RpcSeries& series_;
+    const bool streaming_;
+    const std::chrono::steady_clock::time_point start_;
+    bool done_ = false;
+};
+
+class ServerInterceptorFactory final : public grpc::experimental::ServerInterceptorFactoryInterface {
+public:
+    grpc::experimental::Interceptor* CreateServerInterceptor(grpc::experimental::ServerRpcInfo* info) override {
+        return new ServerInterceptor(info);
+    }
+};
+
+}  // namespace detail
+
+inline std::vector<std::unique_ptr<grpc::experimental::ServerInterceptorFactoryInterface>> serverInterceptors() {
+    std::vector<std::unique_ptr<grpc::experimental::ServerInterceptorFactoryInterface>> creators;
+    creators.push_back(std::make_unique<detail::ServerInterceptorFactory>());
+    return creators;
+}
+
+}  // namespace metrics
@@ -0,0 +1,232 @@
+#include "Metrics.h"
+
+#include "httplib.h"
+
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <thread>
+
+namespace metrics {
+
+namespace {
+// Each thread sticks to one shard, assigned round-robin on first use.
+size_t shard_index() {
+    static std::atomic<size_t> next{0};
+    thread_local const size_t index = next.fetch_add(1, std::memory_order_relaxed);
+    return index;
+}
+
+size_t bucket_index(std::uint64_t micros) {
+    if (micros < Histogram::kSubBuckets) return static_cast<size_t>(micros);
+    int e = 63;
+    while (!(micros >> e)) --e;  // e >= 3
+    const size_t sub = static_cast<size_t>(micros >> (e - 3)) & (Histogram::kSubBuckets - 1);
+    const size_t index = static_cast<size_t>(e - 2) * Histogram::kSubBuckets + sub;
+    return std::min(index, Histogram::kBuckets - 1);
+}
+
+// Exposed `le` bounds, in seconds.
+constexpr double kLe[] = {0.0001, 0.00025, 0.0005, 0.001, 0.0025, 0.005, 0.01, 0.025, 0.05,
+                          0.1,    0.25,    0.5,    1.0,   2.5,    5.0,   10.0, 30.0, 60.0};
+
+void append_escaped(std::string& out, const std::string& s, bool labelValue) {
+    for (const char c : s) {
+        if (c == '\\') out += "\\\\";
+        else if (c == '\n') out += "\\n";
+        else if (c == '"' && labelValue) out += "\\\"";
+        else out += c;
+    }
+}
+
+std::string label_text(const Labels& labels) {
+    std::string out;
+    for (const auto& [k, v] : labels) {
+        out += out.empty() ? "" : ",";
+        out += k + "=\"";
+        append_escaped(out, v, true);
+        out += '"';
+    }
+    return out;
+}
+
+void append_number(std::string& out, double v) {
+    char buf[32];
+    if (v == std::floor(v) && std::fabs(v) < 1e15) {
+        std::snprintf(buf, sizeof(buf), "%.0f", v);
+    } else {
+        std::snprintf(buf, sizeof(buf), "%.9g", v);
+    }
+    out += buf;
+}
+
+void append_sample(std::string& out, const std::string& name, const std::string& labels, double v) {
+    out += name;
+    if (!labels.empty()) out += "{" + labels + "}";
+    out += ' ';
+    append_number(out, v);
+    out += '\n';
+}
+}  // namespace
+
+void Counter::inc(std::uint64_t n) {
+    cells_[shard_index() % kShards].v.fetch_add(n, std::memory_order_relaxed);
+}
+
+std::uint64_t Counter::value() const {
+    std::uint64_t total = 0;
+    for (const auto& c : cells_) total += c.v.load(std::memory_order_relaxed);
+    return total;
+}
+
+void Histogram::observe(std::chrono::nanoseconds d) {
+    const auto ns = static_cast<std::uint64_t>(std::max<std::int64_t>(0, d.count()));
+    Shard& shard = shards_[shard_index() % shards_.size()];
+    shard.buckets[bucket_index(ns / 1000)].fetch_add(1, std::memory_order_relaxed);
+    shard.sumNs.fetch_add(ns, std::memory_order_relaxed);
+}
+
+Histogram::Snapshot Histogram::snapshot() const {
+    Snapshot s;
+    std::uint64_t sumNs = 0;
+    for (const auto& shard : shards_) {
+        for (size_t i = 0; i < kBuckets; ++i) s.buckets[i] += shard.buckets[i].load(std::memory_order_relaxed);
+        sumNs += shard.sumNs.load(std::memory_order_relaxed);
+    }
+    for (const auto b : s.buckets) s.count += b;
+    s.sumSeconds = static_cast<double>(sumNs) / 1e9;
+    return s;
+}
+
+std::uint64_t Histogram::bucketUpperMicros(size_t i) {
+    if (i < kSubBuckets) return i + 1;
+    const size_t e = i / kSubBuckets + 2;
+    const size_t sub = i % kSubBuckets;
+    return static_cast<std::uint64_t>(kSubBuckets + 1 + sub) << (e - 3);
+}
+
+double Histogram::Snapshot::quantileSeconds(double q) const {
+    if (count == 0) return 0;
+    const auto rank = static_cast<std::uint64_t>(std::ceil(q * static_cast<double>(count)));
+    std::uint64_t seen = 0;
+    for (size_t i = 0; i < kBuckets; ++i) {
+        seen += buckets[i];
+        if (seen >= std::max<std::uint64_t>(rank, 1)) return static_cast<double>(bucketUpperMicros(i)) / 1e6;
+    }
+    return static_cast<double>(bucketUpperMicros(kBuckets - 1)) / 1e6;
+}
+
+Registry::Series& Registry::series(const std::string& name, const std::string& help, const char* type,
+                                   const Labels& labels) {
+    Family& family = families_[name];
+    if (family.type.empty()) {
+        family.help = help;
+        family.type = type;
+    }
+    return family.series[label_text(labels)];
+}
+
+Counter& Registry::counter(const std::string& name, const std::string& help, const Labels& labels) {
+    std::lock_guard<std::mutex> lk(m_);
+    Series& s = series(name, help, "counter", labels);
+    if (!s.counter) s.counter = std::make_unique<Counter>();
+    return *s.counter;
+}
+
+Gauge& Registry::gauge(const std::string& name, const std::string& help, const Labels& labels) {
+    std::lock_guard<std::mutex> lk(m_);
+    Series& s = series(name, help, "gauge", labels);
+    if (!s.gauge) s.gauge = std::make_unique<Gauge>();
+    return *s.gauge;
+}
+
+Histogram& Registry::histogram(const std::string& name, const std::string& help, const Labels& labels) {
+    std::lock_guard<std::mutex> lk(m_);
+    Series& s = series(name, help, "histogram", labels);
+    if (!s.histogram) s.histogram = std::make_unique<Histogram>();
+    return *s.histogram;
+}
+
+void Registry::counterCallback(const std::string& name, const std::string& help, const Labels& labels,
+                               std::function<double()> read) {
+    std::lock_guard<std::mutex> lk(m_);
+    series(name, help, "counter", labels).read = std::move(read);
+}
+
+void Registry::gaugeCallback(const std::string& name, const std::string& help, const Labels& labels,
+                             std::function<double()> read) {
+    std::lock_guard<std::mutex> lk(m_);
+    series(name, help, "gauge", labels).read = std::move(read);
+}
+
+std::string Registry::render() const {
+    std::lock_guard<std::mutex> lk(m_);
+    std::string out;
+    out.reserve(16 * 1024);
+    for (const auto& [name, family] : families_) {
+        out += "# HELP " + name + ' ';
+        append_escaped(out, family.help, false);
+        out += "\n# TYPE " + name + ' ' + family.type + '\n';
+        for (const auto& [labels, s] : family.series) {
+            if (s.read) {
+                append_sample(out, name, labels, s.read());
+            } else if (s.counter) {
+                append_sample(out, name, labels, static_cast<double>(s.counter->value()));
+            } else if (s.gauge) {
+                append_sample(out, name, labels, static_cast<double>(s.gauge->value()));
+            } else if (s.histogram) {
+                const auto snap = s.histogram->snapshot();
+                const std::string prefix = labels.empty() ? std::string() : labels + ",";
+                size_t i = 0;
+                std::uint64_t cumulative = 0;
+                char le[32];
+                for (const double bound : kLe) {
+                    const auto boundMicros = static_cast<std::uint64_t>(std::llround(bound * 1e6));
+                    while (i < Histogram::kBuckets && Histogram::bucketUpperMicros(i) <= boundMicros) {
+                        cumulative += snap.buckets[i++];
+                    }
+                    // The bucket straddling the bound is split linearly.
+                    double partial = 0;
+                    if (i < Histogram::kBuckets && snap.buckets[i] != 0) {
+                        const std::uint64_t lower = i == 0 ? 0 : Histogram::bucketUpperMicros(i - 1);
+                        const std::uint64_t upper = Histogram::bucketUpperMicros(i);
+                        if (boundMicros > lower) {
+                            partial = std::floor(static_cast<double>(snap.buckets[i]) *
+                                                 static_cast<double>(boundMicros - lower) /
+                                                 static_cast<double>(upper - lower));
+                        }
+                    }
+                    std::snprintf(le, sizeof(le), "%g", bound);
+                    append_sample(out, name + "_bucket", prefix + "le=\"" + le + "\"",
+                                  static_cast<double>(cumulative) + partial);
+                }
+                append_sample(out, name + "_bucket", prefix + "le=\"+Inf\"", static_cast<double>(snap.count));
+                append_sample(out, name + "_sum", labels, snap.sumSeconds);
+                append_sample(out, name + "_count", labels, static_cast<double>(snap.count));
+            }
+        }
+    }
+    return out;
+}
+
+Registry& registry() {
+    static Registry* r = new Registry();  // never destroyed: instrumented code may run during exit
+    return *r;
+}
+
+int serveFromEnv(int fallbackPort) {
+    int port = fallbackPort;
+    if (const char* v = std::getenv("METRICS_PORT"); v && *v) port = std::atoi(v);
+    if (port <= 0) return 0;
+
+    auto server = std::make_shared<httplib::Server>();
+    server->new_task_queue = [] { return new httplib::ThreadPool(1); };
+    server->Get("/metrics", [](const httplib::Request&, httplib::Response& res) {
+        res.set_content(registry().render(), kContentType);
+    });
+    if (!server->bind_to_port("0.0.0.0", port)) return 0;
+    std::thread([server]() { server->listen_after_bind(); }).detach();
+    return port;
+}
+
+}  // namespace metrics
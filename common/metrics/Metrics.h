@@ -0,0 +1,134 @@
+#pragma once
+
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <functional>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <utility>
+#include <vector>
+
+// Prometheus metrics (text exposition format 0.0.4).
+// Counters and histograms are sharded: each thread updates its own cache line with a relaxed
+// atomic add, and the shards are only summed when /metrics is scraped. Histograms are log-linear
+// (HDR-style: 8 sub-buckets per power of two of microseconds, from 1 µs to weeks); a scrape folds
+// them into fixed `le` buckets, so histogram_quantile() works as usual.
+//
+// Series are registered once (typically into a function-local static reference) and updated
+// without any lookup:
+//   static auto& latency = metrics::registry().histogram("db_query_duration_seconds", "...",
+//                                                        {{"method", "getHistory"}});
+//   const metrics::Timer timer(latency);
+namespace metrics {
+
+using Labels = std::vector<std::pair<std::string, std::string>>;
+
+constexpr size_t kShards = 8;
+constexpr const char* kContentType = "text/plain; version=0.0.4; charset=utf-8";
+
+class Counter {
+public:
+    void inc(std::uint64_t n = 1);
+    std::uint64_t value() const;
+
+private:
+    struct alignas(64) Cell {
+        std::atomic<std::uint64_t> v{0};
+    };
+    std::array<Cell, kShards> cells_;
+};
+
+class Gauge {
+public:
+    void add(std::int64_t delta) { v_.fetch_add(delta, std::memory_order_relaxed); }
+    void set(std::int64_t value) { v_.store(value, std::memory_order_relaxed); }
+    std::int64_t value() const { return v_.load(std::memory_order_relaxed); }
+
+private:
+    std::atomic<std::int64_t> v_{0};
+};
+
+class Histogram {
+public:
+    static constexpr size_t kSubBuckets = 8;
+    static constexpr size_t kBuckets = 41 * kSubBuckets;  // up to 2^41 µs
+
+    void observe(std::chrono::nanoseconds d);
+
+    struct Snapshot {
+        std::array<std::uint64_t, kBuckets> buckets{};
+        std::uint64_t count = 0;
+        double sumSeconds = 0;
+        // Upper bound of the bucket holding the q-quantile (0 when empty).
+        double quantileSeconds(double q) const;
+    };
+    Snapshot snapshot() const;
+
+    // Values in bucket i are < bucketUpperMicros(i).
+    static std::uint64_t bucketUpperMicros(size_t i);
+
+private:
+    struct alignas(64) Shard {
+        std::array<std::atomic<std::uint64_t>, kBuckets> buckets{};
+        std::atomic<std::uint64_t> sumNs{0};
+    };
+    std::array<Shard, kShards / 2> shards_;
+};
+
+class Timer {
+public:
+    explicit Timer(Histogram& h) : h_(h), start_(std::chrono::steady_clock::now()) {}
+    ~Timer() { h_.observe(std::chrono::steady_clock::now() - start_); }
+    Timer(const Timer&) = delete;
+    Timer& operator=(const Timer&) = delete;
+
+private:
+    Histogram& h_;
+    const std::chrono::steady_clock::time_point start_;
+};
+
+class Registry {
+public:
+    // The same name + labels always returns the same series.
+    Counter& counter(const std::string& name, const std::string& help, const Labels& labels = {});
+    Gauge& gauge(const std::string& name, const std::string& help, const Labels& labels = {});
+    Histogram& histogram(const std::string& name, const std::string& help, const Labels& labels = {});
+
+    // Values owned elsewhere (existing stats structs), read at scrape time.
+    void counterCallback(const std::string& name, const std::string& help, const Labels& labels,
+                         std::function<double()> read);
+    void gaugeCallback(const std::string& name, const std::string& help, const Labels& labels,
+                       std::function<double()> read);
+
+    std::string render() const;
+
+private:
+    struct Series {
+        std::unique_ptr<Counter> counter;
+        std::unique_ptr<Gauge> gauge;
+        std::unique_ptr<Histogram> histogram;
+        std::function<double()> read;
+    };
+    struct Family {
+        std::string help;
+        std::string type;
+        std::map<std::string, Series> series;  // by rendered label set
+    };
+
+    Series& series(const std::string& name, const std::string& help, const char* type, const Labels& labels);
+
+    mutable std::mutex m_;
+    std::map<std::string, Family> families_;
+};
+
+Registry& registry();
+
+// gRPC services: serves GET /metrics from registry() on its own thread, on METRICS_PORT
+// (default `fallbackPort`, 0 disables). Returns the port, or 0 when disabled or it cannot be bound.
+int serveFromEnv(int fallbackPort);
+
+}  // namespace metrics
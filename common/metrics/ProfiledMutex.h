@@ -0,0 +1,108 @@
+#pragma once
+
+#include "Metrics.h"
+
+#include <chrono>
+#include <mutex>
+
+// Mutexes on the request paths, swapped at build time (cmake -DLOCK_PROFILING=ON) for an
+// instrumented version that records, per named lock:
+//   lock_acquires_total{lock}            acquisitions (outermost ones for a recursive mutex)
+//   lock_contended_acquires_total{lock}  acquisitions that found the lock held
+//   lock_wait_seconds{lock}              time blocked, contended acquisitions only (histogram)
+//   lock_hold_seconds{lock}              acquisition to release (histogram)
+// served with the other series on /metrics. Without LOCK_PROFILING these are the std types and
+// the name is ignored.
+//
+//   metrics::Mutex m_{"Database::m_"};
+//   std::lock_guard<metrics::Mutex> lk(m_);
+namespace metrics {
+
+#if defined(LOCK_PROFILING)
+
+namespace detail {
+
+struct LockSeries {
+    Counter* acquires = nullptr;
+    Counter* contended = nullptr;
+    Histogram* wait = nullptr;
+    Histogram* hold = nullptr;
+};
+
+// Instances of the same name (several Database connections) share their series.
+inline LockSeries lock_series(const char* name) {
+    const Labels labels{{"lock", name}};
+    auto& r = registry();
+    LockSeries s;
+    s.acquires = &r.counter("lock_acquires_total", "Lock acquisitions", labels);
+    s.contended = &r.counter("lock_contended_acquires_total", "Lock acquisitions that had to wait", labels);
+    s.wait = &r.histogram("lock_wait_seconds", "Time blocked on a held lock (contended acquisitions)", labels);
+    s.hold = &r.histogram("lock_hold_seconds", "Time a lock is held, acquisition to release", labels);
+    return s;
+}
+
+}  // namespace detail
+
+// Uncontended cost: a try_lock plus two clock reads and two sharded counter/histogram updates.
+template <typename Base>
+class ProfiledMutex {
+public:
+    explicit ProfiledMutex(const char* name) : series_(detail::lock_series(name)) {}
+    ProfiledMutex(const ProfiledMutex&) = delete;
+    ProfiledMutex& operator=(const ProfiledMutex&) = delete;
+
+    void lock() {
+        if (base_.try_lock()) {
+            acquired(std::chrono::steady_clock::now());
+            return;
+        }
+        const auto start = std::chrono::steady_clock::now();
+        base_.lock();
+        const auto now = std::chrono::steady_clock::now();
+        series_.contended->inc();
+        series_.wait->observe(now - start);
+        acquired(now);
+    }
+
+    bool try_lock() {
+        if (!base_.try_lock()) return false;
+        acquired(std::chrono::steady_clock::now());
+        return true;
+    }
+
+    void unlock() {
+        // depth_ and acquiredAt_ belong to the owner: read them before releasing.
+        if (--depth_ == 0) series_.hold->observe(std::chrono::steady_clock::now() - acquiredAt_);
+        base_.unlock();
+    }
+
+private:
+    void acquired(std::chrono::steady_clock::time_point now) {
+        if (depth_++ != 0) return;  // re-entered recursive mutex
+        acquiredAt_ = now;
+        series_.acquires->inc();
+    }
+
+    Base base_;
+    const detail::LockSeries series_;
+    int depth_ = 0;
+    std::chrono::steady_clock::time_point acquiredAt_;
+};
+
+using Mutex = ProfiledMutex<std::mutex>;
+using RecursiveMutex = ProfiledMutex<std::recursive_mutex>;
+
+#else
+
+template <typename Base>
+class NamedMutex : public Base {
+public:
+    explicit NamedMutex(const char*) {}
+};
+
+using Mutex = NamedMutex<std::mutex>;
+using RecursiveMutex = NamedMutex<std::recursive_mutex>;
+
+#endif
+
+}  // namespace metrics
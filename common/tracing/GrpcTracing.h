@@ -0,0 +1,84 @@
+#pragma once
+
+#include "Tracing.h"
+
+#include <grpcpp/grpcpp.h>
+#include <grpcpp/support/server_interceptor.h>
+
+#include <memory>
+#include <string>
+
+// A server span per RPC, joined to the caller's trace through the `traceparent` metadata entry.
+// With the synchronous server the handler runs on the thread that received the initial metadata,
+// so the span is that thread's current one while the handler runs and the Database spans
+// (tracing::ScopedSpan) nest under it.
+//
+//   auto interceptors = metrics::serverInterceptors();
+//   interceptors.push_back(tracing::serverInterceptorFactory());
+//   builder.experimental().SetInterceptorCreators(std::move(interceptors));
+namespace tracing {
+
+namespace detail {
+
+class ServerInterceptor final : public grpc::experimental::Interceptor {
+public:
+    explicit ServerInterceptor(grpc::experimental::ServerRpcInfo* info) : method_(info->method()) {}
+
+    ~ServerInterceptor() override {
+        if (span_.recording()) span_.setError("cancelled");
+        finish();
+    }
+
+    void Intercept(grpc::experimental::InterceptorBatchMethods* methods) override {
+        using grpc::experimental::InterceptionHookPoints;
+        if (methods->QueryInterceptionHookPoint(InterceptionHookPoints::POST_RECV_INITIAL_METADATA)) {
+            SpanContext parent;
+            const auto* md = methods->GetRecvInitialMetadata();
+            if (md) {
+                const auto it = md->find("traceparent");
+                if (it != md->end()) parent = SpanContext::parse(std::string_view(it->second.data(), it->second.size()));
+            }
+            span_ = Span(method_ ? method_ : "", Kind::Server, parent);
+            if (span_.context().valid()) {
+                previous_ = current();
+                setCurrent(span_.context());
+                active_ = true;
+            }
+        }
+        if (methods->QueryInterceptionHookPoint(InterceptionHookPoints::PRE_SEND_STATUS)) {
+            const auto status = methods->GetSendStatus();
+            span_.setAttribute("rpc.grpc.status_code", static_cast<long long>(status.error_code()));
+            if (!status.ok()) span_.setError(status.error_message());
+            finish();
+        }
+        methods->Proceed();
+    }
+
+private:
+    void finish() {
+        span_.end();
+        // Only undone on the thread that made it current, and only if nothing replaced it.
+        if (active_ && current() == span_.context()) setCurrent(previous_);
+        active_ = false;
+    }
+
+    const char* method_;
+    Span span_;
+    SpanContext previous_;
+    bool active_ = false;
+};
+
+class ServerInterceptorFactory final : public grpc::experimental::ServerInterceptorFactoryInterface {
+public:
+    grpc::experimental::Interceptor* CreateServerInterceptor(grpc::experimental::ServerRpcInfo* info) override {
+        return new ServerInterceptor(info);
+    }
+};
+
+}  // namespace detail
+
+inline std::unique_ptr<grpc::experimental::ServerInterceptorFactoryInterface> serverInterceptorFactory() {
+    return std::make_unique<detail::ServerInterceptorFactory>();
+}
+
+}  // namespace tracing
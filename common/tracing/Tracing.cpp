@@ -0,0 +1,390 @@
+#include "Tracing.h"
+
+#include "Metrics.h"
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdio>
+#include <cstdlib>
+#include <mutex>
+#include <random>
+#include <thread>
+#include <utility>
+#include <vector>
+
+namespace tracing {
+
+namespace detail {
+struct SpanData {
+    std::string name;
+    Kind kind = Kind::Internal;
+    SpanContext ctx;
+    std::array<std::uint8_t, 8> parentSpanId{};
+    std::int64_t startNs = 0;
+    std::int64_t endNs = 0;
+    std::string attributes;  // OTLP/JSON attribute objects, comma-separated
+    std::string error;
+    bool failed = false;
+};
+}  // namespace detail
+
+namespace {
+
+constexpr size_t kBatchSpans = 512;
+constexpr size_t kMaxPending = 16384;
+
+thread_local SpanContext tlsCurrent;
+
+std::int64_t now_unix_ns() {
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::system_clock::now().time_since_epoch())
+        .count();
+}
+
+std::mt19937_64& rng() {
+    thread_local std::mt19937_64 gen([] {
+        std::random_device rd;
+        return (static_cast<std::uint64_t>(rd()) << 32) ^ rd() ^
+               static_cast<std::uint64_t>(std::chrono::steady_clock::now().time_since_epoch().count());
+    }());
+    return gen;
+}
+
+template <size_t N>
+void random_id(std::array<std::uint8_t, N>& id) {
+    do {
+        for (size_t i = 0; i < N; i += 8) {
+            const std::uint64_t r = rng()();
+            for (size_t j = 0; j < 8 && i + j < N; ++j) id[i + j] = static_cast<std::uint8_t>(r >> (8 * j));
+        }
+    } while (std::all_of(id.begin(), id.end(), [](std::uint8_t b) { return b == 0; }));
+}
+
+template <size_t N>
+void append_hex(std::string& out, const std::array<std::uint8_t, N>& id) {
+    static constexpr char kDigits[] = "0123456789abcdef";
+    for (const auto b : id) {
+        out += kDigits[b >> 4];
+        out += kDigits[b & 0xf];
+    }
+}
+
+int hex_value(char c) {
+    if (c >= '0' && c <= '9') return c - '0';
+    if (c >= 'a' && c <= 'f') return c - 'a' + 10;
+    return -1;  // upper case is not valid in traceparent
+}
+
+template <size_t N>
+bool parse_hex(std::string_view s, std::array<std::uint8_t, N>& id) {
+    if (s.size() != 2 * N) return false;
+    bool nonZero = false;
+    for (size_t i = 0; i < N; ++i) {
+        const int hi = hex_value(s[2 * i]);
+        const int lo = hex_value(s[2 * i + 1]);
+        if (hi < 0 || lo < 0) return false;
+        id[i] = static_cast<std::uint8_t>(hi << 4 | lo);
+        nonZero = nonZero || id[i] != 0;
+    }
+    return nonZero;
+}
+
+void append_json_string(std::string& out, std::string_view s) {
+    out += '"';
+    for (const char c : s) {
+        switch (c) {
+        case '"': out += "\\\""; break;
+        case '\\': out += "\\\\"; break;
+        case '\n': out += "\\n"; break;
+        case '\r': out += "\\r"; break;
+        case '\t': out += "\\t"; break;
+        default:
+            if (static_cast<unsigned char>(c) < 0x20) {
+                char buf[8];
+                std::snprintf(buf, sizeof(buf), "\\u%04x", c);
+                out += buf;
+            } else {
+                out += c;
+            }
+        }
+    }
+    out += '"';
+}
+
+class Exporter {
+public:
+    Exporter(std::string path, std::string serviceName, double ratio)
+        : path_(std::move(path)), serviceName_(std::move(serviceName)), ratio_(ratio) {
+        std::thread([this]() { run(); }).detach();
+    }
+
+    bool sample() const {
+        if (ratio_ >= 1.0) return true;
+        if (ratio_ <= 0.0) return false;
+        return std::uniform_real_distribution<double>(0.0, 1.0)(rng()) < ratio_;
+    }
+
+    void push(std::unique_ptr<detail::SpanData> span) {
+        static auto& dropped = metrics::registry().counter("trace_spans_dropped_total",
+                                                           "Spans dropped because the export queue was full");
+        std::lock_guard<std::mutex> lk(m_);
+        if (pending_.size() >= kMaxPending) {
+            dropped.inc();
+            return;
+        }
+        pending_.push_back(std::move(span));
+        ++pushed_;
+        if (pending_.size() >= kBatchSpans) wake_.notify_one();
+    }
+
+    void flush() {
+        std::unique_lock<std::mutex> lk(m_);
+        const std::uint64_t target = pushed_;
+        flushRequested_ = true;
+        wake_.notify_one();
+        flushed_.wait(lk, [&]() { return written_ >= target; });
+    }
+
+private:
+    void run() {
+        static auto& exported = metrics::registry().counter("trace_spans_exported_total",
+                                                            "Spans written to TRACE_EXPORT_FILE");
+        std::vector<std::unique_ptr<detail::SpanData>> batch;
+        std::string line;
+        for (;;) {
+            std::uint64_t taken = 0;
+            {
+                std::unique_lock<std::mutex> lk(m_);
+                wake_.wait_for(lk, std::chrono::seconds(1),
+                               [this]() { return flushRequested_ || pending_.size() >= kBatchSpans; });
+                flushRequested_ = false;
+                batch.swap(pending_);
+                taken = written_ + batch.size();
+            }
+            if (!batch.empty()) {
+                write(batch, line);
+                exported.inc(batch.size());
+                batch.clear();
+            }
+            std::lock_guard<std::mutex> lk(m_);
+            written_ = taken;
+            flushed_.notify_all();
+        }
+    }
+
+    // One ExportTraceServiceRequest per line.
+    void write(const std::vector<std::unique_ptr<detail::SpanData>>& spans, std::string& line) {
+        line.clear();
+        line += R"({"resourceSpans":[{"resource":{"attributes":[{"key":"service.name","value":{"stringValue":)";
+        append_json_string(line, serviceName_);
+        line += R"(}}]},"scopeSpans":[{"scope":{"name":"securecloud.tracing"},"spans":[)";
+        bool first = true;
+        for (const auto& s : spans) {
+            line += first ? "{" : ",{";
+            first = false;
+            line += "\"traceId\":\"";
+            append_hex(line, s->ctx.traceId);
+            line += "\",\"spanId\":\"";
+            append_hex(line, s->ctx.spanId);
+            line += '"';
+            if (std::any_of(s->parentSpanId.begin(), s->parentSpanId.end(), [](std::uint8_t b) { return b != 0; })) {
+                line += ",\"parentSpanId\":\"";
+                append_hex(line, s->parentSpanId);
+                line += '"';
+            }
+            line += ",\"name\":";
+            append_json_string(line, s->name);
+            line += ",\"kind\":" + std::to_string(static_cast<int>(s->kind));
+            line += ",\"startTimeUnixNano\":\"" + std::to_string(s->startNs) + "\"";
+            line += ",\"endTimeUnixNano\":\"" + std::to_string(s->endNs) + "\"";
+            line += ",\"attributes\":[" + s->attributes + "]";
+            if (s->failed) {
+                line += R"(,"status":{"code":2,"message":)";
+                append_json_string(line, s->error);
+                line += '}';
+            }
+            line += '}';
+        }
+        line += "]}]}]}\n";
+
+        if (!file_) file_ = std::fopen(path_.c_str(), "a");
+        if (!file_) return;  // batch lost; opening is retried with the next one
+        std::fwrite(line.data(), 1, line.size(), file_);
+        std::fflush(file_);
+    }
+
+    const std::string path_;
+    const std::string serviceName_;
+    const double ratio_;
+    std::FILE* file_ = nullptr;  // exporter thread only
+
+    std::mutex m_;
+    std::condition_variable wake_;
+    std::condition_variable flushed_;
+    std::vector<std::unique_ptr<detail::SpanData>> pending_;
+    std::uint64_t pushed_ = 0;
+    std::uint64_t written_ = 0;
+    bool flushRequested_ = false;
+};
+
+// Set once by initFromEnv; never destroyed (spans may end during exit).
+std::atomic<Exporter*> exporter{nullptr};
+
+}  // namespace
+
+bool SpanContext::valid() const {
+    return std::any_of(traceId.begin(), traceId.end(), [](std::uint8_t b) { return b != 0; }) &&
+           std::any_of(spanId.begin(), spanId.end(), [](std::uint8_t b) { return b != 0; });
+}
+
+std::string SpanContext::traceparent() const {
+    std::string out = "00-";
+    out.reserve(55);
+    append_hex(out, traceId);
+    out += '-';
+    append_hex(out, spanId);
+    out += sampled ? "-01" : "-00";
+    return out;
+}
+
+std::string SpanContext::traceIdHex() const {
+    std::string out;
+    append_hex(out, traceId);
+    return out;
+}
+
+SpanContext SpanContext::parse(std::string_view h) {
+    // version "-" trace-id "-" parent-id "-" trace-flags; later versions may append fields.
+    SpanContext ctx;
+    if (h.size() < 55 || h[2] != '-' || h[35] != '-' || h[52] != '-') return {};
+    if (h.substr(0, 2) == "ff" || hex_value(h[0]) < 0 || hex_value(h[1]) < 0) return {};
+    if (h.substr(0, 2) == "00" && h.size() != 55) return {};
+    if (!parse_hex(h.substr(3, 32), ctx.traceId) || !parse_hex(h.substr(36, 16), ctx.spanId)) return {};
+    const int hi = hex_value(h[53]);
+    const int lo = hex_value(h[54]);
+    if (hi < 0 || lo < 0) return {};
+    ctx.sampled = (lo & 1) != 0;
+    return ctx;
+}
+
+Span::Span() = default;
+
+Span::Span(std::string_view name, Kind kind, const SpanContext& parent) {
+    Exporter* ex = exporter.load(std::memory_order_acquire);
+    if (parent.valid()) {
+        ctx_.traceId = parent.traceId;
+        ctx_.sampled = parent.sampled;
+    } else {
+        if (!ex) return;
+        random_id(ctx_.traceId);
+        ctx_.sampled = ex->sample();
+    }
+    random_id(ctx_.spanId);
+    if (!ex || !ctx_.sampled) return;
+
+    data_ = std::make_unique<detail::SpanData>();
+    data_->name = std::string(name);
+    data_->kind = kind;
+    data_->ctx = ctx_;
+    if (parent.valid()) data_->parentSpanId = parent.spanId;
+    data_->startNs = now_unix_ns();
+}
+
+Span::~Span() {
+    end();
+}
+
+Span::Span(Span&& other) noexcept : ctx_(other.ctx_), data_(std::move(other.data_)) {}
+
+Span& Span::operator=(Span&& other) noexcept {
+    if (this != &other) {
+        end();
+        ctx_ = other.ctx_;
+        data_ = std::move(other.data_);
+    }
+    return *this;
+}
+
+void Span::setAttribute(std::string_view key, std::string_view value) {
+    if (!data_) return;
+    std::string& a = data_->attributes;
+    if (!a.empty()) a += ',';
+    a += "{\"key\":";
+    append_json_string(a, key);
+    a += ",\"value\":{\"stringValue\":";
+    append_json_string(a, value);
+    a += "}}";
+}
+
+void Span::setAttribute(std::string_view key, long long value) {
+    if (!data_) return;
+    std::string& a = data_->attributes;
+    if (!a.empty()) a += ',';
+    a += "{\"key\":";
+    append_json_string(a, key);
+    a += ",\"value\":{\"intValue\":\"" + std::to_string(value) + "\"}}";
+}
+
+void Span::setError(std::string_view message) {
+    if (!data_) return;
+    data_->failed = true;
+    data_->error = std::string(message);
+}
+
+void Span::end() {
+    if (!data_) return;
+    data_->endNs = now_unix_ns();
+    if (Exporter* ex = exporter.load(std::memory_order_acquire)) ex->push(std::move(data_));
+    data_.reset();
+}
+
+SpanContext current() {
+    return tlsCurrent;
+}
+
+void setCurrent(const SpanContext& ctx) {
+    tlsCurrent = ctx;
+}
+
+ScopedContext::ScopedContext(const SpanContext& ctx) : previous_(tlsCurrent) {
+    tlsCurrent = ctx;
+}
+
+ScopedContext::~ScopedContext() {
+    tlsCurrent = previous_;
+}
+
+ScopedSpan::ScopedSpan(std::string_view name, Kind kind) {
+    if (!tlsCurrent.sampled) return;
+    previous_ = tlsCurrent;
+    span_ = Span(name, kind, previous_);
+    if (span_.context().valid()) tlsCurrent = span_.context();
+}
+
+ScopedSpan::~ScopedSpan() {
+    span_.end();
+    if (previous_.valid()) tlsCurrent = previous_;
+}
+
+bool initFromEnv(std::string_view serviceName) {
+    if (exporter.load(std::memory_order_acquire)) return true;
+    const char* path = std::getenv("TRACE_EXPORT_FILE");
+    if (!path || !*path) return false;
+    double ratio = 0.01;
+    if (const char* r = std::getenv("TRACE_SAMPLE_RATIO"); r && *r) {
+        char* end = nullptr;
+        const double v = std::strtod(r, &end);
+        if (end != r) ratio = std::min(1.0, std::max(0.0, v));
+    }
+    auto* ex = new Exporter(path, std::string(serviceName), ratio);
+    exporter.store(ex, std::memory_order_release);
+    std::atexit([] { flush(); });
+    return true;
+}
+
+void flush() {
+    if (Exporter* ex = exporter.load(std::memory_order_acquire)) ex->flush();
+}
+
+}  // namespace tracing
@@ -0,0 +1,114 @@
+#pragma once
+
+#include <array>
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <string_view>
+
+// Distributed tracing with W3C Trace Context propagation (traceparent: 00-<trace id>-<span id>-<flags>).
+// The gateway starts a trace per HTTP request (or continues the client's), its upstream calls carry
+// the context in gRPC metadata, and each service records a span per RPC handler and per Database
+// call. Ended spans are batched by a background thread and appended to TRACE_EXPORT_FILE as OTLP/JSON
+// lines (one ExportTraceServiceRequest per batch), the format of the OpenTelemetry collector's file
+// exporter and otlpjsonfile receiver.
+//
+// TRACE_EXPORT_FILE: unset records nothing (an incoming traceparent is still forwarded).
+// TRACE_SAMPLE_RATIO (0..1, default 0.01): share of new traces recorded; a request that arrives with
+// a traceparent follows its sampled flag instead.
+namespace tracing {
+
+struct SpanContext {
+    std::array<std::uint8_t, 16> traceId{};
+    std::array<std::uint8_t, 8> spanId{};
+    bool sampled = false;
+
+    bool valid() const;
+    std::string traceparent() const;
+    std::string traceIdHex() const;
+    // Invalid context when the header is missing or malformed.
+    static SpanContext parse(std::string_view traceparent);
+
+    bool operator==(const SpanContext& o) const { return spanId == o.spanId && traceId == o.traceId; }
+};
+
+enum class Kind : int { Internal = 1, Server = 2, Client = 3 };
+
+namespace detail {
+struct SpanData;
+}
+
+class Span {
+public:
+    Span();  // not recording, invalid context
+    // Joins `parent`'s trace; with an invalid parent, starts a new trace (sampled at
+    // TRACE_SAMPLE_RATIO) when spans are exported, and is a no-op otherwise.
+    Span(std::string_view name, Kind kind, const SpanContext& parent);
+    ~Span();
+    Span(Span&& other) noexcept;
+    Span& operator=(Span&& other) noexcept;
+    Span(const Span&) = delete;
+    Span& operator=(const Span&) = delete;
+
+    const SpanContext& context() const { return ctx_; }
+    bool recording() const { return data_ != nullptr; }
+
+    void setAttribute(std::string_view key, std::string_view value);
+    void setAttribute(std::string_view key, long long value);
+    void setError(std::string_view message);
+    // Idempotent; the destructor ends a span that is still open.
+    void end();
+
+private:
+    SpanContext ctx_;
+    std::unique_ptr<detail::SpanData> data_;
+};
+
+// Context of the span running on this thread (invalid when none).
+SpanContext current();
+void setCurrent(const SpanContext& ctx);
+
+// Makes `ctx` current until the end of the scope, then restores the previous context. gRPC
+// completion callbacks run on threads where the request's context is not current: one that
+// issues a further upstream call captures the context first and scopes it around the call.
+//
+//   auto trace = tracing::current();
+//   stub.async()->Get(&ctx, &req, &resp, [&stub, trace](grpc::Status) {
+//       const tracing::ScopedContext traced(trace);
+//       stub.async()->Next(...);  // child of the request's span
+//   });
+class ScopedContext {
+public:
+    explicit ScopedContext(const SpanContext& ctx);
+    ~ScopedContext();
+    ScopedContext(const ScopedContext&) = delete;
+    ScopedContext& operator=(const ScopedContext&) = delete;
+
+private:
+    SpanContext previous_;
+};
+
+// Child of the thread's current span, itself current until the end of the scope. Costs one
+// thread-local read when the current span is not sampled.
+class ScopedSpan {
+public:
+    explicit ScopedSpan(std::string_view name, Kind kind = Kind::Internal);
+    ~ScopedSpan();
+    ScopedSpan(const ScopedSpan&) = delete;
+    ScopedSpan& operator=(const ScopedSpan&) = delete;
+
+    Span& span() { return span_; }
+
+private:
+    Span span_;
+    SpanContext previous_;
+};
+
+// Reads TRACE_EXPORT_FILE / TRACE_SAMPLE_RATIO; `serviceName` becomes the resource's service.name.
+// Returns true when spans are exported.
+bool initFromEnv(std::string_view serviceName);
+
+// Waits until every span ended before the call has been written.
+void flush();
+
+}  // namespace tracing
@@ -0,0 +1,61 @@
+#include "BodyFormat.h"
+
+#include <algorithm>
+#include <cctype>
+#include <cstdlib>
+
+namespace {
+std::string trim_lower(const std::string& s, size_t b, size_t e) {
+    while (b < e && std::isspace(static_cast<unsigned char>(s[b]))) ++b;
+    while (e > b && std::isspace(static_cast<unsigned char>(s[e - 1]))) --e;
+    std::string out = s.substr(b, e - b);
+    std::transform(out.begin(), out.end(), out.begin(), [](unsigned char c) { return std::tolower(c); });
+    return out;
+}
+}
+
+BodyFormat negotiate_body_format(const std::string& accept) {
+    double protobufQ = 0.0;
+    double jsonQ = 0.0;
+    size_t pos = 0;
+    while (pos < accept.size()) {
+        size_t end = accept.find(',', pos);
+        if (end == std::string::npos) end = accept.size();
+
+        // media-range *( ";" parameter ), with q among the parameters.
+        const size_t semi = accept.find(';', pos);
+        const std::string range = trim_lower(accept, pos, std::min(semi, end));
+        double q = 1.0;
+        for (size_t p = semi; p < end;) {
+            size_t next = accept.find(';', p + 1);
+            if (next == std::string::npos || next > end) next = end;
+            const std::string param = trim_lower(accept, p + 1, next);
+            if (param.rfind("q=", 0) == 0) q = std::strtod(param.c_str() + 2, nullptr);
+            p = next;
+        }
+
+        if (range == kProtobufContentType) {
+            protobufQ = std::max(protobufQ, q);
+        } else if (range == "application/json" || range == "application/*" || range == "*/*") {
+            jsonQ = std::max(jsonQ, q);
+        }
+        pos = end + 1;
+    }
+    return protobufQ > 0.0 && protobufQ >= jsonQ ? BodyFormat::Protobuf : BodyFormat::Json;
+}
+
+const char* content_type(BodyFormat format) {
+    return format == BodyFormat::Protobuf ? kProtobufContentType : "application/json";
+}
+
+bool is_protobuf_content_type(const std::string& contentType) {
+    return trim_lower(contentType, 0, std::min(contentType.find(';'), contentType.size())) == kProtobufContentType;
+}
+
+void append_varint(std::string& out, std::uint64_t value) {
+    while (value >= 0x80) {
+        out += static_cast<char>((value & 0x7f) | 0x80);
+        value >>= 7;
+    }
+    out += static_cast<char>(value);
+}
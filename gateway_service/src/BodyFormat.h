@@ -0,0 +1,77 @@
+#pragma once
+
+#include "GatewayJson.h"
+#include "gateway.pb.h"
+#include "messaging.pb.h"
+
+#include <cstdint>
+#include <string>
+
+// Representation of a gateway response body, chosen from the request's Accept header.
+// JSON stays the default; application/x-protobuf is the binary encoding of the same
+// gateway.proto message (same ETag versions, "-pb" suffixed).
+enum class BodyFormat { Json, Protobuf };
+
+constexpr const char* kProtobufContentType = "application/x-protobuf";
+
+// Protobuf only when the client lists application/x-protobuf with a q-value at least as high as
+// the best JSON match (application/json, application/*, */*). An empty Accept means JSON.
+BodyFormat negotiate_body_format(const std::string& accept);
+
+const char* content_type(BodyFormat format);
+
+// True for request bodies sent as application/x-protobuf (POST routes accept both encodings).
+bool is_protobuf_content_type(const std::string& contentType);
+
+// Appends an unsigned varint (protobuf wire format).
+void append_varint(std::string& out, std::uint64_t value);
+
+// A ListMessagesResponse body produced message by message from upstream messages, in either
+// format: same bytes as serializing the equivalent ListMessagesResponse. The buffer may be
+// drained between add() calls (chunked responses).
+class MessagesPageStream {
+public:
+    MessagesPageStream(std::string& out, BodyFormat format) : out_(out), format_(format), json_(out) {}
+
+    void add(const securecloud::messaging::EncryptedMessage& m, const std::string& clientConversationId) {
+        if (format_ == BodyFormat::Json) {
+            json_.add(m, clientConversationId);
+            return;
+        }
+        // messages = 1, length-delimited; one HttpMessage reused for every element.
+        message_.set_message_id(m.message_id());
+        message_.set_conversation_id(clientConversationId);
+        message_.set_sender_id(m.sender_id());
+        message_.set_content(m.ciphertext());
+        message_.set_timestamp_unix(m.timestamp_unix());
+        out_ += '\x0a';
+        append_varint(out_, message_.ByteSizeLong());
+        message_.AppendToString(&out_);
+    }
+
+    // Protobuf has no envelope: an empty page is an empty body.
+    void finish() {
+        if (format_ == BodyFormat::Json) json_.finish();
+    }
+
+    // Ends the body as a SyncHttpResponse: the messages, then has_more = 2 and cursor = 3
+    // (omitted at their default, like SerializeAsString).
+    void finish(bool hasMore, const std::string& cursor) {
+        if (format_ == BodyFormat::Json) {
+            json_.finish(hasMore, cursor);
+            return;
+        }
+        if (hasMore) out_ += "\x10\x01";
+        if (!cursor.empty()) {
+            out_ += '\x1a';
+            append_varint(out_, cursor.size());
+            out_ += cursor;
+        }
+    }
+
+private:
+    std::string& out_;
+    BodyFormat format_;
+    MessagesJsonStream json_;
+    securecloud::gateway::HttpMessage message_;
+};
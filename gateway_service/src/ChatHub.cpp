@@ -0,0 +1,296 @@
+#include "ChatHub.h"
+
+#include <algorithm>
+#include <cstdlib>
+#include <iostream>
+
+namespace {
+size_t env_size(const char* name, size_t fallback) {
+    const char* v = std::getenv(name);
+    if (!v || !*v) return fallback;
+    try {
+        const long long n = std::stoll(v);
+        return n > 0 ? static_cast<size_t>(n) : fallback;
+    } catch (...) {
+        return fallback;
+    }
+}
+
+// "dm:<a>:<b>" -> a, b
+bool split_dm_key(const std::string& key, std::string* a, std::string* b) {
+    const std::string prefix = "dm:";
+    if (key.rfind(prefix, 0) != 0) return false;
+    const auto pos = key.find(':', prefix.size());
+    if (pos == std::string::npos) return false;
+    *a = key.substr(prefix.size(), pos - prefix.size());
+    *b = key.substr(pos + 1);
+    return !a->empty() && !b->empty();
+}
+}
+
+ChatHub::Subscription::Next ChatHub::Subscription::next(
+    std::shared_ptr<const securecloud::messaging::EncryptedMessage>* out,
+    std::chrono::milliseconds wait) {
+    std::unique_lock<std::mutex> lk(m_);
+    if (!cv_.wait_for(lk, wait, [this]() { return closed_ || !queue_.empty(); })) {
+        return Next::Timeout;
+    }
+    if (queue_.empty()) return Next::Closed;
+    auto msg = std::move(queue_.front());
+    queue_.pop_front();
+    if (!msg) return Next::Resync;
+    *out = std::move(msg);
+    return Next::Message;
+}
+
+void ChatHub::Subscription::push(std::shared_ptr<const securecloud::messaging::EncryptedMessage> msg) {
+    {
+        std::lock_guard<std::mutex> lk(m_);
+        if (closed_) return;
+        if (queue_.size() >= queueLimit_) {
+            // Slow consumer: drop the stream rather than buffer without bound.
+            queue_.clear();
+            closed_ = true;
+        } else {
+            queue_.push_back(std::move(msg));
+        }
+    }
+    cv_.notify_one();
+}
+
+void ChatHub::Subscription::close() {
+    {
+        std::lock_guard<std::mutex> lk(m_);
+        closed_ = true;
+    }
+    cv_.notify_all();
+}
+
+ChatHub::ChatHub(UpstreamPool<securecloud::messaging::MessagingService>& messagingStub, Options opts)
+    : messagingStub_(messagingStub), opts_(opts), upstreamCtx_(messagingStub.targetCount(), nullptr) {}
+
+ChatHub::~ChatHub() {
+    stop();
+}
+
+ChatHub::Options ChatHub::optionsFromEnv() {
+    Options opts;
+    opts.queueLimit = env_size("GATEWAY_EVENTS_QUEUE_LIMIT", opts.queueLimit);
+    opts.maxSubscribers = env_size("GATEWAY_EVENTS_MAX_STREAMS", opts.maxSubscribers);
+    opts.roomRefresh = std::chrono::seconds(
+        static_cast<long long>(env_size("GATEWAY_EVENTS_ROOM_REFRESH_SECONDS", static_cast<size_t>(opts.roomRefresh.count()))));
+    return opts;
+}
+
+void ChatHub::start() {
+    std::lock_guard<std::mutex> lk(m_);
+    if (!upstreams_.empty()) return;
+    stopping_ = false;
+    for (size_t t = 0; t < messagingStub_.targetCount(); ++t) {
+        upstreams_.emplace_back([this, t]() { upstreamLoop(t); });
+    }
+    refresher_ = std::thread([this]() { refreshLoop(); });
+}
+
+void ChatHub::stop() {
+    {
+        std::lock_guard<std::mutex> lk(m_);
+        stopping_ = true;
+        for (auto* ctx : upstreamCtx_) {
+            if (ctx) ctx->TryCancel();
+        }
+        for (auto& [userId, entry] : users_) {
+            for (auto& sub : entry.subs) sub->close();
+        }
+    }
+    cv_.notify_all();
+    for (auto& t : upstreams_) {
+        if (t.joinable()) t.join();
+    }
+    upstreams_.clear();
+    if (refresher_.joinable()) refresher_.join();
+}
+
+std::shared_ptr<ChatHub::Subscription> ChatHub::subscribe(const std::string& userId) {
+    {
+        std::lock_guard<std::mutex> lk(m_);
+        if (stopping_ || subscriberCount_ >= opts_.maxSubscribers) return nullptr;
+        ++subscriberCount_;
+    }
+
+    // Rooms are loaded before registering so the first room message is not missed; if the
+    // lookup fails the refresher retries on its next pass.
+    std::unordered_set<std::string> rooms;
+    const bool loaded = loadRooms(userId, &rooms);
+
+    auto sub = std::make_shared<Subscription>(userId, opts_.queueLimit);
+    {
+        std::lock_guard<std::mutex> lk(m_);
+        auto& entry = users_[userId];
+        entry.subs.push_back(sub);
+        if (loaded) {
+            setRoomsLocked(userId, entry, std::move(rooms));
+        } else {
+            roomsStale_ = true;
+        }
+    }
+    if (!loaded) cv_.notify_all();
+    return sub;
+}
+
+void ChatHub::unsubscribe(const std::shared_ptr<Subscription>& sub) {
+    if (!sub) return;
+    sub->close();
+    std::lock_guard<std::mutex> lk(m_);
+    const auto it = users_.find(sub->userId());
+    if (it == users_.end()) return;
+    auto& subs = it->second.subs;
+    const auto pos = std::find(subs.begin(), subs.end(), sub);
+    if (pos == subs.end()) return;
+    subs.erase(pos);
+    --subscriberCount_;
+    if (subs.empty()) {
+        setRoomsLocked(it->first, it->second, {});
+        users_.erase(it);
+    }
+}
+
+void ChatHub::closeUser(const std::string& userId) {
+    std::lock_guard<std::mutex> lk(m_);
+    const auto it = users_.find(userId);
+    if (it == users_.end()) return;
+    // Entries are removed by unsubscribe() when each stream's handler ends.
+    for (auto& sub : it->second.subs) sub->close();
+}
+
+void ChatHub::invalidateRooms() {
+    {
+        std::lock_guard<std::mutex> lk(m_);
+        roomsStale_ = true;
+    }
+    cv_.notify_all();
+}
+
+size_t ChatHub::subscriberCount() const {
+    std::lock_guard<std::mutex> lk(m_);
+    return subscriberCount_;
+}
+
+bool ChatHub::loadRooms(const std::string& userId, std::unordered_set<std::string>* rooms) {
+    securecloud::messaging::ListConversationsRequest lreq;
+    lreq.set_user_id(userId);
+    lreq.set_limit(1000);
+    securecloud::messaging::ListConversationsResponse lresp;
+    grpc::ClientContext ctx;
+    messagingStub_.setDeadline(ctx);
+    const auto st = messagingStub_->ListConversations(&ctx, lreq, &lresp);
+    if (!st.ok()) return false;
+    for (const auto& c : lresp.conversations()) {
+        if (c.conversation_id().rfind("room:", 0) == 0) rooms->insert(c.conversation_id());
+    }
+    return true;
+}
+
+void ChatHub::setRoomsLocked(const std::string& userId, UserEntry& entry, std::unordered_set<std::string> rooms) {
+    for (const auto& room : entry.rooms) {
+        if (rooms.count(room)) continue;
+        const auto it = roomUsers_.find(room);
+        if (it == roomUsers_.end()) continue;
+        it->second.erase(userId);
+        if (it->second.empty()) roomUsers_.erase(it);
+    }
+    for (const auto& room : rooms) {
+        roomUsers_[room].insert(userId);
+    }
+    entry.rooms = std::move(rooms);
+}
+
+void ChatHub::dispatch(const std::shared_ptr<const securecloud::messaging::EncryptedMessage>& msg) {
+    const std::string& key = msg->conversation_id();
+    std::lock_guard<std::mutex> lk(m_);
+    auto deliver = [&](const std::string& userId) {
+        const auto it = users_.find(userId);
+        if (it == users_.end()) return;
+        for (auto& sub : it->second.subs) sub->push(msg);
+    };
+
+    std::string a, b;
+    if (split_dm_key(key, &a, &b)) {
+        deliver(a);
+        if (b != a) deliver(b);
+        return;
+    }
+    const auto room = roomUsers_.find(key);
+    if (room == roomUsers_.end()) return;
+    for (const auto& userId : room->second) deliver(userId);
+}
+
+void ChatHub::upstreamLoop(size_t target) {
+    auto backoff = std::chrono::milliseconds(500);
+    for (;;) {
+        grpc::ClientContext ctx;
+        {
+            std::lock_guard<std::mutex> lk(m_);
+            if (stopping_) return;
+            upstreamCtx_[target] = &ctx;
+        }
+
+        // Read-only: the write side stays open (WritesDone would end the server handler).
+        auto stream = messagingStub_.forTarget(target).ChatStream(&ctx);
+        stream->WaitForInitialMetadata();
+        const auto& md = ctx.GetServerInitialMetadata();
+        const bool registered = md.find("x-stream-registered") != md.end();
+        if (registered) {
+            // Broadcasts sent through this replica while no stream to it was registered are lost
+            // for live delivery.
+            std::lock_guard<std::mutex> lk(m_);
+            for (auto& [userId, entry] : users_) {
+                for (auto& sub : entry.subs) sub->push(nullptr);
+            }
+        }
+
+        bool gotMessage = false;
+        for (;;) {
+            auto msg = std::make_shared<securecloud::messaging::EncryptedMessage>();
+            if (!stream->Read(msg.get())) break;
+            gotMessage = true;
+            dispatch(msg);
+        }
+        const auto st = stream->Finish();
+
+        {
+            std::unique_lock<std::mutex> lk(m_);
+            upstreamCtx_[target] = nullptr;
+            if (stopping_) return;
+            std::cerr << "[gateway] chat upstream " << messagingStub_.options().targets[target] << " closed ("
+                      << st.error_message() << "), reconnecting" << std::endl;
+            backoff = (registered || gotMessage) ? std::chrono::milliseconds(500)
+                                                 : std::min(backoff * 2, std::chrono::milliseconds(30000));
+            cv_.wait_for(lk, backoff, [this]() { return stopping_; });
+            if (stopping_) return;
+        }
+    }
+}
+
+void ChatHub::refreshLoop() {
+    for (;;) {
+        std::vector<std::string> userIds;
+        {
+            std::unique_lock<std::mutex> lk(m_);
+            cv_.wait_for(lk, opts_.roomRefresh, [this]() { return stopping_ || roomsStale_; });
+            if (stopping_) return;
+            roomsStale_ = false;
+            userIds.reserve(users_.size());
+            for (const auto& [userId, entry] : users_) userIds.push_back(userId);
+        }
+
+        for (const auto& userId : userIds) {
+            std::unordered_set<std::string> rooms;
+            if (!loadRooms(userId, &rooms)) continue;
+            std::lock_guard<std::mutex> lk(m_);
+            if (stopping_) return;
+            const auto it = users_.find(userId);
+            if (it != users_.end()) setRoomsLocked(userId, it->second, std::move(rooms));
+        }
+    }
+}
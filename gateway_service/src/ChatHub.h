@@ -0,0 +1,112 @@
+#pragma once
+
+#include "UpstreamPool.h"
+#include "messaging.grpc.pb.h"
+
+#include <grpcpp/grpcpp.h>
+
+#include <chrono>
+#include <condition_variable>
+#include <cstddef>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <unordered_map>
+#include <unordered_set>
+#include <vector>
+
+// Real-time fan-out for GET /events. A MessagingService::ChatStream only carries the messages sent
+// through its own replica, so the hub keeps one open per messaging_service target; each message
+// is routed to the connected users it concerns:
+//  - dm:<a>:<b>  -> users a and b,
+//  - room:<id>   -> the room's participants, as last listed by ListConversations (refreshed
+//                   periodically, and right away after a room is created through this gateway).
+// A subscriber that falls behind by more than queueLimit messages is closed; the client
+// reconnects and catches up through /sync.
+class ChatHub {
+public:
+    struct Options {
+        size_t queueLimit = 256;
+        size_t maxSubscribers = 48;
+        std::chrono::seconds roomRefresh{30};
+    };
+
+    class Subscription {
+    public:
+        enum class Next { Message, Resync, Timeout, Closed };
+
+        explicit Subscription(std::string userId, size_t queueLimit)
+            : userId_(std::move(userId)), queueLimit_(queueLimit) {}
+
+        const std::string& userId() const { return userId_; }
+
+        // Waits up to `wait` for the next event. Resync means messages may have been missed
+        // (upstream reconnected): the client should reload what it displays.
+        Next next(std::shared_ptr<const securecloud::messaging::EncryptedMessage>* out,
+                  std::chrono::milliseconds wait);
+
+    private:
+        friend class ChatHub;
+        void push(std::shared_ptr<const securecloud::messaging::EncryptedMessage> msg);
+        void close();
+
+        const std::string userId_;
+        const size_t queueLimit_;
+        std::mutex m_;
+        std::condition_variable cv_;
+        // nullptr entries are resync markers.
+        std::deque<std::shared_ptr<const securecloud::messaging::EncryptedMessage>> queue_;
+        bool closed_ = false;
+    };
+
+    ChatHub(UpstreamPool<securecloud::messaging::MessagingService>& messagingStub, Options opts);
+    ~ChatHub();
+
+    ChatHub(const ChatHub&) = delete;
+    ChatHub& operator=(const ChatHub&) = delete;
+
+    void start();
+    void stop();
+
+    // nullptr when maxSubscribers streams are already open.
+    std::shared_ptr<Subscription> subscribe(const std::string& userId);
+    void unsubscribe(const std::shared_ptr<Subscription>& sub);
+    // Closes every stream of a user (account deleted).
+    void closeUser(const std::string& userId);
+    // Room membership changed: reload the connected users' rooms now.
+    void invalidateRooms();
+
+    size_t subscriberCount() const;
+
+    // Reads GATEWAY_EVENTS_QUEUE_LIMIT, GATEWAY_EVENTS_MAX_STREAMS and
+    // GATEWAY_EVENTS_ROOM_REFRESH_SECONDS.
+    static Options optionsFromEnv();
+
+private:
+    struct UserEntry {
+        std::vector<std::shared_ptr<Subscription>> subs;
+        std::unordered_set<std::string> rooms;
+    };
+
+    void upstreamLoop(size_t target);
+    void refreshLoop();
+    void dispatch(const std::shared_ptr<const securecloud::messaging::EncryptedMessage>& msg);
+    bool loadRooms(const std::string& userId, std::unordered_set<std::string>* rooms);
+    void setRoomsLocked(const std::string& userId, UserEntry& entry, std::unordered_set<std::string> rooms);
+
+    UpstreamPool<securecloud::messaging::MessagingService>& messagingStub_;
+    const Options opts_;
+
+    mutable std::mutex m_;
+    std::condition_variable cv_;
+    std::unordered_map<std::string, UserEntry> users_;
+    std::unordered_map<std::string, std::unordered_set<std::string>> roomUsers_;
+    size_t subscriberCount_ = 0;
+    bool roomsStale_ = false;
+    bool stopping_ = false;
+    std::vector<grpc::ClientContext*> upstreamCtx_;  // per target
+    std::vector<std::thread> upstreams_;
+    std::thread refresher_;
+};
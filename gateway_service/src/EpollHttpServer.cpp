@@ -0,0 +1,1098 @@
+#include "EpollHttpServer.h"
+
+#if defined(__linux__)
+
+#include <arpa/inet.h>
+#include <fcntl.h>
+#include <netdb.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <cctype>
+#include <cerrno>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+#include <unordered_map>
+
+namespace {
+constexpr uint64_t kListenerId = 0;
+constexpr uint64_t kWakeId = 1;
+// A streaming response stops producing once this much is queued for a slow client.
+constexpr size_t kStreamHighWater = 1024 * 1024;
+// A streamed request body stops being read from the socket once this much waits for its handler.
+constexpr size_t kUploadHighWater = 1024 * 1024;
+
+size_t env_size(const char* name, size_t fallback) {
+    const char* v = std::getenv(name);
+    if (!v || !*v) return fallback;
+    try {
+        const long long n = std::stoll(v);
+        return n > 0 ? static_cast<size_t>(n) : fallback;
+    } catch (...) {
+        return fallback;
+    }
+}
+
+bool iequals(const std::string& a, const char* b) {
+    const size_t n = std::strlen(b);
+    if (a.size() != n) return false;
+    for (size_t i = 0; i < n; ++i) {
+        if (std::tolower(static_cast<unsigned char>(a[i])) != std::tolower(static_cast<unsigned char>(b[i]))) {
+            return false;
+        }
+    }
+    return true;
+}
+
+bool contains_token(const std::string& value, const char* token) {
+    std::string lower = value;
+    std::transform(lower.begin(), lower.end(), lower.begin(), [](unsigned char c) { return std::tolower(c); });
+    return lower.find(token) != std::string::npos;
+}
+
+std::string trim(const std::string& s) {
+    const auto b = s.find_first_not_of(" \t");
+    if (b == std::string::npos) return {};
+    const auto e = s.find_last_not_of(" \t");
+    return s.substr(b, e - b + 1);
+}
+
+std::string status_line_and_headers(const httplib::Response& res, bool keepAlive, bool streaming) {
+    std::string out;
+    out.reserve(256);
+    out += "HTTP/1.1 ";
+    out += std::to_string(res.status);
+    out += ' ';
+    out += httplib::status_message(res.status);
+    out += "\r\n";
+    for (const auto& [key, value] : res.headers) {
+        if (iequals(key, "Content-Length") || iequals(key, "Connection") || iequals(key, "Transfer-Encoding")) continue;
+        out += key;
+        out += ": ";
+        out += value;
+        out += "\r\n";
+    }
+    if (streaming) {
+        if (res.content_length_ > 0 && !res.is_chunked_content_provider_) {
+            out += "Content-Length: " + std::to_string(res.content_length_) + "\r\n";
+        } else {
+            out += "Transfer-Encoding: chunked\r\n";
+        }
+    } else if (res.status != 204 && res.status != 304) {
+        // 304: the cached representation's length is not ours to restate, and no body follows.
+        out += "Content-Length: " + std::to_string(res.body.size()) + "\r\n";
+    }
+    out += keepAlive ? "Connection: keep-alive\r\n\r\n" : "Connection: close\r\n\r\n";
+    return out;
+}
+
+// httplib::Server semantics for provider responses marked 206: the provider covers the whole
+// representation and the server sends the requested range. Several ranges get the whole
+// representation (200), which RFC 9110 allows.
+void narrow_to_range(httplib::Request& req, httplib::Response& res) {
+    if (req.ranges.empty()) {
+        res.status = 200;
+        return;
+    }
+    if (httplib::detail::range_error(req, res)) {
+        const size_t total = res.content_length_;
+        res.content_provider_ = nullptr;
+        res.content_length_ = 0;
+        res.body.clear();
+        res.status = 416;
+        res.set_header("Content-Range", "bytes */" + std::to_string(total));
+        return;
+    }
+    if (req.ranges.size() != 1) {
+        res.status = 200;
+        return;
+    }
+    const auto range = httplib::detail::get_range_offset_and_length(req.ranges[0], res.content_length_);
+    res.set_header("Content-Range", httplib::detail::make_content_range_header_field(range, res.content_length_));
+    const size_t first = range.first;
+    res.content_provider_ = [provider = std::move(res.content_provider_), first](size_t offset, size_t length,
+                                                                                 httplib::DataSink& sink) {
+        return provider(first + offset, length, sink);
+    };
+    res.content_length_ = range.second;
+}
+
+std::string error_response(int status) {
+    httplib::Response res;
+    res.status = status;
+    return status_line_and_headers(res, /*keepAlive*/ false, /*streaming*/ false);
+}
+
+// Incremental decoder for a chunked request body (RFC 9112 section 7.1). Chunk extensions and
+// trailer fields are skipped.
+class ChunkedDecoder {
+public:
+    bool done() const { return state_ == State::Done; }
+
+    // Decodes whole framing units from data[0, len) and appends the payload to *out; *consumed is
+    // how much was used (a partial size or trailer line is left for the next call).
+    // false on a framing error.
+    bool feed(const char* data, size_t len, size_t* consumed, std::string* out) {
+        size_t pos = 0;
+        while (state_ != State::Done) {
+            if (state_ == State::Data) {
+                const size_t n = std::min(len - pos, left_);
+                out->append(data + pos, n);
+                pos += n;
+                left_ -= n;
+                if (left_ > 0) break;
+                state_ = State::DataEnd;
+                continue;
+            }
+            if (state_ == State::DataEnd) {
+                if (len - pos < 2) break;
+                if (data[pos] != '\r' || data[pos + 1] != '\n') return false;
+                pos += 2;
+                state_ = State::Size;
+                continue;
+            }
+            // Size or trailer line.
+            const char* lineEnd = static_cast<const char*>(std::memchr(data + pos, '\n', len - pos));
+            if (!lineEnd) {
+                if (len - pos > kMaxLine) return false;
+                break;
+            }
+            const size_t end = static_cast<size_t>(lineEnd - data);
+            if (end == pos || data[end - 1] != '\r') return false;
+            const std::string line(data + pos, end - 1 - pos);
+            pos = end + 1;
+            if (state_ == State::Trailer) {
+                if (line.empty()) state_ = State::Done;
+                continue;
+            }
+            size_t size = 0;
+            size_t digits = 0;
+            for (const char ch : line) {
+                int v;
+                if (ch >= '0' && ch <= '9') v = ch - '0';
+                else if (ch >= 'a' && ch <= 'f') v = ch - 'a' + 10;
+                else if (ch >= 'A' && ch <= 'F') v = ch - 'A' + 10;
+                else break;  // ';' extension or whitespace
+                if (++digits > 15) return false;
+                size = size * 16 + static_cast<size_t>(v);
+            }
+            if (digits == 0) return false;
+            left_ = size;
+            state_ = size == 0 ? State::Trailer : State::Data;
+        }
+        *consumed = pos;
+        return true;
+    }
+
+private:
+    enum class State { Size, Data, DataEnd, Trailer, Done };
+    static constexpr size_t kMaxLine = 4096;
+    State state_ = State::Size;
+    size_t left_ = 0;
+};
+
+// A streamed response or upload refused at the transfer limit.
+httplib::Response busy_response() {
+    httplib::Response res;
+    res.status = 503;
+    res.set_header("Retry-After", "5");
+    res.set_content("{\"error\":\"Too many concurrent transfers\"}", "application/json");
+    return res;
+}
+
+bool is_chunked(const httplib::Request& req) {
+    return iequals(trim(req.get_header_value("Transfer-Encoding")), "chunked");
+}
+}
+
+struct EpollHttpServer::Exchange {
+    Loop* loop = nullptr;
+    uint64_t connId = 0;
+    bool keepAlive = true;
+    httplib::Request req;
+    httplib::Response res;
+    // Admission release (HttpRouter::Admission), called by complete().
+    HttpRouter::Release release;
+
+    // Set by the loop when the client goes away.
+    std::atomic<bool> closed{false};
+    // Streaming backpressure: bytes handed to the loop and not yet flushed.
+    std::mutex m;
+    std::condition_variable cv;
+    size_t queued = 0;
+    // Streamed request body (HttpRouter::PostStream): appended by the loop, drained by the handler.
+    bool streamedBody = false;
+    std::string bodyIn;
+    bool bodyEnd = false;
+
+    void markClosed() {
+        {
+            std::lock_guard<std::mutex> lk(m);
+            closed = true;
+        }
+        cv.notify_all();
+    }
+};
+
+class EpollHttpServer::Loop {
+public:
+    Loop(EpollHttpServer& server, size_t index) : server_(server), nextConnId_(2 + (static_cast<uint64_t>(index) << 48)) {}
+
+    ~Loop() {
+        if (listenFd_ >= 0) ::close(listenFd_);
+        if (wakeFd_ >= 0) ::close(wakeFd_);
+        if (epollFd_ >= 0) ::close(epollFd_);
+    }
+
+    bool bind(const std::string& host, int port) {
+        addrinfo hints{};
+        hints.ai_family = AF_UNSPEC;
+        hints.ai_socktype = SOCK_STREAM;
+        hints.ai_flags = AI_PASSIVE;
+        addrinfo* result = nullptr;
+        const std::string service = std::to_string(port);
+        if (::getaddrinfo(host.empty() ? nullptr : host.c_str(), service.c_str(), &hints, &result) != 0) return false;
+
+        for (addrinfo* ai = result; ai; ai = ai->ai_next) {
+            const int fd = ::socket(ai->ai_family, ai->ai_socktype | SOCK_NONBLOCK | SOCK_CLOEXEC, ai->ai_protocol);
+            if (fd < 0) continue;
+            const int one = 1;
+            ::setsockopt(fd, SOL_SOCKET, SO_REUSEADDR, &one, sizeof(one));
+            ::setsockopt(fd, SOL_SOCKET, SO_REUSEPORT, &one, sizeof(one));
+            if (::bind(fd, ai->ai_addr, ai->ai_addrlen) == 0 && ::listen(fd, SOMAXCONN) == 0) {
+                listenFd_ = fd;
+                break;
+            }
+            ::close(fd);
+        }
+        ::freeaddrinfo(result);
+        if (listenFd_ < 0) return false;
+
+        epollFd_ = ::epoll_create1(EPOLL_CLOEXEC);
+        wakeFd_ = ::eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+        if (epollFd_ < 0 || wakeFd_ < 0) return false;
+        epoll_event ev{};
+        ev.events = EPOLLIN;
+        ev.data.u64 = kListenerId;
+        ::epoll_ctl(epollFd_, EPOLL_CTL_ADD, listenFd_, &ev);
+        ev.data.u64 = kWakeId;
+        ::epoll_ctl(epollFd_, EPOLL_CTL_ADD, wakeFd_, &ev);
+        return true;
+    }
+
+    void run() {
+        epoll_event events[256];
+        auto lastSweep = std::chrono::steady_clock::now();
+        while (!server_.stopping_.load(std::memory_order_acquire)) {
+            const int n = ::epoll_wait(epollFd_, events, 256, 1000);
+            if (n < 0 && errno != EINTR) break;
+            for (int i = 0; i < n; ++i) {
+                const uint64_t id = events[i].data.u64;
+                if (id == kListenerId) {
+                    acceptAll();
+                    continue;
+                }
+                if (id == kWakeId) {
+                    uint64_t count = 0;
+                    (void)!::read(wakeFd_, &count, sizeof(count));
+                    drainCompletions();
+                    continue;
+                }
+                auto it = conns_.find(id);
+                if (it == conns_.end()) continue;
+                const uint32_t mask = events[i].events;
+                if (mask & (EPOLLIN | EPOLLHUP | EPOLLERR)) {
+                    if (!onReadable(it->second)) continue;
+                }
+                if (mask & EPOLLOUT) {
+                    it = conns_.find(id);
+                    if (it != conns_.end()) flush(it->second);
+                }
+            }
+            const auto now = std::chrono::steady_clock::now();
+            if (now - lastSweep >= std::chrono::seconds(1)) {
+                lastSweep = now;
+                sweepIdle(now);
+            }
+        }
+
+        std::vector<uint64_t> ids;
+        ids.reserve(conns_.size());
+        for (const auto& [id, c] : conns_) ids.push_back(id);
+        for (const auto id : ids) closeConn(conns_.at(id));
+    }
+
+    void wake() {
+        const uint64_t one = 1;
+        (void)!::write(wakeFd_, &one, sizeof(one));
+    }
+
+    // Thread-safe: hands response bytes to the loop. `last` ends the exchange; `stream` attaches a
+    // streaming exchange to the connection for backpressure.
+    void post(uint64_t connId, std::string bytes, bool last, bool close, std::shared_ptr<Exchange> stream = nullptr) {
+        {
+            std::lock_guard<std::mutex> lk(completionsM_);
+            completions_.push_back(Completion{connId, std::move(bytes), last, close, std::move(stream)});
+        }
+        wake();
+    }
+
+private:
+    struct Conn {
+        int fd = -1;
+        uint64_t id = 0;
+        std::string remoteAddr;
+        int remotePort = -1;
+        std::string in;
+        std::string out;
+        size_t outOff = 0;
+        bool busy = false;
+        bool closeAfter = false;
+        bool continueSent = false;
+        uint32_t interest = 0;
+        bool registered = false;
+        std::chrono::steady_clock::time_point lastActive;
+        std::shared_ptr<Exchange> current;
+        std::shared_ptr<Exchange> streaming;
+        // Exchange whose streamed body is still arriving, and how much of it (Content-Length),
+        // or its decoder and the payload received so far (chunked).
+        std::shared_ptr<Exchange> uploading;
+        size_t uploadLeft = 0;
+        bool uploadChunked = false;
+        size_t uploadReceived = 0;
+        ChunkedDecoder dechunk;
+        // Buffered chunked body being decoded: payload so far and where decoding resumes in `in`.
+        bool dechunking = false;
+        std::string dechunked;
+        size_t dechunkFrom = 0;
+    };
+
+    struct Completion {
+        uint64_t connId;
+        std::string bytes;
+        bool last;
+        bool close;
+        std::shared_ptr<Exchange> stream;
+    };
+
+    enum class Parse { Incomplete, Ready, Error };
+
+    void acceptAll() {
+        for (;;) {
+            sockaddr_storage addr{};
+            socklen_t len = sizeof(addr);
+            const int fd = ::accept4(listenFd_, reinterpret_cast<sockaddr*>(&addr), &len, SOCK_NONBLOCK | SOCK_CLOEXEC);
+            if (fd < 0) {
+                if (errno == EINTR) continue;
+                return; // EAGAIN, or out of descriptors: retried on the next readiness event
+            }
+            if (conns_.size() >= server_.opts_.maxConnectionsPerLoop) {
+                ::close(fd);
+                continue;
+            }
+            const int one = 1;
+            ::setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+
+            const uint64_t id = nextConnId_++;
+            Conn& c = conns_[id];
+            c.fd = fd;
+            c.id = id;
+            c.lastActive = std::chrono::steady_clock::now();
+            char host[INET6_ADDRSTRLEN] = {0};
+            if (addr.ss_family == AF_INET) {
+                const auto* a = reinterpret_cast<const sockaddr_in*>(&addr);
+                ::inet_ntop(AF_INET, &a->sin_addr, host, sizeof(host));
+                c.remotePort = ntohs(a->sin_port);
+            } else if (addr.ss_family == AF_INET6) {
+                const auto* a = reinterpret_cast<const sockaddr_in6*>(&addr);
+                ::inet_ntop(AF_INET6, &a->sin6_addr, host, sizeof(host));
+                c.remotePort = ntohs(a->sin6_port);
+            }
+            c.remoteAddr = host;
+            updateInterest(c);
+        }
+    }
+
+    // false if the connection was closed.
+    bool onReadable(Conn& c) {
+        char buf[64 * 1024];
+        for (int rounds = 0; rounds < 4; ++rounds) {
+            const ssize_t n = ::recv(c.fd, buf, sizeof(buf), 0);
+            if (n > 0) {
+                c.in.append(buf, static_cast<size_t>(n));
+                if (static_cast<size_t>(n) < sizeof(buf)) break;
+                continue;
+            }
+            if (n == 0) {
+                closeConn(c);
+                return false;
+            }
+            if (errno == EINTR) continue;
+            if (errno == EAGAIN || errno == EWOULDBLOCK) break;
+            closeConn(c);
+            return false;
+        }
+        c.lastActive = std::chrono::steady_clock::now();
+        if (c.uploading && !feedUpload(c)) {
+            closeConn(c);
+            return false;
+        }
+        return dispatchNext(c);
+    }
+
+    // Moves received body bytes of the uploading exchange to its handler. false on a chunked
+    // framing error or an oversized body: the connection cannot be resynchronised.
+    bool feedUpload(Conn& c) {
+        if (c.uploadChunked) {
+            Exchange& ex = *c.uploading;
+            size_t used = 0;
+            bool ok;
+            {
+                std::lock_guard<std::mutex> lk(ex.m);
+                const size_t before = ex.bodyIn.size();
+                ok = c.dechunk.feed(c.in.data(), c.in.size(), &used, &ex.bodyIn);
+                c.uploadReceived += ex.bodyIn.size() - before;
+                ok = ok && c.uploadReceived <= server_.opts_.maxUploadBytes;
+                ex.bodyEnd = ok && c.dechunk.done();
+            }
+            ex.cv.notify_all();
+            c.in.erase(0, used);
+            if (ex.bodyEnd) {
+                c.uploading.reset();
+                c.uploadChunked = false;
+            }
+            return ok;
+        }
+        const size_t n = std::min(c.in.size(), c.uploadLeft);
+        if (n == 0) return true;
+        Exchange& ex = *c.uploading;
+        {
+            std::lock_guard<std::mutex> lk(ex.m);
+            ex.bodyIn.append(c.in, 0, n);
+            c.uploadLeft -= n;
+            ex.bodyEnd = c.uploadLeft == 0;
+        }
+        ex.cv.notify_all();
+        c.in.erase(0, n);
+        if (c.uploadLeft == 0) c.uploading.reset();
+        return true;
+    }
+
+    // Writes what it can; once a finished response is fully sent, starts the next pipelined
+    // request. false if the connection was closed.
+    bool flush(Conn& c, bool dispatchAfter = true) {
+        while (c.outOff < c.out.size()) {
+            const ssize_t n = ::send(c.fd, c.out.data() + c.outOff, c.out.size() - c.outOff, MSG_NOSIGNAL);
+            if (n > 0) {
+                c.outOff += static_cast<size_t>(n);
+                continue;
+            }
+            if (n < 0 && errno == EINTR) continue;
+            if (n < 0 && (errno == EAGAIN || errno == EWOULDBLOCK)) break;
+            closeConn(c);
+            return false;
+        }
+
+        if (c.outOff == c.out.size()) {
+            c.out.clear();
+            c.outOff = 0;
+            if (c.streaming) {
+                {
+                    std::lock_guard<std::mutex> lk(c.streaming->m);
+                    c.streaming->queued = 0;
+                }
+                c.streaming->cv.notify_all();
+            }
+            if (!c.busy) {
+                if (c.closeAfter) {
+                    closeConn(c);
+                    return false;
+                }
+                if (dispatchAfter) return dispatchNext(c);
+            }
+        }
+        updateInterest(c);
+        return true;
+    }
+
+    bool dispatchNext(Conn& c) {
+        if (c.busy || c.closeAfter) {
+            updateInterest(c);
+            return true;
+        }
+
+        auto ex = std::make_shared<Exchange>();
+        int errorStatus = 0;
+        switch (parse(c, ex.get(), &errorStatus)) {
+        case Parse::Incomplete:
+            if (!c.out.empty()) return flush(c, /*dispatchAfter*/ false); // 100 Continue
+            updateInterest(c);
+            return true;
+        case Parse::Error:
+            c.out += error_response(errorStatus);
+            c.closeAfter = true;
+            return flush(c);
+        case Parse::Ready:
+            break;
+        }
+
+        if (ex->streamedBody && !ex->bodyEnd) c.uploading = ex;
+        ex->loop = this;
+        ex->connId = c.id;
+        ex->req.remote_addr = c.remoteAddr;
+        ex->req.remote_port = c.remotePort;
+        ex->req.is_connection_closed = [w = std::weak_ptr<Exchange>(ex)]() {
+            const auto e = w.lock();
+            return !e || e->closed.load();
+        };
+        c.busy = true;
+        c.current = ex;
+        EpollHttpServer* server = &server_;
+        if (!server_.workers_->enqueue([server, ex]() { server->runHandler(ex); })) {
+            c.busy = false;
+            c.current.reset();
+            c.out += error_response(503);
+            c.closeAfter = true;
+            return flush(c);
+        }
+        if (!c.out.empty()) return flush(c, /*dispatchAfter*/ false); // 100 Continue of a streamed body
+        updateInterest(c);
+        return true;
+    }
+
+    Parse parse(Conn& c, Exchange* ex, int* errorStatus) {
+        const auto headerEnd = c.in.find("\r\n\r\n");
+        if (headerEnd == std::string::npos) {
+            if (c.in.size() > server_.opts_.maxHeaderBytes) {
+                *errorStatus = 431;
+                return Parse::Error;
+            }
+            return Parse::Incomplete;
+        }
+
+        httplib::Request& req = ex->req;
+        size_t lineEnd = c.in.find("\r\n");
+        {
+            const std::string line = c.in.substr(0, lineEnd);
+            const auto s1 = line.find(' ');
+            const auto s2 = s1 == std::string::npos ? std::string::npos : line.find(' ', s1 + 1);
+            if (s2 == std::string::npos) {
+                *errorStatus = 400;
+                return Parse::Error;
+            }
+            req.method = line.substr(0, s1);
+            req.target = line.substr(s1 + 1, s2 - s1 - 1);
+            req.version = line.substr(s2 + 1);
+            if (req.version != "HTTP/1.1" && req.version != "HTTP/1.0") {
+                *errorStatus = 505;
+                return Parse::Error;
+            }
+        }
+
+        size_t pos = lineEnd + 2;
+        while (pos < headerEnd) {
+            lineEnd = c.in.find("\r\n", pos);
+            const std::string line = c.in.substr(pos, lineEnd - pos);
+            pos = lineEnd + 2;
+            const auto colon = line.find(':');
+            if (colon == std::string::npos) {
+                *errorStatus = 400;
+                return Parse::Error;
+            }
+            req.headers.emplace(trim(line.substr(0, colon)), trim(line.substr(colon + 1)));
+        }
+
+        std::string target = req.target;
+        const auto hash = target.find('#');
+        if (hash != std::string::npos) target.erase(hash);
+        const auto q = target.find('?');
+        req.path = httplib::decode_path_component(target.substr(0, q));
+        if (q != std::string::npos) {
+            httplib::detail::parse_query_text(target.substr(q + 1), req.params);
+        }
+        if (req.has_header("Range") && !httplib::detail::parse_range_header(req.get_header_value("Range"), req.ranges)) {
+            *errorStatus = 416;
+            return Parse::Error;
+        }
+        // Streamed bodies are POST only (HttpRouter::PostStream): other requests skip the lookup.
+        const HttpRouter::Route* route = req.method == "POST" ? server_.router_.match(req) : nullptr;
+        const bool streamed = route && route->bodyHandler;
+
+        const bool chunked = is_chunked(req);
+        if (req.has_header("Transfer-Encoding")) {
+            if (!chunked) {
+                *errorStatus = 501;  // other transfer codings (gzip, ...) are not supported
+                return Parse::Error;
+            }
+            if (req.has_header("Content-Length")) {
+                *errorStatus = 400;  // ambiguous framing (request smuggling)
+                return Parse::Error;
+            }
+        }
+        size_t contentLength = 0;
+        if (req.has_header("Content-Length")) {
+            try {
+                contentLength = static_cast<size_t>(std::stoull(req.get_header_value("Content-Length")));
+            } catch (...) {
+                *errorStatus = 400;
+                return Parse::Error;
+            }
+            if (contentLength > (streamed ? server_.opts_.maxUploadBytes : server_.opts_.maxBodyBytes)) {
+                *errorStatus = 413;
+                return Parse::Error;
+            }
+        }
+
+        const std::string connection = req.get_header_value("Connection");
+        if (req.version == "HTTP/1.1") {
+            ex->keepAlive = !contains_token(connection, "close");
+        } else {
+            ex->keepAlive = contains_token(connection, "keep-alive");
+        }
+
+        if (streamed && chunked) {
+            // Dispatched right away; the body follows through feedUpload().
+            const size_t start = headerEnd + 4;
+            ex->streamedBody = true;
+            c.uploadChunked = true;
+            c.dechunk = ChunkedDecoder();
+            size_t used = 0;
+            if (!c.dechunk.feed(c.in.data() + start, c.in.size() - start, &used, &ex->bodyIn) ||
+                ex->bodyIn.size() > server_.opts_.maxUploadBytes) {
+                *errorStatus = ex->bodyIn.size() > server_.opts_.maxUploadBytes ? 413 : 400;
+                return Parse::Error;
+            }
+            c.in.erase(0, start + used);
+            c.uploadReceived = ex->bodyIn.size();
+            ex->bodyEnd = c.dechunk.done();
+            if (ex->bodyEnd) c.uploadChunked = false;
+            if (!ex->bodyEnd && contains_token(req.get_header_value("Expect"), "100-continue")) {
+                c.out += "HTTP/1.1 100 Continue\r\n\r\n";
+            }
+            c.continueSent = false;
+            return Parse::Ready;
+        }
+
+        if (chunked) {
+            // Buffered like a Content-Length body; decoding resumes where the last read stopped.
+            if (!c.dechunking) {
+                c.dechunking = true;
+                c.dechunk = ChunkedDecoder();
+                c.dechunked.clear();
+                c.dechunkFrom = headerEnd + 4;
+            }
+            size_t used = 0;
+            if (!c.dechunk.feed(c.in.data() + c.dechunkFrom, c.in.size() - c.dechunkFrom, &used, &c.dechunked)) {
+                c.dechunking = false;
+                *errorStatus = 400;
+                return Parse::Error;
+            }
+            c.dechunkFrom += used;
+            if (c.dechunked.size() > server_.opts_.maxBodyBytes) {
+                c.dechunking = false;
+                *errorStatus = 413;
+                return Parse::Error;
+            }
+            if (!c.dechunk.done()) {
+                if (!c.continueSent && contains_token(req.get_header_value("Expect"), "100-continue")) {
+                    c.out += "HTTP/1.1 100 Continue\r\n\r\n";
+                    c.continueSent = true;
+                }
+                return Parse::Incomplete;
+            }
+            req.body = std::move(c.dechunked);
+            c.dechunked.clear();
+            c.in.erase(0, c.dechunkFrom);
+            c.dechunking = false;
+            c.continueSent = false;
+            return Parse::Ready;
+        }
+
+        if (streamed) {
+            // Dispatched right away; the body follows through feedUpload().
+            const size_t start = headerEnd + 4;
+            const size_t now = std::min(c.in.size() - start, contentLength);
+            ex->streamedBody = true;
+            ex->bodyIn.assign(c.in, start, now);
+            c.in.erase(0, start + now);
+            c.uploadLeft = contentLength - now;
+            ex->bodyEnd = c.uploadLeft == 0;
+            if (!ex->bodyEnd && contains_token(req.get_header_value("Expect"), "100-continue")) {
+                c.out += "HTTP/1.1 100 Continue\r\n\r\n";
+            }
+            c.continueSent = false;
+            return Parse::Ready;
+        }
+
+        const size_t total = headerEnd + 4 + contentLength;
+        if (c.in.size() < total) {
+            if (!c.continueSent && contains_token(req.get_header_value("Expect"), "100-continue")) {
+                c.out += "HTTP/1.1 100 Continue\r\n\r\n";
+                c.continueSent = true;
+            }
+            return Parse::Incomplete;
+        }
+        req.body.assign(c.in, headerEnd + 4, contentLength);
+        c.in.erase(0, total);
+        c.continueSent = false;
+        return Parse::Ready;
+    }
+
+    void drainCompletions() {
+        std::vector<Completion> batch;
+        {
+            std::lock_guard<std::mutex> lk(completionsM_);
+            batch.swap(completions_);
+        }
+        for (auto& comp : batch) {
+            const auto it = conns_.find(comp.connId);
+            if (it == conns_.end()) {
+                if (comp.stream) comp.stream->markClosed();
+                continue;
+            }
+            Conn& c = it->second;
+            c.out += comp.bytes;
+            if (comp.stream) c.streaming = std::move(comp.stream);
+            if (comp.last) {
+                c.busy = false;
+                c.current.reset();
+                c.streaming.reset();
+                if (comp.close) c.closeAfter = true;
+                if (c.uploading) {
+                    // Answered before the whole body was read: the rest cannot be told from the
+                    // next request.
+                    c.uploading.reset();
+                    c.uploadLeft = 0;
+                    c.uploadChunked = false;
+                    c.closeAfter = true;
+                }
+            }
+            c.lastActive = std::chrono::steady_clock::now();
+            flush(c);
+        }
+    }
+
+    void sweepIdle(std::chrono::steady_clock::time_point now) {
+        std::vector<uint64_t> idle;
+        for (const auto& [id, c] : conns_) {
+            if (!c.busy && c.out.empty() && now - c.lastActive > server_.opts_.idleTimeout) idle.push_back(id);
+        }
+        for (const auto id : idle) closeConn(conns_.at(id));
+    }
+
+    void updateInterest(Conn& c) {
+        uint32_t want = 0;
+        bool uploadFull = false;
+        if (c.uploading) {
+            std::lock_guard<std::mutex> lk(c.uploading->m);
+            uploadFull = c.uploading->bodyIn.size() >= kUploadHighWater;
+        }
+        // While a request is in flight, buffer at most one more request's worth of pipelined input.
+        if (!uploadFull && (!c.busy || c.in.size() < server_.opts_.maxHeaderBytes + server_.opts_.maxBodyBytes)) {
+            want |= EPOLLIN;
+        }
+        if (c.outOff < c.out.size()) want |= EPOLLOUT;
+        if (c.registered && want == c.interest) return;
+        epoll_event ev{};
+        ev.events = want;
+        ev.data.u64 = c.id;
+        ::epoll_ctl(epollFd_, c.registered ? EPOLL_CTL_MOD : EPOLL_CTL_ADD, c.fd, &ev);
+        c.registered = true;
+        c.interest = want;
+    }
+
+    void closeConn(Conn& c) {
+        if (c.current) c.current->markClosed();
+        if (c.streaming) c.streaming->markClosed();
+        ::epoll_ctl(epollFd_, EPOLL_CTL_DEL, c.fd, nullptr);
+        ::close(c.fd);
+        const uint64_t id = c.id;
+        conns_.erase(id);
+    }
+
+    EpollHttpServer& server_;
+    int listenFd_ = -1;
+    int epollFd_ = -1;
+    int wakeFd_ = -1;
+    uint64_t nextConnId_;
+    std::unordered_map<uint64_t, Conn> conns_;
+
+    std::mutex completionsM_;
+    std::vector<Completion> completions_;
+};
+
+EpollHttpServer::EpollHttpServer(const HttpRouter& router, Options opts)
+    : router_(router), opts_(opts), workers_(new httplib::ThreadPool(std::max<size_t>(1, opts.workers))) {}
+
+EpollHttpServer::~EpollHttpServer() {
+    stop();
+    for (auto& t : loopThreads_) {
+        if (t.joinable()) t.join();
+    }
+    {
+        std::unique_lock<std::mutex> lk(streamsM_);
+        streamsCv_.wait(lk, [this]() { return activeStreams_ == 0; });
+        transfersStopping_ = true;
+    }
+    transfersCv_.notify_all();
+    for (auto& t : transferThreads_) t.join();
+    workers_->shutdown();
+}
+
+EpollHttpServer::Options EpollHttpServer::optionsFromEnv() {
+    Options opts;
+    opts.loops = env_size("GATEWAY_EPOLL_LOOPS", std::max(1u, std::thread::hardware_concurrency() / 2));
+    opts.workers = env_size("GATEWAY_HTTP_THREADS", opts.workers);
+    opts.maxUploadBytes = env_size("GATEWAY_MAX_UPLOAD_BYTES", opts.maxUploadBytes);
+    opts.maxStreams = env_size("GATEWAY_MAX_STREAMS", opts.maxStreams);
+    opts.idleTimeout = std::chrono::seconds(
+        static_cast<long long>(env_size("GATEWAY_HTTP_IDLE_TIMEOUT_SECONDS", static_cast<size_t>(opts.idleTimeout.count()))));
+    return opts;
+}
+
+bool EpollHttpServer::listen(const std::string& host, int port) {
+    stopping_ = false;
+    for (size_t i = 0; i < std::max<size_t>(1, opts_.loops); ++i) {
+        auto loop = std::make_unique<Loop>(*this, i);
+        if (!loop->bind(host, port)) {
+            std::cerr << "[gateway] epoll: cannot bind " << host << ":" << port << ": " << std::strerror(errno) << std::endl;
+            loops_.clear();
+            return false;
+        }
+        loops_.push_back(std::move(loop));
+    }
+    for (size_t i = 1; i < loops_.size(); ++i) {
+        Loop* loop = loops_[i].get();
+        loopThreads_.emplace_back([loop]() { loop->run(); });
+    }
+    loops_[0]->run();
+    for (auto& t : loopThreads_) {
+        if (t.joinable()) t.join();
+    }
+    return true;
+}
+
+void EpollHttpServer::stop() {
+    stopping_ = true;
+    for (auto& loop : loops_) loop->wake();
+}
+
+void EpollHttpServer::runHandler(const std::shared_ptr<Exchange>& ex) {
+    const auto* route = router_.match(ex->req);
+    if (!route) {
+        ex->res.status = 404;
+        complete(ex);
+        return;
+    }
+    try {
+        if (!router_.admit(ex->req, ex->res, &ex->release)) {
+            complete(ex);
+            return;
+        }
+        if (route->bodyHandler) {
+            runBodyHandler(*route, ex);
+            return;
+        }
+        if (route->handler) {
+            route->handler(ex->req, ex->res);
+            complete(ex);
+        } else {
+            route->asyncHandler(ex->req, ex->res, [this, ex]() { complete(ex); });
+        }
+    } catch (const std::exception& e) {
+        std::cerr << "[gateway] handler error on " << ex->req.path << ": " << e.what() << std::endl;
+        ex->res = httplib::Response();
+        ex->res.status = 500;
+        complete(ex);
+    }
+}
+
+void EpollHttpServer::complete(const std::shared_ptr<Exchange>& ex) {
+    if (ex->res.status == -1) ex->res.status = 200;
+    if (ex->release) {
+        const auto release = std::move(ex->release);
+        ex->release = nullptr;
+        release(ex->res);
+    }
+    router_.filterResponse(ex->req, ex->res);
+    if (ex->res.status == 206 && ex->res.content_provider_ && ex->res.content_length_ > 0) {
+        narrow_to_range(ex->req, ex->res);
+    }
+
+    if (!ex->res.content_provider_) {
+        std::string bytes = status_line_and_headers(ex->res, ex->keepAlive, /*streaming*/ false);
+        bytes += ex->res.body;
+        ex->loop->post(ex->connId, std::move(bytes), /*last*/ true, /*close*/ !ex->keepAlive);
+        return;
+    }
+
+    // Headers are only queued once a transfer thread is secured: at the limit the provider is
+    // released unused and the client told to come back.
+    const bool started = startTransfer([this, ex]() {
+        ex->loop->post(ex->connId, status_line_and_headers(ex->res, ex->keepAlive, /*streaming*/ true),
+                       /*last*/ false, /*close*/ false, ex);
+        stream(ex);
+    });
+    if (!started) {
+        const auto releaser = std::move(ex->res.content_provider_resource_releaser_);
+        ex->res.content_provider_resource_releaser_ = nullptr;
+        ex->res.content_provider_ = nullptr;
+        if (releaser) releaser(false);
+        ex->res = busy_response();
+        std::string bytes = status_line_and_headers(ex->res, ex->keepAlive, /*streaming*/ false);
+        bytes += ex->res.body;
+        ex->loop->post(ex->connId, std::move(bytes), /*last*/ true, /*close*/ !ex->keepAlive);
+    }
+}
+
+bool EpollHttpServer::startTransfer(std::function<void()> fn) {
+    {
+        std::lock_guard<std::mutex> lk(streamsM_);
+        if (transfersStopping_ || activeStreams_ >= std::max<size_t>(1, opts_.maxStreams)) return false;
+        ++activeStreams_;
+        transfers_.push_back(std::move(fn));
+        // activeStreams_ <= maxStreams bounds the thread count: one is started only when every
+        // existing thread is busy.
+        if (transfers_.size() > idleTransferThreads_) {
+            transferThreads_.emplace_back([this]() { transferWorker(); });
+        }
+    }
+    transfersCv_.notify_one();
+    return true;
+}
+
+void EpollHttpServer::transferWorker() {
+    std::unique_lock<std::mutex> lk(streamsM_);
+    for (;;) {
+        ++idleTransferThreads_;
+        transfersCv_.wait(lk, [this]() { return transfersStopping_ || !transfers_.empty(); });
+        --idleTransferThreads_;
+        if (transfers_.empty()) return;  // stopping
+        auto fn = std::move(transfers_.front());
+        transfers_.pop_front();
+        lk.unlock();
+        fn();
+        fn = nullptr;  // drop captured exchanges before signalling completion
+        lk.lock();
+        --activeStreams_;
+        streamsCv_.notify_all();
+    }
+}
+
+void EpollHttpServer::runBodyHandler(const HttpRouter::Route& route, const std::shared_ptr<Exchange>& ex) {
+    // Uploads last as long as the transfer: off the worker pool, like streamed responses.
+    const bool started = startTransfer([this, &route, ex]() {
+        httplib::ContentReader reader(
+            [ex](httplib::ContentReceiver receiver) {
+                std::string chunk;
+                for (;;) {
+                    bool end = false;
+                    {
+                        std::unique_lock<std::mutex> lk(ex->m);
+                        ex->cv.wait(lk, [&]() { return ex->closed || !ex->bodyIn.empty() || ex->bodyEnd; });
+                        if (ex->closed) return false;
+                        // Swap buffers: both keep their capacity, memory stays bounded per transfer.
+                        chunk.clear();
+                        chunk.swap(ex->bodyIn);
+                        end = ex->bodyEnd;
+                    }
+                    // The loop may have stopped reading at the high-water mark.
+                    if (!end) ex->loop->post(ex->connId, std::string(), /*last*/ false, /*close*/ false);
+                    if (!chunk.empty() && !receiver(chunk.data(), chunk.size())) return false;
+                    if (end) return true;
+                }
+            },
+            [](httplib::FormDataHeader, httplib::ContentReceiver) { return false; });
+        try {
+            route.bodyHandler(ex->req, ex->res, reader);
+        } catch (const std::exception& e) {
+            std::cerr << "[gateway] handler error on " << ex->req.path << ": " << e.what() << std::endl;
+            ex->res = httplib::Response();
+            ex->res.status = 500;
+        }
+        complete(ex);
+    });
+    if (!started) {
+        // The loop sees the answer before the end of the body and closes the connection.
+        ex->res = busy_response();
+        complete(ex);
+    }
+}
+
+void EpollHttpServer::stream(const std::shared_ptr<Exchange>& ex) {
+    httplib::Response& res = ex->res;
+    const bool chunked = res.is_chunked_content_provider_ || res.content_length_ == 0;
+    size_t offset = 0;
+    bool finished = false;
+
+    httplib::DataSink sink;
+    sink.write = [&](const char* data, size_t len) -> bool {
+        if (len == 0) return !ex->closed;
+        {
+            std::unique_lock<std::mutex> lk(ex->m);
+            ex->cv.wait(lk, [&]() { return ex->closed || ex->queued < kStreamHighWater; });
+            if (ex->closed) return false;
+            ex->queued += len;
+        }
+        std::string frame;
+        if (chunked) {
+            char size[32];
+            std::snprintf(size, sizeof(size), "%zx\r\n", len);
+            frame.reserve(len + 40);
+            frame += size;
+            frame.append(data, len);
+            frame += "\r\n";
+        } else {
+            frame.assign(data, len);
+        }
+        offset += len;
+        ex->loop->post(ex->connId, std::move(frame), /*last*/ false, /*close*/ false);
+        return true;
+    };
+    sink.is_writable = [&]() { return !ex->closed; };
+    sink.done = [&]() { finished = true; };
+    sink.done_with_trailer = [&](const httplib::Headers&) { finished = true; };
+
+    bool ok = true;
+    while (ok && !finished && !ex->closed) {
+        if (!chunked && offset >= res.content_length_) {
+            finished = true;
+            break;
+        }
+        ok = res.content_provider_(offset, chunked ? 0 : res.content_length_ - offset, sink);
+    }
+
+    if (ok && finished && !ex->closed) {
+        res.content_provider_success_ = true;
+        ex->loop->post(ex->connId, chunked ? std::string("0\r\n\r\n") : std::string(), /*last*/ true, !ex->keepAlive);
+    } else {
+        // Aborted mid-body: the framing is broken, drop the connection.
+        ex->loop->post(ex->connId, std::string(), /*last*/ true, /*close*/ true);
+    }
+}
+
+#else
+
+// Not available on this platform: main() keeps the httplib engine.
+class EpollHttpServer::Loop {};
+struct EpollHttpServer::Exchange {};
+EpollHttpServer::EpollHttpServer(const HttpRouter& router, Options opts) : router_(router), opts_(opts) {}
+EpollHttpServer::~EpollHttpServer() = default;
+EpollHttpServer::Options EpollHttpServer::optionsFromEnv() { return Options{}; }
+bool EpollHttpServer::listen(const std::string&, int) { return false; }
+void EpollHttpServer::stop() {}
+void EpollHttpServer::runHandler(const std::shared_ptr<Exchange>&) {}
+void EpollHttpServer::complete(const std::shared_ptr<Exchange>&) {}
+void EpollHttpServer::stream(const std::shared_ptr<Exchange>&) {}
+void EpollHttpServer::runBodyHandler(const HttpRouter::Route&, const std::shared_ptr<Exchange>&) {}
+bool EpollHttpServer::startTransfer(std::function<void()>) { return false; }
+void EpollHttpServer::transferWorker() {}
+
+#endif
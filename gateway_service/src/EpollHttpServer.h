@@ -0,0 +1,89 @@
+#pragma once
+
+#include "HttpRouter.h"
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstddef>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+// HTTP/1.1 server core built on epoll (Linux), hosting an HttpRouter.
+//  - Connections cost a buffer, not a thread: each event loop owns its own SO_REUSEPORT listener
+//    and multiplexes thousands of keep-alive sockets.
+//  - Requests on one connection are served in order (keep-alive and pipelining); a pipelined
+//    request is parsed once the previous response is queued.
+//  - Handlers run on a worker pool. Async routes return their worker as soon as the upstream
+//    gRPC call is issued and the response is sent from the completion callback, so a slow
+//    upstream no longer pins one thread per request.
+//  - Streaming responses (content providers, e.g. /events, file downloads) are pumped by a
+//    thread of the transfer pool, with write backpressure from the loop. A provider response
+//    marked 206 is narrowed to the request's Range, as httplib::Server does.
+//  - Streamed request bodies (HttpRouter::PostStream, uploads) are handed to their handler, also
+//    on the transfer pool, as they arrive; the loop stops reading the socket while
+//    kUploadHighWater bytes wait.
+//  - The transfer pool starts threads on demand and reuses them, up to maxStreams transfers at
+//    once; past that a stream or upload is answered 503 with Retry-After.
+//  - Request bodies may be chunked (Transfer-Encoding: chunked), buffered or streamed.
+class EpollHttpServer {
+public:
+    struct Options {
+        size_t loops = 1;
+        size_t workers = 16;
+        size_t maxConnectionsPerLoop = 20000;
+        size_t maxHeaderBytes = 64 * 1024;
+        size_t maxBodyBytes = 8 * 1024 * 1024;
+        size_t maxUploadBytes = size_t{16} << 30;  // streamed bodies only
+        size_t maxStreams = 512;                    // concurrent streamed responses + uploads
+        std::chrono::seconds idleTimeout{60};
+    };
+
+    EpollHttpServer(const HttpRouter& router, Options opts);
+    ~EpollHttpServer();
+
+    EpollHttpServer(const EpollHttpServer&) = delete;
+    EpollHttpServer& operator=(const EpollHttpServer&) = delete;
+
+    // Binds and serves until stop(); false if the socket could not be bound.
+    bool listen(const std::string& host, int port);
+    void stop();
+
+    // Reads GATEWAY_EPOLL_LOOPS, GATEWAY_HTTP_THREADS, GATEWAY_HTTP_IDLE_TIMEOUT_SECONDS,
+    // GATEWAY_MAX_UPLOAD_BYTES and GATEWAY_MAX_STREAMS.
+    static Options optionsFromEnv();
+
+    class Loop;
+    struct Exchange;
+
+private:
+    void runHandler(const std::shared_ptr<Exchange>& ex);
+    void complete(const std::shared_ptr<Exchange>& ex);
+    void stream(const std::shared_ptr<Exchange>& ex);
+    void runBodyHandler(const HttpRouter::Route& route, const std::shared_ptr<Exchange>& ex);
+    // Runs `fn` on the transfer pool; false, without running it, when maxStreams transfers are
+    // already in progress. The destructor waits for every accepted transfer.
+    bool startTransfer(std::function<void()> fn);
+    void transferWorker();
+
+    const HttpRouter& router_;
+    const Options opts_;
+    std::unique_ptr<httplib::TaskQueue> workers_;
+    std::vector<std::unique_ptr<Loop>> loops_;
+    std::vector<std::thread> loopThreads_;
+    std::atomic<bool> stopping_{false};
+
+    std::mutex streamsM_;
+    std::condition_variable streamsCv_;      // activeStreams_ dropped
+    std::condition_variable transfersCv_;    // job queued, or shutting down
+    std::deque<std::function<void()>> transfers_;
+    std::vector<std::thread> transferThreads_;
+    size_t activeStreams_ = 0;  // accepted transfers, queued or running
+    size_t idleTransferThreads_ = 0;
+    bool transfersStopping_ = false;
+};
@@ -0,0 +1,191 @@
+#pragma once
+
+#include "JsonWriter.h"
+#include "gateway.pb.h"
+#include "messaging.pb.h"
+
+#include <string>
+
+// JSON for the gateway.proto response types, byte-for-byte what MessageToJsonString prints
+// (compact) for the same message. Field names are the proto3 json names; keep them in sync with
+// gateway.proto (gateway_json_bench checks every type against MessageToJsonString).
+
+inline void write_json(JsonWriter& w, const securecloud::gateway::LoginResponse& m) {
+    w.beginObject();
+    w.field("accessToken", m.access_token());
+    w.field("refreshToken", m.refresh_token());
+    w.field("expiresIn", m.expires_in());
+    w.endObject();
+}
+
+inline void write_json(JsonWriter& w, const securecloud::gateway::ConversationSummary& m) {
+    w.beginObject();
+    w.field("conversationId", m.conversation_id());
+    w.field("lastMessage", m.last_message());
+    w.field("lastTimestampUnix", m.last_timestamp_unix());
+    w.endObject();
+}
+
+inline void write_json(JsonWriter& w, const securecloud::gateway::ListConversationsResponse& m) {
+    w.beginObject();
+    w.field("conversations", m.conversations());
+    w.endObject();
+}
+
+// HttpMessage fields, shared by the gateway type and the upstream messages the history and
+// event routes render directly (no intermediate HttpMessage).
+inline void write_http_message(JsonWriter& w,
+                               const std::string& messageId,
+                               const std::string& conversationId,
+                               const std::string& senderId,
+                               const std::string& content,
+                               std::int64_t timestampUnix) {
+    w.beginObject();
+    w.field("messageId", messageId);
+    w.field("conversationId", conversationId);
+    w.field("senderId", senderId);
+    w.field("content", content);
+    w.field("timestampUnix", timestampUnix);
+    w.endObject();
+}
+
+inline void write_json(JsonWriter& w, const securecloud::gateway::HttpMessage& m) {
+    write_http_message(w, m.message_id(), m.conversation_id(), m.sender_id(), m.content(), m.timestamp_unix());
+}
+
+// An upstream message as the HttpMessage the client sees: ciphertext becomes content and the
+// conversation id is the client-facing one.
+inline void write_http_message(JsonWriter& w,
+                               const securecloud::messaging::EncryptedMessage& m,
+                               const std::string& clientConversationId) {
+    write_http_message(w, m.message_id(), clientConversationId, m.sender_id(), m.ciphertext(), m.timestamp_unix());
+}
+
+inline void write_json(JsonWriter& w, const securecloud::gateway::ListMessagesResponse& m) {
+    w.beginObject();
+    w.field("messages", m.messages());
+    w.endObject();
+}
+
+inline void write_json(JsonWriter& w, const securecloud::gateway::SyncHttpResponse& m) {
+    w.beginObject();
+    w.field("messages", m.messages());
+    w.field("hasMore", m.has_more());
+    w.field("cursor", m.cursor());
+    w.endObject();
+}
+
+// A ListMessagesResponse body produced message by message from upstream messages, without
+// building the gateway message: same bytes as write_json on the equivalent ListMessagesResponse.
+// The buffer may be drained between add() calls (chunked responses).
+class MessagesJsonStream {
+public:
+    explicit MessagesJsonStream(std::string& out) : w_(out) {}
+
+    void add(const securecloud::messaging::EncryptedMessage& m, const std::string& clientConversationId) {
+        if (count_ == 0) {
+            w_.beginObject();
+            w_.beginArray("messages");
+        }
+        w_.arraySeparator(count_ == 0);
+        write_http_message(w_, m, clientConversationId);
+        ++count_;
+    }
+
+    void finish() {
+        closeMessages();
+        w_.endObject();
+    }
+
+    // Same bytes as write_json on the equivalent SyncHttpResponse (/sync pages).
+    void finish(bool hasMore, const std::string& cursor) {
+        closeMessages();
+        w_.field("hasMore", hasMore);
+        w_.field("cursor", cursor);
+        w_.endObject();
+    }
+
+    size_t count() const { return count_; }
+
+private:
+    void closeMessages() {
+        if (count_ == 0) {
+            w_.beginObject();
+        } else {
+            w_.endArray();
+        }
+    }
+
+    JsonWriter w_;
+    size_t count_ = 0;
+};
+
+inline void write_json(JsonWriter& w, const securecloud::gateway::SendMessageHttpResponse& m) {
+    w.beginObject();
+    w.field("messageId", m.message_id());
+    w.field("accepted", m.accepted());
+    w.endObject();
+}
+
+inline void write_json(JsonWriter& w, const securecloud::gateway::HttpUser& m) {
+    w.beginObject();
+    w.field("userId", m.user_id());
+    w.field("fullName", m.full_name());
+    w.field("email", m.email());
+    w.field("role", m.role());
+    w.endObject();
+}
+
+inline void write_json(JsonWriter& w, const securecloud::gateway::ListUsersHttpResponse& m) {
+    w.beginObject();
+    w.field("users", m.users());
+    w.endObject();
+}
+
+inline void write_json(JsonWriter& w, const securecloud::gateway::CreateRoomHttpResponse& m) {
+    w.beginObject();
+    w.field("success", m.success());
+    w.field("message", m.message());
+    w.field("roomId", m.room_id());
+    w.endObject();
+}
+
+inline void write_json(JsonWriter& w, const securecloud::gateway::RoomSummary& m) {
+    w.beginObject();
+    w.field("roomId", m.room_id());
+    w.field("title", m.title());
+    w.endObject();
+}
+
+inline void write_json(JsonWriter& w, const securecloud::gateway::ListRoomsResponse& m) {
+    w.beginObject();
+    w.field("rooms", m.rooms());
+    w.endObject();
+}
+
+inline void write_json(JsonWriter& w, const securecloud::gateway::ConversationPage& m) {
+    w.beginObject();
+    w.field("conversationId", m.conversation_id());
+    w.field("messages", m.messages());
+    w.field("status", m.status());
+    w.field("error", m.error());
+    w.endObject();
+}
+
+inline void write_json(JsonWriter& w, const securecloud::gateway::BootstrapResponse& m) {
+    w.beginObject();
+    if (m.has_me()) w.object("me", m.me());
+    w.field("users", m.users());
+    w.field("rooms", m.rooms());
+    w.field("conversations", m.conversations());
+    w.endObject();
+}
+
+// Whole message into a fresh string.
+template <typename TMessage>
+std::string to_json(const TMessage& m) {
+    std::string out;
+    JsonWriter w(out);
+    write_json(w, m);
+    return out;
+}
@@ -0,0 +1,103 @@
+#include "HttpRouter.h"
+
+#include <future>
+#include <memory>
+
+HttpRouter& HttpRouter::add(const std::string& method,
+                            const std::string& pattern,
+                            Handler handler,
+                            AsyncHandler asyncHandler,
+                            BodyHandler bodyHandler) {
+    routes_.push_back(Route{method, pattern, std::regex(pattern), std::move(handler), std::move(asyncHandler),
+                            std::move(bodyHandler)});
+    return *this;
+}
+
+HttpRouter& HttpRouter::Get(const std::string& pattern, Handler handler) {
+    return add("GET", pattern, std::move(handler), nullptr);
+}
+
+HttpRouter& HttpRouter::Post(const std::string& pattern, Handler handler) {
+    return add("POST", pattern, std::move(handler), nullptr);
+}
+
+HttpRouter& HttpRouter::Delete(const std::string& pattern, Handler handler) {
+    return add("DELETE", pattern, std::move(handler), nullptr);
+}
+
+HttpRouter& HttpRouter::GetAsync(const std::string& pattern, AsyncHandler handler) {
+    return add("GET", pattern, nullptr, std::move(handler));
+}
+
+HttpRouter& HttpRouter::PostAsync(const std::string& pattern, AsyncHandler handler) {
+    return add("POST", pattern, nullptr, std::move(handler));
+}
+
+HttpRouter& HttpRouter::PostStream(const std::string& pattern, BodyHandler handler) {
+    return add("POST", pattern, nullptr, nullptr, std::move(handler));
+}
+
+const HttpRouter::Route* HttpRouter::match(httplib::Request& req) const {
+    for (const auto& route : routes_) {
+        if (route.method != req.method) continue;
+        if (std::regex_match(req.path, req.matches, route.regex)) return &route;
+    }
+    return nullptr;
+}
+
+namespace {
+// Calls the admission's release when the handler returns, or unwinds.
+struct ReleaseGuard {
+    HttpRouter::Release release;
+    const httplib::Response& res;
+    ~ReleaseGuard() {
+        if (release) release(res);
+    }
+};
+}
+
+void HttpRouter::mountOn(httplib::Server& server) const {
+    for (const auto& route : routes_) {
+        if (route.bodyHandler) {
+            const BodyHandler body = route.bodyHandler;
+            server.Post(route.pattern, [this, body](const httplib::Request& req, httplib::Response& res,
+                                                    const httplib::ContentReader& reader) {
+                {
+                    ReleaseGuard guard{nullptr, res};
+                    if (admit(req, res, &guard.release)) body(req, res, reader);
+                }
+                filterResponse(req, res);
+            });
+            continue;
+        }
+
+        httplib::Server::Handler handler;
+        if (route.handler) {
+            const Handler sync = route.handler;
+            handler = [this, sync](const httplib::Request& req, httplib::Response& res) {
+                {
+                    ReleaseGuard guard{nullptr, res};
+                    if (admit(req, res, &guard.release)) sync(req, res);
+                }
+                filterResponse(req, res);
+            };
+        } else {
+            const AsyncHandler async = route.asyncHandler;
+            handler = [this, async](const httplib::Request& req, httplib::Response& res) {
+                {
+                    ReleaseGuard guard{nullptr, res};
+                    if (admit(req, res, &guard.release)) {
+                        auto finished = std::make_shared<std::promise<void>>();
+                        auto future = finished->get_future();
+                        async(req, res, [finished]() { finished->set_value(); });
+                        future.wait();
+                    }
+                }
+                filterResponse(req, res);
+            };
+        }
+        if (route.method == "GET") server.Get(route.pattern, std::move(handler));
+        else if (route.method == "POST") server.Post(route.pattern, std::move(handler));
+        else if (route.method == "DELETE") server.Delete(route.pattern, std::move(handler));
+    }
+}
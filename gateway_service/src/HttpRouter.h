@@ -0,0 +1,96 @@
+#pragma once
+
+#include "httplib.h"
+
+#include <functional>
+#include <regex>
+#include <string>
+#include <utility>
+#include <vector>
+
+// Route table shared by the two HTTP engines: httplib::Server (thread per connection) and
+// EpollHttpServer (event loop + worker pool). Patterns are regexes matched against the whole
+// path, as with httplib; captures land in req.matches.
+class HttpRouter {
+public:
+    using Handler = std::function<void(const httplib::Request&, httplib::Response&)>;
+    // Completes the response later, typically from a gRPC callback: `done` must be called exactly
+    // once, after which `res` is sent. req/res stay valid until then.
+    using Done = std::function<void()>;
+    using AsyncHandler = std::function<void(const httplib::Request&, httplib::Response&, Done done)>;
+    // Streamed request body (uploads): req.body stays empty and the handler pulls the body through
+    // the reader, piece by piece, with bounded buffering in the engine. Runs off the request
+    // workers (EpollHttpServer transfer pool).
+    using BodyHandler =
+        std::function<void(const httplib::Request&, httplib::Response&, const httplib::ContentReader& body)>;
+    // Runs on every routed response just before it is sent (e.g. compression).
+    using ResponseFilter = std::function<void(const httplib::Request&, httplib::Response&)>;
+    // Admission control, run before the handler (rate limits, load shedding). Returning false
+    // rejects the request with `res` as filled by the admission; otherwise a `release` it sets is
+    // called exactly once when the response is complete.
+    using Release = std::function<void(const httplib::Response&)>;
+    using Admission = std::function<bool(const httplib::Request&, httplib::Response&, Release* release)>;
+
+    struct Route {
+        std::string method;
+        std::string pattern;
+        std::regex regex;
+        Handler handler;
+        AsyncHandler asyncHandler;
+        BodyHandler bodyHandler;
+    };
+
+    HttpRouter& Get(const std::string& pattern, Handler handler);
+    HttpRouter& Post(const std::string& pattern, Handler handler);
+    HttpRouter& Delete(const std::string& pattern, Handler handler);
+    HttpRouter& GetAsync(const std::string& pattern, AsyncHandler handler);
+    HttpRouter& PostAsync(const std::string& pattern, AsyncHandler handler);
+    HttpRouter& PostStream(const std::string& pattern, BodyHandler handler);
+
+    void setResponseFilter(ResponseFilter filter) { filter_ = std::move(filter); }
+    void setAdmission(Admission admission) { admission_ = std::move(admission); }
+    bool admit(const httplib::Request& req, httplib::Response& res, Release* release) const {
+        return !admission_ || admission_(req, res, release);
+    }
+    void filterResponse(const httplib::Request& req, httplib::Response& res) const {
+        if (filter_) filter_(req, res);
+    }
+
+    // First route registered for req.method whose pattern matches req.path (fills req.matches).
+    const Route* match(httplib::Request& req) const;
+
+    // Registers every route on an httplib server; async routes block their worker until done.
+    void mountOn(httplib::Server& server) const;
+
+private:
+    HttpRouter& add(const std::string& method,
+                    const std::string& pattern,
+                    Handler handler,
+                    AsyncHandler asyncHandler,
+                    BodyHandler bodyHandler = nullptr);
+
+    std::vector<Route> routes_;
+    ResponseFilter filter_;
+    Admission admission_;
+};
+
+// Adds a token to the response's Vary header, keeping a single header without duplicates.
+inline void add_vary(httplib::Response& res, const std::string& token) {
+    const auto it = res.headers.find("Vary");
+    if (it == res.headers.end()) {
+        res.set_header("Vary", token);
+        return;
+    }
+    const std::string& value = it->second;
+    size_t pos = 0;
+    while (pos <= value.size()) {
+        size_t end = value.find(',', pos);
+        if (end == std::string::npos) end = value.size();
+        std::string item = value.substr(pos, end - pos);
+        item.erase(0, item.find_first_not_of(" \t"));
+        item.erase(item.find_last_not_of(" \t") + 1);
+        if (httplib::detail::case_ignore::equal(item, token)) return;
+        pos = end + 1;
+    }
+    it->second += ", " + token;
+}
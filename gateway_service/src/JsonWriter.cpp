@@ -0,0 +1,188 @@
+#include "JsonWriter.h"
+
+#include <cstddef>
+
+namespace {
+constexpr char kHex[] = "0123456789abcdef";
+
+void append_u_escape(std::string& out, std::uint32_t unit) {
+    out += "\\u";
+    out += kHex[(unit >> 12) & 0xf];
+    out += kHex[(unit >> 8) & 0xf];
+    out += kHex[(unit >> 4) & 0xf];
+    out += kHex[unit & 0xf];
+}
+
+// ASCII bytes protobuf escapes: C0 controls, '"', '\\', '<', '>' (HTML safety) and DEL.
+bool ascii_needs_escape(unsigned char c) {
+    return c < 0x20 || c == '"' || c == '\\' || c == '<' || c == '>' || c == 0x7f;
+}
+
+// Bytes that end a plain run: the ASCII ones above and every non-ASCII byte.
+struct RunTable {
+    bool stop[256] = {};
+    constexpr RunTable() {
+        for (int c = 0; c < 256; ++c) stop[c] = c >= 0x80 || c < 0x20 || c == '"' || c == '\\' || c == '<' || c == '>' || c == 0x7f;
+    }
+};
+constexpr RunTable kRunTable;
+
+// Code points of multi-byte sequences protobuf escapes: C1 controls and invisible formatting
+// characters, plus the ASCII ones when overlong-encoded.
+bool code_point_needs_escape(std::uint32_t cp) {
+    if (cp < 0x80) return ascii_needs_escape(static_cast<unsigned char>(cp));
+    return cp < 0xa0 || cp == 0xad || (cp >= 0x600 && cp <= 0x603) || cp == 0x6dd || cp == 0x70f ||
+           cp == 0x17b4 || cp == 0x17b5 || (cp >= 0x200b && cp <= 0x200f) || (cp >= 0x2028 && cp <= 0x202e) ||
+           (cp >= 0x2060 && cp <= 0x2064) || (cp >= 0x206a && cp <= 0x206f) || cp == 0xfeff ||
+           (cp >= 0xfff9 && cp <= 0xfffb) || cp == 0xe0001 || (cp >= 0xe0020 && cp <= 0xe007f);
+}
+
+void append_escaped_ascii(std::string& out, unsigned char c) {
+    switch (c) {
+    case '"': out += "\\\""; break;
+    case '\\': out += "\\\\"; break;
+    case '\b': out += "\\b"; break;
+    case '\t': out += "\\t"; break;
+    case '\n': out += "\\n"; break;
+    case '\f': out += "\\f"; break;
+    case '\r': out += "\\r"; break;
+    default: append_u_escape(out, c); break;
+    }
+}
+}
+
+void append_json_string(std::string& out, std::string_view value) {
+    out += '"';
+    const auto* s = reinterpret_cast<const unsigned char*>(value.data());
+    const size_t n = value.size();
+    size_t i = 0;
+    while (i < n) {
+        // Copy the longest run that needs no escaping in one go.
+        size_t run = i;
+        while (run < n && !kRunTable.stop[s[run]]) ++run;
+        if (run > i) {
+            out.append(value.data() + i, run - i);
+            i = run;
+            if (i == n) break;
+        }
+
+        const unsigned char lead = s[i];
+        if (lead < 0x80) {
+            append_escaped_ascii(out, lead);
+            ++i;
+            continue;
+        }
+
+        // Multi-byte sequence. Like protobuf, continuation bytes are only checked for their
+        // 10xxxxxx prefix (overlong forms pass) and an invalid or truncated sequence is dropped
+        // together with the byte that broke it.
+        size_t extra = 0;
+        std::uint32_t cp = 0;
+        if (lead >= 0xc0 && lead <= 0xdf) {
+            extra = 1;
+            cp = lead & 0x1f;
+        } else if (lead >= 0xe0 && lead <= 0xef) {
+            extra = 2;
+            cp = lead & 0x0f;
+        } else if (lead >= 0xf0 && lead <= 0xf7) {
+            extra = 3;
+            cp = lead & 0x07;
+        } else {
+            ++i; // stray continuation byte or 0xf8..0xff
+            continue;
+        }
+        const size_t start = i;
+        ++i;
+        bool valid = true;
+        for (size_t k = 0; k < extra; ++k) {
+            if (i >= n) {
+                valid = false;
+                break;
+            }
+            const unsigned char c = s[i++];
+            if (c < 0x80 || c > 0xbf) {
+                valid = false;
+                break;
+            }
+            cp = (cp << 6) | (c & 0x3f);
+        }
+        if (!valid || (cp >= 0xd800 && cp <= 0xdfff) || cp > 0x10ffff) continue;
+
+        if (!code_point_needs_escape(cp)) {
+            out.append(value.data() + start, i - start);
+        } else if (cp < 0x80) {
+            append_escaped_ascii(out, static_cast<unsigned char>(cp));
+        } else if (cp <= 0xffff) {
+            append_u_escape(out, cp);
+        } else {
+            const std::uint32_t v = cp - 0x10000;
+            append_u_escape(out, 0xd800 + (v >> 10));
+            append_u_escape(out, 0xdc00 + (v & 0x3ff));
+        }
+    }
+    out += '"';
+}
+
+void JsonWriter::key(const char* name) {
+    if (needComma_) out_ += ',';
+    out_ += '"';
+    out_ += name;
+    out_ += "\":";
+}
+
+void JsonWriter::beginObject() {
+    // Top level, field value or array element: any separator is already written.
+    out_ += '{';
+    needComma_ = false;
+}
+
+void JsonWriter::endObject() {
+    out_ += '}';
+    needComma_ = true;
+}
+
+void JsonWriter::field(const char* name, const std::string& value) {
+    if (value.empty()) return;
+    key(name);
+    append_json_string(out_, value);
+    needComma_ = true;
+}
+
+void JsonWriter::field(const char* name, std::int64_t value) {
+    if (value == 0) return;
+    key(name);
+    out_ += '"';
+    out_ += std::to_string(value);
+    out_ += '"';
+    needComma_ = true;
+}
+
+void JsonWriter::field(const char* name, std::int32_t value) {
+    if (value == 0) return;
+    key(name);
+    out_ += std::to_string(value);
+    needComma_ = true;
+}
+
+void JsonWriter::field(const char* name, bool value) {
+    if (!value) return;
+    key(name);
+    out_ += "true";
+    needComma_ = true;
+}
+
+void JsonWriter::beginArray(const char* name) {
+    key(name);
+    out_ += '[';
+    needComma_ = false;
+}
+
+void JsonWriter::endArray() {
+    out_ += ']';
+    needComma_ = true;
+}
+
+void JsonWriter::string(std::string_view value) {
+    append_json_string(out_, value);
+    needComma_ = true;
+}
@@ -0,0 +1,74 @@
+#pragma once
+
+#include <google/protobuf/repeated_ptr_field.h>
+
+#include <cstdint>
+#include <string>
+#include <string_view>
+
+// Reflection-free JSON writer producing exactly what MessageToJsonString prints with
+// add_whitespace = false (proto3 mapping): fields in declaration order under their lowerCamelCase
+// json names, default values omitted, int64 quoted, strings escaped the same way (including the
+// HTML-safe < / > and the dropping of invalid UTF-8).
+// Output is appended to a caller-owned buffer, so one buffer can be reserved once and reused
+// across chunks of a streamed response. Types are serialized by write_json overloads
+// (GatewayJson.h).
+class JsonWriter {
+public:
+    explicit JsonWriter(std::string& out) : out_(out) {}
+
+    void beginObject();
+    void endObject();
+
+    // Proto3 scalars: nothing is written for the default value.
+    void field(const char* name, const std::string& value);
+    void field(const char* name, std::int64_t value);
+    void field(const char* name, std::int32_t value);  // unquoted, unlike int64
+    void field(const char* name, bool value);
+
+    // Singular message field: the caller skips it when unset (has_<field>()).
+    template <typename T>
+    void object(const char* name, const T& value) {
+        key(name);
+        write_json(*this, value);
+    }
+
+    // Repeated message / string fields: omitted when empty.
+    template <typename T>
+    void field(const char* name, const google::protobuf::RepeatedPtrField<T>& values) {
+        if (values.empty()) return;
+        key(name);
+        out_ += '[';
+        bool first = true;
+        for (const auto& v : values) {
+            if (!first) out_ += ',';
+            first = false;
+            write_json(*this, v);
+        }
+        out_ += ']';
+        needComma_ = true;
+    }
+
+    // Manual form for values assembled from another source (streamed arrays).
+    void beginArray(const char* name);
+    void arraySeparator(bool first) {
+        if (!first) out_ += ',';
+    }
+    void endArray();
+
+    void string(std::string_view value);
+    std::string& buffer() { return out_; }
+
+private:
+    void key(const char* name);
+
+    std::string& out_;
+    bool needComma_ = false;
+};
+
+// Appends value as a JSON string literal, escaped like protobuf's JSON printer.
+void append_json_string(std::string& out, std::string_view value);
+
+inline void write_json(JsonWriter& w, const std::string& value) {
+    w.string(value);
+}
@@ -0,0 +1,225 @@
+#include "JwtVerifier.h"
+
+#include <google/protobuf/struct.pb.h>
+#include <google/protobuf/util/json_util.h>
+
+#include <openssl/bio.h>
+#include <openssl/bn.h>
+#include <openssl/crypto.h>
+#include <openssl/ecdsa.h>
+#include <openssl/evp.h>
+#include <openssl/hmac.h>
+#include <openssl/pem.h>
+
+#include <cstdlib>
+#include <ctime>
+#include <fstream>
+#include <iostream>
+#include <sstream>
+
+namespace {
+bool base64url_decode(const std::string& in, std::string* out) {
+    out->clear();
+    out->reserve(in.size() * 3 / 4);
+    unsigned int buf = 0;
+    int bits = 0;
+    for (const char c : in) {
+        int v;
+        if (c >= 'A' && c <= 'Z') v = c - 'A';
+        else if (c >= 'a' && c <= 'z') v = c - 'a' + 26;
+        else if (c >= '0' && c <= '9') v = c - '0' + 52;
+        else if (c == '-') v = 62;
+        else if (c == '_') v = 63;
+        else if (c == '=') break;
+        else return false;
+        buf = (buf << 6) | static_cast<unsigned int>(v);
+        bits += 6;
+        if (bits >= 8) {
+            bits -= 8;
+            out->push_back(static_cast<char>((buf >> bits) & 0xFF));
+        }
+    }
+    return true;
+}
+
+bool parse_json_object(const std::string& json, google::protobuf::Struct* out) {
+    google::protobuf::util::JsonParseOptions opts;
+    opts.ignore_unknown_fields = true;
+    return !json.empty() && google::protobuf::util::JsonStringToMessage(json, out, opts).ok();
+}
+
+const google::protobuf::Value* field(const google::protobuf::Struct& s, const char* name) {
+    const auto it = s.fields().find(name);
+    return it == s.fields().end() ? nullptr : &it->second;
+}
+
+std::string string_claim(const google::protobuf::Struct& s, const char* name) {
+    const auto* v = field(s, name);
+    if (!v) return {};
+    if (v->kind_case() == google::protobuf::Value::kStringValue) return v->string_value();
+    if (v->kind_case() == google::protobuf::Value::kNumberValue) {
+        return std::to_string(static_cast<long long>(v->number_value()));
+    }
+    return {};
+}
+
+bool number_claim(const google::protobuf::Struct& s, const char* name, long long* out) {
+    const auto* v = field(s, name);
+    if (!v || v->kind_case() != google::protobuf::Value::kNumberValue) return false;
+    *out = static_cast<long long>(v->number_value());
+    return true;
+}
+}
+
+struct JwtVerifier::PublicKey {
+    EVP_PKEY* pkey = nullptr;
+    ~PublicKey() { EVP_PKEY_free(pkey); }
+};
+
+JwtVerifier::JwtVerifier(std::string hmacSecret, const std::string& publicKeyPem)
+    : hmacSecret_(std::move(hmacSecret)) {
+    if (publicKeyPem.empty()) return;
+    BIO* bio = BIO_new_mem_buf(publicKeyPem.data(), static_cast<int>(publicKeyPem.size()));
+    if (!bio) return;
+    EVP_PKEY* pkey = PEM_read_bio_PUBKEY(bio, nullptr, nullptr, nullptr);
+    BIO_free(bio);
+    if (!pkey) {
+        std::cerr << "[gateway] JWT public key: invalid PEM, local EdDSA/ES256 verification disabled" << std::endl;
+        return;
+    }
+    publicKey_ = std::make_unique<PublicKey>();
+    publicKey_->pkey = pkey;
+}
+
+JwtVerifier::~JwtVerifier() = default;
+
+std::unique_ptr<JwtVerifier> JwtVerifier::fromEnv() {
+    const char* secret = std::getenv("JWT_SECRET");
+    std::string pem;
+    if (const char* path = std::getenv("GATEWAY_JWT_PUBLIC_KEY_FILE"); path && *path) {
+        std::ifstream in(path, std::ios::binary);
+        std::ostringstream ss;
+        ss << in.rdbuf();
+        pem = ss.str();
+        if (pem.empty()) std::cerr << "[gateway] cannot read GATEWAY_JWT_PUBLIC_KEY_FILE=" << path << std::endl;
+    }
+    return std::make_unique<JwtVerifier>(secret ? std::string(secret) : std::string(), pem);
+}
+
+bool JwtVerifier::enabled() const {
+    return !hmacSecret_.empty() || publicKey_ != nullptr;
+}
+
+bool JwtVerifier::verifySignature(const std::string& alg,
+                                  const std::string& signingInput,
+                                  const std::string& sig) const {
+    if (alg == "HS256") {
+        if (hmacSecret_.empty()) return false;
+        unsigned char mac[EVP_MAX_MD_SIZE];
+        unsigned int macLen = 0;
+        if (!HMAC(EVP_sha256(), hmacSecret_.data(), static_cast<int>(hmacSecret_.size()),
+                  reinterpret_cast<const unsigned char*>(signingInput.data()), signingInput.size(), mac, &macLen)) {
+            return false;
+        }
+        return macLen == sig.size() && CRYPTO_memcmp(mac, sig.data(), macLen) == 0;
+    }
+
+    if (!publicKey_) return false;
+    const int keyType = EVP_PKEY_base_id(publicKey_->pkey);
+
+    std::string derSig;
+    const EVP_MD* md = nullptr;
+    if (alg == "EdDSA") {
+        if (keyType != EVP_PKEY_ED25519) return false;
+    } else if (alg == "ES256") {
+        if (keyType != EVP_PKEY_EC || sig.size() != 64) return false;
+        // JWS carries raw r||s; OpenSSL wants DER.
+        ECDSA_SIG* es = ECDSA_SIG_new();
+        BIGNUM* r = BN_bin2bn(reinterpret_cast<const unsigned char*>(sig.data()), 32, nullptr);
+        BIGNUM* s = BN_bin2bn(reinterpret_cast<const unsigned char*>(sig.data()) + 32, 32, nullptr);
+        if (!es || !r || !s || !ECDSA_SIG_set0(es, r, s)) {
+            BN_free(r);
+            BN_free(s);
+            ECDSA_SIG_free(es);
+            return false;
+        }
+        unsigned char* der = nullptr;
+        const int derLen = i2d_ECDSA_SIG(es, &der);
+        ECDSA_SIG_free(es);
+        if (derLen <= 0) return false;
+        derSig.assign(reinterpret_cast<const char*>(der), static_cast<size_t>(derLen));
+        OPENSSL_free(der);
+        md = EVP_sha256();
+    } else {
+        return false;
+    }
+
+    const std::string& toCheck = derSig.empty() ? sig : derSig;
+    EVP_MD_CTX* ctx = EVP_MD_CTX_new();
+    if (!ctx) return false;
+    const bool ok = EVP_DigestVerifyInit(ctx, nullptr, md, nullptr, publicKey_->pkey) == 1 &&
+                    EVP_DigestVerify(ctx, reinterpret_cast<const unsigned char*>(toCheck.data()), toCheck.size(),
+                                     reinterpret_cast<const unsigned char*>(signingInput.data()),
+                                     signingInput.size()) == 1;
+    EVP_MD_CTX_free(ctx);
+    return ok;
+}
+
+JwtVerifier::Result JwtVerifier::verify(const std::string& token, Verified* out) const {
+    if (!out || !enabled()) return Result::Unverifiable;
+
+    const auto p1 = token.find('.');
+    const auto p2 = p1 == std::string::npos ? std::string::npos : token.find('.', p1 + 1);
+    if (p2 == std::string::npos || token.find('.', p2 + 1) != std::string::npos) return Result::Unverifiable;
+
+    std::string headerJson, payloadJson, sig;
+    if (!base64url_decode(token.substr(0, p1), &headerJson) ||
+        !base64url_decode(token.substr(p1 + 1, p2 - p1 - 1), &payloadJson) ||
+        !base64url_decode(token.substr(p2 + 1), &sig)) {
+        return Result::Unverifiable;
+    }
+
+    google::protobuf::Struct header;
+    if (!parse_json_object(headerJson, &header)) return Result::Unverifiable;
+    const std::string alg = string_claim(header, "alg");
+    const bool haveKey = (alg == "HS256" && !hmacSecret_.empty()) || ((alg == "EdDSA" || alg == "ES256") && publicKey_);
+    if (!haveKey) return Result::Unverifiable;
+
+    if (!verifySignature(alg, token.substr(0, p2), sig)) return Result::Invalid;
+
+    google::protobuf::Struct payload;
+    if (!parse_json_object(payloadJson, &payload)) return Result::Invalid;
+
+    const long long now = static_cast<long long>(std::time(nullptr));
+    long long exp = 0;
+    long long nbf = 0;
+    if (!number_claim(payload, "exp", &exp)) return Result::Unverifiable;
+    if (exp <= now) return Result::Invalid;
+    if (number_claim(payload, "nbf", &nbf) && nbf > now) return Result::Invalid;
+
+    for (const char* typeClaim : {"type", "token_type", "typ"}) {
+        if (string_claim(payload, typeClaim) == "refresh") return Result::Invalid;
+    }
+
+    std::string userId = string_claim(payload, "sub");
+    if (userId.empty()) userId = string_claim(payload, "user_id");
+    const std::string jti = string_claim(payload, "jti");
+    const std::string role = string_claim(payload, "role");
+    // Without subject/role we can't answer like ValidateToken; without a jti we can't check revocation.
+    if (userId.empty() || role.empty() || jti.empty()) return Result::Unverifiable;
+
+    out->claims.Clear();
+    out->claims.set_valid(true);
+    out->claims.set_user_id(userId);
+    out->claims.set_email(string_claim(payload, "email"));
+    out->claims.set_role(role);
+    if (const auto* perms = field(payload, "permissions");
+        perms && perms->kind_case() == google::protobuf::Value::kListValue) {
+        for (const auto& p : perms->list_value().values()) {
+            if (p.kind_case() == google::protobuf::Value::kStringValue) out->claims.add_permissions(p.string_value());
+        }
+    }
+    out->jti = jti;
+    out->expiresAtUnix = exp;
+    return Result::Ok;
+}
@@ -0,0 +1,46 @@
+#pragma once
+
+#include "auth.pb.h"
+
+#include <memory>
+#include <string>
+
+// Local verification of access tokens (signature, exp/nbf, token type) so the gateway does not
+// need an AuthService::ValidateToken round-trip per request. Revocation is checked by the caller
+// against RevocationSet using the returned jti.
+//
+// Keys: HS256 with the shared JWT_SECRET, and/or EdDSA (Ed25519) / ES256 with the PEM public key
+// in GATEWAY_JWT_PUBLIC_KEY_FILE. The token's alg must match a configured key ("none" never does).
+class JwtVerifier {
+public:
+    enum class Result {
+        Ok,
+        Invalid,     // bad signature, expired, not yet valid, refresh token...
+        Unverifiable // malformed for us / no key for its alg / missing claims: ask auth_service
+    };
+
+    struct Verified {
+        securecloud::auth::ValidateTokenResponse claims;
+        std::string jti;
+        long long expiresAtUnix = 0;
+    };
+
+    JwtVerifier(std::string hmacSecret, const std::string& publicKeyPem);
+    ~JwtVerifier();
+
+    JwtVerifier(const JwtVerifier&) = delete;
+    JwtVerifier& operator=(const JwtVerifier&) = delete;
+
+    static std::unique_ptr<JwtVerifier> fromEnv();
+
+    bool enabled() const;
+    Result verify(const std::string& token, Verified* out) const;
+
+private:
+    struct PublicKey;
+
+    bool verifySignature(const std::string& alg, const std::string& signingInput, const std::string& sig) const;
+
+    std::string hmacSecret_;
+    std::unique_ptr<PublicKey> publicKey_;
+};
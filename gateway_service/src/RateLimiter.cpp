@@ -0,0 +1,233 @@
+#include "RateLimiter.h"
+
+#include <algorithm>
+#include <cctype>
+#include <cmath>
+#include <cstdlib>
+#include <cstring>
+#include <functional>
+#include <mutex>
+
+namespace {
+long long env_ll(const char* key, long long fallback) {
+    const char* v = std::getenv(key);
+    if (!v || !*v) return fallback;
+    try {
+        return std::stoll(v);
+    } catch (...) {
+        return fallback;
+    }
+}
+
+// A bucket untouched for this long can go even if a very slow class has not refilled it yet.
+constexpr std::uint32_t kIdleMs = 60000;
+
+bool env_off(const char* key) {
+    const char* v = std::getenv(key);
+    return v && (std::strcmp(v, "0") == 0 || std::strcmp(v, "off") == 0);
+}
+
+constexpr std::uint64_t pack(std::uint32_t ms, std::uint32_t milliTokens) {
+    return (static_cast<std::uint64_t>(ms) << 32) | milliTokens;
+}
+
+// Milli-tokens after refilling up to `now`, and the timestamp to store with them. Sub-milli-token
+// refills keep the old timestamp so that slow rates (< 1 token/s) still accumulate.
+std::uint32_t refill(std::uint64_t state, std::uint32_t now, double milliPerMs, std::uint32_t burstMilli,
+                     std::uint32_t* stamp) {
+    const auto last = static_cast<std::uint32_t>(state >> 32);
+    const auto tokens = static_cast<std::uint32_t>(state & 0xffffffffu);
+    const std::uint32_t elapsed = now - last;  // modulo 2^32: ~49 days between two requests of a key
+    const double added = std::floor(static_cast<double>(elapsed) * milliPerMs);
+    if (added < 1.0) {
+        *stamp = last;
+        return std::min(tokens, burstMilli);
+    }
+    *stamp = now;
+    return static_cast<std::uint32_t>(std::min<double>(burstMilli, static_cast<double>(tokens) + added));
+}
+}
+
+TokenBucketLimiter::TokenBucketLimiter(size_t shards, size_t maxKeysPerShard)
+    : maxKeysPerShard_(std::max<size_t>(1, maxKeysPerShard)),
+      epoch_(std::chrono::steady_clock::now()),
+      shards_(std::max<size_t>(1, shards)) {}
+
+int TokenBucketLimiter::addClass(const std::string& name, Limit limit) {
+    auto c = std::make_unique<Class>();
+    c->name = name;
+    c->milliPerMs = std::max(0.001, limit.ratePerSecond);
+    c->burstMilli = static_cast<std::uint32_t>(std::clamp(limit.burst, 1.0, 4.0e6) * 1000.0);
+    classes_.push_back(std::move(c));
+    return static_cast<int>(classes_.size() - 1);
+}
+
+std::uint32_t TokenBucketLimiter::nowMs() const {
+    return static_cast<std::uint32_t>(
+        std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::steady_clock::now() - epoch_).count());
+}
+
+bool TokenBucketLimiter::insert(Shard& shard, const Class& c, const std::string& key) {
+    std::unique_lock<std::shared_mutex> lk(shard.m);
+    if (shard.buckets.count(key)) return true;
+    if (shard.buckets.size() >= maxKeysPerShard_) {
+        // Full: drop buckets that have refilled or sat idle, whose keys lose nothing by starting over.
+        // A bucket still being drained is never dropped (its key would come back with a full burst).
+        const std::uint32_t now = nowMs();
+        for (auto it = shard.buckets.begin(); it != shard.buckets.end();) {
+            const Class& owner = *classes_[static_cast<unsigned char>(it->first[0])];
+            const std::uint64_t state = it->second->load(std::memory_order_relaxed);
+            std::uint32_t stamp;
+            if (refill(state, now, owner.milliPerMs, owner.burstMilli, &stamp) >= owner.burstMilli ||
+                now - static_cast<std::uint32_t>(state >> 32) >= kIdleMs) {
+                it = shard.buckets.erase(it);
+            } else {
+                ++it;
+            }
+        }
+        if (shard.buckets.size() >= maxKeysPerShard_) return false;
+    }
+    shard.buckets.emplace(key, std::make_unique<Bucket>(pack(nowMs(), c.burstMilli)));
+    return true;
+}
+
+TokenBucketLimiter::Decision TokenBucketLimiter::acquire(int cls, const std::string& key) {
+    Class& c = *classes_.at(static_cast<size_t>(cls));
+    // First byte = class index (at most 256 classes), so classes never share a bucket.
+    std::string k;
+    k.reserve(key.size() + 1);
+    k.push_back(static_cast<char>(cls));
+    k += key;
+    Shard& shard = shards_[std::hash<std::string>{}(k) % shards_.size()];
+
+    for (;;) {
+        std::shared_lock<std::shared_mutex> lk(shard.m);
+        const auto it = shard.buckets.find(k);
+        if (it == shard.buckets.end()) {
+            lk.unlock();
+            if (!insert(shard, c, k)) {
+                // Every bucket of the shard is in use: new keys wait until one refills.
+                c.rejected.fetch_add(1, std::memory_order_relaxed);
+                Decision d;
+                d.allowed = false;
+                d.retryAfter = std::chrono::seconds(1);
+                return d;
+            }
+            continue;
+        }
+
+        Bucket& bucket = *it->second;
+        std::uint64_t state = bucket.load(std::memory_order_relaxed);
+        for (;;) {
+            const std::uint32_t now = nowMs();
+            std::uint32_t stamp;
+            const std::uint32_t tokens = refill(state, now, c.milliPerMs, c.burstMilli, &stamp);
+            if (tokens < 1000) {
+                // Not written back: a rejected request must not add contention on the bucket.
+                c.rejected.fetch_add(1, std::memory_order_relaxed);
+                const double waitMs = std::ceil(static_cast<double>(1000 - tokens) / c.milliPerMs);
+                Decision d;
+                d.allowed = false;
+                d.retryAfter = std::chrono::seconds(std::max(1LL, static_cast<long long>(std::ceil(waitMs / 1000.0))));
+                return d;
+            }
+            if (bucket.compare_exchange_weak(state, pack(stamp, tokens - 1000), std::memory_order_acq_rel,
+                                             std::memory_order_relaxed)) {
+                c.allowed.fetch_add(1, std::memory_order_relaxed);
+                return Decision{};
+            }
+        }
+    }
+}
+
+std::vector<TokenBucketLimiter::ClassStats> TokenBucketLimiter::stats() const {
+    std::vector<ClassStats> out;
+    out.reserve(classes_.size());
+    for (const auto& c : classes_) {
+        out.push_back(ClassStats{c->name, c->allowed.load(std::memory_order_relaxed),
+                                 c->rejected.load(std::memory_order_relaxed)});
+    }
+    return out;
+}
+
+AdaptiveConcurrencyLimit::AdaptiveConcurrencyLimit(std::string name, Options opts)
+    : name_(std::move(name)), opts_(opts), limit_(std::clamp(opts.initial, opts.min, opts.max)) {}
+
+bool AdaptiveConcurrencyLimit::tryAcquire() {
+    const int limit = static_cast<int>(limit_.load(std::memory_order_relaxed));
+    if (inflight_.fetch_add(1, std::memory_order_acq_rel) >= limit) {
+        inflight_.fetch_sub(1, std::memory_order_acq_rel);
+        rejected_.fetch_add(1, std::memory_order_relaxed);
+        return false;
+    }
+    admitted_.fetch_add(1, std::memory_order_relaxed);
+    return true;
+}
+
+void AdaptiveConcurrencyLimit::release(std::chrono::steady_clock::duration latency, bool overloaded) {
+    inflight_.fetch_sub(1, std::memory_order_acq_rel);
+
+    double limit = limit_.load(std::memory_order_relaxed);
+    if (!overloaded && latency <= opts_.target) {
+        // Additive increase; capped so that an idle upstream does not accumulate headroom forever.
+        while (limit < opts_.max &&
+               !limit_.compare_exchange_weak(limit, std::min<double>(opts_.max, limit + 1.0 / limit),
+                                             std::memory_order_relaxed)) {
+        }
+        return;
+    }
+
+    const std::int64_t now = std::chrono::duration_cast<std::chrono::nanoseconds>(
+                                 std::chrono::steady_clock::now().time_since_epoch())
+                                 .count();
+    std::int64_t last = lastDecreaseNs_.load(std::memory_order_relaxed);
+    const std::int64_t interval = std::chrono::duration_cast<std::chrono::nanoseconds>(opts_.target).count();
+    if (now - last < interval || !lastDecreaseNs_.compare_exchange_strong(last, now, std::memory_order_relaxed)) {
+        return;
+    }
+    while (!limit_.compare_exchange_weak(limit, std::max<double>(opts_.min, limit * opts_.backoff),
+                                         std::memory_order_relaxed)) {
+    }
+    decreases_.fetch_add(1, std::memory_order_relaxed);
+}
+
+AdaptiveConcurrencyLimit::Stats AdaptiveConcurrencyLimit::stats() const {
+    Stats s;
+    s.name = name_;
+    s.limit = static_cast<int>(limit_.load(std::memory_order_relaxed));
+    s.inflight = inflight_.load(std::memory_order_relaxed);
+    s.admitted = admitted_.load(std::memory_order_relaxed);
+    s.rejected = rejected_.load(std::memory_order_relaxed);
+    s.decreases = decreases_.load(std::memory_order_relaxed);
+    return s;
+}
+
+LoadSheddingOptions LoadSheddingOptions::fromEnv() {
+    LoadSheddingOptions o;
+    o.rateLimits = !env_off("GATEWAY_RATE_LIMIT");
+    o.adaptiveConcurrency = !env_off("GATEWAY_ADAPTIVE_CONCURRENCY");
+    o.upstream.target = std::chrono::milliseconds(
+        std::max(1LL, env_ll("GATEWAY_UPSTREAM_TARGET_MS", o.upstream.target.count())));
+    o.upstream.min = static_cast<int>(std::max(1LL, env_ll("GATEWAY_UPSTREAM_MIN_CONCURRENCY", o.upstream.min)));
+    o.upstream.max = static_cast<int>(
+        std::max<long long>(o.upstream.min, env_ll("GATEWAY_UPSTREAM_MAX_CONCURRENCY", o.upstream.max)));
+    o.upstream.initial = std::clamp(o.upstream.initial, o.upstream.min, o.upstream.max);
+    return o;
+}
+
+TokenBucketLimiter::Limit rate_limit_from_env(const std::string& name, TokenBucketLimiter::Limit fallback) {
+    std::string key = "GATEWAY_RATE_";
+    for (const char ch : name) key += static_cast<char>(std::toupper(static_cast<unsigned char>(ch)));
+    const char* v = std::getenv(key.c_str());
+    if (!v || !*v) return fallback;
+
+    char* end = nullptr;
+    const double rate = std::strtod(v, &end);
+    if (end == v || rate <= 0.0) return fallback;
+    TokenBucketLimiter::Limit limit{rate, std::max(1.0, rate)};
+    if (*end == '/') {
+        const double burst = std::strtod(end + 1, nullptr);
+        if (burst >= 1.0) limit.burst = burst;
+    }
+    return limit;
+}
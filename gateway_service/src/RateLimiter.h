@@ -0,0 +1,123 @@
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <memory>
+#include <shared_mutex>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+// Per-key token buckets, one family per route class (send, read, directory, ...).
+// Buckets live in sharded maps; a decision takes the shard's reader lock and updates the bucket
+// with a CAS on a single 64-bit word (timestamp + tokens), so concurrent requests never serialize
+// on an exclusive lock except when a new key is inserted.
+class TokenBucketLimiter {
+public:
+    struct Limit {
+        double ratePerSecond = 10.0;
+        double burst = 20.0;
+    };
+
+    struct Decision {
+        bool allowed = true;
+        std::chrono::seconds retryAfter{0};  // set when rejected
+    };
+
+    struct ClassStats {
+        std::string name;
+        std::uint64_t allowed = 0;
+        std::uint64_t rejected = 0;
+    };
+
+    explicit TokenBucketLimiter(size_t shards = 64, size_t maxKeysPerShard = 4096);
+
+    // Classes are registered before serving; the returned index is passed to acquire().
+    int addClass(const std::string& name, Limit limit);
+
+    // Takes one token from `key`'s bucket in class `cls`. A new key is rejected while its shard
+    // holds maxKeysPerShard buckets that are all in use.
+    Decision acquire(int cls, const std::string& key);
+
+    std::vector<ClassStats> stats() const;
+
+private:
+    struct Class {
+        std::string name;
+        double milliPerMs;  // tokens per second == milli-tokens per millisecond
+        std::uint32_t burstMilli;
+        std::atomic<std::uint64_t> allowed{0};
+        std::atomic<std::uint64_t> rejected{0};
+    };
+    // State word: high 32 bits = last refill (ms since epoch_, wraps), low 32 bits = milli-tokens.
+    using Bucket = std::atomic<std::uint64_t>;
+    struct Shard {
+        mutable std::shared_mutex m;
+        std::unordered_map<std::string, std::unique_ptr<Bucket>> buckets;
+    };
+
+    std::uint32_t nowMs() const;
+    // False when the shard is full of buckets still in use (none refilled or idle).
+    bool insert(Shard& shard, const Class& c, const std::string& key);
+
+    const size_t maxKeysPerShard_;
+    const std::chrono::steady_clock::time_point epoch_;
+    std::vector<std::unique_ptr<Class>> classes_;
+    std::vector<Shard> shards_;
+};
+
+// Adaptive concurrency limit in front of one upstream (AIMD): each request completing under the
+// latency target raises the limit by 1/limit (about +1 per limit's worth of requests); a slow or
+// failed one cuts it by `backoff`, at most once per target interval so that a burst of slow
+// completions counts as a single congestion signal.
+class AdaptiveConcurrencyLimit {
+public:
+    struct Options {
+        int initial = 64;
+        int min = 4;
+        int max = 512;
+        std::chrono::milliseconds target{250};
+        double backoff = 0.9;
+    };
+
+    struct Stats {
+        std::string name;
+        int limit = 0;
+        int inflight = 0;
+        std::uint64_t admitted = 0;
+        std::uint64_t rejected = 0;
+        std::uint64_t decreases = 0;
+    };
+
+    AdaptiveConcurrencyLimit(std::string name, Options opts);
+
+    bool tryAcquire();
+    // `overloaded`: the upstream failed (gateway answered 502/503/504).
+    void release(std::chrono::steady_clock::duration latency, bool overloaded);
+
+    Stats stats() const;
+
+private:
+    const std::string name_;
+    const Options opts_;
+    std::atomic<double> limit_;
+    std::atomic<int> inflight_{0};
+    std::atomic<std::int64_t> lastDecreaseNs_{0};
+    std::atomic<std::uint64_t> admitted_{0};
+    std::atomic<std::uint64_t> rejected_{0};
+    std::atomic<std::uint64_t> decreases_{0};
+};
+
+struct LoadSheddingOptions {
+    bool rateLimits = true;
+    bool adaptiveConcurrency = true;
+    AdaptiveConcurrencyLimit::Options upstream;
+
+    // GATEWAY_RATE_LIMIT (0/off disables the token buckets), GATEWAY_ADAPTIVE_CONCURRENCY (0/off),
+    // GATEWAY_UPSTREAM_TARGET_MS, GATEWAY_UPSTREAM_MIN_CONCURRENCY, GATEWAY_UPSTREAM_MAX_CONCURRENCY.
+    static LoadSheddingOptions fromEnv();
+};
+
+// Class limit from GATEWAY_RATE_<NAME> ("rate/burst", e.g. GATEWAY_RATE_SEND=10/30), else `fallback`.
+TokenBucketLimiter::Limit rate_limit_from_env(const std::string& name, TokenBucketLimiter::Limit fallback);
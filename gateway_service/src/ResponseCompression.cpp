@@ -0,0 +1,304 @@
+#include "ResponseCompression.h"
+
+#include "HttpRouter.h"
+
+#include <zlib.h>
+#ifdef GATEWAY_WITH_ZSTD
+#include <zstd.h>
+#endif
+
+#include <algorithm>
+#include <cctype>
+#include <cstdlib>
+#include <cstring>
+#include <functional>
+
+namespace {
+long long env_ll(const char* key, long long fallback) {
+    const char* v = std::getenv(key);
+    if (!v || !*v) return fallback;
+    try {
+        return std::stoll(v);
+    } catch (...) {
+        return fallback;
+    }
+}
+
+std::string trim_lower(const std::string& s, size_t b, size_t e) {
+    while (b < e && std::isspace(static_cast<unsigned char>(s[b]))) ++b;
+    while (e > b && std::isspace(static_cast<unsigned char>(s[e - 1]))) --e;
+    std::string out = s.substr(b, e - b);
+    std::transform(out.begin(), out.end(), out.begin(), [](unsigned char c) { return std::tolower(c); });
+    return out;
+}
+
+// Worth compressing: what the routes emit in bulk. text/event-stream is excluded (events must
+// reach the client as they are written).
+bool compressible(const std::string& contentType) {
+    const std::string type = trim_lower(contentType, 0, std::min(contentType.find(';'), contentType.size()));
+    return type == "application/json" || type == "application/x-protobuf" || type == "application/x-ndjson";
+}
+
+// Grows `out` as needed; `pos` is the end of the data written so far.
+void reserve_tail(std::string* out, size_t pos, size_t atLeast) {
+    if (out->size() - pos < atLeast) out->resize(pos + atLeast);
+}
+
+class GzipCompressor final : public StreamCompressor {
+public:
+    explicit GzipCompressor(int level) {
+        std::memset(&strm_, 0, sizeof(strm_));
+        // windowBits 15 + 16: gzip wrapper.
+        ok_ = deflateInit2(&strm_, level, Z_DEFLATED, 15 + 16, 8, Z_DEFAULT_STRATEGY) == Z_OK;
+    }
+    ~GzipCompressor() override {
+        if (ok_) deflateEnd(&strm_);
+    }
+
+    bool compress(const char* data, size_t len, bool last, std::string* out) override {
+        if (!ok_) return false;
+        strm_.next_in = reinterpret_cast<Bytef*>(const_cast<char*>(data));
+        strm_.avail_in = static_cast<uInt>(len);
+        size_t pos = out->size();
+        reserve_tail(out, pos, deflateBound(&strm_, static_cast<uLong>(len)) + 16);
+        for (;;) {
+            strm_.next_out = reinterpret_cast<Bytef*>(&(*out)[pos]);
+            strm_.avail_out = static_cast<uInt>(out->size() - pos);
+            const int rc = deflate(&strm_, last ? Z_FINISH : Z_SYNC_FLUSH);
+            if (rc == Z_STREAM_ERROR) return false;
+            pos = out->size() - strm_.avail_out;
+            const bool flushed = strm_.avail_out != 0 && strm_.avail_in == 0;
+            if (flushed && (!last || rc == Z_STREAM_END)) break;
+            reserve_tail(out, pos, 16 * 1024);
+        }
+        out->resize(pos);
+        return true;
+    }
+
+private:
+    z_stream strm_;
+    bool ok_ = false;
+};
+
+#ifdef GATEWAY_WITH_ZSTD
+class ZstdCompressor final : public StreamCompressor {
+public:
+    explicit ZstdCompressor(int level) : ctx_(ZSTD_createCCtx()) {
+        if (ctx_) ZSTD_CCtx_setParameter(ctx_, ZSTD_c_compressionLevel, level);
+    }
+    ~ZstdCompressor() override { ZSTD_freeCCtx(ctx_); }
+
+    bool compress(const char* data, size_t len, bool last, std::string* out) override {
+        if (!ctx_) return false;
+        ZSTD_inBuffer in{data, len, 0};
+        size_t pos = out->size();
+        reserve_tail(out, pos, ZSTD_compressBound(len) + 32);
+        for (;;) {
+            ZSTD_outBuffer o{&(*out)[pos], out->size() - pos, 0};
+            const size_t remaining = ZSTD_compressStream2(ctx_, &o, &in, last ? ZSTD_e_end : ZSTD_e_flush);
+            if (ZSTD_isError(remaining)) return false;
+            pos += o.pos;
+            if (remaining == 0) break;
+            reserve_tail(out, pos, std::max<size_t>(remaining, 16 * 1024));
+        }
+        out->resize(pos);
+        return true;
+    }
+
+private:
+    ZSTD_CCtx* ctx_;
+};
+#endif
+}
+
+ContentCoding negotiate_content_coding(const std::string& acceptEncoding) {
+    double gzipQ = -1.0;
+    double zstdQ = -1.0;
+    double anyQ = -1.0;
+    size_t pos = 0;
+    while (pos < acceptEncoding.size()) {
+        size_t end = acceptEncoding.find(',', pos);
+        if (end == std::string::npos) end = acceptEncoding.size();
+        const size_t semi = acceptEncoding.find(';', pos);
+        const std::string coding = trim_lower(acceptEncoding, pos, std::min(semi, end));
+        double q = 1.0;
+        for (size_t p = semi; p < end;) {
+            size_t next = acceptEncoding.find(';', p + 1);
+            if (next == std::string::npos || next > end) next = end;
+            const std::string param = trim_lower(acceptEncoding, p + 1, next);
+            if (param.rfind("q=", 0) == 0) q = std::strtod(param.c_str() + 2, nullptr);
+            p = next;
+        }
+        if (coding == "gzip" || coding == "x-gzip") gzipQ = std::max(gzipQ, q);
+        else if (coding == "zstd") zstdQ = std::max(zstdQ, q);
+        else if (coding == "*") anyQ = std::max(anyQ, q);
+        pos = end + 1;
+    }
+    // "*" covers the codings not listed explicitly.
+    if (gzipQ < 0) gzipQ = std::max(anyQ, 0.0);
+    if (zstdQ < 0) zstdQ = std::max(anyQ, 0.0);
+#ifndef GATEWAY_WITH_ZSTD
+    zstdQ = 0.0;
+#endif
+    if (zstdQ > 0.0 && zstdQ >= gzipQ) return ContentCoding::Zstd;
+    if (gzipQ > 0.0) return ContentCoding::Gzip;
+    return ContentCoding::Identity;
+}
+
+const char* coding_name(ContentCoding coding) {
+    switch (coding) {
+    case ContentCoding::Gzip: return "gzip";
+    case ContentCoding::Zstd: return "zstd";
+    default: return "identity";
+    }
+}
+
+std::unique_ptr<StreamCompressor> StreamCompressor::create(ContentCoding coding, int level) {
+    switch (coding) {
+    case ContentCoding::Gzip: return std::make_unique<GzipCompressor>(level);
+#ifdef GATEWAY_WITH_ZSTD
+    case ContentCoding::Zstd: return std::make_unique<ZstdCompressor>(level);
+#endif
+    default: return nullptr;
+    }
+}
+
+ResponseCompressor::ResponseCompressor(Options opts) : opts_(opts) {}
+
+ResponseCompressor::Options ResponseCompressor::optionsFromEnv() {
+    Options o;
+    if (const char* v = std::getenv("GATEWAY_COMPRESSION"); v && (std::strcmp(v, "0") == 0 || std::strcmp(v, "off") == 0)) {
+        o.enabled = false;
+    }
+    o.minBytes = static_cast<size_t>(std::max(0LL, env_ll("GATEWAY_COMPRESS_MIN_BYTES", static_cast<long long>(o.minBytes))));
+    o.gzipLevel = static_cast<int>(std::clamp(env_ll("GATEWAY_GZIP_LEVEL", o.gzipLevel), 1LL, 9LL));
+    o.zstdLevel = static_cast<int>(std::clamp(env_ll("GATEWAY_ZSTD_LEVEL", o.zstdLevel), 1LL, 19LL));
+    o.cacheBytes = static_cast<size_t>(std::max(0LL, env_ll("GATEWAY_COMPRESS_CACHE_MB", 32))) * 1024 * 1024;
+    return o;
+}
+
+int ResponseCompressor::levelFor(ContentCoding coding) const {
+    return coding == ContentCoding::Zstd ? opts_.zstdLevel : opts_.gzipLevel;
+}
+
+void ResponseCompressor::apply(const httplib::Request& req, httplib::Response& res) {
+    if (!opts_.enabled) return;
+    // A 304 carries the Vary of the 200 it stands for.
+    if (res.status == 304) add_vary(res, "Accept-Encoding");
+    if (res.status != 200 || res.has_header("Content-Encoding")) return;
+    if (!compressible(res.get_header_value("Content-Type"))) return;
+    add_vary(res, "Accept-Encoding");
+
+    const ContentCoding coding = negotiate_content_coding(req.get_header_value("Accept-Encoding"));
+    if (coding == ContentCoding::Identity) return;
+
+    if (res.content_provider_) {
+        // Fixed-length providers keep their Content-Length; chunked ones are compressed on the fly.
+        if (res.is_chunked_content_provider_) compressStream(res, coding);
+        return;
+    }
+    if (res.body.size() < opts_.minBytes) return;
+
+    // Same URL, same representation (ETag) and coding: the compressed bytes can be reused.
+    std::string key;
+    const std::string etag = res.get_header_value("ETag");
+    if (!etag.empty() && opts_.cacheBytes > 0) {
+        key = req.target + '\n' + res.get_header_value("Content-Type") + '\n' + etag + '\n' + coding_name(coding);
+    }
+
+    std::shared_ptr<const std::string> body = key.empty() ? nullptr : cached(key, res.body);
+    if (body) {
+        cacheHits_.fetch_add(1, std::memory_order_relaxed);
+    } else {
+        auto out = std::make_shared<std::string>();
+        const auto compressor = StreamCompressor::create(coding, levelFor(coding));
+        if (!compressor || !compressor->compress(res.body.data(), res.body.size(), /*last*/ true, out.get())) return;
+        // Incompressible (e.g. binary ciphertext): identity is cheaper for both ends.
+        if (out->size() >= res.body.size()) return;
+        body = std::move(out);
+        if (!key.empty()) store(key, res.body, body);
+    }
+
+    compressed_.fetch_add(1, std::memory_order_relaxed);
+    bytesIn_.fetch_add(res.body.size(), std::memory_order_relaxed);
+    bytesOut_.fetch_add(body->size(), std::memory_order_relaxed);
+    res.body.assign(*body);
+    res.set_header("Content-Encoding", coding_name(coding));
+}
+
+void ResponseCompressor::compressStream(httplib::Response& res, ContentCoding coding) {
+    std::shared_ptr<StreamCompressor> compressor = StreamCompressor::create(coding, levelFor(coding));
+    if (!compressor) return;
+
+    // The provider is driven by one thread at a time, always with the same sink. Its offset
+    // argument counts compressed bytes from here on; chunked providers do not use it.
+    auto inner = std::move(res.content_provider_);
+    auto buffer = std::make_shared<std::string>();
+    res.content_provider_ = [inner, compressor, buffer](size_t offset, size_t length, httplib::DataSink& sink) {
+        bool finished = false;
+        httplib::DataSink proxy;
+        proxy.write = [&](const char* data, size_t len) -> bool {
+            buffer->clear();
+            if (!compressor->compress(data, len, /*last*/ false, buffer.get())) return false;
+            return buffer->empty() || sink.write(buffer->data(), buffer->size());
+        };
+        proxy.is_writable = [&]() { return sink.is_writable(); };
+        proxy.done = [&]() { finished = true; };
+        proxy.done_with_trailer = [&](const httplib::Headers&) { finished = true; };
+
+        if (!inner(offset, length, proxy)) return false;
+        if (finished) {
+            buffer->clear();
+            if (!compressor->compress(nullptr, 0, /*last*/ true, buffer.get())) return false;
+            if (!buffer->empty() && !sink.write(buffer->data(), buffer->size())) return false;
+            sink.done();
+        }
+        return true;
+    };
+    res.set_header("Content-Encoding", coding_name(coding));
+    compressed_.fetch_add(1, std::memory_order_relaxed);
+}
+
+std::shared_ptr<const std::string> ResponseCompressor::cached(const std::string& key, std::string_view identity) {
+    const size_t hash = std::hash<std::string_view>{}(identity);
+    std::lock_guard<std::mutex> lk(m_);
+    const auto it = index_.find(key);
+    if (it == index_.end()) return nullptr;
+    if (it->second->identitySize != identity.size() || it->second->identityHash != hash) return nullptr;
+    lru_.splice(lru_.begin(), lru_, it->second);
+    return it->second->body;
+}
+
+void ResponseCompressor::store(const std::string& key,
+                               std::string_view identity,
+                               std::shared_ptr<const std::string> body) {
+    // One resource may not take over the cache.
+    if (body->size() > opts_.cacheBytes / 4) return;
+    const size_t hash = std::hash<std::string_view>{}(identity);
+    std::lock_guard<std::mutex> lk(m_);
+    if (const auto it = index_.find(key); it != index_.end()) {
+        cachedBytes_ -= it->second->body->size();
+        lru_.erase(it->second);
+        index_.erase(it);
+    }
+    cachedBytes_ += body->size();
+    lru_.push_front(CacheEntry{key, identity.size(), hash, std::move(body)});
+    index_.emplace(key, lru_.begin());
+    while (cachedBytes_ > opts_.cacheBytes && !lru_.empty()) {
+        const auto& victim = lru_.back();
+        cachedBytes_ -= victim.body->size();
+        index_.erase(victim.key);
+        lru_.pop_back();
+    }
+}
+
+ResponseCompressor::Stats ResponseCompressor::stats() const {
+    Stats s;
+    s.compressed = compressed_.load(std::memory_order_relaxed);
+    s.cacheHits = cacheHits_.load(std::memory_order_relaxed);
+    s.bytesIn = bytesIn_.load(std::memory_order_relaxed);
+    s.bytesOut = bytesOut_.load(std::memory_order_relaxed);
+    std::lock_guard<std::mutex> lk(m_);
+    s.cacheBytes = cachedBytes_;
+    return s;
+}
@@ -0,0 +1,93 @@
+#pragma once
+
+#include "httplib.h"
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <list>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+
+// Content codings the gateway can produce. zstd only when built with GATEWAY_WITH_ZSTD.
+enum class ContentCoding { Identity, Gzip, Zstd };
+
+// Best coding the client accepts (Accept-Encoding q-values; zstd wins ties with gzip).
+ContentCoding negotiate_content_coding(const std::string& acceptEncoding);
+
+const char* coding_name(ContentCoding coding);
+
+// Incremental compressor for chunked bodies: every compress() call emits what the client needs
+// to decode the data so far (sync flush), the last one closes the stream.
+class StreamCompressor {
+public:
+    virtual ~StreamCompressor() = default;
+    virtual bool compress(const char* data, size_t len, bool last, std::string* out) = 0;
+
+    // nullptr for Identity, or when the coding is not compiled in.
+    static std::unique_ptr<StreamCompressor> create(ContentCoding coding, int level);
+};
+
+// Response compression applied to every route (HttpRouter response filter, both engines).
+//  - JSON, protobuf and NDJSON bodies of 200 responses, above minBytes; SSE is left alone.
+//  - Fixed bodies are compressed in one go; chunked bodies (large history pages, room export)
+//    are compressed chunk by chunk.
+//  - Bodies carrying an ETag are cached compressed, keyed by URL + ETag + coding: revalidation
+//    misses (new client, evicted validator) for an unchanged resource do not recompress. An entry
+//    is only served for the same uncompressed bytes (size + hash checked).
+class ResponseCompressor {
+public:
+    struct Options {
+        bool enabled = true;
+        size_t minBytes = 1024;
+        int gzipLevel = 6;
+        int zstdLevel = 3;
+        size_t cacheBytes = 32 * 1024 * 1024;
+    };
+
+    struct Stats {
+        std::uint64_t compressed = 0;     // responses sent with a content coding
+        std::uint64_t cacheHits = 0;      // of which served from the compressed cache
+        std::uint64_t bytesIn = 0;        // fixed bodies only
+        std::uint64_t bytesOut = 0;
+        std::uint64_t cacheBytes = 0;
+    };
+
+    explicit ResponseCompressor(Options opts);
+
+    void apply(const httplib::Request& req, httplib::Response& res);
+
+    Stats stats() const;
+
+    // Reads GATEWAY_COMPRESSION (0/off disables), GATEWAY_COMPRESS_MIN_BYTES,
+    // GATEWAY_GZIP_LEVEL, GATEWAY_ZSTD_LEVEL and GATEWAY_COMPRESS_CACHE_MB.
+    static Options optionsFromEnv();
+
+private:
+    struct CacheEntry {
+        std::string key;
+        size_t identitySize = 0;
+        size_t identityHash = 0;
+        std::shared_ptr<const std::string> body;
+    };
+
+    int levelFor(ContentCoding coding) const;
+    std::shared_ptr<const std::string> cached(const std::string& key, std::string_view identity);
+    void store(const std::string& key, std::string_view identity, std::shared_ptr<const std::string> body);
+    void compressStream(httplib::Response& res, ContentCoding coding);
+
+    const Options opts_;
+
+    mutable std::mutex m_;
+    std::list<CacheEntry> lru_;  // front = most recently used
+    std::unordered_map<std::string, std::list<CacheEntry>::iterator> index_;
+    size_t cachedBytes_ = 0;
+
+    std::atomic<std::uint64_t> compressed_{0};
+    std::atomic<std::uint64_t> cacheHits_{0};
+    std::atomic<std::uint64_t> bytesIn_{0};
+    std::atomic<std::uint64_t> bytesOut_{0};
+};
@@ -0,0 +1,91 @@
+#include "RevocationSet.h"
+
+#include <mutex>
+
+namespace {
+// Two independent 64-bit hashes (FNV-1a with different offsets), combined by double hashing.
+std::uint64_t fnv1a(const std::string& s, std::uint64_t seed) {
+    std::uint64_t h = seed;
+    for (const unsigned char c : s) {
+        h ^= c;
+        h *= 1099511628211ULL;
+    }
+    return h;
+}
+
+std::int64_t steady_ms() {
+    return std::chrono::duration_cast<std::chrono::milliseconds>(
+               std::chrono::steady_clock::now().time_since_epoch())
+        .count();
+}
+}
+
+RevocationSet::RevocationSet(std::chrono::seconds outageGrace)
+    : outageGrace_(outageGrace), bloom_(new std::atomic<std::uint64_t>[kBloomBits / 64]) {
+    for (size_t i = 0; i < kBloomBits / 64; ++i) bloom_[i].store(0, std::memory_order_relaxed);
+}
+
+void RevocationSet::bloomSet(const std::string& jti) {
+    const std::uint64_t h1 = fnv1a(jti, 14695981039346656037ULL);
+    const std::uint64_t h2 = fnv1a(jti, 0x9e3779b97f4a7c15ULL) | 1;
+    for (int i = 0; i < kBloomHashes; ++i) {
+        const std::uint64_t bit = (h1 + static_cast<std::uint64_t>(i) * h2) % kBloomBits;
+        bloom_[bit / 64].fetch_or(std::uint64_t(1) << (bit % 64), std::memory_order_release);
+    }
+}
+
+bool RevocationSet::bloomTest(const std::string& jti) const {
+    const std::uint64_t h1 = fnv1a(jti, 14695981039346656037ULL);
+    const std::uint64_t h2 = fnv1a(jti, 0x9e3779b97f4a7c15ULL) | 1;
+    for (int i = 0; i < kBloomHashes; ++i) {
+        const std::uint64_t bit = (h1 + static_cast<std::uint64_t>(i) * h2) % kBloomBits;
+        if (!(bloom_[bit / 64].load(std::memory_order_acquire) & (std::uint64_t(1) << (bit % 64)))) return false;
+    }
+    return true;
+}
+
+bool RevocationSet::contains(const std::string& jti) const {
+    if (!bloomTest(jti)) return false;
+    std::shared_lock<std::shared_mutex> lk(m_);
+    return exact_.count(jti) > 0;
+}
+
+void RevocationSet::add(const std::string& jti) {
+    if (jti.empty()) return;
+    // Exact set first: a concurrent contains() that sees the Bloom bits also finds the entry.
+    {
+        std::unique_lock<std::shared_mutex> lk(m_);
+        exact_.insert(jti);
+    }
+    bloomSet(jti);
+}
+
+void RevocationSet::reset() {
+    synced_.store(false, std::memory_order_release);
+    std::unique_lock<std::shared_mutex> lk(m_);
+    exact_.clear();
+    for (size_t i = 0; i < kBloomBits / 64; ++i) bloom_[i].store(0, std::memory_order_relaxed);
+}
+
+void RevocationSet::markSynced() {
+    connected_.store(true, std::memory_order_release);
+    synced_.store(true, std::memory_order_release);
+}
+
+void RevocationSet::markDisconnected() {
+    if (connected_.exchange(false, std::memory_order_acq_rel)) {
+        disconnectedAtMs_.store(steady_ms(), std::memory_order_release);
+    }
+}
+
+bool RevocationSet::usable() const {
+    if (!synced_.load(std::memory_order_acquire)) return false;
+    if (connected_.load(std::memory_order_acquire)) return true;
+    const auto downForMs = steady_ms() - disconnectedAtMs_.load(std::memory_order_acquire);
+    return downForMs < std::chrono::duration_cast<std::chrono::milliseconds>(outageGrace_).count();
+}
+
+size_t RevocationSet::size() const {
+    std::shared_lock<std::shared_mutex> lk(m_);
+    return exact_.size();
+}
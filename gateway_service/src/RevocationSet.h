@@ -0,0 +1,48 @@
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <memory>
+#include <shared_mutex>
+#include <string>
+#include <unordered_set>
+#include <vector>
+
+// In-memory copy of auth_service's revoked jtis (tokens_revoked), fed by RevocationWatcher.
+// Lookups go through a Bloom filter first: the common case (token not revoked) is a handful of
+// relaxed atomic loads, and only a Bloom hit takes the shared lock on the exact set.
+class RevocationSet {
+public:
+    explicit RevocationSet(std::chrono::seconds outageGrace);
+
+    bool contains(const std::string& jti) const;
+
+    // Snapshot protocol of WatchRevocations: reset -> add()... -> markSynced().
+    void reset();
+    void add(const std::string& jti);
+    void markSynced();
+    void markDisconnected();
+
+    // True when the set reflects auth_service: synced and connected, or disconnected for less
+    // than outageGrace (brief auth_service restarts don't send every request back to gRPC).
+    bool usable() const;
+
+    size_t size() const;
+
+private:
+    static constexpr size_t kBloomBits = size_t(1) << 22; // 512 KiB, ~1% FP at 400k jtis
+    static constexpr int kBloomHashes = 7;
+
+    void bloomSet(const std::string& jti);
+    bool bloomTest(const std::string& jti) const;
+
+    const std::chrono::seconds outageGrace_;
+    std::unique_ptr<std::atomic<std::uint64_t>[]> bloom_;
+    mutable std::shared_mutex m_;
+    std::unordered_set<std::string> exact_;
+
+    std::atomic<bool> synced_{false};
+    std::atomic<bool> connected_{false};
+    std::atomic<std::int64_t> disconnectedAtMs_{0};
+};
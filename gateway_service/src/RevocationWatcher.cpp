@@ -0,0 +1,116 @@
+#include "RevocationWatcher.h"
+
+#include <algorithm>
+#include <chrono>
+#include <iostream>
+
+RevocationWatcher::RevocationWatcher(UpstreamPool<securecloud::auth::AuthService>& authStub,
+                                     TokenCache& cache,
+                                     RevocationSet& revoked)
+    : authStub_(authStub),
+      cache_(cache),
+      revoked_(revoked),
+      activeCtx_(authStub.targetCount(), nullptr),
+      synced_(authStub.targetCount(), false) {}
+
+RevocationWatcher::~RevocationWatcher() {
+    stop();
+}
+
+void RevocationWatcher::start() {
+    std::lock_guard<std::mutex> lk(m_);
+    if (!workers_.empty()) return;
+    stopping_ = false;
+    for (size_t t = 0; t < authStub_.targetCount(); ++t) {
+        workers_.emplace_back([this, t]() { loop(t); });
+    }
+}
+
+void RevocationWatcher::stop() {
+    {
+        std::lock_guard<std::mutex> lk(m_);
+        stopping_ = true;
+        for (auto* ctx : activeCtx_) {
+            if (ctx) ctx->TryCancel();
+        }
+    }
+    cv_.notify_all();
+    for (auto& w : workers_) {
+        if (w.joinable()) w.join();
+    }
+    workers_.clear();
+}
+
+void RevocationWatcher::unsyncedLocked(size_t target) {
+    if (synced_[target]) {
+        synced_[target] = false;
+        --syncedCount_;
+    }
+    cache_.setLive(false);
+}
+
+void RevocationWatcher::loop(size_t target) {
+    const std::string& name = authStub_.options().targets[target];
+    auto backoff = std::chrono::milliseconds(500);
+    for (;;) {
+        grpc::ClientContext ctx;
+        {
+            std::lock_guard<std::mutex> lk(m_);
+            if (stopping_) return;
+            activeCtx_[target] = &ctx;
+        }
+
+        securecloud::auth::WatchRevocationsRequest wreq;
+        wreq.set_client_id("gateway");
+        auto reader = authStub_.forTarget(target).WatchRevocations(&ctx, wreq);
+
+        // auth_service opens the stream with reset + snapshot of revoked jtis + synced: only from
+        // then on can no revocation of this replica be missed. The snapshot is read from the
+        // database, which every replica writes before broadcasting: clearing the shared set on
+        // one stream's reset loses nothing once that stream is synced again.
+        securecloud::auth::RevocationEvent ev;
+        bool gotEvent = false;
+        while (reader->Read(&ev)) {
+            gotEvent = true;
+            if (ev.reset()) {
+                std::lock_guard<std::mutex> lk(m_);
+                unsyncedLocked(target);
+                revoked_.reset();
+                continue;
+            }
+            if (ev.synced()) {
+                std::lock_guard<std::mutex> lk(m_);
+                if (!synced_[target]) {
+                    synced_[target] = true;
+                    ++syncedCount_;
+                }
+                if (syncedCount_ == synced_.size()) {
+                    revoked_.markSynced();
+                    cache_.setLive(true);
+                }
+                continue;
+            }
+            revoked_.add(ev.jti());
+            cache_.evictUser(ev.user_id());
+            cache_.evictJti(ev.jti());
+        }
+        {
+            std::lock_guard<std::mutex> lk(m_);
+            unsyncedLocked(target);
+            revoked_.markDisconnected();
+        }
+        const auto st = reader->Finish();
+
+        {
+            std::unique_lock<std::mutex> lk(m_);
+            activeCtx_[target] = nullptr;
+            if (stopping_) return;
+            std::cerr << "[gateway] revocation stream to " << name << " closed (" << st.error_message()
+                      << "), token cache disabled until reconnect" << std::endl;
+            // Note: local JWT verification keeps using the last revocation set for a grace period.
+            backoff = gotEvent ? std::chrono::milliseconds(500) : std::min(backoff * 2, std::chrono::milliseconds(30000));
+            cv_.wait_for(lk, backoff, [this]() { return stopping_; });
+            if (stopping_) return;
+        }
+    }
+}
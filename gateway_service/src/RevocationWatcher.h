@@ -0,0 +1,47 @@
+#pragma once
+
+#include "RevocationSet.h"
+#include "TokenCache.h"
+#include "UpstreamPool.h"
+#include "auth.grpc.pb.h"
+
+#include <grpcpp/grpcpp.h>
+
+#include <condition_variable>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+// Keeps one AuthService::WatchRevocations stream open per auth_service replica (each one only
+// broadcasts the revocations it performs) and applies their events to the TokenCache and the
+// RevocationSet. Both are only trusted while every stream's snapshot is synced; each stream
+// reconnects with backoff.
+class RevocationWatcher {
+public:
+    RevocationWatcher(UpstreamPool<securecloud::auth::AuthService>& authStub, TokenCache& cache, RevocationSet& revoked);
+    ~RevocationWatcher();
+
+    RevocationWatcher(const RevocationWatcher&) = delete;
+    RevocationWatcher& operator=(const RevocationWatcher&) = delete;
+
+    void start();
+    void stop();
+
+private:
+    void loop(size_t target);
+    // m_ held. Stream `target` lost its sync (reset or disconnection).
+    void unsyncedLocked(size_t target);
+
+    UpstreamPool<securecloud::auth::AuthService>& authStub_;
+    TokenCache& cache_;
+    RevocationSet& revoked_;
+    std::vector<std::thread> workers_;
+    std::mutex m_;
+    std::condition_variable cv_;
+    bool stopping_ = false;
+    // Per target.
+    std::vector<grpc::ClientContext*> activeCtx_;
+    std::vector<bool> synced_;
+    size_t syncedCount_ = 0;
+};
@@ -0,0 +1,109 @@
+#pragma once
+
+#include <grpcpp/grpcpp.h>
+
+#include <atomic>
+#include <cstdint>
+#include <functional>
+#include <future>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+// Request coalescing ("singleflight") for upstream gRPC calls.
+// The first caller for a key issues the call; callers arriving while it is in flight wait for
+// the same status and response instead of sending an identical RPC. Nothing is cached: the key is
+// released as soon as the call completes.
+// Keys must cover everything the answer depends on (RPC, normalized request, authorization
+// scope): a caller only ever receives the response to a request it could have sent itself.
+template <typename Response>
+class SingleFlight {
+public:
+    using Result = std::shared_ptr<const Response>;
+    using Done = std::function<void(const grpc::Status&, const Result&)>;
+    // Starts the upstream call; `complete` must be called exactly once, from any thread.
+    using Issue = std::function<void(Done complete)>;
+
+    struct Stats {
+        std::uint64_t requests = 0;   // run() calls
+        std::uint64_t upstream = 0;   // calls actually issued
+        std::uint64_t coalesced = 0;  // requests served by another caller's call
+    };
+
+    // `done` runs on the thread completing the upstream call (the leader's own thread for
+    // synchronous issues), after the key has been released.
+    void run(const std::string& key, const Issue& issue, Done done) {
+        std::shared_ptr<Flight> flight;
+        bool leader = false;
+        {
+            std::lock_guard<std::mutex> lk(m_);
+            auto& slot = flights_[key];
+            if (!slot) {
+                slot = std::make_shared<Flight>();
+                leader = true;
+            }
+            slot->waiters.push_back(std::move(done));
+            flight = slot;
+        }
+        requests_.fetch_add(1, std::memory_order_relaxed);
+        if (!leader) {
+            coalesced_.fetch_add(1, std::memory_order_relaxed);
+            return;
+        }
+        upstream_.fetch_add(1, std::memory_order_relaxed);
+
+        issue([this, key, flight](const grpc::Status& status, const Result& result) {
+            std::vector<Done> waiters;
+            {
+                std::lock_guard<std::mutex> lk(m_);
+                const auto it = flights_.find(key);
+                if (it != flights_.end() && it->second == flight) flights_.erase(it);
+                waiters.swap(flight->waiters);
+            }
+            for (const auto& waiter : waiters) waiter(status, result);
+        });
+    }
+
+    // Blocking form for synchronous handlers: `call` performs the RPC into a fresh response.
+    grpc::Status runSync(const std::string& key,
+                         const std::function<grpc::Status(Response*)>& call,
+                         Result* out) {
+        std::promise<std::pair<grpc::Status, Result>> answer;
+        auto future = answer.get_future();
+        run(
+            key,
+            [&call](Done complete) {
+                auto response = std::make_shared<Response>();
+                const grpc::Status status = call(response.get());
+                complete(status, response);
+            },
+            [&answer](const grpc::Status& status, const Result& result) {
+                answer.set_value({status, result});
+            });
+        auto [status, result] = future.get();
+        if (out) *out = std::move(result);
+        return status;
+    }
+
+    Stats stats() const {
+        Stats s;
+        s.requests = requests_.load(std::memory_order_relaxed);
+        s.upstream = upstream_.load(std::memory_order_relaxed);
+        s.coalesced = coalesced_.load(std::memory_order_relaxed);
+        return s;
+    }
+
+private:
+    struct Flight {
+        std::vector<Done> waiters;
+    };
+
+    std::mutex m_;
+    std::unordered_map<std::string, std::shared_ptr<Flight>> flights_;
+    std::atomic<std::uint64_t> requests_{0};
+    std::atomic<std::uint64_t> upstream_{0};
+    std::atomic<std::uint64_t> coalesced_{0};
+};
@@ -0,0 +1,209 @@
+#include "TokenCache.h"
+
+#include <google/protobuf/struct.pb.h>
+#include <google/protobuf/util/json_util.h>
+
+#include <algorithm>
+#include <cstdlib>
+#include <ctime>
+#include <functional>
+#include <iterator>
+
+namespace {
+std::string base64url_decode(const std::string& in) {
+    std::string out;
+    out.reserve(in.size() * 3 / 4);
+    unsigned int buf = 0;
+    int bits = 0;
+    for (const char c : in) {
+        int v;
+        if (c >= 'A' && c <= 'Z') v = c - 'A';
+        else if (c >= 'a' && c <= 'z') v = c - 'a' + 26;
+        else if (c >= '0' && c <= '9') v = c - '0' + 52;
+        else if (c == '-' || c == '+') v = 62;
+        else if (c == '_' || c == '/') v = 63;
+        else if (c == '=') break;
+        else return {};
+        buf = (buf << 6) | static_cast<unsigned int>(v);
+        bits += 6;
+        if (bits >= 8) {
+            bits -= 8;
+            out.push_back(static_cast<char>((buf >> bits) & 0xFF));
+        }
+    }
+    return out;
+}
+
+// exp / jti from the (already validated by auth_service) JWT payload.
+bool read_token_claims(const std::string& token, long long* expUnix, std::string* jti) {
+    const auto p1 = token.find('.');
+    if (p1 == std::string::npos) return false;
+    const auto p2 = token.find('.', p1 + 1);
+    if (p2 == std::string::npos) return false;
+
+    const std::string payload = base64url_decode(token.substr(p1 + 1, p2 - p1 - 1));
+    google::protobuf::Struct claims;
+    google::protobuf::util::JsonParseOptions opts;
+    opts.ignore_unknown_fields = true;
+    if (payload.empty() || !google::protobuf::util::JsonStringToMessage(payload, &claims, opts).ok()) {
+        return false;
+    }
+
+    const auto& f = claims.fields();
+    const auto exp = f.find("exp");
+    if (exp != f.end() && exp->second.kind_case() == google::protobuf::Value::kNumberValue) {
+        *expUnix = static_cast<long long>(exp->second.number_value());
+    }
+    const auto id = f.find("jti");
+    if (id != f.end() && id->second.kind_case() == google::protobuf::Value::kStringValue) {
+        *jti = id->second.string_value();
+    }
+    return true;
+}
+
+long long env_ll(const char* key, long long fallback) {
+    const char* v = std::getenv(key);
+    if (!v || !*v) return fallback;
+    try {
+        return std::stoll(v);
+    } catch (...) {
+        return fallback;
+    }
+}
+}
+
+TokenCache::TokenCache(Options opts) : opts_(opts), shards_(std::max<size_t>(1, opts.shards)) {}
+
+TokenCache::Options TokenCache::optionsFromEnv() {
+    Options o;
+    o.revalidateAfter = std::chrono::seconds(
+        std::max(0LL, env_ll("GATEWAY_TOKEN_CACHE_TTL_SECONDS", o.revalidateAfter.count())));
+    const long long maxEntries = env_ll("GATEWAY_TOKEN_CACHE_MAX_ENTRIES", 65536);
+    o.maxEntriesPerShard = static_cast<size_t>(std::max(1LL, maxEntries / static_cast<long long>(o.shards)));
+    return o;
+}
+
+TokenCache::Shard& TokenCache::shardFor(const std::string& token) {
+    return shards_[std::hash<std::string>{}(token) % shards_.size()];
+}
+
+std::optional<securecloud::auth::ValidateTokenResponse> TokenCache::get(const std::string& token) {
+    if (!live() || opts_.revalidateAfter.count() == 0) return std::nullopt;
+
+    auto& shard = shardFor(token);
+    std::lock_guard<std::mutex> lk(shard.m);
+    const auto it = shard.entries.find(token);
+    if (it == shard.entries.end()) {
+        misses_.fetch_add(1, std::memory_order_relaxed);
+        return std::nullopt;
+    }
+    if (std::chrono::steady_clock::now() >= it->second.expiresAt) {
+        eraseLocked(shard, it);
+        misses_.fetch_add(1, std::memory_order_relaxed);
+        return std::nullopt;
+    }
+    hits_.fetch_add(1, std::memory_order_relaxed);
+    return it->second.claims;
+}
+
+void TokenCache::put(const std::string& token,
+                     const securecloud::auth::ValidateTokenResponse& claims,
+                     std::uint64_t observedGeneration) {
+    if (!live() || opts_.revalidateAfter.count() == 0 || !claims.valid()) return;
+
+    long long expUnix = 0;
+    std::string jti;
+    if (!read_token_claims(token, &expUnix, &jti)) return;
+
+    const auto now = std::chrono::steady_clock::now();
+    auto expiresAt = now + opts_.revalidateAfter;
+    if (expUnix > 0) {
+        const long long left = expUnix - static_cast<long long>(std::time(nullptr));
+        if (left <= 0) return;
+        expiresAt = std::min(expiresAt, now + std::chrono::seconds(left));
+    }
+
+    auto& shard = shardFor(token);
+    std::lock_guard<std::mutex> lk(shard.m);
+    // Checked under the shard lock: evictions bump the generation before visiting the shards.
+    if (generation() != observedGeneration) return;
+    if (const auto existing = shard.entries.find(token); existing != shard.entries.end()) {
+        eraseLocked(shard, existing);
+    }
+    if (shard.entries.size() >= opts_.maxEntriesPerShard) {
+        // Full: drop what has expired, else an arbitrary entry (it will simply be revalidated).
+        for (auto it = shard.entries.begin(); it != shard.entries.end();) {
+            const auto next = std::next(it);
+            if (now >= it->second.expiresAt) eraseLocked(shard, it);
+            it = next;
+        }
+        if (shard.entries.size() >= opts_.maxEntriesPerShard) {
+            eraseLocked(shard, shard.entries.begin());
+            evictions_.fetch_add(1, std::memory_order_relaxed);
+        }
+    }
+    if (!claims.user_id().empty()) shard.byUser[claims.user_id()].insert(token);
+    if (!jti.empty()) shard.byJti[jti].insert(token);
+    shard.entries.emplace(token, Entry{claims, std::move(jti), expiresAt});
+}
+
+void TokenCache::eraseLocked(Shard& shard, std::unordered_map<std::string, Entry>::iterator it) {
+    const auto unindex = [&](std::unordered_map<std::string, Tokens>& index, const std::string& key) {
+        if (key.empty()) return;
+        const auto found = index.find(key);
+        if (found == index.end()) return;
+        found->second.erase(it->first);
+        if (found->second.empty()) index.erase(found);
+    };
+    unindex(shard.byUser, it->second.claims.user_id());
+    unindex(shard.byJti, it->second.jti);
+    shard.entries.erase(it);
+}
+
+void TokenCache::evictIndexed(std::unordered_map<std::string, Tokens> Shard::*index, const std::string& key) {
+    generation_.fetch_add(1, std::memory_order_acq_rel);
+    for (auto& shard : shards_) {
+        std::lock_guard<std::mutex> lk(shard.m);
+        const auto found = (shard.*index).find(key);
+        if (found == (shard.*index).end()) continue;
+        // eraseLocked() edits the index set: iterate over a copy.
+        const Tokens tokens = found->second;
+        for (const auto& token : tokens) {
+            const auto it = shard.entries.find(token);
+            if (it == shard.entries.end()) continue;
+            eraseLocked(shard, it);
+            evictions_.fetch_add(1, std::memory_order_relaxed);
+        }
+    }
+}
+
+void TokenCache::evictUser(const std::string& userId) {
+    if (userId.empty()) return;
+    evictIndexed(&Shard::byUser, userId);
+}
+
+void TokenCache::evictJti(const std::string& jti) {
+    if (jti.empty()) return;
+    evictIndexed(&Shard::byJti, jti);
+}
+
+void TokenCache::clear() {
+    generation_.fetch_add(1, std::memory_order_acq_rel);
+    for (auto& shard : shards_) {
+        std::lock_guard<std::mutex> lk(shard.m);
+        evictions_.fetch_add(shard.entries.size(), std::memory_order_relaxed);
+        shard.entries.clear();
+        shard.byUser.clear();
+        shard.byJti.clear();
+    }
+}
+
+void TokenCache::setLive(bool live) {
+    // Entries cached before a (re)connection may have missed revocations.
+    if (live != live_.exchange(live, std::memory_order_acq_rel)) clear();
+}
+
+TokenCache::Stats TokenCache::stats() const {
+    return Stats{hits_.load(std::memory_order_relaxed), misses_.load(std::memory_order_relaxed),
+                 evictions_.load(std::memory_order_relaxed)};
+}
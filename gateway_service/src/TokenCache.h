@@ -0,0 +1,85 @@
+#pragma once
+
+#include "auth.pb.h"
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <mutex>
+#include <optional>
+#include <string>
+#include <unordered_map>
+#include <unordered_set>
+#include <vector>
+
+// Sharded token -> claims cache in front of AuthService::ValidateToken.
+// An entry lives until the earliest of the token's exp and a short revalidation TTL, and is
+// evicted as soon as auth_service reports a revocation for its user or jti (RevocationWatcher).
+// While the revocation stream is down the cache is bypassed (setLive(false)), so a missed
+// revocation can never be served from it.
+class TokenCache {
+public:
+    struct Options {
+        size_t shards = 16;
+        std::chrono::seconds revalidateAfter{30};
+        size_t maxEntriesPerShard = 4096;
+    };
+
+    struct Stats {
+        std::uint64_t hits = 0;
+        std::uint64_t misses = 0;
+        std::uint64_t evictions = 0;
+    };
+
+    explicit TokenCache(Options opts);
+
+    std::optional<securecloud::auth::ValidateTokenResponse> get(const std::string& token);
+    // Bumped by every revocation. Read it before calling ValidateToken and pass it to put():
+    // a revocation that lands while the RPC is in flight then prevents caching its (stale) answer.
+    std::uint64_t generation() const { return generation_.load(std::memory_order_acquire); }
+    // Only valid tokens are cached; exp/jti are read from the JWT payload.
+    void put(const std::string& token,
+             const securecloud::auth::ValidateTokenResponse& claims,
+             std::uint64_t observedGeneration);
+
+    void evictUser(const std::string& userId);
+    void evictJti(const std::string& jti);
+    void clear();
+
+    void setLive(bool live);
+    bool live() const { return live_.load(std::memory_order_acquire); }
+
+    Stats stats() const;
+
+    // Reads GATEWAY_TOKEN_CACHE_TTL_SECONDS and GATEWAY_TOKEN_CACHE_MAX_ENTRIES.
+    static Options optionsFromEnv();
+
+private:
+    struct Entry {
+        securecloud::auth::ValidateTokenResponse claims;
+        std::string jti;
+        std::chrono::steady_clock::time_point expiresAt;
+    };
+    using Tokens = std::unordered_set<std::string>;
+    struct Shard {
+        std::mutex m;
+        std::unordered_map<std::string, Entry> entries;
+        // Secondary indexes over entries: a revocation only touches the tokens it names.
+        std::unordered_map<std::string, Tokens> byUser;
+        std::unordered_map<std::string, Tokens> byJti;
+    };
+
+    Shard& shardFor(const std::string& token);
+    // Shard lock held. Removes the entry and its index references.
+    static void eraseLocked(Shard& shard, std::unordered_map<std::string, Entry>::iterator it);
+    // Bumps the generation, then erases the tokens indexed under key in every shard.
+    void evictIndexed(std::unordered_map<std::string, Tokens> Shard::*index, const std::string& key);
+
+    const Options opts_;
+    std::vector<Shard> shards_;
+    std::atomic<bool> live_{false};
+    std::atomic<std::uint64_t> generation_{0};
+    std::atomic<std::uint64_t> hits_{0};
+    std::atomic<std::uint64_t> misses_{0};
+    std::atomic<std::uint64_t> evictions_{0};
+};
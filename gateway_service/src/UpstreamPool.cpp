@@ -0,0 +1,212 @@
+#include "UpstreamPool.h"
+
+#include "Metrics.h"
+#include "Tracing.h"
+
+#include <grpcpp/support/client_interceptor.h>
+
+#include <algorithm>
+#include <cstdlib>
+#include <cstring>
+#include <random>
+#include <unordered_map>
+
+namespace {
+long long env_ll(const char* key, long long fallback) {
+    const char* v = std::getenv(key);
+    if (!v || !*v) return fallback;
+    try {
+        return std::stoll(v);
+    } catch (...) {
+        return fallback;
+    }
+}
+
+std::string trim(const std::string& s) {
+    const auto b = s.find_first_not_of(" \t");
+    if (b == std::string::npos) return {};
+    return s.substr(b, s.find_last_not_of(" \t") - b + 1);
+}
+
+// gateway_upstream_call_duration_seconds{method} / gateway_upstream_call_errors_total{method}.
+// `method` ("/package.Service/Method") points into the generated stub's static table, so its
+// address keys a per-thread cache of the registry lookups.
+struct CallMetrics {
+    metrics::Histogram* duration = nullptr;
+    metrics::Counter* errors = nullptr;
+};
+
+CallMetrics call_metrics(const char* method) {
+    thread_local std::unordered_map<const char*, CallMetrics> cache;
+    auto& m = cache[method];
+    if (!m.duration) {
+        const metrics::Labels labels{{"method", method ? method : ""}};
+        m.duration = &metrics::registry().histogram("gateway_upstream_call_duration_seconds",
+                                                    "gRPC calls from the gateway, start to status", labels);
+        m.errors = &metrics::registry().counter("gateway_upstream_call_errors_total",
+                                                "gRPC calls from the gateway that ended with a non-OK status", labels);
+    }
+    return m;
+}
+
+// Counts the calls in flight on one channel: the interceptor lives as long as its call.
+// It is created on the thread starting the call, so a call made while an HTTP request's span is
+// current gets a client span and carries it to the service as `traceparent` metadata. Calls
+// started from a completion callback need the request's context made current again first
+// (tracing::ScopedContext), otherwise they start a trace of their own.
+class InflightInterceptor : public grpc::experimental::Interceptor {
+public:
+    InflightInterceptor(std::shared_ptr<std::atomic<int>> inflight, const char* method)
+        : inflight_(std::move(inflight)),
+          metrics_(call_metrics(method)),
+          start_(std::chrono::steady_clock::now()),
+          span_(method ? method : "", tracing::Kind::Client, tracing::current()) {
+        inflight_->fetch_add(1, std::memory_order_relaxed);
+    }
+    ~InflightInterceptor() override { inflight_->fetch_sub(1, std::memory_order_relaxed); }
+
+    void Intercept(grpc::experimental::InterceptorBatchMethods* methods) override {
+        using grpc::experimental::InterceptionHookPoints;
+        if (methods->QueryInterceptionHookPoint(InterceptionHookPoints::PRE_SEND_INITIAL_METADATA) &&
+            span_.context().valid()) {
+            methods->GetSendInitialMetadata()->emplace("traceparent", span_.context().traceparent());
+        }
+        if (methods->QueryInterceptionHookPoint(InterceptionHookPoints::POST_RECV_STATUS)) {
+            metrics_.duration->observe(std::chrono::steady_clock::now() - start_);
+            const auto* status = methods->GetRecvStatus();
+            if (status && !status->ok()) {
+                metrics_.errors->inc();
+                span_.setError(status->error_message());
+            }
+            if (status) span_.setAttribute("rpc.grpc.status_code", static_cast<long long>(status->error_code()));
+            span_.end();
+        }
+        methods->Proceed();
+    }
+
+private:
+    std::shared_ptr<std::atomic<int>> inflight_;
+    const CallMetrics metrics_;  // copied: the call may complete on another thread
+    const std::chrono::steady_clock::time_point start_;
+    tracing::Span span_;
+};
+
+class InflightInterceptorFactory : public grpc::experimental::ClientInterceptorFactoryInterface {
+public:
+    explicit InflightInterceptorFactory(std::shared_ptr<std::atomic<int>> inflight) : inflight_(std::move(inflight)) {}
+
+    grpc::experimental::Interceptor* CreateClientInterceptor(grpc::experimental::ClientRpcInfo* info) override {
+        return new InflightInterceptor(inflight_, info->method());
+    }
+
+private:
+    std::shared_ptr<std::atomic<int>> inflight_;
+};
+
+const char* state_name(grpc_connectivity_state state) {
+    switch (state) {
+    case GRPC_CHANNEL_IDLE: return "idle";
+    case GRPC_CHANNEL_CONNECTING: return "connecting";
+    case GRPC_CHANNEL_READY: return "ready";
+    case GRPC_CHANNEL_TRANSIENT_FAILURE: return "transient_failure";
+    case GRPC_CHANNEL_SHUTDOWN: return "shutdown";
+    }
+    return "unknown";
+}
+}
+
+UpstreamOptions UpstreamOptions::fromEnv(const std::string& prefix, const std::string& fallbackTarget) {
+    UpstreamOptions o;
+    const char* t = std::getenv((prefix + "_GRPC_TARGET").c_str());
+    const std::string value = (t && *t) ? std::string(t) : fallbackTarget;
+    if (value.rfind("ipv4:", 0) == 0 || value.rfind("ipv6:", 0) == 0) {
+        o.targets.push_back(value);
+    } else {
+        size_t pos = 0;
+        while (pos <= value.size()) {
+            size_t end = value.find(',', pos);
+            if (end == std::string::npos) end = value.size();
+            const std::string target = trim(value.substr(pos, end - pos));
+            if (!target.empty()) o.targets.push_back(target);
+            pos = end + 1;
+        }
+    }
+    if (o.targets.empty()) o.targets.push_back(fallbackTarget);
+
+    if (const char* p = std::getenv("GATEWAY_GRPC_LB_POLICY"); p && std::strcmp(p, "least_request") == 0) {
+        o.policy = Policy::LeastRequest;
+    }
+    o.channelsPerTarget = static_cast<int>(std::clamp(env_ll("GATEWAY_GRPC_CHANNELS_PER_TARGET", o.channelsPerTarget), 1LL, 64LL));
+    if (const char* h = std::getenv("GATEWAY_GRPC_HEALTH_CHECK"); h && (std::strcmp(h, "0") == 0 || std::strcmp(h, "off") == 0)) {
+        o.healthCheck = false;
+    }
+    o.deadline = std::chrono::milliseconds(
+        std::max(1LL, env_ll(("GATEWAY_" + prefix + "_DEADLINE_MS").c_str(), o.deadline.count())));
+    return o;
+}
+
+UpstreamChannels::UpstreamChannels(UpstreamOptions opts) : opts_(std::move(opts)) {
+    std::string serviceConfig = R"({"loadBalancingConfig":[{"round_robin":{}}])";
+    if (opts_.healthCheck) serviceConfig += R"(,"healthCheckConfig":{"serviceName":""})";
+    serviceConfig += "}";
+
+    for (const auto& target : opts_.targets) {
+        for (int i = 0; i < opts_.channelsPerTarget; ++i) {
+            grpc::ChannelArguments args;
+            args.SetServiceConfigJSON(serviceConfig);
+            // Own subchannels: channels with equal args would otherwise share one connection.
+            args.SetInt(GRPC_ARG_USE_LOCAL_SUBCHANNEL_POOL, 1);
+
+            auto inflight = std::make_shared<std::atomic<int>>(0);
+            std::vector<std::unique_ptr<grpc::experimental::ClientInterceptorFactoryInterface>> interceptors;
+            interceptors.push_back(std::make_unique<InflightInterceptorFactory>(inflight));
+            auto channel = grpc::experimental::CreateCustomChannelWithInterceptors(
+                target, grpc::InsecureChannelCredentials(), args, std::move(interceptors));
+            channels_.push_back(Entry{target, std::move(channel), std::move(inflight)});
+        }
+    }
+}
+
+bool UpstreamChannels::usable(const Entry& e) const {
+    return e.channel->GetState(/*try_to_connect*/ false) != GRPC_CHANNEL_TRANSIENT_FAILURE;
+}
+
+size_t UpstreamChannels::pickIndex() {
+    const size_t n = channels_.size();
+    if (n == 1) return 0;
+
+    if (opts_.policy == UpstreamOptions::Policy::LeastRequest) {
+        thread_local std::minstd_rand rng(std::random_device{}());
+        const size_t a = rng() % n;
+        size_t b = rng() % (n - 1);
+        if (b >= a) ++b;
+        const bool okA = usable(channels_[a]);
+        const bool okB = usable(channels_[b]);
+        if (okA != okB) return okA ? a : b;
+        if (okA) {
+            return channels_[b].inflight->load(std::memory_order_relaxed) <
+                           channels_[a].inflight->load(std::memory_order_relaxed)
+                       ? b
+                       : a;
+        }
+        // Both failing: fall through to a scan for any usable channel.
+    }
+
+    const size_t start = static_cast<size_t>(next_.fetch_add(1, std::memory_order_relaxed) % n);
+    for (size_t i = 0; i < n; ++i) {
+        const size_t idx = (start + i) % n;
+        if (usable(channels_[idx])) return idx;
+    }
+    // Nothing usable: let gRPC fail (or wait for) the call on the round-robin choice.
+    return start;
+}
+
+std::vector<UpstreamChannels::ChannelStats> UpstreamChannels::stats() const {
+    std::vector<ChannelStats> out;
+    out.reserve(channels_.size());
+    for (const auto& e : channels_) {
+        out.push_back(ChannelStats{e.target, state_name(e.channel->GetState(false)),
+                                   e.inflight->load(std::memory_order_relaxed)});
+    }
+    return out;
+}
@@ -0,0 +1,98 @@
+#pragma once
+
+#include <grpcpp/grpcpp.h>
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <vector>
+
+// Channel settings for one backend service (auth_service, messaging_service).
+struct UpstreamOptions {
+    enum class Policy { RoundRobin, LeastRequest };
+
+    std::vector<std::string> targets;
+    Policy policy = Policy::RoundRobin;
+    int channelsPerTarget = 2;
+    bool healthCheck = true;
+    std::chrono::milliseconds deadline{5000};
+
+    // <PREFIX>_GRPC_TARGET: one target or replicas separated by commas ("auth-1:50051,auth-2:50051";
+    // an ipv4:/ipv6: address list is kept as a single target), else `fallbackTarget`.
+    // GATEWAY_GRPC_LB_POLICY (round_robin | least_request), GATEWAY_GRPC_CHANNELS_PER_TARGET,
+    // GATEWAY_GRPC_HEALTH_CHECK (0/off), GATEWAY_<PREFIX>_DEADLINE_MS.
+    static UpstreamOptions fromEnv(const std::string& prefix, const std::string& fallbackTarget);
+};
+
+// Channels to the replicas of one backend service.
+//  - Each target gets channelsPerTarget channels with their own connections (local subchannel
+//    pool): one saturated HTTP/2 connection does not delay every call.
+//  - Inside a channel, every address the target resolves to (dns:///host:port, ipv4: lists) is
+//    balanced round_robin; with health checking, addresses whose grpc.health.v1 service reports
+//    NOT_SERVING leave the rotation (a backend without the health service counts as serving).
+//  - Calls pick a channel round robin, or the least loaded of two random ones (least_request,
+//    calls in flight counted by a client interceptor). Channels in TRANSIENT_FAILURE are skipped
+//    while another one is usable.
+class UpstreamChannels {
+public:
+    struct ChannelStats {
+        std::string target;
+        std::string state;
+        int inflight = 0;
+    };
+
+    explicit UpstreamChannels(UpstreamOptions opts);
+
+    size_t size() const { return channels_.size(); }
+    size_t targetCount() const { return opts_.targets.size(); }
+    const std::shared_ptr<grpc::Channel>& channel(size_t i) const { return channels_[i].channel; }
+    const UpstreamOptions& options() const { return opts_; }
+
+    // Per-call deadline (unary calls and bounded streams).
+    void setDeadline(grpc::ClientContext& ctx) const {
+        ctx.set_deadline(std::chrono::system_clock::now() + opts_.deadline);
+    }
+
+    std::vector<ChannelStats> stats() const;
+
+protected:
+    size_t pickIndex();
+
+private:
+    struct Entry {
+        std::string target;
+        std::shared_ptr<grpc::Channel> channel;
+        std::shared_ptr<std::atomic<int>> inflight;
+    };
+
+    bool usable(const Entry& e) const;
+
+    const UpstreamOptions opts_;
+    std::vector<Entry> channels_;
+    std::atomic<std::uint64_t> next_{0};
+};
+
+// Stub per channel; `pool->Method(...)` issues the call on the picked channel.
+// Server streams that only carry what their own replica sees (WatchRevocations, ChatStream) go
+// through `forTarget(t)` instead, one per target: replicas must then be listed one by one in
+// <PREFIX>_GRPC_TARGET, a single DNS name resolving to several of them reaches only one.
+template <typename Service>
+class UpstreamPool : public UpstreamChannels {
+public:
+    using Stub = typename Service::Stub;
+
+    explicit UpstreamPool(UpstreamOptions opts) : UpstreamChannels(std::move(opts)) {
+        stubs_.reserve(size());
+        for (size_t i = 0; i < size(); ++i) stubs_.push_back(Service::NewStub(channel(i)));
+    }
+
+    Stub& pick() { return *stubs_[pickIndex()]; }
+    Stub* operator->() { return &pick(); }
+    // First channel of target `t` (channels are laid out target by target).
+    Stub& forTarget(size_t t) { return *stubs_[t * static_cast<size_t>(options().channelsPerTarget)]; }
+
+private:
+    std::vector<std::unique_ptr<Stub>> stubs_;
+};
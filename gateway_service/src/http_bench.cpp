@@ -0,0 +1,336 @@
+// wrk-style closed-loop HTTP/1.1 benchmark for the gateway (Linux).
+//
+//   gateway_http_bench [-c connections] [-t threads] [-d seconds] [-w warmup_seconds]
+//                      [-p pipeline_depth] [-H "Name: value"]... http://host:port/path
+//
+// Every connection keeps `pipeline_depth` requests in flight and sends the next one as soon as
+// a response completes. Latencies are recorded after the warm-up (which also absorbs the
+// connection ramp-up) and reported as percentiles. Compare the two gateway engines with e.g.
+//   GATEWAY_HTTP_ENGINE=httplib ./gateway_service   vs   GATEWAY_HTTP_ENGINE=epoll ./gateway_service
+//   ./gateway_http_bench -c 10000 -t 4 -d 30 http://127.0.0.1:8080/health
+#include <arpa/inet.h>
+#include <netdb.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <sys/epoll.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <atomic>
+#include <cctype>
+#include <cerrno>
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+#include <memory>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace {
+using Clock = std::chrono::steady_clock;
+
+struct Config {
+    std::string host = "127.0.0.1";
+    std::string port = "8080";
+    std::string path = "/health";
+    std::vector<std::string> headers;
+    int connections = 100;
+    int threads = 1;
+    int durationSeconds = 10;
+    int warmupSeconds = 1;
+    int pipeline = 1;
+};
+
+struct Stats {
+    std::vector<std::uint32_t> latenciesUs;
+    std::uint64_t requests = 0;
+    std::uint64_t non2xx = 0;
+    std::uint64_t connectErrors = 0;
+    std::uint64_t readErrors = 0;
+    std::uint64_t bytes = 0;
+};
+
+struct Conn {
+    int fd = -1;
+    bool connected = false;
+    std::string in;
+    size_t outOff = 0;
+    std::vector<Clock::time_point> inFlight;
+};
+
+bool parse_url(const std::string& url, Config* cfg) {
+    const std::string scheme = "http://";
+    if (url.rfind(scheme, 0) != 0) return false;
+    const std::string rest = url.substr(scheme.size());
+    const auto slash = rest.find('/');
+    const std::string authority = rest.substr(0, slash);
+    cfg->path = slash == std::string::npos ? "/" : rest.substr(slash);
+    const auto colon = authority.rfind(':');
+    if (colon == std::string::npos) {
+        cfg->host = authority;
+        cfg->port = "80";
+    } else {
+        cfg->host = authority.substr(0, colon);
+        cfg->port = authority.substr(colon + 1);
+    }
+    return !cfg->host.empty();
+}
+
+// Status code and total length of the first complete response in `in`; 0 if incomplete,
+// -1 if it cannot be framed (chunked or no Content-Length).
+long long frame_response(const std::string& in, int* status, bool* close) {
+    const auto headerEnd = in.find("\r\n\r\n");
+    if (headerEnd == std::string::npos) return 0;
+    if (in.size() < 12) return -1;
+    *status = std::atoi(in.c_str() + 9);
+
+    std::string head = in.substr(0, headerEnd);
+    std::transform(head.begin(), head.end(), head.begin(), [](unsigned char c) { return std::tolower(c); });
+    *close = head.find("\r\nconnection: close") != std::string::npos;
+    const auto cl = head.find("\r\ncontent-length:");
+    if (cl == std::string::npos) return -1;
+    const long long length = std::atoll(head.c_str() + cl + 17);
+    const long long total = static_cast<long long>(headerEnd) + 4 + length;
+    return static_cast<long long>(in.size()) >= total ? total : 0;
+}
+
+class Worker {
+public:
+    Worker(const Config& cfg, const addrinfo* addr, int connections, const std::string& request,
+           Clock::time_point recordFrom, Clock::time_point end)
+        : cfg_(cfg), addr_(addr), request_(request), recordFrom_(recordFrom), end_(end), conns_(static_cast<size_t>(connections)) {
+        stats_.latenciesUs.reserve(1 << 20);
+    }
+
+    void run() {
+        epfd_ = ::epoll_create1(EPOLL_CLOEXEC);
+        for (size_t i = 0; i < conns_.size(); ++i) open(i);
+
+        epoll_event events[512];
+        while (Clock::now() < end_) {
+            const int n = ::epoll_wait(epfd_, events, 512, 100);
+            for (int e = 0; e < n; ++e) {
+                const size_t i = static_cast<size_t>(events[e].data.u64);
+                Conn& c = conns_[i];
+                if (c.fd < 0) continue;
+                if (events[e].events & (EPOLLERR | EPOLLHUP)) {
+                    fail(i, !c.connected);
+                    continue;
+                }
+                if (!c.connected && (events[e].events & EPOLLOUT)) {
+                    c.connected = true;
+                    send(i);
+                    continue;
+                }
+                if (events[e].events & EPOLLIN) receive(i);
+                if (c.fd >= 0 && (events[e].events & EPOLLOUT)) send(i);
+            }
+        }
+        for (auto& c : conns_) {
+            if (c.fd >= 0) ::close(c.fd);
+        }
+        ::close(epfd_);
+    }
+
+    Stats& stats() { return stats_; }
+
+private:
+    void open(size_t i) {
+        Conn& c = conns_[i];
+        c = Conn{};
+        c.fd = ::socket(addr_->ai_family, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+        if (c.fd < 0) {
+            ++stats_.connectErrors;
+            return;
+        }
+        const int one = 1;
+        ::setsockopt(c.fd, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+        if (::connect(c.fd, addr_->ai_addr, addr_->ai_addrlen) < 0 && errno != EINPROGRESS) {
+            ::close(c.fd);
+            c.fd = -1;
+            ++stats_.connectErrors;
+            return;
+        }
+        epoll_event ev{};
+        ev.events = EPOLLIN | EPOLLOUT;
+        ev.data.u64 = i;
+        ::epoll_ctl(epfd_, EPOLL_CTL_ADD, c.fd, &ev);
+    }
+
+    void fail(size_t i, bool connecting) {
+        if (connecting) ++stats_.connectErrors;
+        else ++stats_.readErrors;
+        ::close(conns_[i].fd);
+        conns_[i].fd = -1;
+        if (Clock::now() < end_) open(i);
+    }
+
+    void send(size_t i) {
+        Conn& c = conns_[i];
+        while (c.inFlight.size() < static_cast<size_t>(cfg_.pipeline) || c.outOff > 0) {
+            if (c.outOff == 0) c.inFlight.push_back(Clock::now());
+            const ssize_t n = ::send(c.fd, request_.data() + c.outOff, request_.size() - c.outOff, MSG_NOSIGNAL);
+            if (n < 0) {
+                if (errno == EAGAIN || errno == EWOULDBLOCK) {
+                    if (c.outOff == 0) c.inFlight.pop_back();
+                    setOut(i, true);
+                    return;
+                }
+                fail(i, false);
+                return;
+            }
+            c.outOff += static_cast<size_t>(n);
+            if (c.outOff == request_.size()) c.outOff = 0;
+        }
+        setOut(i, false);
+    }
+
+    void setOut(size_t i, bool want) {
+        epoll_event ev{};
+        ev.events = EPOLLIN | (want ? EPOLLOUT : 0u);
+        ev.data.u64 = i;
+        ::epoll_ctl(epfd_, EPOLL_CTL_MOD, conns_[i].fd, &ev);
+    }
+
+    void receive(size_t i) {
+        Conn& c = conns_[i];
+        char buf[16 * 1024];
+        for (;;) {
+            const ssize_t n = ::recv(c.fd, buf, sizeof(buf), 0);
+            if (n > 0) {
+                c.in.append(buf, static_cast<size_t>(n));
+                stats_.bytes += static_cast<std::uint64_t>(n);
+                continue;
+            }
+            if (n < 0 && (errno == EAGAIN || errno == EWOULDBLOCK)) break;
+            fail(i, false);
+            return;
+        }
+
+        bool completed = false;
+        for (;;) {
+            int status = 0;
+            bool close = false;
+            const long long len = frame_response(c.in, &status, &close);
+            if (len == 0) break;
+            if (len < 0 || c.inFlight.empty()) {
+                fail(i, false);
+                return;
+            }
+            const auto now = Clock::now();
+            if (now >= recordFrom_) {
+                ++stats_.requests;
+                if (status < 200 || status >= 300) ++stats_.non2xx;
+                const auto us = std::chrono::duration_cast<std::chrono::microseconds>(now - c.inFlight.front()).count();
+                stats_.latenciesUs.push_back(static_cast<std::uint32_t>(std::min<long long>(us, UINT32_MAX)));
+            }
+            c.inFlight.erase(c.inFlight.begin());
+            c.in.erase(0, static_cast<size_t>(len));
+            completed = true;
+            if (close) {
+                ::close(c.fd);
+                c.fd = -1;
+                open(i);
+                return;
+            }
+        }
+        if (completed) send(i);
+    }
+
+    const Config& cfg_;
+    const addrinfo* addr_;
+    const std::string& request_;
+    const Clock::time_point recordFrom_;
+    const Clock::time_point end_;
+    std::vector<Conn> conns_;
+    Stats stats_;
+    int epfd_ = -1;
+};
+
+void usage() {
+    std::cerr << "usage: gateway_http_bench [-c connections] [-t threads] [-d seconds] [-w warmup_seconds]\n"
+                 "                          [-p pipeline_depth] [-H \"Name: value\"]... http://host:port/path\n";
+}
+}
+
+int main(int argc, char** argv) {
+    Config cfg;
+    std::string url;
+    for (int i = 1; i < argc; ++i) {
+        const std::string arg = argv[i];
+        auto next = [&]() -> const char* { return i + 1 < argc ? argv[++i] : ""; };
+        if (arg == "-c") cfg.connections = std::atoi(next());
+        else if (arg == "-t") cfg.threads = std::atoi(next());
+        else if (arg == "-d") cfg.durationSeconds = std::atoi(next());
+        else if (arg == "-w") cfg.warmupSeconds = std::atoi(next());
+        else if (arg == "-p") cfg.pipeline = std::atoi(next());
+        else if (arg == "-H") cfg.headers.emplace_back(next());
+        else url = arg;
+    }
+    if (url.empty() || !parse_url(url, &cfg) || cfg.connections <= 0 || cfg.threads <= 0 || cfg.pipeline <= 0) {
+        usage();
+        return 2;
+    }
+    cfg.threads = std::min(cfg.threads, cfg.connections);
+
+    addrinfo hints{};
+    hints.ai_family = AF_UNSPEC;
+    hints.ai_socktype = SOCK_STREAM;
+    addrinfo* addr = nullptr;
+    if (::getaddrinfo(cfg.host.c_str(), cfg.port.c_str(), &hints, &addr) != 0 || !addr) {
+        std::cerr << "cannot resolve " << cfg.host << ":" << cfg.port << "\n";
+        return 1;
+    }
+
+    std::string request = "GET " + cfg.path + " HTTP/1.1\r\nHost: " + cfg.host + ":" + cfg.port + "\r\n";
+    for (const auto& h : cfg.headers) request += h + "\r\n";
+    request += "\r\n";
+
+    const auto start = Clock::now();
+    const auto recordFrom = start + std::chrono::seconds(cfg.warmupSeconds);
+    const auto end = recordFrom + std::chrono::seconds(cfg.durationSeconds);
+
+    std::vector<std::unique_ptr<Worker>> workers;
+    std::vector<std::thread> threads;
+    for (int t = 0; t < cfg.threads; ++t) {
+        const int share = cfg.connections / cfg.threads + (t < cfg.connections % cfg.threads ? 1 : 0);
+        workers.push_back(std::make_unique<Worker>(cfg, addr, share, request, recordFrom, end));
+    }
+    for (auto& w : workers) threads.emplace_back([&w]() { w->run(); });
+    for (auto& t : threads) t.join();
+    ::freeaddrinfo(addr);
+
+    Stats total;
+    for (auto& w : workers) {
+        auto& s = w->stats();
+        total.requests += s.requests;
+        total.non2xx += s.non2xx;
+        total.connectErrors += s.connectErrors;
+        total.readErrors += s.readErrors;
+        total.bytes += s.bytes;
+        total.latenciesUs.insert(total.latenciesUs.end(), s.latenciesUs.begin(), s.latenciesUs.end());
+    }
+    std::sort(total.latenciesUs.begin(), total.latenciesUs.end());
+    auto pct = [&](double p) -> double {
+        if (total.latenciesUs.empty()) return 0.0;
+        const auto idx = static_cast<size_t>(p / 100.0 * static_cast<double>(total.latenciesUs.size() - 1));
+        return total.latenciesUs[idx] / 1000.0;
+    };
+
+    const double seconds = static_cast<double>(cfg.durationSeconds);
+    std::printf("%s: %d connections, %d threads, pipeline %d, %ds (+%ds warm-up)\n", url.c_str(), cfg.connections,
+                cfg.threads, cfg.pipeline, cfg.durationSeconds, cfg.warmupSeconds);
+    std::printf("  requests      %llu (%.0f req/s)\n", static_cast<unsigned long long>(total.requests),
+                static_cast<double>(total.requests) / seconds);
+    std::printf("  latency ms    p50 %.2f  p90 %.2f  p99 %.2f  p99.9 %.2f  max %.2f\n", pct(50), pct(90), pct(99),
+                pct(99.9), pct(100));
+    std::printf("  errors        connect %llu  read %llu  non-2xx %llu\n",
+                static_cast<unsigned long long>(total.connectErrors), static_cast<unsigned long long>(total.readErrors),
+                static_cast<unsigned long long>(total.non2xx));
+    return 0;
+}
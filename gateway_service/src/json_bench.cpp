@@ -0,0 +1,338 @@
+// JsonWriter (GatewayJson.h) vs MessageToJsonString for the gateway response types.
+//
+//   gateway_json_bench [-n messages_per_page] [-s content_bytes] [-i iterations] [-f fuzz_cases]
+//
+// First checks that every gateway.proto response type serializes byte-for-byte like
+// MessageToJsonString (compact), on random messages whose strings mix ASCII, escapes, multi-byte
+// UTF-8, characters protobuf escapes and invalid UTF-8. Then times a history page
+// (ListMessagesResponse) three ways: MessageToJsonString, to_json() into a fresh string, and
+// JsonWriter into one reused buffer (the streaming path), and compares it with the
+// application/x-protobuf representation (size, encode, decode). Exits non-zero on any mismatch.
+#include "BodyFormat.h"
+#include "GatewayJson.h"
+
+#include <google/protobuf/stubs/logging.h>
+#include <google/protobuf/util/json_util.h>
+
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <iostream>
+#include <random>
+#include <string>
+
+namespace {
+using Clock = std::chrono::steady_clock;
+namespace gw = securecloud::gateway;
+
+struct Config {
+    int messages = 200;
+    int contentBytes = 200;
+    int iterations = 2000;
+    int fuzzCases = 20000;
+};
+
+std::string reference_json(const google::protobuf::Message& m) {
+    google::protobuf::util::JsonPrintOptions opts;
+    opts.add_whitespace = false;
+    std::string out;
+    google::protobuf::util::MessageToJsonString(m, &out, opts);
+    return out;
+}
+
+std::string random_string(std::mt19937& rng, size_t maxLen) {
+    static const char* const pieces[] = {
+        "a", "Z", "0", " ", "\"", "\\", "/", "<", ">", "&", "\n", "\t", "\r", "\b", "\f",
+        "" /* NUL, see below */, "\x01", "\x1f", "\x7f",
+        "\xc3\xa9",         // é
+        "\xe2\x82\xac",     // €
+        "\xf0\x9f\x98\x80", // 😀
+        "\xc2\x80",         // C1 control
+        "\xc2\xad",         // soft hyphen
+        "\xe2\x80\xa8",     // line separator
+        "\xe2\x80\x8b",     // zero width space
+        "\xef\xbb\xbf",     // BOM
+        "\xf3\xa0\x80\x81", // language tag
+        "\xc0\xaf",         // overlong '/'
+        "\xc0\xbc",         // overlong '<'
+        "\xed\xa0\x80",     // surrogate
+        "\x80", "\xbf", "\xc3", "\xe2\x82", "\xf8", "\xff", "\xf4\x90\x80\x80",
+    };
+    constexpr size_t kPieces = sizeof(pieces) / sizeof(pieces[0]);
+    std::uniform_int_distribution<size_t> len(0, maxLen);
+    std::uniform_int_distribution<size_t> pick(0, kPieces - 1);
+    std::uniform_int_distribution<int> byte(0, 255);
+    std::string s;
+    const size_t n = len(rng);
+    for (size_t i = 0; i < n; ++i) {
+        const size_t p = pick(rng);
+        if (pieces[p][0] == '\0') s.push_back('\0');
+        else if (p == 0 && (rng() & 7) == 0) s.push_back(static_cast<char>(byte(rng)));
+        else s += pieces[p];
+    }
+    return s;
+}
+
+std::int64_t random_int(std::mt19937& rng) {
+    switch (rng() % 4) {
+    case 0: return 0;
+    case 1: return static_cast<std::int64_t>(rng() % 2000000000);
+    case 2: return -static_cast<std::int64_t>(rng());
+    default: return static_cast<std::int64_t>((static_cast<std::uint64_t>(rng()) << 32) | rng());
+    }
+}
+
+void fill(std::mt19937& rng, gw::HttpMessage* m) {
+    m->set_message_id(random_string(rng, 4));
+    m->set_conversation_id(random_string(rng, 4));
+    m->set_sender_id(random_string(rng, 3));
+    m->set_content(random_string(rng, 24));
+    m->set_timestamp_unix(random_int(rng));
+}
+
+template <typename TMessage>
+bool same(const TMessage& m, const char* type, int* failures) {
+    const auto expected = reference_json(m);
+    const auto actual = to_json(m);
+    if (expected == actual) return true;
+    if (++*failures <= 5) {
+        std::cerr << "mismatch for " << type << "\n  protobuf: " << expected << "\n  writer:   " << actual << "\n";
+    }
+    return false;
+}
+
+int check_all(int cases) {
+    std::mt19937 rng(12345);
+    int failures = 0;
+    for (int i = 0; i < cases; ++i) {
+        gw::LoginResponse login;
+        login.set_access_token(random_string(rng, 6));
+        login.set_refresh_token(random_string(rng, 6));
+        login.set_expires_in(random_int(rng));
+        same(login, "LoginResponse", &failures);
+
+        gw::ListConversationsResponse convs;
+        for (int k = static_cast<int>(rng() % 4); k > 0; --k) {
+            auto* c = convs.add_conversations();
+            c->set_conversation_id(random_string(rng, 4));
+            c->set_last_message(random_string(rng, 8));
+            c->set_last_timestamp_unix(random_int(rng));
+        }
+        same(convs, "ListConversationsResponse", &failures);
+
+        gw::ListMessagesResponse msgs;
+        for (int k = static_cast<int>(rng() % 4); k > 0; --k) fill(rng, msgs.add_messages());
+        same(msgs, "ListMessagesResponse", &failures);
+
+        // The streamed form (history, /sync), drained between messages like a chunked body.
+        std::string streamed, buffer, binary;
+        MessagesJsonStream stream(buffer);
+        MessagesPageStream binaryStream(binary, BodyFormat::Protobuf);
+        for (const auto& hm : msgs.messages()) {
+            securecloud::messaging::EncryptedMessage em;
+            em.set_message_id(hm.message_id());
+            em.set_conversation_id("ignored");
+            em.set_sender_id(hm.sender_id());
+            em.set_ciphertext(hm.content());
+            em.set_timestamp_unix(hm.timestamp_unix());
+            stream.add(em, hm.conversation_id());
+            binaryStream.add(em, hm.conversation_id());
+            streamed += buffer;
+            buffer.clear();
+        }
+        stream.finish();
+        streamed += buffer;
+        if (streamed != reference_json(msgs) && ++failures <= 5) {
+            std::cerr << "mismatch for MessagesJsonStream\n  protobuf: " << reference_json(msgs)
+                      << "\n  stream:   " << streamed << "\n";
+        }
+
+        binaryStream.finish();
+        if (binary != msgs.SerializeAsString() && ++failures <= 5) {
+            std::cerr << "mismatch for MessagesPageStream (protobuf)\n";
+        }
+
+        // A /sync page: the same messages followed by has_more / cursor.
+        gw::SyncHttpResponse sync;
+        *sync.mutable_messages() = msgs.messages();
+        sync.set_has_more(rng() & 1);
+        sync.set_cursor(random_string(rng, 6));
+        same(sync, "SyncHttpResponse", &failures);
+        for (const BodyFormat format : {BodyFormat::Json, BodyFormat::Protobuf}) {
+            std::string body;
+            MessagesPageStream page(body, format);
+            for (const auto& hm : sync.messages()) {
+                securecloud::messaging::EncryptedMessage em;
+                em.set_message_id(hm.message_id());
+                em.set_sender_id(hm.sender_id());
+                em.set_ciphertext(hm.content());
+                em.set_timestamp_unix(hm.timestamp_unix());
+                page.add(em, hm.conversation_id());
+            }
+            page.finish(sync.has_more(), sync.cursor());
+            const std::string expected =
+                format == BodyFormat::Json ? reference_json(sync) : sync.SerializeAsString();
+            if (body != expected && ++failures <= 5) {
+                std::cerr << "mismatch for MessagesPageStream (SyncHttpResponse, "
+                          << (format == BodyFormat::Json ? "json" : "protobuf") << ")\n";
+            }
+        }
+
+        gw::HttpMessage one;
+        fill(rng, &one);
+        same(one, "HttpMessage", &failures);
+
+        gw::SendMessageHttpResponse sent;
+        sent.set_message_id(random_string(rng, 4));
+        sent.set_accepted(rng() & 1);
+        same(sent, "SendMessageHttpResponse", &failures);
+
+        gw::ListUsersHttpResponse users;
+        for (int k = static_cast<int>(rng() % 4); k > 0; --k) {
+            auto* u = users.add_users();
+            u->set_user_id(random_string(rng, 3));
+            u->set_full_name(random_string(rng, 8));
+            u->set_email(random_string(rng, 8));
+            u->set_role(random_string(rng, 3));
+        }
+        same(users, "ListUsersHttpResponse", &failures);
+
+        gw::CreateRoomHttpResponse created;
+        created.set_success(rng() & 1);
+        created.set_message(random_string(rng, 6));
+        created.set_room_id(random_string(rng, 4));
+        same(created, "CreateRoomHttpResponse", &failures);
+
+        gw::ListRoomsResponse rooms;
+        for (int k = static_cast<int>(rng() % 4); k > 0; --k) {
+            auto* r = rooms.add_rooms();
+            r->set_room_id(random_string(rng, 4));
+            r->set_title(random_string(rng, 8));
+        }
+        same(rooms, "ListRoomsResponse", &failures);
+
+        gw::BootstrapResponse boot;
+        if (rng() & 1) {
+            auto* me = boot.mutable_me();
+            me->set_user_id(random_string(rng, 3));
+            me->set_full_name(random_string(rng, 8));
+        }
+        *boot.mutable_users() = users.users();
+        *boot.mutable_rooms() = rooms.rooms();
+        for (int k = static_cast<int>(rng() % 3); k > 0; --k) {
+            auto* page = boot.add_conversations();
+            page->set_conversation_id(random_string(rng, 4));
+            for (int j = static_cast<int>(rng() % 3); j > 0; --j) fill(rng, page->add_messages());
+            page->set_status(static_cast<std::int32_t>(random_int(rng)));
+            page->set_error(random_string(rng, 6));
+        }
+        same(boot, "BootstrapResponse", &failures);
+    }
+    return failures;
+}
+
+template <typename Fn>
+double ns_per_page(int iterations, size_t* bytes, Fn&& fn) {
+    *bytes = 0;
+    const auto start = Clock::now();
+    for (int i = 0; i < iterations; ++i) *bytes += fn();
+    const auto ns = std::chrono::duration_cast<std::chrono::nanoseconds>(Clock::now() - start).count();
+    return static_cast<double>(ns) / iterations;
+}
+
+void usage() {
+    std::cerr << "usage: gateway_json_bench [-n messages_per_page] [-s content_bytes] [-i iterations] [-f fuzz_cases]\n";
+}
+}
+
+int main(int argc, char** argv) {
+    Config cfg;
+    for (int i = 1; i < argc; ++i) {
+        const std::string arg = argv[i];
+        auto next = [&]() -> const char* { return i + 1 < argc ? argv[++i] : "0"; };
+        if (arg == "-n") cfg.messages = std::atoi(next());
+        else if (arg == "-s") cfg.contentBytes = std::atoi(next());
+        else if (arg == "-i") cfg.iterations = std::atoi(next());
+        else if (arg == "-f") cfg.fuzzCases = std::atoi(next());
+        else {
+            usage();
+            return 2;
+        }
+    }
+    if (cfg.messages < 0 || cfg.contentBytes < 0 || cfg.iterations <= 0 || cfg.fuzzCases < 0) {
+        usage();
+        return 2;
+    }
+
+    // Invalid UTF-8 is part of the fuzz corpus; protobuf logs every occurrence.
+    google::protobuf::LogSilencer silenceInvalidUtf8;
+    const int failures = check_all(cfg.fuzzCases);
+    std::printf("equivalence: %d random cases per type, %d mismatches\n", cfg.fuzzCases, failures);
+    if (failures) return 1;
+
+    // A history page as the gateway renders it: ASCII content (client-side JSON text).
+    std::mt19937 rng(7);
+    gw::ListMessagesResponse page;
+    for (int i = 0; i < cfg.messages; ++i) {
+        auto* m = page.add_messages();
+        m->set_message_id("db_" + std::to_string(100000 + i));
+        m->set_conversation_id("room:42");
+        m->set_sender_id(std::to_string(1 + rng() % 50));
+        std::string content;
+        content.reserve(static_cast<size_t>(cfg.contentBytes));
+        for (int k = 0; k < cfg.contentBytes; ++k) content.push_back(static_cast<char>('a' + rng() % 26));
+        if (cfg.contentBytes > 8) content.replace(4, 4, "\"<é>");
+        m->set_content(std::move(content));
+        m->set_timestamp_unix(1700000000 + i);
+    }
+    if (reference_json(page) != to_json(page)) {
+        std::cerr << "benchmark page mismatch\n";
+        return 1;
+    }
+
+    size_t bytes = 0;
+    const double reflection = ns_per_page(cfg.iterations, &bytes, [&] { return reference_json(page).size(); });
+    const size_t pageBytes = bytes / static_cast<size_t>(cfg.iterations);
+    const double fresh = ns_per_page(cfg.iterations, &bytes, [&] { return to_json(page).size(); });
+    std::string reused;
+    const double buffered = ns_per_page(cfg.iterations, &bytes, [&] {
+        reused.clear();
+        JsonWriter w(reused);
+        write_json(w, page);
+        return reused.size();
+    });
+
+    std::printf("page: %d messages, %d content bytes each, %zu JSON bytes\n", cfg.messages, cfg.contentBytes, pageBytes);
+    std::printf("  MessageToJsonString   %10.1f us/page  %8.1f MB/s\n", reflection / 1000.0, pageBytes * 1000.0 / reflection);
+    std::printf("  JsonWriter (fresh)    %10.1f us/page  %8.1f MB/s  x%.1f\n", fresh / 1000.0, pageBytes * 1000.0 / fresh,
+                reflection / fresh);
+    std::printf("  JsonWriter (reused)   %10.1f us/page  %8.1f MB/s  x%.1f\n", buffered / 1000.0,
+                pageBytes * 1000.0 / buffered, reflection / buffered);
+
+    // Accept: application/x-protobuf. Decoding stands in for the client's parse.
+    const std::string json = to_json(page);
+    const std::string binary = page.SerializeAsString();
+    const double encode = ns_per_page(cfg.iterations, &bytes, [&] {
+        reused.clear();
+        page.AppendToString(&reused);
+        return reused.size();
+    });
+    google::protobuf::util::JsonParseOptions parseOpts;
+    parseOpts.ignore_unknown_fields = true;
+    const double jsonDecode = ns_per_page(cfg.iterations, &bytes, [&] {
+        gw::ListMessagesResponse parsed;
+        google::protobuf::util::JsonStringToMessage(json, &parsed, parseOpts);
+        return static_cast<size_t>(parsed.messages_size());
+    });
+    const double binaryDecode = ns_per_page(cfg.iterations, &bytes, [&] {
+        gw::ListMessagesResponse parsed;
+        parsed.ParseFromString(binary);
+        return static_cast<size_t>(parsed.messages_size());
+    });
+    std::printf("protobuf: %zu bytes (%.0f%% of JSON)\n", binary.size(), 100.0 * binary.size() / json.size());
+    std::printf("  encode (reused)       %10.1f us/page\n", encode / 1000.0);
+    std::printf("  decode JSON           %10.1f us/page\n", jsonDecode / 1000.0);
+    std::printf("  decode protobuf       %10.1f us/page  x%.1f\n", binaryDecode / 1000.0, jsonDecode / binaryDecode);
+    return 0;
+}
@@ -0,0 +1,718 @@
+// End-to-end load generator: virtual users driving the gateway (and through it auth_service,
+// messaging_service and Postgres) the way the client does.
+//
+//   gateway_load_gen [options] [http://host:port]
+//
+// Each virtual user (VU) logs in, loads the directory (GET /users) and its rooms (GET /rooms), then
+// runs scenarios picked at random by weight until the end of the run:
+//   -m "60:history,send;30:sync;10:directory,rooms"      (the default mix)
+//   -s scenarios.txt                                      one "weight step step ..." per line, # comments
+// Steps: login me directory rooms bootstrap conversations history send sync think:<ms>
+//
+// Closed loop (default): every VU starts its next scenario when the previous one ends.
+// Open loop (-r N): scenarios start at N per second overall (--poisson: exponential gaps), whatever
+// the response times; VUs only bound the concurrency. Latencies are then measured from the
+// *intended* start of each scenario (coordinated omission corrected, as wrk2): a late start caused
+// by a slow server counts against the server instead of silently thinning the load.
+//
+// Options:
+//   -u VUs (50)  -d seconds (30)  -w warmup_seconds (5)  -r scenarios_per_second (0 = closed loop)
+//   --users N (VUs)  --user-prefix lg-user  --password LoadGen123!  --think ms (0, closed loop)
+//   --events N      N extra users hold GET /events open; reports send -> delivery latency
+//   --json FILE     results as JSON (compare runs between commits)
+//   --max-p99-ms X / --max-error-rate R   exit 2 when exceeded (CI gate)
+//   --setup --admin-email E --admin-password P [--rooms 20] [--room-size 10]
+//                   register the --users accounts and create rooms through the gateway, then exit
+//
+// Against a local stack (Postgres with init/schema.sql + init/bootstrap_admin.sql, the three
+// services and the gateway), see test/load_test.sh.
+#include "httplib.h"
+
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <cmath>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <random>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace {
+using Clock = std::chrono::steady_clock;
+
+enum class Step { Login, Me, Directory, Rooms, Bootstrap, Conversations, History, Send, Sync, Think };
+constexpr const char* kStepNames[] = {"login",   "me",      "directory", "rooms", "bootstrap",
+                                      "conversations", "history", "send", "sync", "think"};
+constexpr size_t kSteps = std::size(kStepNames);
+
+struct Action {
+    Step step = Step::Me;
+    int thinkMs = 0;
+};
+
+struct Scenario {
+    std::string name;
+    double weight = 1;
+    std::vector<Action> actions;
+};
+
+struct Config {
+    std::string host = "127.0.0.1";
+    int port = 8080;
+    int vus = 50;
+    int durationSeconds = 30;
+    int warmupSeconds = 5;
+    double rate = 0;
+    bool poisson = false;
+    int users = 0;
+    std::string userPrefix = "lg-user";
+    std::string password = "LoadGen123!";
+    int thinkMs = 0;
+    int eventListeners = 0;
+    std::string jsonPath;
+    double maxP99Ms = 0;
+    double maxErrorRate = -1;
+    bool setup = false;
+    std::string adminEmail;
+    std::string adminPassword;
+    int rooms = 20;
+    int roomSize = 10;
+    std::vector<Scenario> scenarios;
+};
+
+bool parse_step(const std::string& word, Action* out) {
+    if (word.rfind("think:", 0) == 0) {
+        out->step = Step::Think;
+        out->thinkMs = std::max(0, std::atoi(word.c_str() + 6));
+        return true;
+    }
+    for (size_t i = 0; i + 1 < kSteps; ++i) {
+        if (word == kStepNames[i]) {
+            out->step = static_cast<Step>(i);
+            return true;
+        }
+    }
+    return false;
+}
+
+// "weight step step ..." (file) or "weight:step,step" (-m); returns false on an unknown step.
+bool parse_scenario(std::string line, Scenario* out) {
+    std::replace(line.begin(), line.end(), ':', ' ');
+    std::replace(line.begin(), line.end(), ',', ' ');
+    // think:<ms> lost its colon above: glue "think N" back together.
+    std::istringstream in(line);
+    std::string word;
+    if (!(in >> out->weight) || out->weight <= 0) return false;
+    std::vector<std::string> words;
+    while (in >> word) words.push_back(word);
+    for (size_t i = 0; i < words.size(); ++i) {
+        Action a;
+        const std::string w = words[i] == "think" && i + 1 < words.size() ? "think:" + words[++i] : words[i];
+        if (!parse_step(w, &a)) {
+            std::cerr << "unknown step: " << w << "\n";
+            return false;
+        }
+        out->actions.push_back(a);
+        if (!out->name.empty()) out->name += ',';
+        out->name += w;
+    }
+    return !out->actions.empty();
+}
+
+bool parse_mix(const std::string& mix, std::vector<Scenario>* out) {
+    size_t pos = 0;
+    while (pos <= mix.size()) {
+        size_t end = mix.find(';', pos);
+        if (end == std::string::npos) end = mix.size();
+        const std::string part = mix.substr(pos, end - pos);
+        if (part.find_first_not_of(" \t") != std::string::npos) {
+            Scenario s;
+            if (!parse_scenario(part, &s)) return false;
+            out->push_back(std::move(s));
+        }
+        pos = end + 1;
+    }
+    return !out->empty();
+}
+
+bool load_scenarios(const std::string& path, std::vector<Scenario>* out) {
+    std::ifstream f(path);
+    if (!f) return false;
+    std::string line;
+    while (std::getline(f, line)) {
+        const auto hash = line.find('#');
+        if (hash != std::string::npos) line.erase(hash);
+        if (line.find_first_not_of(" \t\r") == std::string::npos) continue;
+        Scenario s;
+        if (!parse_scenario(line, &s)) return false;
+        out->push_back(std::move(s));
+    }
+    return !out->empty();
+}
+
+// Values of "key":"..." in a JSON body (ids and tokens: no escapes to handle).
+std::vector<std::string> json_strings(const std::string& body, const std::string& key) {
+    std::vector<std::string> out;
+    const std::string needle = "\"" + key + "\"";
+    size_t pos = 0;
+    while ((pos = body.find(needle, pos)) != std::string::npos) {
+        pos = body.find_first_not_of(" \t\r\n:", pos + needle.size());
+        if (pos == std::string::npos) break;
+        if (body[pos] != '"') continue;
+        const auto end = body.find('"', ++pos);
+        if (end == std::string::npos) break;
+        out.push_back(body.substr(pos, end - pos));
+        pos = end + 1;
+    }
+    return out;
+}
+
+std::string json_escape(const std::string& s) {
+    std::string out;
+    for (const char c : s) {
+        if (c == '"' || c == '\\') out += '\\';
+        out += c;
+    }
+    return out;
+}
+
+std::string user_email(const Config& cfg, int i) {
+    return cfg.userPrefix + "-" + std::to_string(i) + "@loadgen.local";
+}
+
+std::int64_t unix_ns() {
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::system_clock::now().time_since_epoch())
+        .count();
+}
+
+// Latencies of one thread, merged at the end.
+struct Recorder {
+    std::array<std::vector<std::uint32_t>, kSteps> correctedUs;
+    std::array<std::vector<std::uint32_t>, kSteps> serviceUs;
+    std::array<std::uint64_t, kSteps> errors{};
+    std::map<std::string, std::vector<std::uint32_t>> scenarioUs;  // corrected, whole scenario
+    std::uint64_t scenarioErrors = 0;
+    std::vector<std::uint32_t> deliveryUs;
+    double maxLagMs = 0;
+
+    void merge(Recorder& o) {
+        for (size_t i = 0; i < kSteps; ++i) {
+            correctedUs[i].insert(correctedUs[i].end(), o.correctedUs[i].begin(), o.correctedUs[i].end());
+            serviceUs[i].insert(serviceUs[i].end(), o.serviceUs[i].begin(), o.serviceUs[i].end());
+            errors[i] += o.errors[i];
+        }
+        for (auto& [name, v] : o.scenarioUs) scenarioUs[name].insert(scenarioUs[name].end(), v.begin(), v.end());
+        scenarioErrors += o.scenarioErrors;
+        deliveryUs.insert(deliveryUs.end(), o.deliveryUs.begin(), o.deliveryUs.end());
+        maxLagMs = std::max(maxLagMs, o.maxLagMs);
+    }
+};
+
+std::uint32_t to_us(Clock::duration d) {
+    const auto us = std::chrono::duration_cast<std::chrono::microseconds>(d).count();
+    return static_cast<std::uint32_t>(std::clamp<long long>(us, 0, UINT32_MAX));
+}
+
+// Start times of open-loop scenarios, shared by all VUs.
+class Schedule {
+public:
+    Schedule(const Config& cfg, Clock::time_point start) : cfg_(cfg), next_(start), rng_(42) {}
+
+    Clock::time_point next() {
+        std::lock_guard<std::mutex> lk(m_);
+        const auto t = next_;
+        const double gap = cfg_.poisson ? std::exponential_distribution<double>(cfg_.rate)(rng_) : 1.0 / cfg_.rate;
+        next_ += std::chrono::duration_cast<Clock::duration>(std::chrono::duration<double>(gap));
+        return t;
+    }
+
+private:
+    const Config& cfg_;
+    std::mutex m_;
+    Clock::time_point next_;
+    std::mt19937_64 rng_;
+};
+
+class VirtualUser {
+public:
+    VirtualUser(const Config& cfg, int index, Recorder& rec)
+        : cfg_(cfg), index_(index), rec_(rec), client_(cfg.host, cfg.port), rng_(static_cast<unsigned>(index) * 7919u + 1) {
+        client_.set_keep_alive(true);
+        client_.set_tcp_nodelay(true);
+        client_.set_connection_timeout(5);
+        client_.set_read_timeout(30);
+        client_.set_write_timeout(30);
+        deviceId_ = "lg-device-" + std::to_string(index);
+    }
+
+    // login -> directory -> rooms; recorded like any step.
+    bool start(bool record) {
+        const auto t = Clock::now();
+        return run(Step::Login, t, record) && run(Step::Directory, Clock::now(), record) &&
+               run(Step::Rooms, Clock::now(), record);
+    }
+
+    // One scenario intended to start at `intended`.
+    void scenario(const Scenario& s, Clock::time_point intended, bool record) {
+        const auto begin = Clock::now();
+        if (record) rec_.maxLagMs = std::max(rec_.maxLagMs, std::chrono::duration<double, std::milli>(begin - intended).count());
+        auto stepIntended = intended;
+        bool ok = true;
+        for (const auto& a : s.actions) {
+            if (a.step == Step::Think) {
+                std::this_thread::sleep_for(std::chrono::milliseconds(a.thinkMs));
+                stepIntended = Clock::now();
+                continue;
+            }
+            ok = run(a.step, stepIntended, record) && ok;
+            stepIntended = Clock::now();  // dependent steps: the next one is due when this one ends
+        }
+        if (!record) return;
+        rec_.scenarioUs[s.name].push_back(to_us(Clock::now() - intended));
+        if (!ok) ++rec_.scenarioErrors;
+    }
+
+private:
+    bool run(Step step, Clock::time_point intended, bool record) {
+        const auto start = Clock::now();
+        const bool ok = issue(step);
+        const auto end = Clock::now();
+        if (record) {
+            const auto i = static_cast<size_t>(step);
+            rec_.correctedUs[i].push_back(to_us(end - intended));
+            rec_.serviceUs[i].push_back(to_us(end - start));
+            if (!ok) ++rec_.errors[i];
+        }
+        return ok;
+    }
+
+    bool issue(Step step) {
+        switch (step) {
+        case Step::Login: {
+            const int user = index_ % std::max(1, cfg_.users);
+            const std::string body = "{\"username\":\"" + json_escape(user_email(cfg_, user)) + "\",\"password\":\"" +
+                                     json_escape(cfg_.password) + "\"}";
+            auto r = client_.Post("/login", body, "application/json");
+            if (!r || r->status != 200) return false;
+            const auto tokens = json_strings(r->body, "accessToken");
+            if (tokens.empty()) return false;
+            headers_ = {{"Authorization", "Bearer " + tokens.front()}};
+            return true;
+        }
+        case Step::Me: return get("/me");
+        case Step::Directory: {
+            auto r = client_.Get("/users", headers_);
+            if (!r || r->status != 200) return false;
+            peers_ = json_strings(r->body, "userId");
+            return true;
+        }
+        case Step::Rooms: {
+            auto r = client_.Get("/rooms", headers_);
+            if (!r || (r->status != 200 && r->status != 304)) return false;
+            if (r->status == 200) rooms_ = json_strings(r->body, "roomId");
+            return true;
+        }
+        case Step::Bootstrap: {
+            std::string path = "/bootstrap?limit=20";
+            if (!rooms_.empty()) path += "&conversations=" + pick(rooms_);
+            return get(path);
+        }
+        case Step::Conversations: return get("/conversations");
+        case Step::History: {
+            const std::string conv = conversation();
+            return !conv.empty() && get("/conversations/" + conv + "/messages?limit=50");
+        }
+        case Step::Send: {
+            const std::string conv = conversation();
+            if (conv.empty()) return false;
+            // Carries its send time: the /events listeners measure delivery latency from it.
+            const std::string body = "{\"content\":\"lg:" + std::to_string(unix_ns()) + ":" + std::to_string(index_) + "\"}";
+            auto r = client_.Post("/conversations/" + conv + "/messages", headers_, body, "application/json");
+            return r && r->status == 200;
+        }
+        case Step::Sync: {
+            // Acks like the client does, so the backlog does not grow over the run.
+            auto r = client_.Get("/sync?deviceId=" + deviceId_, headers_);
+            if (!r || r->status != 200) return false;
+            // One page per step: the next Sync step picks up the following page.
+            const auto cursor = json_strings(r->body, "cursor");
+            if (cursor.empty()) return true;
+            const std::string body = "{\"deviceId\":\"" + deviceId_ + "\",\"cursor\":\"" + cursor.back() + "\"}";
+            auto a = client_.Post("/sync/ack", headers_, body, "application/json");
+            return a && a->status == 200;
+        }
+        case Step::Think: return true;
+        }
+        return false;
+    }
+
+    bool get(const std::string& path) {
+        auto r = client_.Get(path, headers_);
+        return r && (r->status == 200 || r->status == 304);
+    }
+
+    const std::string& pick(const std::vector<std::string>& v) {
+        return v[std::uniform_int_distribution<size_t>(0, v.size() - 1)(rng_)];
+    }
+
+    // A room of the user, or a DM with someone from the directory.
+    std::string conversation() {
+        if (!rooms_.empty() && (peers_.empty() || rng_() % 4 != 0)) return pick(rooms_);
+        if (!peers_.empty()) return pick(peers_);
+        return {};
+    }
+
+    const Config& cfg_;
+    const int index_;
+    Recorder& rec_;
+    httplib::Client client_;
+    std::mt19937 rng_;
+    httplib::Headers headers_;
+    std::string deviceId_;
+    std::vector<std::string> peers_;
+    std::vector<std::string> rooms_;
+};
+
+// Holds GET /events open and records how long messages sent by the VUs took to arrive. `client`
+// belongs to the caller, which stops it (shutting down a blocked read) before joining.
+void listen_events(httplib::Client& client, const Config& cfg, int userIndex, Recorder& rec, std::mutex& recM,
+                   const std::atomic<bool>& recording, const std::atomic<bool>& stop) {
+    client.set_read_timeout(20);
+    const std::string body = "{\"username\":\"" + json_escape(user_email(cfg, userIndex)) + "\",\"password\":\"" +
+                             json_escape(cfg.password) + "\"}";
+    auto r = client.Post("/login", body, "application/json");
+    if (!r || r->status != 200) return;
+    const auto tokens = json_strings(r->body, "accessToken");
+    if (tokens.empty()) return;
+    const httplib::Headers headers{{"Authorization", "Bearer " + tokens.front()}};
+
+    std::string pending;
+    while (!stop.load()) {
+        client.Get("/events", headers, [&](const char* data, size_t len) {
+            pending.append(data, len);
+            size_t pos = 0;
+            while ((pos = pending.find("\"lg:", pos)) != std::string::npos) {
+                const long long sent = std::atoll(pending.c_str() + pos + 4);
+                const long long delay = (unix_ns() - sent) / 1000;
+                if (sent > 0 && recording.load()) {
+                    std::lock_guard<std::mutex> lk(recM);
+                    rec.deliveryUs.push_back(static_cast<std::uint32_t>(std::clamp<long long>(delay, 0, UINT32_MAX)));
+                }
+                pos += 4;
+            }
+            const auto keep = pending.rfind('\n');
+            if (keep != std::string::npos) pending.erase(0, keep + 1);
+            return !stop.load();
+        });
+        if (!stop.load()) std::this_thread::sleep_for(std::chrono::seconds(1));
+    }
+}
+
+struct Summary {
+    std::uint64_t count = 0;
+    double p50 = 0, p90 = 0, p99 = 0, p999 = 0, max = 0;  // ms
+};
+
+Summary summarize(std::vector<std::uint32_t>& v) {
+    Summary s;
+    s.count = v.size();
+    if (v.empty()) return s;
+    std::sort(v.begin(), v.end());
+    const auto at = [&](double q) {
+        const size_t rank = static_cast<size_t>(std::ceil(q * static_cast<double>(v.size())));
+        return static_cast<double>(v[std::min(v.size() - 1, rank == 0 ? 0 : rank - 1)]) / 1000.0;
+    };
+    s.p50 = at(0.5);
+    s.p90 = at(0.9);
+    s.p99 = at(0.99);
+    s.p999 = at(0.999);
+    s.max = static_cast<double>(v.back()) / 1000.0;
+    return s;
+}
+
+std::string summary_json(const Summary& s) {
+    char buf[256];
+    std::snprintf(buf, sizeof(buf), "{\"count\":%llu,\"p50_ms\":%.3f,\"p90_ms\":%.3f,\"p99_ms\":%.3f,\"p999_ms\":%.3f,\"max_ms\":%.3f}",
+                  static_cast<unsigned long long>(s.count), s.p50, s.p90, s.p99, s.p999, s.max);
+    return buf;
+}
+
+void print_row(const std::string& name, const Summary& c, const Summary* service, std::uint64_t errors) {
+    std::printf("%-26s %8llu %7llu %9.2f %9.2f %9.2f %9.2f", name.c_str(), static_cast<unsigned long long>(c.count),
+                static_cast<unsigned long long>(errors), c.p50, c.p99, c.p999, c.max);
+    if (service) std::printf("   | %8.2f %8.2f %8.2f", service->p50, service->p99, service->p999);
+    std::printf("\n");
+}
+
+// Registers the --users accounts and creates rooms of --room-size members (admin account).
+int run_setup(const Config& cfg) {
+    httplib::Client admin(cfg.host, cfg.port);
+    admin.set_read_timeout(30);
+    const std::string login = "{\"username\":\"" + json_escape(cfg.adminEmail) + "\",\"password\":\"" +
+                              json_escape(cfg.adminPassword) + "\"}";
+    auto r = admin.Post("/login", login, "application/json");
+    const auto tokens = r && r->status == 200 ? json_strings(r->body, "accessToken") : std::vector<std::string>{};
+    if (tokens.empty()) {
+        std::cerr << "setup: admin login failed (" << (r ? std::to_string(r->status) : "no response") << ")\n";
+        return 1;
+    }
+    const httplib::Headers headers{{"Authorization", "Bearer " + tokens.front()}};
+
+    std::atomic<int> next{0};
+    std::atomic<int> created{0};
+    std::vector<std::thread> threads;
+    for (int t = 0; t < std::min(cfg.vus, 16); ++t) {
+        threads.emplace_back([&]() {
+            httplib::Client c(cfg.host, cfg.port);
+            c.set_keep_alive(true);
+            c.set_read_timeout(30);
+            for (int i = next++; i < cfg.users; i = next++) {
+                const std::string body = "{\"fullName\":\"Load Gen " + std::to_string(i) + "\",\"email\":\"" +
+                                         json_escape(user_email(cfg, i)) + "\",\"password\":\"" +
+                                         json_escape(cfg.password) + "\",\"roleName\":\"user\"}";
+                auto res = c.Post("/register", headers, body, "application/json");
+                if (res && res->status == 200 && res->body.find("\"success\":true") != std::string::npos) ++created;
+            }
+        });
+    }
+    for (auto& t : threads) t.join();
+    std::cout << "users: " << created << " registered, " << (cfg.users - created) << " already present or failed\n";
+
+    int rooms = 0;
+    for (int room = 0; room < cfg.rooms; ++room) {
+        std::string body = "{\"title\":\"lg-room-" + std::to_string(room) + "\",\"participantEmails\":[";
+        for (int j = 0; j < std::min(cfg.roomSize, cfg.users); ++j) {
+            body += (j ? ",\"" : "\"") + json_escape(user_email(cfg, (room * cfg.roomSize + j) % cfg.users)) + "\"";
+        }
+        body += "]}";
+        auto res = admin.Post("/rooms", headers, body, "application/json");
+        if (res && res->status == 200) ++rooms;
+    }
+    std::cout << "rooms: " << rooms << "/" << cfg.rooms << " created\n";
+    return 0;
+}
+
+bool parse_args(int argc, char** argv, Config* cfg) {
+    std::string mix = "60:history,send;30:sync;10:directory,rooms";
+    std::string scenarioFile;
+    for (int i = 1; i < argc; ++i) {
+        const std::string a = argv[i];
+        const auto value = [&]() -> std::string { return i + 1 < argc ? argv[++i] : ""; };
+        if (a == "-u") cfg->vus = std::max(1, std::atoi(value().c_str()));
+        else if (a == "-d") cfg->durationSeconds = std::max(1, std::atoi(value().c_str()));
+        else if (a == "-w") cfg->warmupSeconds = std::max(0, std::atoi(value().c_str()));
+        else if (a == "-r") cfg->rate = std::max(0.0, std::atof(value().c_str()));
+        else if (a == "--poisson") cfg->poisson = true;
+        else if (a == "-m") mix = value();
+        else if (a == "-s") scenarioFile = value();
+        else if (a == "--users") cfg->users = std::max(1, std::atoi(value().c_str()));
+        else if (a == "--user-prefix") cfg->userPrefix = value();
+        else if (a == "--password") cfg->password = value();
+        else if (a == "--think") cfg->thinkMs = std::max(0, std::atoi(value().c_str()));
+        else if (a == "--events") cfg->eventListeners = std::max(0, std::atoi(value().c_str()));
+        else if (a == "--json") cfg->jsonPath = value();
+        else if (a == "--max-p99-ms") cfg->maxP99Ms = std::atof(value().c_str());
+        else if (a == "--max-error-rate") cfg->maxErrorRate = std::atof(value().c_str());
+        else if (a == "--setup") cfg->setup = true;
+        else if (a == "--admin-email") cfg->adminEmail = value();
+        else if (a == "--admin-password") cfg->adminPassword = value();
+        else if (a == "--rooms") cfg->rooms = std::max(0, std::atoi(value().c_str()));
+        else if (a == "--room-size") cfg->roomSize = std::max(1, std::atoi(value().c_str()));
+        else if (a.rfind("http://", 0) == 0) {
+            const std::string authority = a.substr(7, a.find('/', 7) - 7);
+            const auto colon = authority.rfind(':');
+            cfg->host = authority.substr(0, colon);
+            if (colon != std::string::npos) cfg->port = std::atoi(authority.c_str() + colon + 1);
+        } else {
+            std::cerr << "unknown argument: " << a << "\n";
+            return false;
+        }
+    }
+    if (cfg->users == 0) cfg->users = cfg->vus + cfg->eventListeners;
+    if (!scenarioFile.empty()) {
+        if (!load_scenarios(scenarioFile, &cfg->scenarios)) {
+            std::cerr << "cannot read scenarios from " << scenarioFile << "\n";
+            return false;
+        }
+    } else if (!parse_mix(mix, &cfg->scenarios)) {
+        std::cerr << "invalid mix: " << mix << "\n";
+        return false;
+    }
+    return true;
+}
+}  // namespace
+
+int main(int argc, char** argv) {
+    Config cfg;
+    if (!parse_args(argc, argv, &cfg)) return 1;
+    if (cfg.setup) return run_setup(cfg);
+
+    double totalWeight = 0;
+    for (const auto& s : cfg.scenarios) totalWeight += s.weight;
+
+    const auto begin = Clock::now() + std::chrono::milliseconds(200);
+    const auto recordFrom = begin + std::chrono::seconds(cfg.warmupSeconds);
+    const auto end = recordFrom + std::chrono::seconds(cfg.durationSeconds);
+    Schedule schedule(cfg, begin);
+
+    std::vector<Recorder> recorders(static_cast<size_t>(cfg.vus));
+    std::atomic<int> loginFailures{0};
+    std::vector<std::thread> threads;
+    for (int v = 0; v < cfg.vus; ++v) {
+        threads.emplace_back([&, v]() {
+            Recorder& rec = recorders[static_cast<size_t>(v)];
+            VirtualUser vu(cfg, v + cfg.eventListeners, rec);
+            std::this_thread::sleep_until(begin + std::chrono::milliseconds(cfg.vus > 1 ? 1000 * v / cfg.vus : 0));
+            if (!vu.start(Clock::now() >= recordFrom)) {
+                ++loginFailures;
+                return;
+            }
+            std::mt19937 rng(static_cast<unsigned>(v) + 1);
+            std::uniform_real_distribution<double> dist(0.0, totalWeight);
+            for (;;) {
+                Clock::time_point intended;
+                if (cfg.rate > 0) {
+                    intended = schedule.next();
+                    // Past the end, slots still due are reported as missed rather than run late.
+                    if (intended >= end || Clock::now() >= end) break;
+                    std::this_thread::sleep_until(intended);
+                } else {
+                    intended = Clock::now();
+                    if (intended >= end) break;
+                }
+                double x = dist(rng);
+                const Scenario* s = &cfg.scenarios.back();
+                for (const auto& c : cfg.scenarios) {
+                    if ((x -= c.weight) < 0) {
+                        s = &c;
+                        break;
+                    }
+                }
+                vu.scenario(*s, intended, intended >= recordFrom);
+                if (cfg.rate <= 0 && cfg.thinkMs > 0) std::this_thread::sleep_for(std::chrono::milliseconds(cfg.thinkMs));
+            }
+        });
+    }
+
+    Recorder events;
+    std::mutex eventsM;
+    std::atomic<bool> eventsRecording{false};
+    std::atomic<bool> stopEvents{false};
+    std::vector<std::unique_ptr<httplib::Client>> eventClients;
+    std::vector<std::thread> listeners;
+    for (int l = 0; l < cfg.eventListeners; ++l) {
+        eventClients.push_back(std::make_unique<httplib::Client>(cfg.host, cfg.port));
+        httplib::Client* client = eventClients.back().get();
+        listeners.emplace_back([&, l, client]() {
+            listen_events(*client, cfg, l, events, eventsM, eventsRecording, stopEvents);
+        });
+    }
+    std::this_thread::sleep_until(recordFrom);
+    eventsRecording = true;
+
+    for (auto& t : threads) t.join();
+    eventsRecording = false;
+    stopEvents = true;
+    // Listeners reference this frame: joined, not detached. stop() interrupts a read blocked until
+    // the next keepalive; one racing into a new GET sees the stop flag on its first chunk (or
+    // its read timeout).
+    for (auto& c : eventClients) c->stop();
+    for (auto& t : listeners) t.join();
+
+    Recorder all;
+    for (auto& r : recorders) all.merge(r);
+    {
+        std::lock_guard<std::mutex> lk(eventsM);
+        all.merge(events);
+    }
+
+    const double seconds = cfg.durationSeconds;
+    std::uint64_t requests = 0;
+    std::uint64_t errors = 0;
+    std::printf("%s, %d VUs, %ds (+%ds warm-up)", cfg.rate > 0 ? "open loop" : "closed loop", cfg.vus,
+                cfg.durationSeconds, cfg.warmupSeconds);
+    if (cfg.rate > 0) std::printf(", %.1f scenarios/s%s", cfg.rate, cfg.poisson ? " (poisson)" : "");
+    std::printf("\n");
+    std::printf("%-26s %8s %7s %9s %9s %9s %9s   | %8s %8s %8s\n", "latency (ms)", "count", "errors", "p50", "p99",
+                "p999", "max", "svc p50", "svc p99", "svc p999");
+
+    std::string json = "{\"mode\":\"" + std::string(cfg.rate > 0 ? "open" : "closed") + "\",\"vus\":" +
+                       std::to_string(cfg.vus) + ",\"duration_s\":" + std::to_string(cfg.durationSeconds) +
+                       ",\"rate\":" + std::to_string(cfg.rate) + ",\"steps\":{";
+    double worstP99 = 0;
+    bool first = true;
+    for (size_t i = 0; i + 1 < kSteps; ++i) {
+        if (all.correctedUs[i].empty()) continue;
+        const Summary corrected = summarize(all.correctedUs[i]);
+        const Summary service = summarize(all.serviceUs[i]);
+        print_row(kStepNames[i], corrected, &service, all.errors[i]);
+        requests += corrected.count;
+        errors += all.errors[i];
+        worstP99 = std::max(worstP99, corrected.p99);
+        json += std::string(first ? "" : ",") + "\"" + kStepNames[i] + "\":{\"errors\":" + std::to_string(all.errors[i]) +
+                ",\"corrected\":" + summary_json(corrected) + ",\"service\":" + summary_json(service) + "}";
+        first = false;
+    }
+    json += "},\"scenarios\":{";
+    first = true;
+    for (auto& [name, v] : all.scenarioUs) {
+        const Summary s = summarize(v);
+        print_row("[" + name + "]", s, nullptr, 0);
+        json += std::string(first ? "" : ",") + "\"" + json_escape(name) + "\":" + summary_json(s);
+        first = false;
+    }
+    json += "}";
+    std::uint64_t started = 0;
+    for (const auto& [name, v] : all.scenarioUs) started += v.size();
+    const double due = cfg.rate * seconds;
+    const std::uint64_t missed = cfg.rate > 0 && due > static_cast<double>(started)
+                                     ? static_cast<std::uint64_t>(due - static_cast<double>(started))
+                                     : 0;
+    if (!all.deliveryUs.empty()) {
+        const Summary d = summarize(all.deliveryUs);
+        print_row("delivery (send -> /events)", d, nullptr, 0);
+        json += ",\"delivery\":" + summary_json(d);
+    }
+    const double errorRate = requests ? static_cast<double>(errors) / static_cast<double>(requests) : 0.0;
+    char tail[256];
+    std::snprintf(tail, sizeof(tail), ",\"requests\":%llu,\"errors\":%llu,\"rps\":%.1f,\"max_start_lag_ms\":%.1f,\"missed_scenarios\":%llu,\"login_failures\":%d}",
+                  static_cast<unsigned long long>(requests), static_cast<unsigned long long>(errors),
+                  static_cast<double>(requests) / seconds, all.maxLagMs, static_cast<unsigned long long>(missed),
+                  loginFailures.load());
+    json += tail;
+
+    std::printf("requests %llu (%.1f/s), errors %llu (%.2f%%), login failures %d\n",
+                static_cast<unsigned long long>(requests), static_cast<double>(requests) / seconds,
+                static_cast<unsigned long long>(errors), 100.0 * errorRate, loginFailures.load());
+    if (cfg.rate > 0 && (all.maxLagMs > 1000 || missed > 0)) {
+        std::printf("warning: scenarios started up to %.0f ms late, %llu due never started: not enough VUs for -r %.1f "
+                    "(latencies include the wait)\n",
+                    all.maxLagMs, static_cast<unsigned long long>(missed), cfg.rate);
+    }
+    if (!cfg.jsonPath.empty()) {
+        std::ofstream(cfg.jsonPath) << json << "\n";
+    }
+
+    int rc = 0;
+    if (cfg.maxP99Ms > 0 && worstP99 > cfg.maxP99Ms) {
+        std::printf("FAIL: p99 %.2f ms > %.2f ms\n", worstP99, cfg.maxP99Ms);
+        rc = 2;
+    }
+    if (cfg.maxErrorRate >= 0 && errorRate > cfg.maxErrorRate) {
+        std::printf("FAIL: error rate %.4f > %.4f\n", errorRate, cfg.maxErrorRate);
+        rc = 2;
+    }
+    if (requests == 0) rc = rc ? rc : 1;
+    return rc;
+}
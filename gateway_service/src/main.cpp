@@ -1,17 +1,44 @@
 #include "gateway.pb.h"
 #include "auth.grpc.pb.h"
 #include "messaging.grpc.pb.h"
+#include "file_service.grpc.pb.h"
 #include <grpcpp/grpcpp.h>
+#include <google/protobuf/arena.h>
 #include <google/protobuf/util/json_util.h>
 
+#include "AllocStats.h"
+#include "BodyFormat.h"
+#include "ChatHub.h"
+#include "EpollHttpServer.h"
+#include "GatewayJson.h"
+#include "HttpRouter.h"
+#include "JwtVerifier.h"
+#include "Metrics.h"
+#include "RateLimiter.h"
+#include "ResponseCompression.h"
+#include "RevocationSet.h"
+#include "RevocationWatcher.h"
+#include "SingleFlight.h"
+#include "TokenCache.h"
+#include "Tracing.h"
+#include "UpstreamPool.h"
 #include "httplib.h"
 
 #include <algorithm>
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <cstdio>
 #include <ctime>
 #include <iostream>
+#include <memory>
 #include <cstdlib>
 #include <string>
+#include <type_traits>
 #include <unordered_map>
+#include <unordered_set>
+#include <utility>
 #include <vector>
 
 namespace {
@@ -35,8 +62,19 @@ void set_json(httplib::Response& res, int status, const std::string& body) {
     res.set_content(body, "application/json");
 }
 
+// Types with a JsonWriter overload (gateway.proto responses) skip reflection.
+template <typename TProto, typename = void>
+struct has_json_writer : std::false_type {};
+template <typename TProto>
+struct has_json_writer<TProto, std::void_t<decltype(write_json(std::declval<JsonWriter&>(), std::declval<const TProto&>()))>>
+    : std::true_type {};
+
 template <typename TProto>
 bool set_proto_json(httplib::Response& res, int status, const TProto& message) {
+    if constexpr (has_json_writer<TProto>::value) {
+        set_json(res, status, to_json(message));
+        return true;
+    }
     std::string json;
     const auto printStatus = MessageToJsonString(message, &json, compact_json_opts());
     if (!printStatus.ok()) {
@@ -47,6 +85,177 @@ bool set_proto_json(httplib::Response& res, int status, const TProto& message) {
     return true;
 }
 
+BodyFormat response_format(const httplib::Request& req) {
+    return negotiate_body_format(req.get_header_value("Accept"));
+}
+
+// Negotiated body: the message as JSON or binary protobuf. Vary keeps shared caches from
+// serving one representation for the other.
+template <typename TProto>
+bool set_proto_body(httplib::Response& res, BodyFormat format, int status, const TProto& message) {
+    add_vary(res, "Accept");
+    if (format == BodyFormat::Json) return set_proto_json(res, status, message);
+    std::string body;
+    if (!message.SerializeToString(&body)) {
+        set_json(res, 500, json_error("Failed to serialize response"));
+        return false;
+    }
+    res.status = status;
+    res.set_content(std::move(body), kProtobufContentType);
+    return true;
+}
+
+// Request body as JSON (default) or, with Content-Type: application/x-protobuf, binary.
+template <typename TProto>
+bool parse_proto_body(const httplib::Request& req, TProto* message, std::string* err) {
+    if (is_protobuf_content_type(req.get_header_value("Content-Type"))) {
+        if (message->ParseFromString(req.body)) return true;
+        *err = "Invalid protobuf payload";
+        return false;
+    }
+    JsonParseOptions parseOpts;
+    parseOpts.ignore_unknown_fields = true;
+    if (JsonStringToMessage(req.body, message, parseOpts).ok()) return true;
+    *err = "Invalid JSON payload";
+    return false;
+}
+
+// Per-call protobuf arena. The first block is part of the owning allocation, so a typical
+// decoded history page costs a few heap blocks instead of one allocation per message and per
+// string field.
+constexpr size_t kRequestArenaBlockSize = 64 * 1024;
+
+// History pages larger than this (estimated) are sent chunked, kHistoryChunkBytes at a time,
+// instead of being rendered into one body.
+constexpr size_t kHistoryStreamAboveBytes = 256 * 1024;
+constexpr size_t kHistoryChunkBytes = 64 * 1024;
+
+google::protobuf::ArenaOptions request_arena_options(char* initialBlock, size_t size) {
+    google::protobuf::ArenaOptions opts;
+    opts.initial_block = initialBlock;
+    opts.initial_block_size = size;
+    opts.start_block_size = kRequestArenaBlockSize;
+    opts.max_block_size = 1024 * 1024;
+    return opts;
+}
+
+// One upstream GetHistory, shared by every request coalesced onto it (SingleFlight).
+struct HistoryFetch {
+    alignas(std::max_align_t) char arenaBlock[kRequestArenaBlockSize];
+    google::protobuf::Arena arena;
+    grpc::ClientContext ctx;
+    securecloud::messaging::HistoryRequest* hreq = nullptr;
+    securecloud::messaging::HistoryResponse* hresp = nullptr;
+    AllocStats::Snapshot issueAllocs;
+    HistoryFetch() : arena(request_arena_options(arenaBlock, sizeof(arenaBlock))) {}
+};
+using HistoryFlight = SingleFlight<HistoryFetch>;
+
+// Key of a HistoryFlight call: everything the page depends on. `scope` is "v<version>" when a
+// validator lookup has already checked access (pages then coalesce across requesters), else
+// "u<requester>".
+std::string history_flight_key(const std::string& conversationKey, int limit, const std::string& before,
+                               const std::string& scope) {
+    return "h:" + conversationKey + ":" + std::to_string(limit) + ":" + before + ":" + scope;
+}
+
+// Issues the GetHistory behind a HistoryFlight key (history route and /bootstrap).
+HistoryFlight::Issue history_issue(UpstreamPool<securecloud::messaging::MessagingService>* stub,
+                                   std::string conversationKey, int limit, std::string before,
+                                   std::string requesterId) {
+    return [stub, conversationKey = std::move(conversationKey), limit, before = std::move(before),
+            requesterId = std::move(requesterId)](HistoryFlight::Done complete) {
+        const AllocStats::Scope fetchScope;
+        auto fetch = std::make_shared<HistoryFetch>();
+        fetch->hreq = google::protobuf::Arena::CreateMessage<securecloud::messaging::HistoryRequest>(&fetch->arena);
+        fetch->hreq->set_conversation_id(conversationKey);
+        fetch->hreq->set_limit(limit);
+        fetch->hreq->set_before_message_id(before);
+        if (!requesterId.empty()) {
+            // Provide requester_id for room membership checks.
+            fetch->hreq->set_requester_id(requesterId);
+        }
+        // Deserialized straight into the arena.
+        fetch->hresp = google::protobuf::Arena::CreateMessage<securecloud::messaging::HistoryResponse>(&fetch->arena);
+        fetch->issueAllocs = fetchScope.delta();
+        stub->setDeadline(fetch->ctx);
+        stub->pick().async()->GetHistory(&fetch->ctx, fetch->hreq, fetch->hresp,
+                                         [fetch, complete](grpc::Status st) { complete(st, fetch); });
+    };
+}
+
+// GATEWAY_ALLOC_STATS=1: expose per-request heap allocations as response headers, for this
+// handler and (via gRPC trailing metadata) for the messaging handler that served it.
+bool alloc_stats_enabled() {
+    static const bool enabled = [] {
+        const char* v = std::getenv("GATEWAY_ALLOC_STATS");
+        return v && std::string(v) == "1";
+    }();
+    return enabled;
+}
+
+void set_alloc_headers(httplib::Response& res, const AllocStats::Snapshot& d, const grpc::ClientContext& ctx) {
+    if (!alloc_stats_enabled()) return;
+    res.set_header("X-Alloc-Count", std::to_string(d.allocations));
+    res.set_header("X-Alloc-Bytes", std::to_string(d.bytes));
+    const auto& trailers = ctx.GetServerTrailingMetadata();
+    const auto it = trailers.find("x-alloc-count");
+    if (it != trailers.end()) {
+        res.set_header("X-Upstream-Alloc-Count", std::string(it->second.data(), it->second.size()));
+    }
+}
+
+// Conditional GET. ETags are weak (W/"...") and built from version counters kept by auth and
+// messaging, so a revalidation costs one indexed lookup instead of relisting.
+// Weak validator for a versioned body; each representation gets its own (RFC 9110 8.8.3).
+std::string weak_etag(const std::string& tag, BodyFormat format) {
+    return "W/\"" + tag + (format == BodyFormat::Protobuf ? "-pb" : "") + "\"";
+}
+
+void set_etag(httplib::Response& res, const std::string& etag) {
+    res.set_header("ETag", etag);
+    // Always revalidate: the body is per-user and changes without notice.
+    res.set_header("Cache-Control", "private, no-cache");
+    add_vary(res, "Accept");
+}
+
+// Weak comparison (RFC 9110 8.8.3.2) against each entry of an If-None-Match list.
+bool etag_matches(const std::string& ifNoneMatch, const std::string& etag) {
+    const auto opaque = [](std::string tag) {
+        const auto b = tag.find_first_not_of(" \t");
+        if (b == std::string::npos) return std::string();
+        const auto e = tag.find_last_not_of(" \t");
+        tag = tag.substr(b, e - b + 1);
+        if (tag.rfind("W/", 0) == 0) tag.erase(0, 2);
+        return tag;
+    };
+    const std::string wanted = opaque(etag);
+    size_t pos = 0;
+    while (pos <= ifNoneMatch.size()) {
+        const auto comma = ifNoneMatch.find(',', pos);
+        const auto candidate = opaque(ifNoneMatch.substr(pos, comma == std::string::npos ? std::string::npos : comma - pos));
+        if (candidate == "*" || (!candidate.empty() && candidate == wanted)) return true;
+        if (comma == std::string::npos) break;
+        pos = comma + 1;
+    }
+    return false;
+}
+
+void set_not_modified(httplib::Response& res, const std::string& etag) {
+    res.status = 304;
+    set_etag(res, etag);
+}
+
+// {"requests":N,"upstream":N,"coalesced":N,"ratio":coalesced/requests} for GET /stats.
+template <typename FlightStats>
+std::string flight_stats_json(const FlightStats& st) {
+    const double ratio = st.requests ? static_cast<double>(st.coalesced) / static_cast<double>(st.requests) : 0.0;
+    char ratioBuf[32];
+    std::snprintf(ratioBuf, sizeof(ratioBuf), "%.4f", ratio);
+    return "{\"requests\":" + std::to_string(st.requests) + ",\"upstream\":" + std::to_string(st.upstream) +
+           ",\"coalesced\":" + std::to_string(st.coalesced) + ",\"ratio\":" + ratioBuf + "}";
+}
+
 std::string get_bearer_token(const httplib::Request& req) {
     if (!req.has_header("Authorization")) {
         return {};
@@ -62,7 +271,19 @@ std::string get_bearer_token(const httplib::Request& req) {
     return value.substr(prefix.size());
 }
 
-bool validate_access_token(securecloud::auth::AuthService::Stub& authStub,
+// Token checks, cheapest first:
+//  1. validated-token cache (hash lookup),
+//  2. local JWT verification + in-memory revocation set (no I/O; survives brief auth outages),
+//  3. AuthService::ValidateToken.
+// Answers from 2 and 3 are cached.
+struct TokenValidation {
+    UpstreamPool<securecloud::auth::AuthService>& authStub;
+    TokenCache& cache;
+    const JwtVerifier& verifier;
+    const RevocationSet& revoked;
+};
+
+bool validate_access_token(const TokenValidation& auth,
                            const httplib::Request& req,
                            securecloud::auth::ValidateTokenResponse* out,
                            std::string* err) {
@@ -76,10 +297,37 @@ bool validate_access_token(securecloud::auth::AuthService::Stub& authStub,
         return false;
     }
 
+    TokenCache& tokenCache = auth.cache;
+    if (auto cached = tokenCache.get(token)) {
+        *out = std::move(*cached);
+        return true;
+    }
+    const auto generation = tokenCache.generation();
+
+    if (auth.verifier.enabled() && auth.revoked.usable()) {
+        JwtVerifier::Verified v;
+        switch (auth.verifier.verify(token, &v)) {
+        case JwtVerifier::Result::Ok:
+            if (auth.revoked.contains(v.jti)) {
+                if (err) *err = "Invalid token";
+                return false;
+            }
+            *out = std::move(v.claims);
+            tokenCache.put(token, *out, generation);
+            return true;
+        case JwtVerifier::Result::Invalid:
+            if (err) *err = "Invalid token";
+            return false;
+        case JwtVerifier::Result::Unverifiable:
+            break;
+        }
+    }
+
     securecloud::auth::ValidateTokenRequest vreq;
     vreq.set_access_token(token);
     grpc::ClientContext ctx;
-    auto st = authStub.ValidateToken(&ctx, vreq, out);
+    auth.authStub.setDeadline(ctx);
+    auto st = auth.authStub->ValidateToken(&ctx, vreq, out);
     if (!st.ok()) {
         if (err) *err = st.error_message();
         return false;
@@ -88,9 +336,109 @@ bool validate_access_token(securecloud::auth::AuthService::Stub& authStub,
         if (err) *err = "Invalid token";
         return false;
     }
+    tokenCache.put(token, *out, generation);
     return true;
 }
 
+// Who a request is charged to by the rate limiter, without any upstream call: the user of a cached
+// or locally verified token (cached, so the handler's own validation is a hit), else the client
+// address. An unverified token is never a key of its own: minting random tokens would otherwise
+// give a client a fresh bucket per request.
+std::string rate_limit_key(const TokenValidation& auth, const std::string& token, const std::string& remoteAddr) {
+    if (auto cached = auth.cache.get(token)) return "u:" + cached->user_id();
+    if (auth.verifier.enabled() && auth.revoked.usable()) {
+        const auto generation = auth.cache.generation();
+        JwtVerifier::Verified v;
+        if (auth.verifier.verify(token, &v) == JwtVerifier::Result::Ok && !auth.revoked.contains(v.jti)) {
+            auth.cache.put(token, v.claims, generation);
+            return "u:" + v.claims.user_id();
+        }
+    }
+    return "ip:" + remoteAddr;
+}
+
+// Token bucket families; the names are also the GATEWAY_RATE_<NAME> suffixes ("rate/burst").
+enum class RouteClass { Auth, Send, Read, Directory, Admin, Events, Files };
+struct RouteClassInfo {
+    const char* name;
+    TokenBucketLimiter::Limit defaults;
+};
+constexpr RouteClassInfo kRouteClasses[] = {
+    {"auth", {2.0, 10.0}},       // login/register/refresh/logout, per client address
+    {"send", {10.0, 30.0}},      // POST /conversations/:id/messages
+    {"read", {20.0, 60.0}},      // conversations, history, /sync
+    {"directory", {5.0, 20.0}},  // /me, /users, GET /rooms
+    {"admin", {2.0, 10.0}},      // room creation/export/deletion, user deletion
+    {"events", {0.5, 5.0}},      // /events (re)connections
+    {"files", {2.0, 10.0}},      // POST /files, GET /files/:id
+};
+
+enum class Upstream { None, Auth, Messaging };
+
+struct RouteLimits {
+    bool limited = false;
+    RouteClass cls = RouteClass::Read;
+    Upstream upstream = Upstream::None;
+};
+
+RouteLimits route_limits(const httplib::Request& req) {
+    const std::string& p = req.path;
+    const bool get = req.method == "GET";
+    if (p == "/health" || p == "/stats" || p == "/metrics") return {};
+    if (p == "/login" || p == "/register" || p == "/refresh" || p == "/logout") {
+        return {true, RouteClass::Auth, Upstream::Auth};
+    }
+    // Long-lived: counted on connection, never against an upstream concurrency limit.
+    if (p == "/events") return {true, RouteClass::Events, Upstream::None};
+    if (p == "/me" || p == "/users") return {true, RouteClass::Directory, Upstream::Auth};
+    if (p.rfind("/users/", 0) == 0) return {true, RouteClass::Admin, Upstream::Auth};
+    if (p == "/rooms") return {true, get ? RouteClass::Directory : RouteClass::Admin, Upstream::Messaging};
+    if (p.rfind("/rooms/", 0) == 0) return {true, RouteClass::Admin, Upstream::Messaging};
+    // Transfers last as long as the client takes: kept out of the latency-based limits.
+    if (p == "/files" || p.rfind("/files/", 0) == 0) return {true, RouteClass::Files, Upstream::None};
+    if (p.rfind("/conversations/", 0) == 0 && req.method == "POST") {
+        return {true, RouteClass::Send, Upstream::Messaging};
+    }
+    return {true, RouteClass::Read, Upstream::Messaging};
+}
+
+// gateway_http_request_duration_seconds{route} and gateway_http_responses_total{route,code} for one
+// route class; `code` is the status class (2xx ... 5xx) to keep the series count fixed.
+struct RouteMetrics {
+    metrics::Histogram* duration = nullptr;
+    std::array<metrics::Counter*, 5> responses{};
+
+    void record(std::chrono::steady_clock::duration elapsed, int status) const {
+        duration->observe(elapsed);
+        responses[static_cast<size_t>(std::clamp(status / 100, 1, 5) - 1)]->inc();
+    }
+};
+
+std::vector<RouteMetrics> route_metrics() {
+    std::vector<RouteMetrics> out;
+    for (const auto& c : kRouteClasses) {
+        RouteMetrics m;
+        m.duration = &metrics::registry().histogram("gateway_http_request_duration_seconds",
+                                                    "Time from admission to the end of the response, per route class",
+                                                    {{"route", c.name}});
+        for (int k = 0; k < 5; ++k) {
+            m.responses[static_cast<size_t>(k)] = &metrics::registry().counter(
+                "gateway_http_responses_total", "HTTP responses per route class and status class",
+                {{"route", c.name}, {"code", std::to_string(k + 1) + "xx"}});
+        }
+        out.push_back(m);
+    }
+    return out;
+}
+
+// Ends the span of an HTTP request; it stops being the thread's current span if it still is.
+void end_request_span(tracing::Span& span, int status) {
+    span.setAttribute("http.status_code", static_cast<long long>(status));
+    if (status >= 500) span.setError("HTTP " + std::to_string(status));
+    span.end();
+    if (tracing::current() == span.context()) tracing::setCurrent({});
+}
+
 bool try_parse_int64(const std::string& s, long long* out) {
     if (!out) return false;
     if (s.empty()) return false;
@@ -125,64 +473,355 @@ bool is_numeric_id(const std::string& s) {
     long long tmp = 0;
     return try_parse_int64(s, &tmp);
 }
+
+// Inverse of dm_conversation_key: the UI addresses a DM by the other participant's id.
+std::string client_conversation_id(const std::string& conversationKey, const std::string& selfUserId) {
+    const std::string prefix = "dm:";
+    if (conversationKey.rfind(prefix, 0) != 0) return conversationKey;
+    const auto rest = conversationKey.substr(prefix.size());
+    const auto pos = rest.find(':');
+    if (pos == std::string::npos) return conversationKey;
+    const auto a = rest.substr(0, pos);
+    const auto b = rest.substr(pos + 1);
+    if (a == selfUserId) return b;
+    if (b == selfUserId) return a;
+    return conversationKey;
+}
+
+// Whether userId may attach files to / read files of a conversation: a DM key names both
+// participants; rooms (and anything else) are checked by messaging_service as for the history.
+grpc::Status conversation_access(UpstreamPool<securecloud::messaging::MessagingService>& messagingStub,
+                                 const std::string& conversationKey, const std::string& userId) {
+    if (conversationKey.rfind("dm:", 0) == 0) {
+        if (client_conversation_id(conversationKey, userId) != conversationKey) return grpc::Status::OK;
+        return grpc::Status(grpc::StatusCode::PERMISSION_DENIED, "Not a participant of this conversation");
+    }
+    securecloud::messaging::DataVersionRequest dreq;
+    dreq.set_conversation_id(conversationKey);
+    dreq.set_requester_id(userId);
+    securecloud::messaging::DataVersionResponse dresp;
+    grpc::ClientContext ctx;
+    messagingStub.setDeadline(ctx);
+    return messagingStub->GetDataVersion(&ctx, dreq, &dresp);
+}
+
+// Mirrors GET /stats as Prometheus series; the callbacks run on each scrape of GET /metrics.
+void register_stats_metrics(const SingleFlight<securecloud::auth::ListUsersResponse>& listUsersFlight,
+                            const SingleFlight<securecloud::messaging::ListConversationsResponse>& listConversationsFlight,
+                            const HistoryFlight& historyFlight, const ResponseCompressor& compressor,
+                            const TokenBucketLimiter& rateLimiter,
+                            std::initializer_list<const AdaptiveConcurrencyLimit*> limits,
+                            std::initializer_list<std::pair<const char*, const UpstreamChannels*>> pools,
+                            const TokenCache& tokenCache, const ChatHub& chatHub) {
+    auto& r = metrics::registry();
+    const auto flight = [&r](const char* call, auto stats) {
+        r.counterCallback("gateway_coalescing_requests_total", "Upstream reads requested (SingleFlight)",
+                          {{"call", call}}, [stats] { return static_cast<double>(stats().requests); });
+        r.counterCallback("gateway_coalescing_upstream_calls_total", "Upstream reads actually issued (SingleFlight)",
+                          {{"call", call}}, [stats] { return static_cast<double>(stats().upstream); });
+    };
+    flight("ListUsers", [&listUsersFlight] { return listUsersFlight.stats(); });
+    flight("ListConversations", [&listConversationsFlight] { return listConversationsFlight.stats(); });
+    flight("GetHistory", [&historyFlight] { return historyFlight.stats(); });
+
+    const auto comp = [&r, &compressor](const char* name, const char* help, std::uint64_t ResponseCompressor::Stats::*field) {
+        r.counterCallback(name, help, {}, [&compressor, field] { return static_cast<double>(compressor.stats().*field); });
+    };
+    comp("gateway_compressed_responses_total", "Responses sent with a content coding", &ResponseCompressor::Stats::compressed);
+    comp("gateway_compression_cache_hits_total", "Compressed responses served from the cache", &ResponseCompressor::Stats::cacheHits);
+    comp("gateway_compression_in_bytes_total", "Fixed bodies before compression", &ResponseCompressor::Stats::bytesIn);
+    comp("gateway_compression_out_bytes_total", "Fixed bodies after compression", &ResponseCompressor::Stats::bytesOut);
+    r.gaugeCallback("gateway_compression_cache_bytes", "Size of the compressed-body cache", {},
+                    [&compressor] { return static_cast<double>(compressor.stats().cacheBytes); });
+
+    for (size_t i = 0; i < std::size(kRouteClasses); ++i) {
+        const auto classStat = [&rateLimiter, i](bool rejected) {
+            const auto st = rateLimiter.stats();
+            if (i >= st.size()) return 0.0;
+            return static_cast<double>(rejected ? st[i].rejected : st[i].allowed);
+        };
+        r.counterCallback("gateway_rate_limit_allowed_total", "Requests within their token bucket",
+                          {{"route", kRouteClasses[i].name}}, [classStat] { return classStat(false); });
+        r.counterCallback("gateway_rate_limit_rejected_total", "Requests answered 429 by the rate limiter",
+                          {{"route", kRouteClasses[i].name}}, [classStat] { return classStat(true); });
+    }
+
+    for (const auto* limit : limits) {
+        const metrics::Labels labels{{"upstream", limit->stats().name}};
+        r.gaugeCallback("gateway_upstream_concurrency_limit", "Current adaptive concurrency limit", labels,
+                        [limit] { return static_cast<double>(limit->stats().limit); });
+        r.gaugeCallback("gateway_upstream_admitted_inflight", "Admitted requests in progress per upstream", labels,
+                        [limit] { return static_cast<double>(limit->stats().inflight); });
+        r.counterCallback("gateway_upstream_shed_total", "Requests answered 503 by the concurrency limit", labels,
+                          [limit] { return static_cast<double>(limit->stats().rejected); });
+        r.counterCallback("gateway_upstream_limit_decreases_total", "Multiplicative decreases of the limit", labels,
+                          [limit] { return static_cast<double>(limit->stats().decreases); });
+    }
+
+    for (const auto& [name, pool] : pools) {
+        const metrics::Labels labels{{"upstream", name}};
+        r.gaugeCallback("gateway_upstream_calls_inflight", "gRPC calls in flight over the upstream's channels", labels,
+                        [pool = pool] {
+                            int n = 0;
+                            for (const auto& ch : pool->stats()) n += ch.inflight;
+                            return static_cast<double>(n);
+                        });
+        r.gaugeCallback("gateway_upstream_channels_ready", "Channels of the pool in the READY state", labels,
+                        [pool = pool] {
+                            int n = 0;
+                            for (const auto& ch : pool->stats()) n += ch.state == "ready";
+                            return static_cast<double>(n);
+                        });
+    }
+
+    r.counterCallback("gateway_token_cache_hits_total", "Validated-token cache hits", {},
+                      [&tokenCache] { return static_cast<double>(tokenCache.stats().hits); });
+    r.counterCallback("gateway_token_cache_misses_total", "Validated-token cache misses", {},
+                      [&tokenCache] { return static_cast<double>(tokenCache.stats().misses); });
+    r.gaugeCallback("gateway_events_streams", "Open GET /events streams", {},
+                    [&chatHub] { return static_cast<double>(chatHub.subscriberCount()); });
+}
+
+// Size of the UploadChunks a streamed upload is cut into.
+constexpr size_t kFileChunkBytes = 256 * 1024;
 }
 
 int main(int /*argc*/, char** /*argv*/) {
     const std::string http_listen_host = "0.0.0.0";
     const int http_port = 8080;
 
-    const char* envTarget = std::getenv("AUTH_GRPC_TARGET");
-    const std::string auth_target = (envTarget && *envTarget) ? std::string(envTarget) : std::string("localhost:50051");
-    auto authChannel = grpc::CreateChannel(auth_target, grpc::InsecureChannelCredentials());
-    auto authStub = securecloud::auth::AuthService::NewStub(authChannel);
+    // AUTH_GRPC_TARGET / MESSAGING_GRPC_TARGET may list several replicas; every call picks a
+    // channel of the pool and carries a deadline (see UpstreamPool.h).
+    UpstreamPool<securecloud::auth::AuthService> authStub(UpstreamOptions::fromEnv("AUTH", "localhost:50051"));
+
+    // Validated tokens are served locally until exp / revalidation TTL; revocations pushed by
+    // auth_service evict them immediately. With JWT_SECRET (HS256) or GATEWAY_JWT_PUBLIC_KEY_FILE
+    // (EdDSA/ES256) set, tokens are verified in-process against the pushed revocation set.
+    TokenCache tokenCache(TokenCache::optionsFromEnv());
+    const auto jwtVerifier = JwtVerifier::fromEnv();
+    long long revocationGraceSeconds = 60;
+    if (const char* g = std::getenv("GATEWAY_REVOCATION_GRACE_SECONDS"); g && *g) {
+        try_parse_int64(g, &revocationGraceSeconds);
+    }
+    RevocationSet revokedJtis(std::chrono::seconds(std::max(0LL, revocationGraceSeconds)));
+    RevocationWatcher revocationWatcher(authStub, tokenCache, revokedJtis);
+    revocationWatcher.start();
+    const TokenValidation tokenAuth{authStub, tokenCache, *jwtVerifier, revokedJtis};
+
+    UpstreamPool<securecloud::messaging::MessagingService> messagingStub(
+        UpstreamOptions::fromEnv("MESSAGING", "localhost:7002"));
+    UpstreamPool<securecloud::files::FileService> filesStub(UpstreamOptions::fromEnv("FILES", "localhost:50052"));
+
+    // Live delivery for GET /events: a single ChatStream to messaging_service, fanned out here.
+    const auto chatHubOptions = ChatHub::optionsFromEnv();
+    ChatHub chatHub(messagingStub, chatHubOptions);
+    chatHub.start();
+
+    // Identical concurrent upstream reads share one call (reconnect storms, many devices).
+    SingleFlight<securecloud::auth::ListUsersResponse> listUsersFlight;
+    SingleFlight<securecloud::messaging::ListConversationsResponse> listConversationsFlight;
+    HistoryFlight historyFlight;
+
+    // Routes are served by EpollHttpServer (default on Linux) or httplib::Server
+    // (GATEWAY_HTTP_ENGINE=httplib), see the end of main().
+    // Bodies are JSON unless the client sends Accept: application/x-protobuf, in which case the
+    // same gateway.proto message is returned in binary; POST bodies may be sent either way.
+    // Error bodies, /events and the room export stay JSON.
+    HttpRouter router;
+
+    // gzip/zstd per Accept-Encoding for every route; ETag'd bodies are kept compressed.
+    ResponseCompressor compressor(ResponseCompressor::optionsFromEnv());
+    router.setResponseFilter([&compressor](const httplib::Request& req, httplib::Response& res) {
+        compressor.apply(req, res);
+    });
 
-    const char* envMessaging = std::getenv("MESSAGING_GRPC_TARGET");
-    const std::string messaging_target = (envMessaging && *envMessaging) ? std::string(envMessaging) : std::string("localhost:7002");
-    auto messagingChannel = grpc::CreateChannel(messaging_target, grpc::InsecureChannelCredentials());
-    auto messagingStub = securecloud::messaging::MessagingService::NewStub(messagingChannel);
+    // Per-user token buckets (per route class), then an AIMD concurrency limit per upstream:
+    // over budget is a 429, an overloaded upstream a 503, both with Retry-After and no upstream call.
+    const auto shedding = LoadSheddingOptions::fromEnv();
+    TokenBucketLimiter rateLimiter;
+    for (const auto& c : kRouteClasses) rateLimiter.addClass(c.name, rate_limit_from_env(c.name, c.defaults));
+    AdaptiveConcurrencyLimit authLimit("auth_service", shedding.upstream);
+    AdaptiveConcurrencyLimit messagingLimit("messaging_service", shedding.upstream);
+    const auto routeMetrics = route_metrics();
+    router.setAdmission([&](const httplib::Request& req, httplib::Response& res, HttpRouter::Release* release) {
+        // An async handler's span may still be current on this worker thread.
+        tracing::setCurrent({});
+        const auto limits = route_limits(req);
+        if (!limits.limited) return true;
+        const auto start = std::chrono::steady_clock::now();
+        const RouteMetrics& rm = routeMetrics[static_cast<size_t>(limits.cls)];
+
+        // The request's span (child of the client's traceparent, if any) is current while the
+        // handler runs on this thread: the upstream calls it issues join the trace.
+        auto span = std::make_shared<tracing::Span>(req.method + " " + req.path, tracing::Kind::Server,
+                                                    tracing::SpanContext::parse(req.get_header_value("traceparent")));
+        if (span->context().valid()) {
+            span->setAttribute("http.route_class", kRouteClasses[static_cast<size_t>(limits.cls)].name);
+            tracing::setCurrent(span->context());
+            if (span->recording()) res.set_header("X-Trace-Id", span->context().traceIdHex());
+        }
 
-    httplib::Server server;
+        if (shedding.rateLimits) {
+            const auto token = get_bearer_token(req);
+            const std::string key = limits.cls == RouteClass::Auth || token.empty()
+                                        ? "ip:" + req.remote_addr
+                                        : rate_limit_key(tokenAuth, token, req.remote_addr);
+            const auto decision = rateLimiter.acquire(static_cast<int>(limits.cls), key);
+            if (!decision.allowed) {
+                set_json(res, 429, json_error("Rate limit exceeded"));
+                res.set_header("Retry-After", std::to_string(decision.retryAfter.count()));
+                rm.record(std::chrono::steady_clock::now() - start, res.status);
+                end_request_span(*span, res.status);
+                return false;
+            }
+        }
 
-    server.Get("/health", [](const httplib::Request&, httplib::Response& res) {
+        AdaptiveConcurrencyLimit* upstream = limits.upstream == Upstream::Auth        ? &authLimit
+                                             : limits.upstream == Upstream::Messaging ? &messagingLimit
+                                                                                      : nullptr;
+        if (!shedding.adaptiveConcurrency) upstream = nullptr;
+        if (upstream && !upstream->tryAcquire()) {
+            set_json(res, 503, json_error("Upstream overloaded, retry later"));
+            res.set_header("Retry-After", "1");
+            rm.record(std::chrono::steady_clock::now() - start, res.status);
+            end_request_span(*span, res.status);
+            return false;
+        }
+        *release = [&rm, upstream, start, span](const httplib::Response& r) {
+            const auto elapsed = std::chrono::steady_clock::now() - start;
+            if (upstream) upstream->release(elapsed, r.status >= 502 && r.status <= 504);
+            rm.record(elapsed, r.status);
+            end_request_span(*span, r.status);
+        };
+        return true;
+    });
+
+    router.Get("/health", [](const httplib::Request&, httplib::Response& res) {
         set_json(res, 200, "{\"ok\":true}");
     });
 
+    // GET /stats: process counters (JSON), e.g. how many upstream reads were coalesced.
+    router.Get("/stats", [&](const httplib::Request&, httplib::Response& res) {
+        std::string body = "{\"coalescing\":{";
+        body += "\"ListUsers\":" + flight_stats_json(listUsersFlight.stats());
+        body += ",\"ListConversations\":" + flight_stats_json(listConversationsFlight.stats());
+        body += ",\"GetHistory\":" + flight_stats_json(historyFlight.stats());
+        const auto cs = compressor.stats();
+        body += "},\"compression\":{\"responses\":" + std::to_string(cs.compressed) +
+                ",\"cacheHits\":" + std::to_string(cs.cacheHits) + ",\"bytesIn\":" + std::to_string(cs.bytesIn) +
+                ",\"bytesOut\":" + std::to_string(cs.bytesOut) + ",\"cacheBytes\":" + std::to_string(cs.cacheBytes) + "}";
+        body += ",\"limits\":{\"rate\":{";
+        bool first = true;
+        for (const auto& c : rateLimiter.stats()) {
+            body += (first ? "\"" : ",\"") + c.name + "\":{\"allowed\":" + std::to_string(c.allowed) +
+                    ",\"rejected\":" + std::to_string(c.rejected) + "}";
+            first = false;
+        }
+        body += "},\"upstreams\":{";
+        first = true;
+        for (const auto* limit : {&authLimit, &messagingLimit}) {
+            const auto st = limit->stats();
+            body += (first ? "\"" : ",\"") + st.name + "\":{\"limit\":" + std::to_string(st.limit) +
+                    ",\"inflight\":" + std::to_string(st.inflight) + ",\"admitted\":" + std::to_string(st.admitted) +
+                    ",\"rejected\":" + std::to_string(st.rejected) + ",\"decreases\":" + std::to_string(st.decreases) + "}";
+            first = false;
+        }
+        body += "}},\"channels\":{";
+        const std::pair<const char*, const UpstreamChannels*> pools[] = {{"auth_service", &authStub},
+                                                                         {"messaging_service", &messagingStub}};
+        first = true;
+        for (const auto& [name, pool] : pools) {
+            body += std::string(first ? "\"" : ",\"") + name + "\":[";
+            bool firstChannel = true;
+            for (const auto& ch : pool->stats()) {
+                body += firstChannel ? "{\"target\":" : ",{\"target\":";
+                append_json_string(body, ch.target);
+                body += ",\"state\":\"" + ch.state + "\",\"inflight\":" + std::to_string(ch.inflight) + "}";
+                firstChannel = false;
+            }
+            body += "]";
+            first = false;
+        }
+        body += "}}";
+        set_json(res, 200, body);
+    });
+
+    // GET /metrics: Prometheus text format. The /stats counters are read at scrape time.
+    register_stats_metrics(listUsersFlight, listConversationsFlight, historyFlight, compressor, rateLimiter,
+                           {&authLimit, &messagingLimit},
+                           {{"auth_service", &authStub}, {"messaging_service", &messagingStub}, {"file_service", &filesStub}},
+                           tokenCache, chatHub);
+    router.Get("/metrics", [](const httplib::Request&, httplib::Response& res) {
+        res.set_content(metrics::registry().render(), metrics::kContentType);
+    });
+
     // GET /me (Authorization: Bearer <access_token>)
-    server.Get("/me", [&](const httplib::Request& req, httplib::Response& res) {
+    router.Get("/me", [&](const httplib::Request& req, httplib::Response& res) {
         securecloud::auth::ValidateTokenResponse vresp;
         std::string err;
-        if (!validate_access_token(*authStub, req, &vresp, &err)) {
+        if (!validate_access_token(tokenAuth, req, &vresp, &err)) {
             set_json(res, 401, json_error(err));
             return;
         }
 
-        set_proto_json(res, 200, vresp);
+        set_proto_body(res, response_format(req), 200, vresp);
     });
 
     // GET /users (Authorization: Bearer <access_token>)
-    // Returns JSON (ListUsersHttpResponse)
-    server.Get("/users", [&](const httplib::Request& req, httplib::Response& res) {
+    // Returns ListUsersHttpResponse. ETag / If-None-Match: 304 while the directory is unchanged.
+    router.Get("/users", [&](const httplib::Request& req, httplib::Response& res) {
         securecloud::auth::ValidateTokenResponse vresp;
         std::string err;
-        if (!validate_access_token(*authStub, req, &vresp, &err)) {
+        if (!validate_access_token(tokenAuth, req, &vresp, &err)) {
             set_json(res, 401, json_error(err));
             return;
         }
 
-        securecloud::auth::ListUsersRequest lreq;
-        lreq.set_access_token(get_bearer_token(req));
-        lreq.set_include_self(false);
-        securecloud::auth::ListUsersResponse lresp;
-        grpc::ClientContext ctx;
-        auto st = authStub->ListUsers(&ctx, lreq, &lresp);
+        // The version is read before the list: a change in between only costs one extra refetch.
+        // Without it (older auth_service), the list is served without a validator.
+        std::string etag;
+        std::string directoryVersion = "?";
+        {
+            securecloud::auth::DirectoryVersionRequest dreq;
+            dreq.set_access_token(get_bearer_token(req));
+            securecloud::auth::DirectoryVersionResponse dresp;
+            grpc::ClientContext dctx;
+            authStub.setDeadline(dctx);
+            if (authStub->GetDirectoryVersion(&dctx, dreq, &dresp).ok()) {
+                directoryVersion = std::to_string(dresp.version());
+                // The caller is left out of the list: it differs per user.
+                etag = weak_etag("u" + directoryVersion + "-" + vresp.user_id(), response_format(req));
+                if (etag_matches(req.get_header_value("If-None-Match"), etag)) {
+                    set_not_modified(res, etag);
+                    return;
+                }
+            }
+        }
+
+        // Any valid token sees the same directory: one full listing (include_self) serves every
+        // concurrent caller, each filtering itself out. The version in the key keeps a caller
+        // from receiving a listing read before the version its ETag names.
+        SingleFlight<securecloud::auth::ListUsersResponse>::Result lresp;
+        auto st = listUsersFlight.runSync(
+            "dir:" + directoryVersion,
+            [&](securecloud::auth::ListUsersResponse* out) {
+                securecloud::auth::ListUsersRequest lreq;
+                lreq.set_access_token(get_bearer_token(req));
+                lreq.set_include_self(true);
+                grpc::ClientContext ctx;
+                authStub.setDeadline(ctx);
+                return authStub->ListUsers(&ctx, lreq, out);
+            },
+            &lresp);
         if (!st.ok()) {
             set_json(res, 502, json_error(st.error_message()));
             return;
         }
 
         securecloud::gateway::ListUsersHttpResponse out;
-        out.mutable_users()->Reserve(lresp.users_size());
-        for (const auto& u : lresp.users()) {
+        out.mutable_users()->Reserve(lresp->users_size());
+        for (const auto& u : lresp->users()) {
+            if (u.user_id() == vresp.user_id()) continue;
             auto* hu = out.add_users();
             hu->set_user_id(u.user_id());
             hu->set_full_name(u.full_name());
@@ -190,14 +829,14 @@ int main(int /*argc*/, char** /*argv*/) {
             hu->set_role(u.role());
         }
 
-        set_proto_json(res, 200, out);
+        if (set_proto_body(res, response_format(req), 200, out) && !etag.empty()) set_etag(res, etag);
     });
 
     // DELETE /users/:id (admin only)
-    server.Delete(R"(/users/(\d+))", [&](const httplib::Request& req, httplib::Response& res) {
+    router.Delete(R"(/users/(\d+))", [&](const httplib::Request& req, httplib::Response& res) {
         securecloud::auth::ValidateTokenResponse vresp;
         std::string err;
-        if (!validate_access_token(*authStub, req, &vresp, &err)) {
+        if (!validate_access_token(tokenAuth, req, &vresp, &err)) {
             set_json(res, 401, json_error(err));
             return;
         }
@@ -218,6 +857,7 @@ int main(int /*argc*/, char** /*argv*/) {
 
         grpc::ClientContext ctx;
         securecloud::auth::DeleteUserResponse dresp;
+        authStub.setDeadline(ctx);
         auto st = authStub->DeleteUser(&ctx, dreq, &dresp);
         if (!st.ok()) {
             int status = 502;
@@ -233,30 +873,29 @@ int main(int /*argc*/, char** /*argv*/) {
             return;
         }
 
-        set_proto_json(res, 200, dresp);
+        chatHub.closeUser(userId);
+        set_proto_body(res, response_format(req), 200, dresp);
     });
 
     // POST /login
     // Body JSON: {"username":"...","password":"..."}
     // Response JSON: auth_service LoginResponse (tokens, expires)
-    server.Post("/login", [&](const httplib::Request& req, httplib::Response& res) {
+    router.Post("/login", [&](const httplib::Request& req, httplib::Response& res) {
         if (req.body.empty()) {
             set_json(res, 400, json_error("Empty request body"));
             return;
         }
 
         securecloud::auth::LoginRequest authReq;
-        JsonParseOptions parseOpts;
-        parseOpts.ignore_unknown_fields = true;
-
-        auto parseStatus = JsonStringToMessage(req.body, &authReq, parseOpts);
-        if (!parseStatus.ok()) {
-            set_json(res, 400, json_error("Invalid JSON payload"));
+        std::string parseErr;
+        if (!parse_proto_body(req, &authReq, &parseErr)) {
+            set_json(res, 400, json_error(parseErr));
             return;
         }
 
         grpc::ClientContext authCtx;
         securecloud::auth::LoginResponse authResp;
+        authStub.setDeadline(authCtx);
         auto callStatus = authStub->Login(&authCtx, authReq, &authResp);
 
         if (!callStatus.ok()) {
@@ -277,29 +916,28 @@ int main(int /*argc*/, char** /*argv*/) {
             return;
         }
 
-        set_proto_json(res, 200, authResp);
+        set_proto_body(res, response_format(req), 200, authResp);
     });
 
     // POST /refresh
     // Body JSON: {"refreshToken":"..."}
     // Response JSON: auth_service RefreshTokenResponse
-    server.Post("/refresh", [&](const httplib::Request& req, httplib::Response& res) {
+    router.Post("/refresh", [&](const httplib::Request& req, httplib::Response& res) {
         if (req.body.empty()) {
             set_json(res, 400, json_error("Empty request body"));
             return;
         }
 
         securecloud::auth::RefreshTokenRequest rreq;
-        JsonParseOptions parseOpts;
-        parseOpts.ignore_unknown_fields = true;
-        auto parseStatus = JsonStringToMessage(req.body, &rreq, parseOpts);
-        if (!parseStatus.ok()) {
-            set_json(res, 400, json_error("Invalid JSON payload"));
+        std::string parseErr;
+        if (!parse_proto_body(req, &rreq, &parseErr)) {
+            set_json(res, 400, json_error(parseErr));
             return;
         }
 
         grpc::ClientContext ctx;
         securecloud::auth::RefreshTokenResponse rresp;
+        authStub.setDeadline(ctx);
         auto st = authStub->RefreshToken(&ctx, rreq, &rresp);
         if (!st.ok()) {
             const int status = (st.error_code() == grpc::StatusCode::UNAUTHENTICATED) ? 401 : 502;
@@ -311,16 +949,16 @@ int main(int /*argc*/, char** /*argv*/) {
             return;
         }
 
-        set_proto_json(res, 200, rresp);
+        set_proto_body(res, response_format(req), 200, rresp);
     });
 
     // POST /logout
     // Authorization: Bearer <access_token>
     // Revokes tokens for current user.
-    server.Post("/logout", [&](const httplib::Request& req, httplib::Response& res) {
+    router.Post("/logout", [&](const httplib::Request& req, httplib::Response& res) {
         securecloud::auth::ValidateTokenResponse vresp;
         std::string err;
-        if (!validate_access_token(*authStub, req, &vresp, &err)) {
+        if (!validate_access_token(tokenAuth, req, &vresp, &err)) {
             set_json(res, 401, json_error(err));
             return;
         }
@@ -336,6 +974,7 @@ int main(int /*argc*/, char** /*argv*/) {
         }
 
         securecloud::auth::RevokeTokensResponse rresp;
+        authStub.setDeadline(ctx);
         auto st = authStub->RevokeTokens(&ctx, rreq, &rresp);
         if (!st.ok()) {
             const int status = (st.error_code() == grpc::StatusCode::PERMISSION_DENIED) ? 403 : 502;
@@ -352,10 +991,10 @@ int main(int /*argc*/, char** /*argv*/) {
 
     // POST /register (admin only)
     // Body JSON: {"fullName":"...", "email":"...", "password":"...", "roleName":"user"}
-    server.Post("/register", [&](const httplib::Request& req, httplib::Response& res) {
+    router.Post("/register", [&](const httplib::Request& req, httplib::Response& res) {
         securecloud::auth::ValidateTokenResponse vresp;
         std::string err;
-        if (!validate_access_token(*authStub, req, &vresp, &err)) {
+        if (!validate_access_token(tokenAuth, req, &vresp, &err)) {
             set_json(res, 401, json_error(err));
             return;
         }
@@ -365,11 +1004,9 @@ int main(int /*argc*/, char** /*argv*/) {
         }
 
         securecloud::gateway::RegisterHttpRequest in;
-        JsonParseOptions parseOpts;
-        parseOpts.ignore_unknown_fields = true;
-        auto parseStatus = JsonStringToMessage(req.body, &in, parseOpts);
-        if (!parseStatus.ok()) {
-            set_json(res, 400, json_error("Invalid JSON payload"));
+        std::string parseErr;
+        if (!parse_proto_body(req, &in, &parseErr)) {
+            set_json(res, 400, json_error(parseErr));
             return;
         }
 
@@ -384,6 +1021,7 @@ int main(int /*argc*/, char** /*argv*/) {
 
         securecloud::auth::RegisterResponse rresp;
         grpc::ClientContext ctx;
+        authStub.setDeadline(ctx);
         auto st = authStub->RegisterUser(&ctx, rreq, &rresp);
         if (!st.ok()) {
             const int status = (st.error_code() == grpc::StatusCode::PERMISSION_DENIED) ? 403 : 502;
@@ -391,17 +1029,17 @@ int main(int /*argc*/, char** /*argv*/) {
             return;
         }
 
-        set_proto_json(res, 200, rresp);
+        set_proto_body(res, response_format(req), 200, rresp);
     });
 
     // GET /conversations
-    // Returns JSON (ListConversationsResponse)
-    server.Get("/conversations", [&](const httplib::Request& req, httplib::Response& res) {
+    // Returns ListConversationsResponse
+    router.Get("/conversations", [&](const httplib::Request& req, httplib::Response& res) {
         // optional auth: if present, validate; otherwise allow (dev-friendly)
         if (req.has_header("Authorization")) {
             securecloud::auth::ValidateTokenResponse vresp;
             std::string err;
-            if (!validate_access_token(*authStub, req, &vresp, &err)) {
+            if (!validate_access_token(tokenAuth, req, &vresp, &err)) {
                 res.status = 401;
                 res.set_content(json_error(err), "application/json");
                 return;
@@ -412,6 +1050,7 @@ int main(int /*argc*/, char** /*argv*/) {
         hreq.set_limit(200);
         securecloud::messaging::HistoryResponse hresp;
         grpc::ClientContext ctx;
+        messagingStub.setDeadline(ctx);
         auto st = messagingStub->GetHistory(&ctx, hreq, &hresp);
         if (!st.ok()) {
             res.status = 502;
@@ -441,26 +1080,18 @@ int main(int /*argc*/, char** /*argv*/) {
             c->set_last_timestamp_unix(msg.timestamp_unix());
         }
 
-        std::string json;
-        JsonPrintOptions printOpts;
-        printOpts.add_whitespace = false;
-        auto pst = MessageToJsonString(out, &json, printOpts);
-        if (!pst.ok()) {
-            res.status = 500;
-            res.set_content(json_error("Failed to serialize response"), "application/json");
-            return;
-        }
-
-        res.status = 200;
-        res.set_content(json, "application/json");
+        set_proto_body(res, response_format(req), 200, out);
     });
 
-    // GET /conversations/:id/messages?limit=50
-    server.Get(R"(/conversations/([^/]+)/messages)", [&](const httplib::Request& req, httplib::Response& res) {
+    // GET /conversations/:id/messages?limit=50[&before=db_<id>]
+    // Async: the worker returns as soon as the first upstream call is issued; the page is built in
+    // the callbacks. ETag / If-None-Match: 304 while the conversation has no newer message.
+    router.GetAsync(R"(/conversations/([^/]+)/messages)", [&](const httplib::Request& req, httplib::Response& res, HttpRouter::Done done) {
         const auto conversationId = req.matches.size() >= 2 ? req.matches[1].str() : std::string();
         if (conversationId.empty()) {
             res.status = 400;
             res.set_content(json_error("Missing conversation id"), "application/json");
+            done();
             return;
         }
 
@@ -472,9 +1103,10 @@ int main(int /*argc*/, char** /*argv*/) {
         // optional auth
         if (req.has_header("Authorization")) {
             std::string err;
-            if (!validate_access_token(*authStub, req, &vresp, &err)) {
+            if (!validate_access_token(tokenAuth, req, &vresp, &err)) {
                 res.status = 401;
                 res.set_content(json_error(err), "application/json");
+                done();
                 return;
             }
 
@@ -496,140 +1128,432 @@ int main(int /*argc*/, char** /*argv*/) {
             }
         }
 
-        securecloud::messaging::HistoryRequest hreq;
-        hreq.set_conversation_id(conversationKey);
-        hreq.set_limit(limit);
-        if (hasValidatedAuth) {
-            // Provide requester_id for room membership checks.
-            hreq.set_requester_id(vresp.user_id());
-        }
-        securecloud::messaging::HistoryResponse hresp;
-        grpc::ClientContext ctx;
-
-        auto st = messagingStub->GetHistory(&ctx, hreq, &hresp);
-        if (!st.ok()) {
-            res.status = 502;
-            res.set_content(json_error(st.error_message()), "application/json");
-            return;
-        }
-
-        securecloud::gateway::ListMessagesResponse out;
-
-        // hresp is newest-first; return oldest-first
-        for (int i = hresp.messages_size() - 1; i >= 0; --i) {
-            const auto& m = hresp.messages(i);
-            auto* hm = out.add_messages();
-            hm->set_message_id(m.message_id());
-            hm->set_conversation_id(conversationId);
-            hm->set_sender_id(m.sender_id());
-            hm->set_content(std::string(m.ciphertext().begin(), m.ciphertext().end()));
-            hm->set_timestamp_unix(m.timestamp_unix());
-        }
-
-        std::string json;
-        JsonPrintOptions printOpts;
-        printOpts.add_whitespace = false;
-        auto pst = MessageToJsonString(out, &json, printOpts);
-        if (!pst.ok()) {
-            res.status = 500;
-            res.set_content(json_error("Failed to serialize response"), "application/json");
+        // Pagination cursor: messageId (db_<id>) of the oldest message already shown; the page
+        // holds the messages before it.
+        const std::string before = req.has_param("before") ? req.get_param_value("before") : std::string();
+        if (!before.empty() && (before.rfind("db_", 0) != 0 || !is_numeric_id(before.substr(3)))) {
+            res.status = 400;
+            res.set_content(json_error("Invalid before cursor"), "application/json");
+            done();
             return;
         }
 
-        res.status = 200;
-        res.set_content(json, "application/json");
+        httplib::Response* out = &res;
+        const BodyFormat format = response_format(req);
+        auto* stub = &messagingStub;
+        auto* flight = &historyFlight;
+        const std::string requesterId = hasValidatedAuth ? vresp.user_id() : std::string();
+        const auto fetchHistory = [stub, flight, out, done, format, conversationId, conversationKey, limit, before,
+                                   requesterId](const std::string& etag, const std::string& scope) {
+            flight->run(history_flight_key(conversationKey, limit, before, scope),
+                        history_issue(stub, conversationKey, limit, before, requesterId),
+                        [out, done, format, conversationId, etag](const grpc::Status& st,
+                                                                  const HistoryFlight::Result& fetch) {
+                const AllocStats::Scope completeScope;
+                if (!st.ok()) {
+                    out->status = 502;
+                    out->set_content(json_error(st.error_message()), "application/json");
+                    done();
+                    return;
+                }
+
+                // The page is written straight from the upstream response (possibly shared with
+                // coalesced requests), oldest-first: hresp is newest-first.
+                const auto& messages = fetch->hresp->messages();
+                size_t estimate = 16;
+                for (const auto& m : messages) estimate += m.ciphertext().size() + 160;
+
+                const auto setHeaders = [&] {
+                    const auto completeAllocs = completeScope.delta();
+                    set_alloc_headers(*out,
+                                      AllocStats::Snapshot{fetch->issueAllocs.allocations + completeAllocs.allocations,
+                                                           fetch->issueAllocs.bytes + completeAllocs.bytes},
+                                      fetch->ctx);
+                    if (!etag.empty()) set_etag(*out, etag);
+                    add_vary(*out, "Accept");
+                    out->status = 200;
+                };
+
+                if (estimate <= kHistoryStreamAboveBytes) {
+                    std::string body;
+                    body.reserve(estimate);
+                    MessagesPageStream page(body, format);
+                    for (int i = messages.size() - 1; i >= 0; --i) page.add(messages.Get(i), conversationId);
+                    page.finish();
+                    setHeaders();
+                    out->set_content(std::move(body), content_type(format));
+                    done();
+                    return;
+                }
+
+                // Large page: chunked, a batch of messages per chunk through one reused buffer.
+                struct PageStream {
+                    PageStream(BodyFormat format) : page(buffer, format) {}
+                    HistoryFlight::Result fetch;
+                    std::string conversationId;
+                    std::string buffer;
+                    MessagesPageStream page;
+                    int next = 0;
+                };
+                auto stream = std::make_shared<PageStream>(format);
+                stream->fetch = fetch;
+                stream->conversationId = conversationId;
+                stream->next = messages.size() - 1;
+                stream->buffer.reserve(kHistoryChunkBytes + 4096);
+                setHeaders();
+                out->set_chunked_content_provider(
+                    content_type(format),
+                    [stream](size_t /*offset*/, httplib::DataSink& sink) {
+                        const auto& all = stream->fetch->hresp->messages();
+                        stream->buffer.clear();
+                        while (stream->next >= 0 && stream->buffer.size() < kHistoryChunkBytes) {
+                            stream->page.add(all.Get(stream->next--), stream->conversationId);
+                        }
+                        if (stream->next < 0) stream->page.finish();
+                        if (!sink.write(stream->buffer.data(), stream->buffer.size())) return false;
+                        if (stream->next < 0) sink.done();
+                        return true;
+                    });
+                done();
+            });
+        };
+
+        // Validator first: a page whose conversation has no newer message (and no retired month)
+        // is answered 304 without reading the history. A successful lookup has also checked room
+        // membership, so identical pages at that version are coalesced across requesters. A
+        // failed lookup skips the ETag; GetHistory then applies the access checks itself, and
+        // only identical requests from the same requester are coalesced.
+        struct VersionCall {
+            grpc::ClientContext ctx;
+            securecloud::messaging::DataVersionRequest req;
+            securecloud::messaging::DataVersionResponse resp;
+        };
+        auto version = std::make_shared<VersionCall>();
+        version->req.set_conversation_id(conversationKey);
+        if (hasValidatedAuth) version->req.set_requester_id(vresp.user_id());
+        const std::string ifNoneMatch = req.get_header_value("If-None-Match");
+        // The GetHistory is issued from the callback, on a gRPC thread: it joins the request's
+        // trace through the captured context.
+        const auto trace = tracing::current();
+        stub->setDeadline(version->ctx);
+        stub->pick().async()->GetDataVersion(&version->ctx, &version->req, &version->resp,
+            [version, out, done, format, fetchHistory, ifNoneMatch, requesterId, trace](grpc::Status st) {
+                const tracing::ScopedContext traced(trace);
+                if (!st.ok()) {
+                    fetchHistory(std::string(), "u" + requesterId);
+                    return;
+                }
+                const auto versionTag = std::to_string(version->resp.history_version()) + "-" +
+                                        std::to_string(version->resp.retention_version());
+                const auto etag = weak_etag("h" + versionTag, format);
+                if (etag_matches(ifNoneMatch, etag)) {
+                    set_not_modified(*out, etag);
+                    done();
+                    return;
+                }
+                fetchHistory(etag, "v" + versionTag);
+            });
     });
 
     // POST /conversations/:id/messages
     // Body JSON: {"content":"..."}
-    server.Post(R"(/conversations/([^/]+)/messages)", [&](const httplib::Request& req, httplib::Response& res) {
+    // Async, like the history GET.
+    router.PostAsync(R"(/conversations/([^/]+)/messages)", [&](const httplib::Request& req, httplib::Response& res, HttpRouter::Done done) {
         const auto conversationId = req.matches.size() >= 2 ? req.matches[1].str() : std::string();
         if (conversationId.empty()) {
             res.status = 400;
             res.set_content(json_error("Missing conversation id"), "application/json");
+            done();
             return;
         }
         if (req.body.empty()) {
             res.status = 400;
             res.set_content(json_error("Empty request body"), "application/json");
+            done();
             return;
         }
 
         securecloud::auth::ValidateTokenResponse vresp;
         std::string err;
-        if (!validate_access_token(*authStub, req, &vresp, &err)) {
+        if (!validate_access_token(tokenAuth, req, &vresp, &err)) {
             res.status = 401;
             res.set_content(json_error(err), "application/json");
+            done();
             return;
         }
 
         securecloud::gateway::SendMessageHttpRequest in;
-        JsonParseOptions parseOpts;
-        parseOpts.ignore_unknown_fields = true;
-        auto parseStatus = JsonStringToMessage(req.body, &in, parseOpts);
-        if (!parseStatus.ok()) {
+        std::string parseErr;
+        if (!parse_proto_body(req, &in, &parseErr)) {
             res.status = 400;
-            res.set_content(json_error("Invalid JSON payload"), "application/json");
+            res.set_content(json_error(parseErr), "application/json");
+            done();
             return;
         }
         if (in.content().empty()) {
             res.status = 400;
             res.set_content(json_error("Missing content"), "application/json");
+            done();
             return;
         }
 
-        securecloud::messaging::EncryptedMessage msg;
+        struct SendCall {
+            grpc::ClientContext ctx;
+            securecloud::messaging::EncryptedMessage msg;
+            securecloud::messaging::SendAck ack;
+        };
+        auto call = std::make_shared<SendCall>();
         if (!is_room_id(conversationId) && is_numeric_id(conversationId)) {
-            msg.set_conversation_id(dm_conversation_key(vresp.user_id(), conversationId));
+            call->msg.set_conversation_id(dm_conversation_key(vresp.user_id(), conversationId));
         } else {
-            msg.set_conversation_id(conversationId);
+            call->msg.set_conversation_id(conversationId);
         }
-        msg.set_sender_id(vresp.user_id());
-        msg.set_ciphertext(in.content());
-        msg.set_timestamp_unix(std::time(nullptr));
+        call->msg.set_sender_id(vresp.user_id());
+        call->msg.set_ciphertext(std::move(*in.mutable_content()));
+        call->msg.set_timestamp_unix(std::time(nullptr));
+
+        httplib::Response* out = &res;
+        const BodyFormat format = response_format(req);
+        messagingStub.setDeadline(call->ctx);
+        messagingStub->async()->SendMessage(&call->ctx, &call->msg, &call->ack, [call, out, done, format](grpc::Status st) {
+            if (!st.ok()) {
+                out->status = 502;
+                out->set_content(json_error(st.error_message()), "application/json");
+                done();
+                return;
+            }
+
+            securecloud::gateway::SendMessageHttpResponse resp;
+            resp.set_message_id(call->ack.message_id());
+            resp.set_accepted(call->ack.accepted());
+            set_proto_body(*out, format, 200, resp);
+            done();
+        });
+    });
+
+    // GET /sync?deviceId=<id>[&limit=N] (Authorization: Bearer <token>)
+    // Store-and-forward: the messages this device has not acked yet, across all conversations,
+    // in delivery order (SyncHttpResponse), at most `limit` (default 200) per page so a long
+    // backlog never has to fit in one deadline. Replaces per-room history polling on login.
+    // Reading does not move the device cursor: the same page is returned until POST /sync/ack
+    // with its cursor; the client then asks again while hasMore is set.
+    router.Get("/sync", [&](const httplib::Request& req, httplib::Response& res) {
+        securecloud::auth::ValidateTokenResponse vresp;
+        std::string err;
+        if (!validate_access_token(tokenAuth, req, &vresp, &err)) {
+            set_json(res, 401, json_error(err));
+            return;
+        }
+
+        const std::string deviceId = req.has_param("deviceId") ? req.get_param_value("deviceId") : std::string();
+        if (deviceId.empty()) {
+            set_json(res, 400, json_error("Missing deviceId"));
+            return;
+        }
+
+        int limit = 200;
+        if (req.has_param("limit")) {
+            try {
+                limit = std::max(1, std::min(1000, std::stoi(req.get_param_value("limit"))));
+            } catch (...) {
+                // ignore
+            }
+        }
+
+        const AllocStats::Scope allocScope;
+
+        // One message past the page tells whether another page follows.
+        securecloud::messaging::DrainPendingRequest dreq;
+        dreq.set_user_id(vresp.user_id());
+        dreq.set_device_id(deviceId);
+        dreq.set_limit(limit + 1);
 
-        securecloud::messaging::SendAck ack;
         grpc::ClientContext ctx;
-        auto st = messagingStub->SendMessage(&ctx, msg, &ack);
+        messagingStub.setDeadline(ctx);
+        auto reader = messagingStub->DrainPending(&ctx, dreq);
+
+        // Each streamed message is rendered as it arrives; the read buffer is reused (its string
+        // capacity is kept across Read()s).
+        const BodyFormat format = response_format(req);
+        std::string body;
+        MessagesPageStream page(body, format);
+        securecloud::messaging::EncryptedMessage m;
+        int count = 0;
+        bool hasMore = false;
+        std::string cursor;
+        while (reader->Read(&m)) {
+            if (count == limit) {
+                hasMore = true;
+                continue;
+            }
+            page.add(m, client_conversation_id(m.conversation_id(), vresp.user_id()));
+            cursor = m.delivery_cursor();
+            ++count;
+        }
+        auto st = reader->Finish();
         if (!st.ok()) {
-            res.status = 502;
-            res.set_content(json_error(st.error_message()), "application/json");
+            std::string msg = st.error_message();
+            if (msg.empty()) {
+                msg = "gRPC DrainPending failed (code=" + std::to_string(static_cast<int>(st.error_code())) + ")";
+            }
+            set_json(res, st.error_code() == grpc::StatusCode::INVALID_ARGUMENT ? 400 : 502, json_error(msg));
             return;
         }
+        page.finish(hasMore, cursor);
 
-        securecloud::gateway::SendMessageHttpResponse out;
-        out.set_message_id(ack.message_id());
-        out.set_accepted(ack.accepted());
+        set_alloc_headers(res, allocScope.delta(), ctx);
+        res.status = 200;
+        add_vary(res, "Accept");
+        res.set_content(std::move(body), content_type(format));
+    });
 
-        std::string json;
-        JsonPrintOptions printOpts;
-        printOpts.add_whitespace = false;
-        auto pst = MessageToJsonString(out, &json, printOpts);
-        if (!pst.ok()) {
-            res.status = 500;
-            res.set_content(json_error("Failed to serialize response"), "application/json");
+    // POST /sync/ack (Authorization: Bearer <token>)
+    // Body JSON: {"deviceId":"...", "cursor":"<cursor of a /sync page>"}
+    // Sent once the device has stored every message of that page; the cursor never moves
+    // backwards, so a late or repeated ack is harmless.
+    router.Post("/sync/ack", [&](const httplib::Request& req, httplib::Response& res) {
+        securecloud::auth::ValidateTokenResponse vresp;
+        std::string err;
+        if (!validate_access_token(tokenAuth, req, &vresp, &err)) {
+            set_json(res, 401, json_error(err));
+            return;
+        }
+
+        securecloud::gateway::SyncAckHttpRequest in;
+        std::string parseErr;
+        if (!parse_proto_body(req, &in, &parseErr)) {
+            set_json(res, 400, json_error(parseErr));
+            return;
+        }
+        if (in.device_id().empty() || in.cursor().empty()) {
+            set_json(res, 400, json_error("Missing deviceId or cursor"));
+            return;
+        }
+
+        securecloud::messaging::AckDeliveredRequest areq;
+        areq.set_user_id(vresp.user_id());
+        areq.set_device_id(in.device_id());
+        areq.set_cursor(in.cursor());
+
+        grpc::ClientContext ctx;
+        securecloud::messaging::AckDeliveredResponse aresp;
+        messagingStub.setDeadline(ctx);
+        auto st = messagingStub->AckDelivered(&ctx, areq, &aresp);
+        if (!st.ok()) {
+            std::string msg = st.error_message();
+            if (msg.empty()) {
+                msg = "gRPC AckDelivered failed (code=" + std::to_string(static_cast<int>(st.error_code())) + ")";
+            }
+            set_json(res, st.error_code() == grpc::StatusCode::INVALID_ARGUMENT ? 400 : 502, json_error(msg));
+            return;
+        }
+
+        set_json(res, 200, aresp.success() ? "{\"success\":true}" : "{\"success\":false}");
+    });
+
+    // GET /events (Authorization: Bearer <token>)
+    // Server-Sent Events: every new message of every conversation of the user, as it is stored.
+    //   event: message   data: HttpMessage JSON (conversationId as in /conversations)
+    //   event: resync    live delivery was interrupted; reload what is displayed (e.g. /sync)
+    // A comment line is sent every 15s so proxies keep the connection and dead peers are noticed.
+    router.Get("/events", [&](const httplib::Request& req, httplib::Response& res) {
+        securecloud::auth::ValidateTokenResponse vresp;
+        std::string err;
+        if (!validate_access_token(tokenAuth, req, &vresp, &err)) {
+            set_json(res, 401, json_error(err));
+            return;
+        }
+
+        auto sub = chatHub.subscribe(vresp.user_id());
+        if (!sub) {
+            res.set_header("Retry-After", "30");
+            set_json(res, 503, json_error("Too many event streams"));
             return;
         }
 
         res.status = 200;
-        res.set_content(json, "application/json");
+        res.set_header("Cache-Control", "no-cache");
+        res.set_header("X-Accel-Buffering", "no");
+        const std::string selfUserId = vresp.user_id();
+        res.set_chunked_content_provider(
+            "text/event-stream",
+            [sub, selfUserId](size_t offset, httplib::DataSink& sink) {
+                if (offset == 0) {
+                    // Flush headers right away so the client knows the stream is up.
+                    const std::string hello = "retry: 3000\n\n";
+                    return sink.write(hello.data(), hello.size());
+                }
+
+                std::string chunk;
+                std::shared_ptr<const securecloud::messaging::EncryptedMessage> m;
+                auto wait = std::chrono::milliseconds(15000);
+                // Drain what is already queued into one chunk.
+                for (int i = 0; i < 64; ++i) {
+                    const auto next = sub->next(&m, wait);
+                    wait = std::chrono::milliseconds(0);
+                    if (next == ChatHub::Subscription::Next::Timeout) break;
+                    if (next == ChatHub::Subscription::Next::Closed) {
+                        if (!chunk.empty() && !sink.write(chunk.data(), chunk.size())) return false;
+                        sink.done();
+                        return true;
+                    }
+                    if (next == ChatHub::Subscription::Next::Resync) {
+                        chunk += "event: resync\ndata: {}\n\n";
+                        continue;
+                    }
+
+                    chunk += "id: " + m->message_id() + "\nevent: message\ndata: ";
+                    JsonWriter w(chunk);
+                    write_http_message(w, *m, client_conversation_id(m->conversation_id(), selfUserId));
+                    chunk += "\n\n";
+                }
+                if (chunk.empty()) chunk = ": keepalive\n\n";
+                return sink.write(chunk.data(), chunk.size());
+            },
+            [&chatHub, sub](bool /*success*/) { chatHub.unsubscribe(sub); });
     });
 
     // GET /rooms (Authorization: Bearer <token>)
-    server.Get("/rooms", [&](const httplib::Request& req, httplib::Response& res) {
+    // ETag / If-None-Match: 304 while no room or membership changed.
+    router.Get("/rooms", [&](const httplib::Request& req, httplib::Response& res) {
         securecloud::auth::ValidateTokenResponse vresp;
         std::string err;
-        if (!validate_access_token(*authStub, req, &vresp, &err)) {
+        if (!validate_access_token(tokenAuth, req, &vresp, &err)) {
             set_json(res, 401, json_error(err));
             return;
         }
 
-        securecloud::messaging::ListConversationsRequest lreq;
-        lreq.set_user_id(vresp.user_id());
-        lreq.set_limit(200);
-        securecloud::messaging::ListConversationsResponse lresp;
-        grpc::ClientContext ctx;
-        auto st = messagingStub->ListConversations(&ctx, lreq, &lresp);
+        // Room list = memberships + titles, versioned by the 'membership' counter.
+        std::string etag;
+        std::string membershipVersion = "?";
+        {
+            securecloud::messaging::DataVersionRequest dreq;
+            securecloud::messaging::DataVersionResponse dresp;
+            grpc::ClientContext dctx;
+            messagingStub.setDeadline(dctx);
+            if (messagingStub->GetDataVersion(&dctx, dreq, &dresp).ok()) {
+                membershipVersion = std::to_string(dresp.membership_version());
+                etag = weak_etag("r" + membershipVersion + "-" + vresp.user_id(), response_format(req));
+                if (etag_matches(req.get_header_value("If-None-Match"), etag)) {
+                    set_not_modified(res, etag);
+                    return;
+                }
+            }
+        }
+
+        // Coalesced per user (the same account refreshing from several devices).
+        SingleFlight<securecloud::messaging::ListConversationsResponse>::Result lresp;
+        auto st = listConversationsFlight.runSync(
+            "rooms:" + vresp.user_id() + ":" + membershipVersion,
+            [&](securecloud::messaging::ListConversationsResponse* out) {
+                securecloud::messaging::ListConversationsRequest lreq;
+                lreq.set_user_id(vresp.user_id());
+                lreq.set_limit(200);
+                grpc::ClientContext ctx;
+                messagingStub.setDeadline(ctx);
+                return messagingStub->ListConversations(&ctx, lreq, out);
+            },
+            &lresp);
         if (!st.ok()) {
             std::string msg = st.error_message();
             if (msg.empty()) {
@@ -640,107 +1564,569 @@ int main(int /*argc*/, char** /*argv*/) {
         }
 
         securecloud::gateway::ListRoomsResponse out;
-        for (const auto& c : lresp.conversations()) {
+        for (const auto& c : lresp->conversations()) {
             if (c.type() != "group") continue;
             auto* r = out.add_rooms();
             r->set_room_id(c.conversation_id());
             r->set_title(c.title());
         }
 
-        set_proto_json(res, 200, out);
+        if (set_proto_body(res, response_format(req), 200, out) && !etag.empty()) set_etag(res, etag);
     });
 
-    // POST /rooms (admin only)
-    // Body JSON: {"title":"...","participantEmails":["a@x","b@y"]}
-    server.Post("/rooms", [&](const httplib::Request& req, httplib::Response& res) {
-        securecloud::auth::ValidateTokenResponse vresp;
+    // GET /bootstrap?conversations=<id>,<id>&limit=<n> (Authorization: Bearer <token>)
+    // The client's startup sequence in one round trip: /me, /users, /rooms and the latest page of
+    // each listed conversation, under one token validation. Async, in two rounds that each issue
+    // every upstream call at once:
+    //  1. validators: directory version (auth), membership and retention versions and each page's
+    //     history version (messaging). ETag / If-None-Match: 304 while none of them changed.
+    //  2. the reads, through the SingleFlights of /users, /rooms and the history route: clients
+    //     starting together (reconnect after a gateway restart) share one read per list or page.
+    // A conversation that cannot be read carries its own status instead of failing the whole
+    // response.
+    router.GetAsync("/bootstrap", [&](const httplib::Request& req, httplib::Response& res, HttpRouter::Done done) {
+        struct Page {
+            std::string conversationId;  // as sent by the client
+            std::string key;
+            grpc::ClientContext vctx;
+            securecloud::messaging::DataVersionRequest vreq;
+            securecloud::messaging::DataVersionResponse vresp;
+            grpc::Status vstatus;
+            grpc::Status status;
+            HistoryFlight::Result history;
+        };
+        struct BootstrapCall {
+            securecloud::auth::ValidateTokenResponse vresp;
+            std::string token;
+            int limit = 50;
+            BodyFormat format = BodyFormat::Json;
+            httplib::Response* out = nullptr;
+            HttpRouter::Done done;
+            std::string ifNoneMatch;
+            std::string etag;
+            tracing::SpanContext trace;  // round 2 is issued from round 1's callbacks
+
+            grpc::ClientContext dctx;
+            securecloud::auth::DirectoryVersionRequest dreq;
+            securecloud::auth::DirectoryVersionResponse dresp;
+            grpc::Status dstatus;
+
+            grpc::ClientContext mctx;
+            securecloud::messaging::DataVersionRequest mreq;
+            securecloud::messaging::DataVersionResponse mresp;
+            grpc::Status mstatus;
+
+            grpc::Status ustatus;
+            SingleFlight<securecloud::auth::ListUsersResponse>::Result users;
+            grpc::Status rstatus;
+            SingleFlight<securecloud::messaging::ListConversationsResponse>::Result rooms;
+
+            std::vector<std::unique_ptr<Page>> pages;
+            std::atomic<int> pending{0};
+        };
+        constexpr size_t kMaxBootstrapConversations = 32;
+
+        auto call = std::make_shared<BootstrapCall>();
         std::string err;
-        if (!validate_access_token(*authStub, req, &vresp, &err)) {
+        if (!validate_access_token(tokenAuth, req, &call->vresp, &err)) {
             set_json(res, 401, json_error(err));
+            done();
             return;
         }
-        if (vresp.role() != "admin") {
-            set_json(res, 403, json_error("Admin required"));
-            return;
+        const std::string& userId = call->vresp.user_id();
+        call->token = get_bearer_token(req);
+        call->format = response_format(req);
+        call->out = &res;
+        call->done = done;
+
+        if (req.has_param("limit")) {
+            try {
+                call->limit = std::max(1, std::min(500, std::stoi(req.get_param_value("limit"))));
+            } catch (...) {
+                // ignore
+            }
+        }
+        const std::string list = req.get_param_value("conversations");
+        for (size_t start = 0; start < list.size();) {
+            size_t end = list.find(',', start);
+            if (end == std::string::npos) end = list.size();
+            if (end > start) {
+                if (call->pages.size() == kMaxBootstrapConversations) {
+                    set_json(res, 400, json_error("Too many conversations"));
+                    done();
+                    return;
+                }
+                auto page = std::make_unique<Page>();
+                page->conversationId = list.substr(start, end - start);
+                // Same mapping as GET /conversations/:id/messages.
+                page->key = page->conversationId;
+                if (!is_room_id(page->key) && is_numeric_id(page->key)) {
+                    page->key = dm_conversation_key(userId, page->key);
+                }
+                call->pages.push_back(std::move(page));
+            }
+            start = end + 1;
+        }
+
+        auto* auth = &authStub;
+        auto* messaging = &messagingStub;
+        auto* usersFlight = &listUsersFlight;
+        auto* roomsFlight = &listConversationsFlight;
+        auto* pagesFlight = &historyFlight;
+
+        // Round 2 completion: the response is built once every read is in.
+        const auto finish = [call]() {
+            if (--call->pending > 0) return;
+            httplib::Response& out = *call->out;
+            if (!call->ustatus.ok() || !call->rstatus.ok()) {
+                const auto& st = call->ustatus.ok() ? call->rstatus : call->ustatus;
+                set_json(out, 502, json_error(st.error_message()));
+                call->done();
+                return;
+            }
+
+            securecloud::gateway::BootstrapResponse resp;
+            auto* me = resp.mutable_me();
+            me->set_user_id(call->vresp.user_id());
+            me->set_email(call->vresp.email());
+            me->set_role(call->vresp.role());
+            // Shared listing (include_self): the caller is filled in from it and left out.
+            resp.mutable_users()->Reserve(call->users->users_size());
+            for (const auto& u : call->users->users()) {
+                if (u.user_id() == call->vresp.user_id()) {
+                    me->set_full_name(u.full_name());
+                    continue;
+                }
+                auto* hu = resp.add_users();
+                hu->set_user_id(u.user_id());
+                hu->set_full_name(u.full_name());
+                hu->set_email(u.email());
+                hu->set_role(u.role());
+            }
+            for (const auto& c : call->rooms->conversations()) {
+                if (c.type() != "group") continue;
+                auto* r = resp.add_rooms();
+                r->set_room_id(c.conversation_id());
+                r->set_title(c.title());
+            }
+            for (const auto& p : call->pages) {
+                auto* page = resp.add_conversations();
+                page->set_conversation_id(p->conversationId);
+                if (!p->status.ok()) {
+                    page->set_status(p->status.error_code() == grpc::StatusCode::PERMISSION_DENIED ? 403 : 502);
+                    page->set_error(p->status.error_message());
+                    continue;
+                }
+                page->set_status(200);
+                const auto& messages = p->history->hresp->messages();
+                page->mutable_messages()->Reserve(messages.size());
+                for (int i = messages.size() - 1; i >= 0; --i) {  // hresp is newest-first
+                    const auto& m = messages.Get(i);
+                    auto* hm = page->add_messages();
+                    hm->set_message_id(m.message_id());
+                    hm->set_conversation_id(p->conversationId);
+                    hm->set_sender_id(m.sender_id());
+                    hm->set_content(m.ciphertext());
+                    hm->set_timestamp_unix(m.timestamp_unix());
+                }
+            }
+            if (set_proto_body(out, call->format, 200, resp) && !call->etag.empty()) set_etag(out, call->etag);
+            call->done();
+        };
+
+        // Round 2, keyed like the standalone routes: "?" versions when a validator was missing.
+        const auto read = [call, finish, auth, messaging, usersFlight, roomsFlight, pagesFlight](
+                              const std::string& directoryVersion, const std::string& membershipVersion) {
+            using UsersFlight = SingleFlight<securecloud::auth::ListUsersResponse>;
+            using RoomsFlight = SingleFlight<securecloud::messaging::ListConversationsResponse>;
+            const std::string& userId = call->vresp.user_id();
+            const tracing::ScopedContext traced(call->trace);
+
+            // Counted before anything is issued: a callback may run before the next call starts.
+            call->pending = 2 + static_cast<int>(call->pages.size());
+
+            const std::string token = call->token;
+            usersFlight->run(
+                "dir:" + directoryVersion,
+                [auth, token](UsersFlight::Done complete) {
+                    struct Fetch {
+                        grpc::ClientContext ctx;
+                        securecloud::auth::ListUsersRequest req;
+                    };
+                    auto fetch = std::make_shared<Fetch>();
+                    auto out = std::make_shared<securecloud::auth::ListUsersResponse>();
+                    fetch->req.set_access_token(token);
+                    fetch->req.set_include_self(true);
+                    auth->setDeadline(fetch->ctx);
+                    auth->pick().async()->ListUsers(&fetch->ctx, &fetch->req, out.get(),
+                                                    [fetch, out, complete](grpc::Status st) { complete(st, out); });
+                },
+                [call, finish](const grpc::Status& st, const UsersFlight::Result& users) {
+                    call->ustatus = st;
+                    call->users = users;
+                    finish();
+                });
+
+            roomsFlight->run(
+                "rooms:" + userId + ":" + membershipVersion,
+                [messaging, userId](RoomsFlight::Done complete) {
+                    struct Fetch {
+                        grpc::ClientContext ctx;
+                        securecloud::messaging::ListConversationsRequest req;
+                    };
+                    auto fetch = std::make_shared<Fetch>();
+                    auto out = std::make_shared<securecloud::messaging::ListConversationsResponse>();
+                    fetch->req.set_user_id(userId);
+                    fetch->req.set_limit(200);
+                    messaging->setDeadline(fetch->ctx);
+                    messaging->pick().async()->ListConversations(
+                        &fetch->ctx, &fetch->req, out.get(),
+                        [fetch, out, complete](grpc::Status st) { complete(st, out); });
+                },
+                [call, finish](const grpc::Status& st, const RoomsFlight::Result& rooms) {
+                    call->rstatus = st;
+                    call->rooms = rooms;
+                    finish();
+                });
+
+            for (auto& p : call->pages) {
+                Page* page = p.get();
+                if (page->vstatus.error_code() == grpc::StatusCode::PERMISSION_DENIED) {
+                    // Not readable by this user: answered from the validator lookup.
+                    page->status = page->vstatus;
+                    finish();
+                    continue;
+                }
+                // A checked validator lets identical pages coalesce across requesters, as in the
+                // history route.
+                const std::string scope =
+                    page->vstatus.ok() ? "v" + std::to_string(page->vresp.history_version()) + "-" +
+                                             std::to_string(page->vresp.retention_version())
+                                       : "u" + userId;
+                pagesFlight->run(history_flight_key(page->key, call->limit, std::string(), scope),
+                                 history_issue(messaging, page->key, call->limit, std::string(), userId),
+                                 [call, page, finish](const grpc::Status& st, const HistoryFlight::Result& fetch) {
+                                     page->status = st;
+                                     page->history = fetch;
+                                     finish();
+                                 });
+            }
+        };
+
+        // Round 1 completion: a full set of validators gives the ETag; any one missing serves the
+        // response without it.
+        const auto validated = [call, read]() {
+            if (--call->pending > 0) return;
+            bool versioned = call->dstatus.ok() && call->mstatus.ok();
+            const std::string directoryVersion = call->dstatus.ok() ? std::to_string(call->dresp.version()) : "?";
+            const std::string membershipVersion =
+                call->mstatus.ok() ? std::to_string(call->mresp.membership_version()) : "?";
+            std::string tag = "b" + directoryVersion + "." + membershipVersion + "." +
+                              std::to_string(call->mresp.retention_version());
+            for (const auto& page : call->pages) {
+                if (page->vstatus.ok()) {
+                    tag += "." + std::to_string(page->vresp.history_version());
+                } else if (page->vstatus.error_code() == grpc::StatusCode::PERMISSION_DENIED) {
+                    tag += ".x";
+                } else {
+                    versioned = false;
+                }
+            }
+            if (versioned) {
+                call->etag = weak_etag(tag + "-" + std::to_string(call->limit) + "-" + call->vresp.user_id(),
+                                       call->format);
+                if (etag_matches(call->ifNoneMatch, call->etag)) {
+                    set_not_modified(*call->out, call->etag);
+                    call->done();
+                    return;
+                }
+            }
+            read(directoryVersion, membershipVersion);
+        };
+
+        call->ifNoneMatch = req.get_header_value("If-None-Match");
+        call->trace = tracing::current();
+        call->pending = 2 + static_cast<int>(call->pages.size());
+
+        call->dreq.set_access_token(call->token);
+        auth->setDeadline(call->dctx);
+        auth->pick().async()->GetDirectoryVersion(&call->dctx, &call->dreq, &call->dresp,
+                                                  [call, validated](grpc::Status st) {
+                                                      call->dstatus = std::move(st);
+                                                      validated();
+                                                  });
+
+        messaging->setDeadline(call->mctx);
+        messaging->pick().async()->GetDataVersion(&call->mctx, &call->mreq, &call->mresp,
+                                                  [call, validated](grpc::Status st) {
+                                                      call->mstatus = std::move(st);
+                                                      validated();
+                                                  });
+
+        for (auto& p : call->pages) {
+            Page* page = p.get();
+            page->vreq.set_conversation_id(page->key);
+            page->vreq.set_requester_id(userId);
+            messaging->setDeadline(page->vctx);
+            messaging->pick().async()->GetDataVersion(&page->vctx, &page->vreq, &page->vresp,
+                                                      [call, page, validated](grpc::Status st) {
+                                                          page->vstatus = std::move(st);
+                                                          validated();
+                                                      });
         }
+    });
+
+    // POST /rooms (admin only)
+    // Body JSON: {"title":"...","participantEmails":["a@x","b@y"]}
+    // Async fan-out: the participants are resolved (auth ResolveUsersByEmail, one indexed lookup)
+    // while the token is validated; CreateConversation only waits for both. Errors keep the
+    // sequential precedence: 401, 403, 400 (body), 502 (resolve), 400 (unknown email).
+    router.PostAsync("/rooms", [&](const httplib::Request& req, httplib::Response& res, HttpRouter::Done done) {
+        struct CreateRoomCall {
+            securecloud::gateway::CreateRoomHttpRequest in;
+            std::string bodyErr;
+
+            securecloud::auth::ValidateTokenResponse vresp;
+            std::string authErr;
+            bool authOk = false;
+
+            grpc::ClientContext rctx;
+            securecloud::auth::ResolveUsersByEmailRequest rreq;
+            securecloud::auth::ResolveUsersByEmailResponse rresp;
+            grpc::Status rstatus;
+
+            // Repli pour un auth_service sans ResolveUsersByEmail.
+            grpc::ClientContext lctx;
+            securecloud::auth::ListUsersRequest lreq;
+            securecloud::auth::ListUsersResponse lresp;
+
+            grpc::ClientContext cctx;
+            securecloud::messaging::CreateConversationRequest creq;
+            securecloud::messaging::CreateConversationResponse cresp;
+
+            std::atomic<int> pending{2};  // token validation + participant resolution
+            tracing::SpanContext trace;   // for the calls issued from gRPC callbacks
+        };
+        auto call = std::make_shared<CreateRoomCall>();
+        call->trace = tracing::current();
+
         if (req.body.empty()) {
-            set_json(res, 400, json_error("Empty request body"));
-            return;
+            call->bodyErr = "Empty request body";
+        } else if (!parse_proto_body(req, &call->in, &call->bodyErr)) {
+            // bodyErr set by parse_proto_body
+        } else if (call->in.title().empty()) {
+            call->bodyErr = "Missing title";
         }
 
-        securecloud::gateway::CreateRoomHttpRequest in;
-        JsonParseOptions parseOpts;
-        parseOpts.ignore_unknown_fields = true;
-        auto parseStatus = JsonStringToMessage(req.body, &in, parseOpts);
-        if (!parseStatus.ok()) {
-            set_json(res, 400, json_error("Invalid JSON payload"));
+        httplib::Response* out = &res;
+        const BodyFormat format = response_format(req);
+
+        // Runs once both branches have arrived (on this worker or on a gRPC callback thread).
+        auto create = [&, call, out, done, format]() {
+            const tracing::ScopedContext traced(call->trace);
+            if (!call->authOk) {
+                set_json(*out, 401, json_error(call->authErr));
+                done();
+                return;
+            }
+            if (call->vresp.role() != "admin") {
+                set_json(*out, 403, json_error("Admin required"));
+                done();
+                return;
+            }
+            if (!call->bodyErr.empty()) {
+                set_json(*out, 400, json_error(call->bodyErr));
+                done();
+                return;
+            }
+            if (!call->rstatus.ok()) {
+                set_json(*out, 502, json_error(call->rstatus.error_message()));
+                done();
+                return;
+            }
+
+            std::unordered_map<std::string, std::string> emailToId;
+            const auto& users = call->rresp.users_size() > 0 ? call->rresp.users() : call->lresp.users();
+            emailToId.reserve(static_cast<size_t>(users.size()));
+            for (const auto& u : users) {
+                if (!u.email().empty() && !u.user_id().empty()) {
+                    emailToId.emplace(u.email(), u.user_id());
+                }
+            }
+
+            call->creq.set_creator_id(call->vresp.user_id());
+            call->creq.set_title(call->in.title());
+            for (const auto& mail : call->in.participant_emails()) {
+                const auto it = emailToId.find(mail);
+                if (it == emailToId.end()) {
+                    set_json(*out, 400, json_error("Unknown participant email: " + mail));
+                    done();
+                    return;
+                }
+                call->creq.add_participant_ids(it->second);
+            }
+
+            messagingStub.setDeadline(call->cctx);
+            messagingStub->async()->CreateConversation(&call->cctx, &call->creq, &call->cresp, [&, call, out, done, format](grpc::Status cst) {
+                if (!cst.ok()) {
+                    std::string msg = cst.error_message();
+                    if (msg.empty()) {
+                        msg = "gRPC CreateConversation failed (code=" + std::to_string(static_cast<int>(cst.error_code())) + ")";
+                    }
+                    // If the server is running an old binary that doesn't implement rooms yet.
+                    if (cst.error_code() == grpc::StatusCode::UNIMPLEMENTED) {
+                        msg += ". messaging_service likely needs rebuild/restart.";
+                    }
+                    set_json(*out, 502, json_error(msg));
+                    done();
+                    return;
+                }
+
+                if (call->cresp.success()) {
+                    chatHub.invalidateRooms();
+                }
+
+                securecloud::gateway::CreateRoomHttpResponse resp;
+                resp.set_success(call->cresp.success());
+                resp.set_message(call->cresp.message());
+                resp.set_room_id(call->cresp.conversation_id());
+                set_proto_body(*out, format, 200, resp);
+                done();
+            });
+        };
+        auto arrive = [call, create]() {
+            if (call->pending.fetch_sub(1) == 1) create();
+        };
+
+        // Participant resolution only depends on the body: start it before validating the token.
+        const std::string token = get_bearer_token(req);
+        if (call->bodyErr.empty() && !token.empty() && call->in.participant_emails_size() > 0) {
+            call->rreq.set_access_token(token);
+            std::unordered_set<std::string> seen;
+            for (const auto& mail : call->in.participant_emails()) {
+                if (seen.insert(mail).second) call->rreq.add_emails(mail);
+            }
+            authStub.setDeadline(call->rctx);
+            authStub->async()->ResolveUsersByEmail(&call->rctx, &call->rreq, &call->rresp, [&, call, arrive](grpc::Status st) {
+                if (st.error_code() != grpc::StatusCode::UNIMPLEMENTED) {
+                    call->rstatus = std::move(st);
+                    arrive();
+                    return;
+                }
+                // Ancien auth_service: annuaire complet, comme avant.
+                const tracing::ScopedContext traced(call->trace);
+                call->lreq.set_access_token(call->rreq.access_token());
+                call->lreq.set_include_self(true);
+                authStub.setDeadline(call->lctx);
+                authStub->async()->ListUsers(&call->lctx, &call->lreq, &call->lresp, [call, arrive](grpc::Status lst) {
+                    call->rstatus = std::move(lst);
+                    arrive();
+                });
+            });
+        } else {
+            arrive();
+        }
+
+        call->authOk = validate_access_token(tokenAuth, req, &call->vresp, &call->authErr);
+        arrive();
+    });
+
+    // GET /rooms/:roomId/export (admin only)
+    // Compliance export: NDJSON, one HttpMessage per line, oldest first. Relayed batch by batch
+    // from messaging StreamHistory with chunked transfer, so memory stays bounded by one batch.
+    router.Get(R"(/rooms/([^/]+)/export)", [&](const httplib::Request& req, httplib::Response& res) {
+        securecloud::auth::ValidateTokenResponse vresp;
+        std::string err;
+        if (!validate_access_token(tokenAuth, req, &vresp, &err)) {
+            set_json(res, 401, json_error(err));
             return;
         }
-        if (in.title().empty()) {
-            set_json(res, 400, json_error("Missing title"));
+        if (vresp.role() != "admin") {
+            set_json(res, 403, json_error("Admin required"));
             return;
         }
 
-        // Build email -> user_id mapping via auth ListUsers
-        securecloud::auth::ListUsersRequest ureq;
-        ureq.set_access_token(get_bearer_token(req));
-        ureq.set_include_self(true);
-        securecloud::auth::ListUsersResponse uresp;
-        grpc::ClientContext uctx;
-        auto ust = authStub->ListUsers(&uctx, ureq, &uresp);
-        if (!ust.ok()) {
-            set_json(res, 502, json_error(ust.error_message()));
+        const std::string roomId = (req.matches.size() >= 2) ? req.matches[1].str() : std::string();
+        if (roomId.empty() || !is_room_id(roomId)) {
+            set_json(res, 400, json_error("Invalid room id"));
             return;
         }
-        std::unordered_map<std::string, std::string> emailToId;
-        emailToId.reserve(static_cast<size_t>(uresp.users_size()));
-        for (const auto& u : uresp.users()) {
-            if (!u.email().empty() && !u.user_id().empty()) {
-                emailToId.emplace(u.email(), u.user_id());
-            }
-        }
 
-        securecloud::messaging::CreateConversationRequest creq;
-        creq.set_creator_id(vresp.user_id());
-        creq.set_title(in.title());
+        struct ExportState {
+            grpc::ClientContext ctx;
+            std::unique_ptr<grpc::ClientReader<securecloud::messaging::HistoryResponse>> reader;
+            securecloud::messaging::HistoryResponse pending;
+            bool hasPending = false;
+            bool finished = false;
+        };
+        auto state = std::make_shared<ExportState>();
 
-        for (const auto& mail : in.participant_emails()) {
-            const auto it = emailToId.find(mail);
-            if (it == emailToId.end()) {
-                set_json(res, 400, json_error("Unknown participant email: " + mail));
+        securecloud::messaging::HistoryRequest hreq;
+        hreq.set_conversation_id(roomId);
+        hreq.set_limit(0);
+        hreq.set_batch_size(500);
+        state->reader = messagingStub->StreamHistory(&state->ctx, hreq);
+
+        // Pull the first batch before committing to a 200 so upstream errors still map to a status.
+        state->hasPending = state->reader->Read(&state->pending);
+        if (!state->hasPending) {
+            state->finished = true;
+            auto st = state->reader->Finish();
+            if (!st.ok()) {
+                int status = 502;
+                if (st.error_code() == grpc::StatusCode::PERMISSION_DENIED) status = 403;
+                else if (st.error_code() == grpc::StatusCode::INVALID_ARGUMENT) status = 400;
+                else if (st.error_code() == grpc::StatusCode::RESOURCE_EXHAUSTED) {
+                    // Export slots are all taken on the messaging side.
+                    status = 503;
+                    res.set_header("Retry-After", "30");
+                }
+                std::string msg = st.error_message();
+                if (msg.empty()) {
+                    msg = "gRPC StreamHistory failed (code=" + std::to_string(static_cast<int>(st.error_code())) + ")";
+                }
+                set_json(res, status, json_error(msg));
                 return;
             }
-            creq.add_participant_ids(it->second);
-        }
-
-        securecloud::messaging::CreateConversationResponse cresp;
-        grpc::ClientContext cctx;
-        auto cst = messagingStub->CreateConversation(&cctx, creq, &cresp);
-        if (!cst.ok()) {
-            std::string msg = cst.error_message();
-            if (msg.empty()) {
-                msg = "gRPC CreateConversation failed (code=" + std::to_string(static_cast<int>(cst.error_code())) + ")";
-            }
-            // If the server is running an old binary that doesn't implement rooms yet.
-            if (cst.error_code() == grpc::StatusCode::UNIMPLEMENTED) {
-                msg += ". messaging_service likely needs rebuild/restart.";
-            }
-            set_json(res, 502, json_error(msg));
-            return;
         }
 
-        securecloud::gateway::CreateRoomHttpResponse out;
-        out.set_success(cresp.success());
-        out.set_message(cresp.message());
-        out.set_room_id(cresp.conversation_id());
-        set_proto_json(res, 200, out);
+        res.status = 200;
+        res.set_chunked_content_provider(
+            "application/x-ndjson",
+            [state, roomId](size_t /*offset*/, httplib::DataSink& sink) {
+                if (!state->hasPending) {
+                    if (!state->finished) {
+                        state->finished = true;
+                        (void)state->reader->Finish();
+                    }
+                    sink.done();
+                    return true;
+                }
+
+                std::string chunk;
+                for (const auto& m : state->pending.messages()) {
+                    JsonWriter w(chunk);
+                    write_http_message(w, m, roomId);
+                    chunk += '\n';
+                }
+
+                state->pending.Clear();
+                state->hasPending = state->reader->Read(&state->pending);
+                return chunk.empty() || sink.write(chunk.data(), chunk.size());
+            },
+            [state](bool success) {
+                if (state->finished) return;
+                if (!success) state->ctx.TryCancel();
+                state->finished = true;
+                (void)state->reader->Finish();
+            });
     });
 
     // DELETE /rooms/:roomId (admin only)
-    server.Delete(R"(/rooms/([^/]+))", [&](const httplib::Request& req, httplib::Response& res) {
+    router.Delete(R"(/rooms/([^/]+))", [&](const httplib::Request& req, httplib::Response& res) {
         securecloud::auth::ValidateTokenResponse vresp;
         std::string err;
-        if (!validate_access_token(*authStub, req, &vresp, &err)) {
+        if (!validate_access_token(tokenAuth, req, &vresp, &err)) {
             set_json(res, 401, json_error(err));
             return;
         }
@@ -760,6 +2146,7 @@ int main(int /*argc*/, char** /*argv*/) {
         securecloud::messaging::DeleteConversationResponse dresp;
 
         grpc::ClientContext ctx;
+        messagingStub.setDeadline(ctx);
         auto st = messagingStub->DeleteConversation(&ctx, dreq, &dresp);
         if (!st.ok()) {
             int status = 502;
@@ -774,12 +2161,255 @@ int main(int /*argc*/, char** /*argv*/) {
             return;
         }
 
-        set_proto_json(res, 200, dresp);
+        // Accepted: the room is hidden now, messages are purged in the background
+        // (progress: GET /rooms/:roomId/deletion).
+        set_proto_body(res, response_format(req), 202, dresp);
+    });
+
+    // GET /rooms/:roomId/deletion (admin only): progress of an asynchronous room deletion
+    router.Get(R"(/rooms/([^/]+)/deletion)", [&](const httplib::Request& req, httplib::Response& res) {
+        securecloud::auth::ValidateTokenResponse vresp;
+        std::string err;
+        if (!validate_access_token(tokenAuth, req, &vresp, &err)) {
+            set_json(res, 401, json_error(err));
+            return;
+        }
+        if (vresp.role() != "admin") {
+            set_json(res, 403, json_error("Admin required"));
+            return;
+        }
+
+        const std::string roomId = (req.matches.size() >= 2) ? req.matches[1].str() : std::string();
+        if (roomId.empty() || !is_room_id(roomId)) {
+            set_json(res, 400, json_error("Invalid room id"));
+            return;
+        }
+
+        securecloud::messaging::DeletionStatusRequest sreq;
+        sreq.set_conversation_id(roomId);
+        securecloud::messaging::DeletionStatusResponse sresp;
+
+        grpc::ClientContext ctx;
+        messagingStub.setDeadline(ctx);
+        auto st = messagingStub->GetDeletionStatus(&ctx, sreq, &sresp);
+        if (!st.ok()) {
+            int status = 502;
+            if (st.error_code() == grpc::StatusCode::INVALID_ARGUMENT) status = 400;
+            else if (st.error_code() == grpc::StatusCode::NOT_FOUND) status = 404;
+            std::string msg = st.error_message();
+            if (msg.empty()) {
+                msg = "gRPC GetDeletionStatus failed (code=" + std::to_string(static_cast<int>(st.error_code())) + ")";
+            }
+            set_json(res, status, json_error(msg));
+            return;
+        }
+
+        set_proto_body(res, response_format(req), 200, sresp);
     });
 
-    std::cout << "HTTP Gateway listening on http://" << http_listen_host << ":" << http_port << "\n";
-    std::cout << "Proxying AuthService gRPC at " << auth_target << "\n";
-    std::cout << "Proxying MessagingService gRPC at " << messaging_target << "\n";
+    // POST /files?name=<file name>[&conversationId=<id>] (Authorization: Bearer <token>)
+    // Raw body, already encrypted by the client, forwarded to FileService.Upload while it arrives:
+    // the gateway holds one chunk per transfer whatever the file size.
+    router.PostStream("/files", [&](const httplib::Request& req, httplib::Response& res,
+                                    const httplib::ContentReader& body) {
+        securecloud::auth::ValidateTokenResponse vresp;
+        std::string err;
+        if (!validate_access_token(tokenAuth, req, &vresp, &err)) {
+            set_json(res, 401, json_error(err));
+            return;
+        }
+        const std::string fileName = req.get_param_value("name");
+        if (fileName.empty()) {
+            set_json(res, 400, json_error("Missing file name"));
+            return;
+        }
+
+        // Same conversation ids as the message routes.
+        std::string conversationKey = req.get_param_value("conversationId");
+        if (!is_room_id(conversationKey) && is_numeric_id(conversationKey)) {
+            conversationKey = dm_conversation_key(vresp.user_id(), conversationKey);
+        }
+        if (!conversationKey.empty()) {
+            const auto access = conversation_access(messagingStub, conversationKey, vresp.user_id());
+            if (!access.ok()) {
+                const int status = (access.error_code() == grpc::StatusCode::PERMISSION_DENIED) ? 403 : 502;
+                set_json(res, status, json_error(access.error_message()));
+                return;
+            }
+        }
+
+        securecloud::files::UploadAck ack;
+        grpc::ClientContext ctx;  // no deadline: the upload lasts as long as the client sends
+        auto writer = filesStub->Upload(&ctx, &ack);
+
+        // Metadata travels with the first chunk only; the buffer keeps its capacity between chunks.
+        securecloud::files::UploadChunk chunk;
+        chunk.set_conversation_id(conversationKey);
+        chunk.set_owner_id(vresp.user_id());
+        chunk.set_file_name(fileName);
+        chunk.set_media_type(req.has_header("Content-Type") ? req.get_header_value("Content-Type")
+                                                            : std::string("application/octet-stream"));
+        chunk.set_declared_size(static_cast<long long>(req.get_header_value_u64("Content-Length")));
+        std::string* data = chunk.mutable_cipher_chunk();
+        data->reserve(kFileChunkBytes);
+
+        bool upstreamOk = true;
+        const bool received = body([&](const char* bytes, size_t len) {
+            while (len > 0) {
+                const size_t n = std::min(len, kFileChunkBytes - data->size());
+                data->append(bytes, n);
+                bytes += n;
+                len -= n;
+                if (data->size() < kFileChunkBytes) break;
+                if (!writer->Write(chunk)) {
+                    upstreamOk = false;
+                    return false;
+                }
+                data->clear();
+                chunk.clear_conversation_id();
+                chunk.clear_owner_id();
+                chunk.clear_file_name();
+                chunk.clear_media_type();
+            }
+            return true;
+        });
+        if (received) {
+            chunk.set_last_chunk(true);
+            upstreamOk = writer->Write(chunk);
+        } else if (upstreamOk) {
+            ctx.TryCancel();  // client went away
+        }
+        writer->WritesDone();
+        const auto st = writer->Finish();
+
+        if (!received && upstreamOk) {
+            set_json(res, 400, json_error("Upload interrupted"));
+            return;
+        }
+        if (!st.ok()) {
+            const int status = (st.error_code() == grpc::StatusCode::INVALID_ARGUMENT) ? 400 : 502;
+            std::string msg = st.error_message();
+            if (msg.empty()) msg = "gRPC Upload failed (code=" + std::to_string(static_cast<int>(st.error_code())) + ")";
+            set_json(res, status, json_error(msg));
+            return;
+        }
+
+        securecloud::gateway::UploadFileHttpResponse out;
+        out.set_file_id(ack.file_id());
+        out.set_size(ack.stored_size());
+        set_proto_body(res, response_format(req), 201, out);
+    });
+
+    // GET /files/:id (Authorization: Bearer <token>)
+    // Streamed from FileService.Download as the client reads. Range: bytes=a-b becomes the
+    // download's offset/length, so a resumed transfer only reads what is missing.
+    router.Get(R"(/files/([^/]+))", [&](const httplib::Request& req, httplib::Response& res) {
+        securecloud::auth::ValidateTokenResponse vresp;
+        std::string err;
+        if (!validate_access_token(tokenAuth, req, &vresp, &err)) {
+            set_json(res, 401, json_error(err));
+            return;
+        }
+        const std::string fileId = (req.matches.size() >= 2) ? req.matches[1].str() : std::string();
+
+        securecloud::files::MetadataRequest mreq;
+        mreq.set_file_id(fileId);
+        securecloud::files::FileMetadata meta;
+        grpc::ClientContext mctx;
+        filesStub.setDeadline(mctx);
+        const auto st = filesStub->GetMetadata(&mctx, mreq, &meta);
+        if (!st.ok() || meta.deleted()) {
+            const bool missing = st.ok() || st.error_code() == grpc::StatusCode::NOT_FOUND;
+            set_json(res, missing ? 404 : 502, json_error(missing ? "Unknown file" : st.error_message()));
+            return;
+        }
+        if (meta.owner_id() != vresp.user_id()) {
+            const auto access = meta.conversation_id().empty()
+                                    ? grpc::Status(grpc::StatusCode::PERMISSION_DENIED, "Not owner of file")
+                                    : conversation_access(messagingStub, meta.conversation_id(), vresp.user_id());
+            if (!access.ok()) {
+                const int status = (access.error_code() == grpc::StatusCode::PERMISSION_DENIED) ? 403 : 502;
+                set_json(res, status, json_error(access.error_message()));
+                return;
+            }
+        }
+
+        // Stored files never change: the id is a strong validator.
+        const std::string etag = "\"" + meta.file_id() + "\"";
+        if (etag_matches(req.get_header_value("If-None-Match"), etag)) {
+            set_not_modified(res, etag);
+            return;
+        }
+        set_etag(res, etag);
+        res.set_header("Accept-Ranges", "bytes");
+        const std::string mediaType = meta.media_type().empty() ? "application/octet-stream" : meta.media_type();
+        const auto size = static_cast<size_t>(std::max<long long>(0, meta.size_bytes()));
+        if (size == 0) {
+            res.status = 200;
+            res.set_content(std::string(), mediaType);
+            return;
+        }
+
+        // The provider covers the whole file; both engines narrow a 206 to the requested range.
+        auto* files = &filesStub;
+        res.set_content_provider(size, mediaType, [files, fileId](size_t offset, size_t length, httplib::DataSink& sink) {
+            securecloud::files::DownloadRequest dreq;
+            dreq.set_file_id(fileId);
+            dreq.set_offset(static_cast<long long>(offset));
+            dreq.set_length(static_cast<long long>(length));
+            grpc::ClientContext ctx;  // no deadline: the download lasts as long as the client reads
+            auto reader = (*files)->Download(&ctx, dreq);
+            securecloud::files::DownloadChunk chunk;
+            size_t sent = 0;
+            while (reader->Read(&chunk)) {
+                if (!sink.write(chunk.cipher_chunk().data(), chunk.cipher_chunk().size())) {
+                    ctx.TryCancel();
+                    break;
+                }
+                sent += chunk.cipher_chunk().size();
+            }
+            return reader->Finish().ok() && sent == length;
+        });
+        res.status = req.ranges.empty() ? 200 : 206;
+    });
+
+    const auto describe = [](const UpstreamChannels& pool) {
+        std::string targets;
+        for (const auto& t : pool.options().targets) targets += (targets.empty() ? "" : ", ") + t;
+        return targets + " (" + std::to_string(pool.size()) + " channels)";
+    };
+    if (tracing::initFromEnv("gateway")) {
+        std::cout << "Exporting traces to " << std::getenv("TRACE_EXPORT_FILE") << "\n";
+    }
+    std::cout << "Proxying AuthService gRPC at " << describe(authStub) << "\n";
+    std::cout << "Proxying MessagingService gRPC at " << describe(messagingStub) << "\n";
+    std::cout << "Proxying FileService gRPC at " << describe(filesStub) << "\n";
+
+    const char* envEngine = std::getenv("GATEWAY_HTTP_ENGINE");
+    const std::string engine = (envEngine && *envEngine) ? std::string(envEngine) : std::string("epoll");
+#if defined(__linux__)
+    if (engine == "epoll") {
+        EpollHttpServer server(router, EpollHttpServer::optionsFromEnv());
+        std::cout << "HTTP Gateway (epoll) listening on http://" << http_listen_host << ":" << http_port << "\n";
+        const bool ok = server.listen(http_listen_host, http_port);
+        chatHub.stop();
+        return ok ? 0 : 1;
+    }
+#endif
+
+    httplib::Server server;
+    // Each open /events stream holds a worker thread until the client disconnects: size the pool
+    // so that the maximum number of streams still leaves workers for regular requests.
+    long long httpThreads = static_cast<long long>(chatHubOptions.maxSubscribers) + CPPHTTPLIB_THREAD_POOL_COUNT;
+    if (const char* t = std::getenv("GATEWAY_HTTP_THREADS"); t && *t) {
+        try_parse_int64(t, &httpThreads);
+    }
+    server.new_task_queue = [httpThreads] {
+        return new httplib::ThreadPool(static_cast<size_t>(std::max(1LL, httpThreads)));
+    };
+    router.mountOn(server);
+    std::cout << "HTTP Gateway (httplib) listening on http://" << http_listen_host << ":" << http_port << "\n";
     server.listen(http_listen_host, http_port);
+    chatHub.stop();
     return 0;
 }
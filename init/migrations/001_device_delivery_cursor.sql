@@ -0,0 +1,20 @@
+-- ============================================
+-- MIGRATION 001 - Store-and-forward par appareil
+-- ============================================
+
+-- À exécuter sur une base existante (schema.sql l'inclut déjà pour les nouvelles bases).
+-- Idempotent.
+
+CREATE INDEX IF NOT EXISTS idx_messages_conversation_pending
+    ON messages(conversation_id, id_messages);
+
+-- /sync résout les salons par leur ligne de stockage (title = 'room:<id>').
+CREATE INDEX IF NOT EXISTS idx_conversations_title ON conversations(title);
+
+CREATE TABLE IF NOT EXISTS device_delivery_cursor (
+    id_users INT REFERENCES users(id_users) ON DELETE CASCADE,
+    device_id VARCHAR(128) NOT NULL,
+    last_message_id INT NOT NULL DEFAULT 0,
+    updated_at TIMESTAMP DEFAULT CURRENT_TIMESTAMP,
+    PRIMARY KEY (id_users, device_id)
+);
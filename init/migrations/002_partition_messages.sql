@@ -0,0 +1,43 @@
+-- ============================================
+-- MIGRATION 002 - Partitionnement mensuel de messages
+-- ============================================
+
+-- À exécuter sur une base existante, après 001 (schema.sql l'inclut déjà pour les nouvelles bases).
+-- L'ancienne table devient la partition messages_legacy, qui couvre tout l'historique jusqu'à la
+-- fin du mois courant; messaging_service crée ensuite les partitions messages_pYYYYMM suivantes.
+-- messages_legacy n'est jamais retirée par la politique de rétention (à archiver manuellement).
+
+BEGIN;
+
+ALTER TABLE messages RENAME TO messages_legacy;
+ALTER INDEX IF EXISTS messages_pkey RENAME TO messages_legacy_pkey;
+ALTER INDEX IF EXISTS idx_messages_conversation_pending RENAME TO messages_legacy_conversation_pending;
+
+UPDATE messages_legacy SET created_at = CURRENT_TIMESTAMP WHERE created_at IS NULL;
+ALTER TABLE messages_legacy ALTER COLUMN created_at SET NOT NULL;
+
+CREATE TABLE messages (
+    id_messages INT NOT NULL DEFAULT nextval('messages_id_messages_seq'),
+    conversation_id INT REFERENCES conversations(id_conversations) ON DELETE CASCADE,
+    sender_id INT REFERENCES users(id_users) ON DELETE SET NULL,
+    encrypted_content TEXT NOT NULL,
+    priority VARCHAR(50) DEFAULT 'normal',
+    status VARCHAR(50) DEFAULT 'sent',
+    created_at TIMESTAMP NOT NULL DEFAULT CURRENT_TIMESTAMP,
+    PRIMARY KEY (id_messages, created_at)
+) PARTITION BY RANGE (created_at);
+
+ALTER SEQUENCE messages_id_messages_seq OWNED BY messages.id_messages;
+
+DO $$
+BEGIN
+    EXECUTE format(
+        'ALTER TABLE messages ATTACH PARTITION messages_legacy FOR VALUES FROM (MINVALUE) TO (%L)',
+        date_trunc('month', CURRENT_TIMESTAMP::timestamp) + interval '1 month');
+END $$;
+
+CREATE TABLE messages_default PARTITION OF messages DEFAULT;
+
+CREATE INDEX idx_messages_conversation_pending ON messages(conversation_id, id_messages);
+
+COMMIT;
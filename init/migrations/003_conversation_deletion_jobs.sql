@@ -0,0 +1,19 @@
+-- ============================================
+-- MIGRATION 003 - Suppression asynchrone des conversations
+-- ============================================
+
+-- À exécuter sur une base existante (schema.sql l'inclut déjà pour les nouvelles bases).
+-- Idempotent.
+
+ALTER TABLE conversations ADD COLUMN IF NOT EXISTS deleted_at TIMESTAMP;
+
+CREATE TABLE IF NOT EXISTS conversation_deletion_jobs (
+    id_conversations INT PRIMARY KEY,
+    status VARCHAR(20) NOT NULL DEFAULT 'pending', -- pending | running | done
+    messages_total BIGINT,
+    messages_deleted BIGINT NOT NULL DEFAULT 0,
+    last_error TEXT,
+    requested_at TIMESTAMP NOT NULL DEFAULT CURRENT_TIMESTAMP,
+    started_at TIMESTAMP,
+    finished_at TIMESTAMP
+);
@@ -0,0 +1,41 @@
+-- ============================================
+-- MIGRATION 004 - Versions pour les ETag (/users, /rooms, historique)
+-- ============================================
+
+-- À exécuter sur une base existante (schema.sql l'inclut déjà pour les nouvelles bases).
+-- Idempotent.
+
+CREATE TABLE IF NOT EXISTS data_versions (
+    name VARCHAR(64) PRIMARY KEY,
+    version BIGINT NOT NULL DEFAULT 0
+);
+
+INSERT INTO data_versions(name) VALUES ('directory'), ('membership'), ('retention')
+ON CONFLICT (name) DO NOTHING;
+
+CREATE OR REPLACE FUNCTION bump_data_version() RETURNS trigger AS $$
+BEGIN
+    UPDATE data_versions SET version = version + 1 WHERE name = TG_ARGV[0];
+    RETURN NULL;
+END;
+$$ LANGUAGE plpgsql;
+
+DROP TRIGGER IF EXISTS users_directory_version ON users;
+CREATE TRIGGER users_directory_version
+    AFTER INSERT OR DELETE OR UPDATE OF full_name, email, role_id ON users
+    FOR EACH STATEMENT EXECUTE FUNCTION bump_data_version('directory');
+
+DROP TRIGGER IF EXISTS roles_directory_version ON roles;
+CREATE TRIGGER roles_directory_version
+    AFTER DELETE OR UPDATE OF name ON roles
+    FOR EACH STATEMENT EXECUTE FUNCTION bump_data_version('directory');
+
+DROP TRIGGER IF EXISTS participants_membership_version ON conversation_participant;
+CREATE TRIGGER participants_membership_version
+    AFTER INSERT OR DELETE OR UPDATE ON conversation_participant
+    FOR EACH STATEMENT EXECUTE FUNCTION bump_data_version('membership');
+
+DROP TRIGGER IF EXISTS conversations_membership_version ON conversations;
+CREATE TRIGGER conversations_membership_version
+    AFTER INSERT OR DELETE OR UPDATE OF title, type, deleted_at ON conversations
+    FOR EACH STATEMENT EXECUTE FUNCTION bump_data_version('membership');
@@ -0,0 +1,9 @@
+-- ============================================
+-- MIGRATION 005 - Pagination de l'historique par curseur (created_at, id_messages)
+-- ============================================
+
+-- À exécuter sur une base existante, après 002 (schema.sql l'inclut déjà pour les nouvelles bases).
+-- Idempotent. Créé sur la table parente: chaque partition (existante ou future) reçoit l'index.
+
+CREATE INDEX IF NOT EXISTS idx_messages_conversation_history
+    ON messages(conversation_id, created_at DESC, id_messages DESC);
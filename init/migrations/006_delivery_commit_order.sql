@@ -0,0 +1,21 @@
+-- ============================================
+-- MIGRATION 006 - Curseur de livraison dans l'ordre des commits
+-- ============================================
+
+-- À exécuter sur une base existante, après 005 (schema.sql l'inclut déjà pour les nouvelles bases).
+-- Idempotent.
+-- id_messages est attribué à l'INSERT, pas au COMMIT: un message d'id plus petit peut devenir
+-- visible après un curseur déjà acquitté au-delà. /sync ordonne donc par (tx_id, id_messages),
+-- tx_id étant la transaction d'insertion, et ne livre que sous pg_snapshot_xmin (toutes les
+-- transactions plus anciennes sont terminées).
+-- Colonne ajoutée sans défaut (pas de réécriture des partitions): les lignes existantes gardent
+-- tx_id NULL, lu comme '0' et donc ordonné par id_messages comme avant.
+
+ALTER TABLE messages ADD COLUMN IF NOT EXISTS tx_id xid8;
+ALTER TABLE messages ALTER COLUMN tx_id SET DEFAULT pg_current_xact_id();
+
+CREATE INDEX IF NOT EXISTS idx_messages_conversation_delivery
+    ON messages(conversation_id, (COALESCE(tx_id, '0'::xid8)), id_messages);
+
+-- Les curseurs existants (last_tx_id = 0) couvrent l'ancien ordre par id_messages.
+ALTER TABLE device_delivery_cursor ADD COLUMN IF NOT EXISTS last_tx_id xid8 NOT NULL DEFAULT '0';
@@ -85,9 +85,14 @@ CREATE TABLE conversations (
     id_conversations SERIAL PRIMARY KEY,
     title VARCHAR(150),
     type VARCHAR(50) DEFAULT 'private',
-    created_at TIMESTAMP DEFAULT CURRENT_TIMESTAMP
+    created_at TIMESTAMP DEFAULT CURRENT_TIMESTAMP,
+    -- Tombstone: conversation masquée, ses messages sont purgés en arrière-plan
+    deleted_at TIMESTAMP
 );
 
+-- Clé stable des conversations (dm:<a>:<b>, room:<id>): résolue à chaque envoi et par /sync
+CREATE INDEX idx_conversations_title ON conversations(title);
+
 -- 🔹 TABLE: conversation_participant (association N-N)
 CREATE TABLE conversation_participant (
     id_users INT REFERENCES users(id_users) ON DELETE CASCADE,
@@ -95,15 +100,53 @@ CREATE TABLE conversation_participant (
     PRIMARY KEY (id_users, id_conversations)
 );
 
--- 🔹 TABLE: messages
+-- 🔹 TABLE: messages (partitionnée par mois sur created_at)
+-- Les partitions messages_pYYYYMM sont créées à l'avance et retirées selon la politique de
+-- rétention par le partition manager de messaging_service.
 CREATE TABLE messages (
-    id_messages SERIAL PRIMARY KEY,
+    id_messages SERIAL,
     conversation_id INT REFERENCES conversations(id_conversations) ON DELETE CASCADE,
     sender_id INT REFERENCES users(id_users) ON DELETE SET NULL,
     encrypted_content TEXT NOT NULL,
     priority VARCHAR(50) DEFAULT 'normal',
     status VARCHAR(50) DEFAULT 'sent',
-    created_at TIMESTAMP DEFAULT CURRENT_TIMESTAMP
+    created_at TIMESTAMP NOT NULL DEFAULT CURRENT_TIMESTAMP,
+    -- Transaction d'insertion: ordre de livraison /sync (voir migration 006)
+    tx_id xid8 DEFAULT pg_current_xact_id(),
+    PRIMARY KEY (id_messages, created_at)
+) PARTITION BY RANGE (created_at);
+
+-- Filet de sécurité si le partition manager n'a pas encore créé le mois courant.
+CREATE TABLE messages_default PARTITION OF messages DEFAULT;
+
+-- Dernier id par conversation (versions d'historique)
+CREATE INDEX idx_messages_conversation_pending ON messages(conversation_id, id_messages);
+-- Index de livraison: curseur par appareil dans l'ordre des commits (tx_id, id_messages)
+CREATE INDEX idx_messages_conversation_delivery ON messages(conversation_id, (COALESCE(tx_id, '0'::xid8)), id_messages);
+-- Index d'historique: pages par curseur (created_at, id_messages), du plus récent au plus ancien
+CREATE INDEX idx_messages_conversation_history ON messages(conversation_id, created_at DESC, id_messages DESC);
+
+-- 🔹 TABLE: device_delivery_cursor (store-and-forward par appareil)
+CREATE TABLE device_delivery_cursor (
+    id_users INT REFERENCES users(id_users) ON DELETE CASCADE,
+    device_id VARCHAR(128) NOT NULL,
+    last_tx_id xid8 NOT NULL DEFAULT '0',
+    last_message_id INT NOT NULL DEFAULT 0,
+    updated_at TIMESTAMP DEFAULT CURRENT_TIMESTAMP,
+    PRIMARY KEY (id_users, device_id)
+);
+
+-- 🔹 TABLE: conversation_deletion_jobs (suppression asynchrone par lots)
+-- Pas de FK: la ligne survit à la conversation pour exposer l'état final.
+CREATE TABLE conversation_deletion_jobs (
+    id_conversations INT PRIMARY KEY,
+    status VARCHAR(20) NOT NULL DEFAULT 'pending', -- pending | running | done
+    messages_total BIGINT,
+    messages_deleted BIGINT NOT NULL DEFAULT 0,
+    last_error TEXT,
+    requested_at TIMESTAMP NOT NULL DEFAULT CURRENT_TIMESTAMP,
+    started_at TIMESTAMP,
+    finished_at TIMESTAMP
 );
 
 -- 🔹 TABLE: tokens_revoked
@@ -112,6 +155,40 @@ CREATE TABLE tokens_revoked (
     revoked_at TIMESTAMP DEFAULT CURRENT_TIMESTAMP
 );
 
+-- 🔹 TABLE: data_versions (validateurs ETag du gateway)
+-- Compteurs incrémentés par triggers à chaque changement visible de /users ('directory') ou de
+-- /rooms ('membership'), et par le partition manager quand des mois d'historique sont retirés
+-- ('retention'): le gateway répond 304 sans relister.
+CREATE TABLE data_versions (
+    name VARCHAR(64) PRIMARY KEY,
+    version BIGINT NOT NULL DEFAULT 0
+);
+
+INSERT INTO data_versions(name) VALUES ('directory'), ('membership'), ('retention');
+
+CREATE FUNCTION bump_data_version() RETURNS trigger AS $$
+BEGIN
+    UPDATE data_versions SET version = version + 1 WHERE name = TG_ARGV[0];
+    RETURN NULL;
+END;
+$$ LANGUAGE plpgsql;
+
+-- Annuaire: identité et rôle (pas token_jti, réécrit à chaque login)
+CREATE TRIGGER users_directory_version
+    AFTER INSERT OR DELETE OR UPDATE OF full_name, email, role_id ON users
+    FOR EACH STATEMENT EXECUTE FUNCTION bump_data_version('directory');
+CREATE TRIGGER roles_directory_version
+    AFTER DELETE OR UPDATE OF name ON roles
+    FOR EACH STATEMENT EXECUTE FUNCTION bump_data_version('directory');
+
+-- Salons: participants, titres, suppressions
+CREATE TRIGGER participants_membership_version
+    AFTER INSERT OR DELETE OR UPDATE ON conversation_participant
+    FOR EACH STATEMENT EXECUTE FUNCTION bump_data_version('membership');
+CREATE TRIGGER conversations_membership_version
+    AFTER INSERT OR DELETE OR UPDATE OF title, type, deleted_at ON conversations
+    FOR EACH STATEMENT EXECUTE FUNCTION bump_data_version('membership');
+
 -- ============================================
 -- ✅ FIN DU SCHEMA SECURECLOUD
 -- ============================================
@@ -1,5 +1,7 @@
 #include "FileServiceImpl.h"
+#include "Metrics.h"
 
+#include <algorithm>
 #include <chrono>
 #include <filesystem>
 #include <fstream>
@@ -126,9 +128,11 @@ grpc::Status FileServiceImpl::Upload(grpc::ServerContext* /*context*/,
     }
 
     {
-        std::lock_guard<std::mutex> lock(mutex_);
+        std::lock_guard<metrics::Mutex> lock(mutex_);
         files_[stored.file_id] = stored;
     }
+    static auto& received = metrics::registry().counter("file_upload_bytes_total", "Bytes stored by Upload");
+    received.inc(static_cast<std::uint64_t>(stored.size_bytes));
 
     response->set_file_id(stored.file_id);
     response->set_stored_size(stored.size_bytes);
@@ -144,7 +148,7 @@ grpc::Status FileServiceImpl::Download(grpc::ServerContext* /*context*/,
 
     StoredFile file;
     {
-        std::lock_guard<std::mutex> lock(mutex_);
+        std::lock_guard<metrics::Mutex> lock(mutex_);
         auto it = files_.find(request->file_id());
         if (it == files_.end() || it->second.deleted) {
             return {grpc::StatusCode::NOT_FOUND, "Unknown file"};
@@ -152,23 +156,42 @@ grpc::Status FileServiceImpl::Download(grpc::ServerContext* /*context*/,
         file = it->second;
     }
 
+    if (request->offset() < 0 || request->length() < 0 ||
+        (request->offset() > 0 && request->offset() >= file.size_bytes)) {
+        return {grpc::StatusCode::OUT_OF_RANGE, "Invalid byte range"};
+    }
+    std::int64_t remaining = file.size_bytes - request->offset();
+    if (request->length() > 0) {
+        remaining = std::min(remaining, request->length());
+    }
+
     std::ifstream input(file.file_path, std::ios::binary);
     if (!input.is_open()) {
         return {grpc::StatusCode::INTERNAL, "File missing on disk"};
     }
+    if (request->offset() > 0) {
+        input.seekg(request->offset());
+    }
+
+    static auto& sent = metrics::registry().counter("file_download_bytes_total", "Bytes streamed by Download");
 
-    std::vector<char> buffer(kStreamChunkSize);
-    while (input) {
-        input.read(buffer.data(), static_cast<std::streamsize>(buffer.size()));
-        std::streamsize read_bytes = input.gcount();
+    // Un seul message réutilisé: son buffer garde sa capacité d'un chunk à l'autre.
+    DownloadChunk chunk;
+    std::string* data = chunk.mutable_cipher_chunk();
+    while (remaining > 0 && input) {
+        const auto want = static_cast<std::size_t>(std::min<std::int64_t>(remaining, kStreamChunkSize));
+        data->resize(want);
+        input.read(data->data(), static_cast<std::streamsize>(want));
+        const std::streamsize read_bytes = input.gcount();
         if (read_bytes <= 0) break;
+        data->resize(static_cast<std::size_t>(read_bytes));
+        remaining -= read_bytes;
 
-        DownloadChunk chunk;
-        chunk.set_cipher_chunk(buffer.data(), static_cast<int>(read_bytes));
-        chunk.set_last_chunk(input.peek() == std::char_traits<char>::eof());
+        chunk.set_last_chunk(remaining == 0);
         if (!writer->Write(chunk)) {
             break;
         }
+        sent.inc(static_cast<std::uint64_t>(read_bytes));
     }
 
     return grpc::Status::OK;
@@ -181,7 +204,7 @@ grpc::Status FileServiceImpl::Delete(grpc::ServerContext* /*context*/,
         return {grpc::StatusCode::INVALID_ARGUMENT, "file_id is required"};
     }
 
-    std::lock_guard<std::mutex> lock(mutex_);
+    std::lock_guard<metrics::Mutex> lock(mutex_);
     auto it = files_.find(request->file_id());
     if (it == files_.end() || it->second.deleted) {
         response->set_success(false);
@@ -208,7 +231,7 @@ grpc::Status FileServiceImpl::GetMetadata(grpc::ServerContext* /*context*/,
         return {grpc::StatusCode::INVALID_ARGUMENT, "file_id is required"};
     }
 
-    std::lock_guard<std::mutex> lock(mutex_);
+    std::lock_guard<metrics::Mutex> lock(mutex_);
     auto it = files_.find(request->file_id());
     if (it == files_.end() || it->second.deleted) {
         return {grpc::StatusCode::NOT_FOUND, "Unknown file"};
@@ -6,6 +6,7 @@
 #include <unordered_map>
 #include <vector>
 
+#include "ProfiledMutex.h"
 #include "file_service.grpc.pb.h"
 
 class FileServiceImpl final : public securecloud::files::FileService::Service {
@@ -46,6 +47,6 @@ private:
     securecloud::files::FileMetadata toProto(const StoredFile& file) const;
 
     const std::string storage_root_;
-    mutable std::mutex mutex_;
+    mutable metrics::Mutex mutex_{"FileServiceImpl::mutex_"};
     std::unordered_map<std::string, StoredFile> files_;
 };
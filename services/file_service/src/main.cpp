@@ -1,8 +1,10 @@
 #include <grpcpp/grpcpp.h>
 #include <cstdlib>
-#include <iostream>
 
 #include "FileServiceImpl.h"
+#include "GrpcMetrics.h"
+#include "GrpcTracing.h"
+#include "Logger.h"
 
 using grpc::Server;
 using grpc::ServerBuilder;
@@ -23,17 +25,28 @@ int main(int argc, char** argv) {
 
     try {
         FileServiceImpl service(storage_root);
+        if (tracing::initFromEnv("file-service")) {
+            logging::info("file-service", "Tracing", {{"file", std::getenv("TRACE_EXPORT_FILE")}});
+        }
 
         ServerBuilder builder;
         builder.AddListeningPort(server_address, grpc::InsecureServerCredentials());
         builder.RegisterService(&service);
+        auto interceptors = metrics::serverInterceptors();
+        interceptors.push_back(tracing::serverInterceptorFactory());
+        builder.experimental().SetInterceptorCreators(std::move(interceptors));
 
         std::unique_ptr<Server> server(builder.BuildAndStart());
-        std::cout << "[file-service] listening on " << server_address
-                  << " (storage root: " << storage_root << ")" << std::endl;
+        logging::info("file-service", "Listen", {{"addr", server_address}, {"storage_root", storage_root}});
+        // GET /metrics on a side port (METRICS_PORT, 0 disables).
+        if (const int metrics_port = metrics::serveFromEnv(9103)) {
+            logging::info("file-service", "Metrics", {{"port", metrics_port}});
+        } else {
+            logging::warn("file-service", "Metrics", {{"result", "disabled_or_bind_failed"}});
+        }
         server->Wait();
     } catch (const std::exception& ex) {
-        std::cerr << "file-service failed to start: " << ex.what() << std::endl;
+        logging::error("file-service", "Start", {{"result", "failed"}, {"error", ex.what()}});
         return 1;
     }
 
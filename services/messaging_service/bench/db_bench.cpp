@@ -0,0 +1,409 @@
+// Query latency of the messaging Database under concurrency, against a seeded local Postgres.
+//
+//   messaging_db_bench --seed [--users 10000] [--rooms 1000] [--room-size 20] [--dms 20000]
+//                      [--messages 10000000] [--months 6]
+//   messaging_db_bench [-t 1,4,16] [-d 5] [--connections 1] [--cases a,b] [--json results.json]
+//
+// --db (default: DATABASE_URL) must point at a schema from init/ (schema.sql or the migrations,
+// plus bootstrap_admin.sql for the roles). Seeding is idempotent and only touches bench rows
+// (bench-user-N@bench.local, bench-room-N, their room:<id> and dm:<a>:<b> message stores): it
+// tops the message count up to --messages, spread over the last --months months in monthly
+// partitions, ids increasing with time as in production.
+//
+// Each case runs for -d seconds at every concurrency of -t; threads share --connections Database
+// instances (1 = the service: one connection behind one mutex). insertMessage adds rows to the
+// seeded rooms. The JSON output can be diffed between commits (same seed, same machine).
+#include "Database.h"
+
+#include <pqxx/pqxx>
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cmath>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <fstream>
+#include <functional>
+#include <iostream>
+#include <memory>
+#include <random>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace {
+using Clock = std::chrono::steady_clock;
+
+struct Config {
+    std::string db;
+    bool seed = false;
+    int users = 10000;
+    int rooms = 1000;
+    int roomSize = 20;
+    int dms = 20000;
+    long long messages = 10000000;
+    int months = 6;
+    std::vector<int> threads{1, 4, 16};
+    int seconds = 5;
+    int connections = 1;
+    std::vector<std::string> cases;
+    std::string jsonPath;
+};
+
+std::vector<std::string> split(const std::string& s, char sep) {
+    std::vector<std::string> out;
+    std::stringstream in(s);
+    std::string item;
+    while (std::getline(in, item, sep)) {
+        if (!item.empty()) out.push_back(item);
+    }
+    return out;
+}
+
+std::string int_array(const std::vector<int>& v) {
+    std::string out = "{";
+    for (size_t i = 0; i < v.size(); ++i) out += (i ? "," : "") + std::to_string(v[i]);
+    return out + "}";
+}
+
+// Bench rows created by --seed.
+struct Dataset {
+    std::vector<int> users;         // id_users
+    std::vector<int> groups;        // group conversation ids (participants)
+    std::vector<std::string> keys;  // message-store keys: room:<group id>, dm:<a>:<b>
+    int minMessageId = 0;           // history cursors are drawn from this range
+    int maxMessageId = 0;
+};
+
+std::vector<int> ids(pqxx::work& tx, const std::string& sql) {
+    std::vector<int> out;
+    for (const auto& row : tx.exec(sql)) out.push_back(row[0].as<int>());
+    return out;
+}
+
+Dataset load_dataset(pqxx::connection& conn) {
+    Dataset d;
+    pqxx::work tx(conn);
+    d.users = ids(tx, "SELECT id_users FROM users WHERE email LIKE 'bench-user-%@bench.local' ORDER BY id_users");
+    d.groups = ids(tx, "SELECT id_conversations FROM conversations "
+                       "WHERE type = 'group' AND title LIKE 'bench-room-%' ORDER BY id_conversations");
+    for (const int g : d.groups) d.keys.push_back("room:" + std::to_string(g));
+    for (const auto& row : tx.exec("SELECT title FROM conversations WHERE title LIKE 'dm:%' AND id_conversations IN "
+                                   "(SELECT cp.id_conversations FROM conversation_participant cp "
+                                   "JOIN users u ON u.id_users = cp.id_users "
+                                   "WHERE u.email LIKE 'bench-user-%@bench.local')")) {
+        d.keys.push_back(row[0].as<std::string>());
+    }
+    const auto r = tx.exec("SELECT COALESCE(MIN(id_messages), 0), COALESCE(MAX(id_messages), 0) FROM messages");
+    d.minMessageId = r[0][0].as<int>();
+    d.maxMessageId = r[0][1].as<int>();
+    tx.commit();
+    return d;
+}
+
+void seed(const Config& cfg) {
+    pqxx::connection conn(cfg.db);
+    const auto step = [&](const char* what, const std::string& sql) {
+        const auto start = Clock::now();
+        pqxx::work tx(conn);
+        const auto r = tx.exec(sql);
+        tx.commit();
+        std::fprintf(stderr, "seed: %-28s %8ld rows  %6.1f s\n", what, static_cast<long>(r.affected_rows()),
+                     std::chrono::duration<double>(Clock::now() - start).count());
+    };
+    const std::string users = std::to_string(cfg.users);
+    const std::string months = std::to_string(cfg.months);
+
+    step("users",
+         "INSERT INTO users(full_name, email, password_hash, role_id) "
+         "SELECT 'Bench User ' || i, 'bench-user-' || i || '@bench.local', 'bench', "
+         "(SELECT id_roles FROM roles WHERE name = 'user') "
+         "FROM generate_series(0, " + users + " - 1) AS i ON CONFLICT (email) DO NOTHING");
+    // Created --months ago, like the messages spread over the partitions below.
+    step("rooms",
+         "INSERT INTO conversations(title, type, created_at) "
+         "SELECT 'bench-room-' || i, 'group', CURRENT_TIMESTAMP - make_interval(months => " + months + ") "
+         "FROM generate_series(0, " + std::to_string(cfg.rooms) + " - 1) AS i "
+         "WHERE NOT EXISTS (SELECT 1 FROM conversations c WHERE c.title = 'bench-room-' || i AND c.type = 'group')");
+    step("room message stores",
+         "INSERT INTO conversations(title, type, created_at) "
+         "SELECT 'room:' || g.id_conversations, 'private', g.created_at FROM conversations g "
+         "WHERE g.type = 'group' AND g.title LIKE 'bench-room-%' "
+         "AND NOT EXISTS (SELECT 1 FROM conversations s WHERE s.title = 'room:' || g.id_conversations)");
+    // Member j of room r is user (r * room_size + j) mod users.
+    step("room participants",
+         "INSERT INTO conversation_participant(id_users, id_conversations) "
+         "SELECT u.id_users, g.id_conversations FROM "
+         "(SELECT id_conversations, row_number() OVER (ORDER BY id_conversations) - 1 AS r FROM conversations "
+         " WHERE type = 'group' AND title LIKE 'bench-room-%') g "
+         "CROSS JOIN generate_series(0, " + std::to_string(cfg.roomSize) + " - 1) AS j "
+         "JOIN (SELECT id_users, row_number() OVER (ORDER BY id_users) - 1 AS n FROM users "
+         " WHERE email LIKE 'bench-user-%@bench.local') u "
+         "ON u.n = (g.r * " + std::to_string(cfg.roomSize) + " + j) % " + users + " "
+         "ON CONFLICT DO NOTHING");
+    // DM i between users i and (7i + 1) mod users, keyed like the service: dm:<low id>:<high id>.
+    step("direct conversations",
+         "INSERT INTO conversations(title, type, created_at) "
+         "SELECT DISTINCT 'dm:' || LEAST(a.id_users, b.id_users) || ':' || GREATEST(a.id_users, b.id_users), 'private', "
+         "CURRENT_TIMESTAMP - make_interval(months => " + months + ") "
+         "FROM generate_series(0, " + std::to_string(cfg.dms) + " - 1) AS i "
+         "JOIN (SELECT id_users, row_number() OVER (ORDER BY id_users) - 1 AS n FROM users "
+         " WHERE email LIKE 'bench-user-%@bench.local') a ON a.n = i % " + users + " "
+         "JOIN (SELECT id_users, row_number() OVER (ORDER BY id_users) - 1 AS n FROM users "
+         " WHERE email LIKE 'bench-user-%@bench.local') b ON b.n = (7 * i + 1) % " + users + " "
+         "WHERE a.id_users <> b.id_users AND NOT EXISTS (SELECT 1 FROM conversations c WHERE c.title = "
+         "'dm:' || LEAST(a.id_users, b.id_users) || ':' || GREATEST(a.id_users, b.id_users))");
+    step("direct participants",
+         "INSERT INTO conversation_participant(id_users, id_conversations) "
+         "SELECT split_part(title, ':', k)::int, id_conversations FROM conversations "
+         "CROSS JOIN (VALUES (2), (3)) AS p(k) "
+         "WHERE title ~ '^dm:[0-9]+:[0-9]+$' AND split_part(title, ':', 2)::int IN "
+         "(SELECT id_users FROM users WHERE email LIKE 'bench-user-%@bench.local') "
+         "ON CONFLICT DO NOTHING");
+
+    // Monthly partitions over the seeded range, named like PartitionManager's; a month whose
+    // range is already covered (legacy table, rows in messages_default) is left to the default.
+    {
+        pqxx::work tx(conn);
+        const auto partitioned = tx.exec("SELECT relkind FROM pg_class WHERE oid = to_regclass('messages')");
+        const auto monthsRows = tx.exec(
+            "SELECT to_char(d, 'YYYYMM'), to_char(d, 'YYYY-MM-DD'), to_char(d + interval '1 month', 'YYYY-MM-DD') "
+            "FROM generate_series(date_trunc('month', CURRENT_TIMESTAMP::timestamp) - make_interval(months => " +
+            months + "), date_trunc('month', CURRENT_TIMESTAMP::timestamp) + interval '1 month', "
+            "interval '1 month') AS d");
+        tx.commit();
+        if (!partitioned.empty() && partitioned[0][0].as<std::string>() == "p") {
+            for (const auto& row : monthsRows) {
+                try {
+                    pqxx::work ptx(conn);
+                    ptx.exec("CREATE TABLE IF NOT EXISTS " + ptx.quote_name("messages_p" + row[0].as<std::string>()) +
+                             " PARTITION OF messages FOR VALUES FROM (" + ptx.quote(row[1].as<std::string>()) +
+                             ") TO (" + ptx.quote(row[2].as<std::string>()) + ")");
+                    ptx.commit();
+                } catch (const pqxx::sql_error&) {
+                }
+            }
+        }
+    }
+
+    const Dataset d = load_dataset(conn);
+    if (d.keys.empty() || d.users.empty()) throw std::runtime_error("seed: no bench conversations");
+    std::vector<int> convIds;
+    long long existing = 0;
+    {
+        pqxx::work tx(conn);
+        std::string keys;
+        for (const auto& k : d.keys) keys += (keys.empty() ? "" : ",") + tx.quote(k);
+        convIds = ids(tx, "SELECT id_conversations FROM conversations WHERE title IN (" + keys + ") ORDER BY id_conversations");
+        existing = tx.exec("SELECT count(*) FROM messages WHERE conversation_id = ANY('" + int_array(convIds) + "'::int[])")[0][0]
+                       .as<long long>();
+        tx.commit();
+    }
+
+    // Messages i of [existing, messages): conversation i mod n, created at i/messages of the way
+    // from --months ago to now. 1M rows per transaction.
+    const long long chunk = 1000000;
+    for (long long from = existing; from < cfg.messages; from += chunk) {
+        const long long to = std::min(cfg.messages, from + chunk);
+        step(("messages " + std::to_string(to) + "/" + std::to_string(cfg.messages)).c_str(),
+             "INSERT INTO messages(conversation_id, sender_id, encrypted_content, created_at) "
+             "SELECT c.a[1 + i % array_length(c.a, 1)], u.a[1 + (i * 31) % array_length(u.a, 1)], "
+             "repeat(md5(i::text), 4), "
+             "CURRENT_TIMESTAMP - make_interval(months => " + months + ") + "
+             "(CURRENT_TIMESTAMP - (CURRENT_TIMESTAMP - make_interval(months => " + months + "))) * "
+             "(i::float8 / " + std::to_string(cfg.messages) + ") "
+             "FROM generate_series(" + std::to_string(from) + ", " + std::to_string(to - 1) + ") AS i, "
+             "(SELECT '" + int_array(convIds) + "'::int[] AS a) c, (SELECT '" + int_array(d.users) + "'::int[] AS a) u");
+    }
+    step("analyze", "ANALYZE users, conversations, conversation_participant, messages");
+}
+
+struct Result {
+    std::string name;
+    int threads = 0;
+    std::uint64_t ops = 0;
+    std::uint64_t errors = 0;
+    double seconds = 0;
+    double p50 = 0, p90 = 0, p99 = 0, p999 = 0, max = 0;  // µs
+};
+
+double percentile(const std::vector<std::uint32_t>& sorted, double q) {
+    if (sorted.empty()) return 0;
+    const size_t rank = static_cast<size_t>(std::ceil(q * static_cast<double>(sorted.size())));
+    return sorted[std::min(sorted.size() - 1, rank == 0 ? 0 : rank - 1)];
+}
+
+// op(db, rng) runs one call; every thread calls it in a loop for cfg.seconds.
+Result run_case(const Config& cfg, const std::string& name, int threads, std::vector<std::unique_ptr<Database>>& dbs,
+                const std::function<void(Database&, std::mt19937_64&)>& op) {
+    std::vector<std::vector<std::uint32_t>> lat(static_cast<size_t>(threads));
+    std::vector<std::uint64_t> errors(static_cast<size_t>(threads));
+    const auto end = Clock::now() + std::chrono::seconds(cfg.seconds);
+    std::vector<std::thread> pool;
+    for (int t = 0; t < threads; ++t) {
+        pool.emplace_back([&, t]() {
+            Database& db = *dbs[static_cast<size_t>(t) % dbs.size()];
+            std::mt19937_64 rng(static_cast<unsigned long long>(t) * 0x9E3779B97F4A7C15ull + 1);
+            auto& mine = lat[static_cast<size_t>(t)];
+            mine.reserve(1 << 16);
+            for (;;) {
+                const auto start = Clock::now();
+                if (start >= end) break;
+                try {
+                    op(db, rng);
+                } catch (const std::exception&) {
+                    ++errors[static_cast<size_t>(t)];
+                }
+                mine.push_back(static_cast<std::uint32_t>(
+                    std::chrono::duration_cast<std::chrono::microseconds>(Clock::now() - start).count()));
+            }
+        });
+    }
+    const auto begin = Clock::now();
+    for (auto& th : pool) th.join();
+
+    Result r;
+    r.name = name;
+    r.threads = threads;
+    r.seconds = std::chrono::duration<double>(Clock::now() - begin).count();
+    std::vector<std::uint32_t> all;
+    for (auto& v : lat) all.insert(all.end(), v.begin(), v.end());
+    for (const auto e : errors) r.errors += e;
+    std::sort(all.begin(), all.end());
+    r.ops = all.size();
+    r.p50 = percentile(all, 0.5);
+    r.p90 = percentile(all, 0.9);
+    r.p99 = percentile(all, 0.99);
+    r.p999 = percentile(all, 0.999);
+    r.max = all.empty() ? 0 : all.back();
+    return r;
+}
+
+bool parse_args(int argc, char** argv, Config* cfg) {
+    if (const char* url = std::getenv("DATABASE_URL")) cfg->db = url;
+    for (int i = 1; i < argc; ++i) {
+        const std::string a = argv[i];
+        const auto value = [&]() -> std::string { return i + 1 < argc ? argv[++i] : ""; };
+        if (a == "--db") cfg->db = value();
+        else if (a == "--seed") cfg->seed = true;
+        else if (a == "--users") cfg->users = std::max(2, std::atoi(value().c_str()));
+        else if (a == "--rooms") cfg->rooms = std::max(1, std::atoi(value().c_str()));
+        else if (a == "--room-size") cfg->roomSize = std::max(1, std::atoi(value().c_str()));
+        else if (a == "--dms") cfg->dms = std::max(0, std::atoi(value().c_str()));
+        else if (a == "--messages") cfg->messages = std::max(0LL, std::atoll(value().c_str()));
+        else if (a == "--months") cfg->months = std::max(1, std::atoi(value().c_str()));
+        else if (a == "-t") {
+            cfg->threads.clear();
+            for (const auto& t : split(value(), ',')) cfg->threads.push_back(std::max(1, std::atoi(t.c_str())));
+        } else if (a == "-d") cfg->seconds = std::max(1, std::atoi(value().c_str()));
+        else if (a == "--connections") cfg->connections = std::max(1, std::atoi(value().c_str()));
+        else if (a == "--cases") cfg->cases = split(value(), ',');
+        else if (a == "--json") cfg->jsonPath = value();
+        else {
+            std::cerr << "unknown argument: " << a << "\n";
+            return false;
+        }
+    }
+    if (cfg->db.empty()) {
+        std::cerr << "no database: --db <url> or DATABASE_URL\n";
+        return false;
+    }
+    return !cfg->threads.empty();
+}
+}  // namespace
+
+int main(int argc, char** argv) {
+    Config cfg;
+    if (!parse_args(argc, argv, &cfg)) return 1;
+
+    try {
+        if (cfg.seed) {
+            seed(cfg);
+            return 0;
+        }
+
+        Dataset d;
+        {
+            pqxx::connection conn(cfg.db);
+            d = load_dataset(conn);
+        }
+        if (d.keys.empty() || d.groups.empty() || d.users.empty()) {
+            std::cerr << "no bench data: run with --seed first\n";
+            return 1;
+        }
+
+        std::vector<std::unique_ptr<Database>> dbs;
+        for (int c = 0; c < cfg.connections; ++c) dbs.push_back(std::make_unique<Database>(cfg.db));
+
+        const auto pick = [](const auto& v, std::mt19937_64& rng) -> const auto& {
+            return v[std::uniform_int_distribution<size_t>(0, v.size() - 1)(rng)];
+        };
+        const std::string payload(128, 'x');
+
+        const std::vector<std::pair<std::string, std::function<void(Database&, std::mt19937_64&)>>> cases = {
+            {"insertMessage", [&](Database& db, std::mt19937_64& rng) {
+                 db.insertMessage(pick(d.keys, rng), pick(d.users, rng), payload);
+             }},
+            {"getHistory", [&](Database& db, std::mt19937_64& rng) { db.getHistory(pick(d.keys, rng), 50); }},
+            // An older page: the keyset cursor lands inside the seeded range.
+            {"getHistory_before", [&](Database& db, std::mt19937_64& rng) {
+                 const int before = std::uniform_int_distribution<int>(d.minMessageId, d.maxMessageId)(rng);
+                 db.getHistory(pick(d.keys, rng), 50, before);
+             }},
+            {"listConversationsForUser",
+             [&](Database& db, std::mt19937_64& rng) { db.listConversationsForUser(pick(d.users, rng), 50); }},
+            {"isParticipant",
+             [&](Database& db, std::mt19937_64& rng) { db.isParticipant(pick(d.groups, rng), pick(d.users, rng)); }},
+            {"latestMessageId", [&](Database& db, std::mt19937_64& rng) { db.latestMessageId(pick(d.keys, rng)); }},
+            {"getDataVersion", [&](Database& db, std::mt19937_64&) { db.getDataVersion("membership"); }},
+            {"getPendingForUser", [&](Database& db, std::mt19937_64& rng) {
+                 const int user = pick(d.users, rng);
+                 const int cursor = db.getOrInitDeliveryCursor(user, "bench-device");
+                 db.getPendingForUser(user, std::max(0, cursor - 200), 100);
+             }},
+        };
+
+        std::vector<Result> results;
+        std::fprintf(stderr, "%-26s %7s %10s %10s %9s %9s %9s %9s %9s %7s\n", "case", "threads", "ops", "ops/s",
+                     "p50 us", "p90 us", "p99 us", "p999 us", "max us", "errors");
+        for (const auto& [name, op] : cases) {
+            if (!cfg.cases.empty() && std::find(cfg.cases.begin(), cfg.cases.end(), name) == cfg.cases.end()) continue;
+            for (const int threads : cfg.threads) {
+                const Result r = run_case(cfg, name, threads, dbs, op);
+                std::fprintf(stderr, "%-26s %7d %10llu %10.0f %9.0f %9.0f %9.0f %9.0f %9.0f %7llu\n", r.name.c_str(),
+                             r.threads, static_cast<unsigned long long>(r.ops), static_cast<double>(r.ops) / r.seconds,
+                             r.p50, r.p90, r.p99, r.p999, r.max, static_cast<unsigned long long>(r.errors));
+                results.push_back(r);
+            }
+        }
+
+        std::ostringstream json;
+        json << "{\"service\":\"messaging\",\"connections\":" << cfg.connections << ",\"seconds\":" << cfg.seconds
+             << ",\"dataset\":{\"users\":" << d.users.size() << ",\"rooms\":" << d.groups.size()
+             << ",\"conversations\":" << d.keys.size() << "},\"results\":[";
+        for (size_t i = 0; i < results.size(); ++i) {
+            const auto& r = results[i];
+            char buf[384];
+            std::snprintf(buf, sizeof(buf),
+                          "%s{\"case\":\"%s\",\"threads\":%d,\"ops\":%llu,\"errors\":%llu,\"ops_per_s\":%.1f,"
+                          "\"p50_us\":%.0f,\"p90_us\":%.0f,\"p99_us\":%.0f,\"p999_us\":%.0f,\"max_us\":%.0f}",
+                          i ? "," : "", r.name.c_str(), r.threads, static_cast<unsigned long long>(r.ops),
+                          static_cast<unsigned long long>(r.errors), static_cast<double>(r.ops) / r.seconds, r.p50,
+                          r.p90, r.p99, r.p999, r.max);
+            json << buf;
+        }
+        json << "]}\n";
+        if (cfg.jsonPath.empty()) {
+            std::cout << json.str();
+        } else {
+            std::ofstream(cfg.jsonPath) << json.str();
+        }
+    } catch (const std::exception& e) {
+        std::cerr << "error: " << e.what() << "\n";
+        return 1;
+    }
+    return 0;
+}
@@ -1,8 +1,22 @@
 #include "Database.h"
+#include "Logger.h"
+#include "Metrics.h"
+#include "Tracing.h"
 
+#include <algorithm>
+#include <memory>
 #include <stdexcept>
 #include <string>
 
+namespace {
+// db_query_duration_seconds{method}: durée d'une méthode, attente du verrou de connexion comprise.
+metrics::Histogram& query_latency(const char* method) {
+    return metrics::registry().histogram("db_query_duration_seconds",
+                                         "Database method latency, including the wait for the connection lock",
+                                         {{"method", method}});
+}
+}  // namespace
+
 namespace {
 bool is_likely_connection_loss(const std::string& msg) {
     // libpq / libpqxx messages vary by platform.
@@ -38,7 +52,8 @@ bool parse_dm_key(const std::string& key, int* a, int* b) {
 }
 }
 
-Database::Database(std::string connStr) : connStr_(std::move(connStr)), conn_(connStr_) {
+Database::Database(std::string connStr, int maxStreams)
+    : connStr_(std::move(connStr)), conn_(connStr_), maxStreams_(std::max(1, maxStreams)) {
     if (!conn_.is_open()) {
         throw std::runtime_error("Failed to open PostgreSQL connection");
     }
@@ -63,8 +78,21 @@ void Database::ensureConnectedLocked() {
     }
 }
 
+pqxx::connection& Database::maintenanceConnectionLocked() {
+    if (!maintenanceConn_ || !maintenanceConn_->is_open()) {
+        maintenanceConn_ = std::make_unique<pqxx::connection>(connStr_);
+        if (!maintenanceConn_->is_open()) {
+            throw std::runtime_error("Failed to open PostgreSQL maintenance connection");
+        }
+    }
+    return *maintenanceConn_;
+}
+
 int Database::ensureConversationId(const std::string& conversationKey) {
-    std::lock_guard<std::mutex> lk(m_);
+    static auto& latency = query_latency("ensureConversationId");
+    const metrics::Timer timer(latency);
+    const tracing::ScopedSpan span("Database::ensureConversationId", tracing::Kind::Client);
+    std::lock_guard<metrics::Mutex> lk(m_);
 
     const auto attempt = [&]() {
         ensureConnectedLocked();
@@ -112,7 +140,10 @@ int Database::ensureConversationId(const std::string& conversationKey) {
 int Database::insertMessage(const std::string& conversationKey,
                             std::optional<int> senderId,
                             const std::string& encryptedContentB64) {
-    std::lock_guard<std::mutex> lk(m_);
+    static auto& latency = query_latency("insertMessage");
+    const metrics::Timer timer(latency);
+    const tracing::ScopedSpan span("Database::insertMessage", tracing::Kind::Client);
+    std::lock_guard<metrics::Mutex> lk(m_);
 
     const auto attempt = [&]() {
         ensureConnectedLocked();
@@ -191,88 +222,87 @@ int Database::insertMessage(const std::string& conversationKey,
     }
 }
 
-std::vector<DbMessageRow> Database::getHistory(const std::string& conversationKey, int limit) {
-    std::lock_guard<std::mutex> lk(m_);
+std::vector<DbMessageRow> Database::getHistory(const std::string& conversationKey,
+                                               int limit,
+                                               std::optional<int> beforeMessageId) {
+    static auto& latency = query_latency("getHistory");
+    const metrics::Timer timer(latency);
+    const tracing::ScopedSpan span("Database::getHistory", tracing::Kind::Client);
+    std::lock_guard<metrics::Mutex> lk(m_);
 
     const auto attempt = [&]() {
         ensureConnectedLocked();
         pqxx::work tx(conn_);
 
-        if (conversationKey.empty()) {
-            std::string sql =
-                "SELECT m.id_messages, c.title AS conversation_key, m.sender_id, m.encrypted_content, "
-                "EXTRACT(EPOCH FROM m.created_at)::bigint AS created_at_unix "
-                "FROM messages m "
-                "JOIN conversations c ON c.id_conversations = m.conversation_id "
-                "ORDER BY m.id_messages DESC";
-            if (limit > 0) {
-                sql += " LIMIT $1";
-            }
-
-            pqxx::result r;
-            if (limit > 0) {
-                r = tx.exec_params(sql, limit);
-            } else {
-                r = tx.exec(sql);
-            }
-
-            std::vector<DbMessageRow> out;
-            out.reserve(r.size());
-            for (const auto& row : r) {
-                DbMessageRow m;
-                m.id_messages = row[0].as<int>();
-                m.conversation_key = row[1].as<std::string>();
-                if (row[2].is_null()) m.sender_id = std::nullopt;
-                else m.sender_id = row[2].as<int>();
-                m.encrypted_content_b64 = row[3].as<std::string>();
-                m.created_at_unix = row[4].as<long long>();
-                out.push_back(std::move(m));
+        int convId = 0;
+        if (!conversationKey.empty()) {
+            auto rConv = tx.exec_params(
+                "SELECT id_conversations FROM conversations WHERE title = $1 AND deleted_at IS NULL LIMIT 1",
+                conversationKey);
+            if (rConv.empty()) {
+                tx.commit();
+                return std::vector<DbMessageRow>{};
             }
-
-            tx.commit();
-            return out;
+            convId = rConv[0][0].as<int>();
         }
 
-        auto rConv = tx.exec_params(
-            "SELECT id_conversations FROM conversations WHERE title = $1 LIMIT 1",
-            conversationKey);
-
-        if (rConv.empty()) {
-            tx.commit();
-            return std::vector<DbMessageRow>{};
-        }
-
-        const int convId = rConv[0][0].as<int>();
-
-        std::string sql =
-            "SELECT id_messages, sender_id, encrypted_content, "
-            "EXTRACT(EPOCH FROM created_at)::bigint AS created_at_unix "
-            "FROM messages "
-            "WHERE conversation_id = $1 "
-            "ORDER BY id_messages DESC";
-
-        if (limit > 0) {
-            sql += " LIMIT $2";
+        // Keyset cursor (created_at, id_messages) of the last message of the previous page, at
+        // full timestamp precision. Messages of the same second on both sides of a page boundary
+        // are neither skipped nor repeated. A purged cursor message falls back to the id alone;
+        // a message of another conversation is refused.
+        std::optional<std::string> cursorAt;
+        if (beforeMessageId && conversationKey.empty()) {
+            auto rCursor = tx.exec_params(
+                "SELECT created_at::text FROM messages WHERE id_messages = $1 LIMIT 1", *beforeMessageId);
+            if (!rCursor.empty()) cursorAt = rCursor[0][0].as<std::string>();
+        } else if (beforeMessageId) {
+            auto rCursor = tx.exec_params(
+                "SELECT created_at::text FROM messages WHERE id_messages = $1 AND conversation_id = $2 LIMIT 1",
+                *beforeMessageId,
+                convId);
+            if (!rCursor.empty()) {
+                cursorAt = rCursor[0][0].as<std::string>();
+            } else if (!tx.exec_params("SELECT 1 FROM messages WHERE id_messages = $1 LIMIT 1", *beforeMessageId)
+                            .empty()) {
+                throw ForeignCursor("before_message_id belongs to another conversation");
+            }
         }
 
-        pqxx::result r;
-        if (limit > 0) {
-            r = tx.exec_params(sql, convId, limit);
-        } else {
-            r = tx.exec_params(sql, convId);
+        // One query on the parent table, newest first. The plain created_at bound is rendered as
+        // a literal so the planner prunes newer partitions (row comparisons do not prune); the
+        // per-partition idx_messages_conversation_history scans are merged and stopped after
+        // `limit` rows.
+        std::string sql = conversationKey.empty()
+            ? "SELECT m.id_messages, c.title, m.sender_id, m.encrypted_content, "
+              "EXTRACT(EPOCH FROM m.created_at)::bigint "
+              "FROM messages m "
+              "JOIN conversations c ON c.id_conversations = m.conversation_id "
+              "WHERE c.deleted_at IS NULL"
+            : "SELECT m.id_messages, NULL::text, m.sender_id, m.encrypted_content, "
+              "EXTRACT(EPOCH FROM m.created_at)::bigint "
+              "FROM messages m "
+              "WHERE m.conversation_id = " + std::to_string(convId);
+        if (cursorAt) {
+            sql += " AND m.created_at <= " + tx.quote(*cursorAt) + "::timestamp"
+                   " AND (m.created_at, m.id_messages) < (" + tx.quote(*cursorAt) + "::timestamp, " +
+                   std::to_string(*beforeMessageId) + ")";
+        } else if (beforeMessageId) {
+            sql += " AND m.id_messages < " + std::to_string(*beforeMessageId);
         }
+        sql += " ORDER BY m.created_at DESC, m.id_messages DESC";
+        if (limit > 0) sql += " LIMIT " + std::to_string(limit);
 
+        auto r = tx.exec(sql);
         std::vector<DbMessageRow> out;
         out.reserve(r.size());
-
         for (const auto& row : r) {
             DbMessageRow m;
             m.id_messages = row[0].as<int>();
-            m.conversation_key = conversationKey;
-            if (row[1].is_null()) m.sender_id = std::nullopt;
-            else m.sender_id = row[1].as<int>();
-            m.encrypted_content_b64 = row[2].as<std::string>();
-            m.created_at_unix = row[3].as<long long>();
+            m.conversation_key = row[1].is_null() ? conversationKey : row[1].as<std::string>();
+            if (row[2].is_null()) m.sender_id = std::nullopt;
+            else m.sender_id = row[2].as<int>();
+            m.encrypted_content_b64 = row[3].as<std::string>();
+            m.created_at_unix = row[4].as<long long>();
             out.push_back(std::move(m));
         }
 
@@ -291,8 +321,107 @@ std::vector<DbMessageRow> Database::getHistory(const std::string& conversationKe
     }
 }
 
+void Database::streamHistory(const std::string& conversationKey,
+                             int limit,
+                             int batchSize,
+                             const std::function<bool(const std::vector<DbMessageRow>&)>& onBatch) {
+    static auto& latency = query_latency("streamHistory");
+    const metrics::Timer timer(latency);
+    const tracing::ScopedSpan span("Database::streamHistory", tracing::Kind::Client);
+    static auto& active = metrics::registry().gauge("db_history_streams_active",
+                                                    "Exports holding a dedicated connection");
+    static auto& rejected = metrics::registry().counter("db_history_streams_rejected_total",
+                                                        "Exports refused at the connection limit");
+
+    // Each export costs a backend: refuse rather than queue once the limit is reached, the
+    // caller maps it to RESOURCE_EXHAUSTED and the client retries later.
+    if (activeStreams_.fetch_add(1) >= maxStreams_) {
+        activeStreams_.fetch_sub(1);
+        rejected.inc();
+        throw StreamLimitReached("Too many concurrent history exports");
+    }
+    active.add(1);
+    struct Slot {
+        std::atomic<int>& streams;
+        metrics::Gauge& gauge;
+        ~Slot() {
+            streams.fetch_sub(1);
+            gauge.add(-1);
+        }
+    } slot{activeStreams_, active};
+
+    // No lock: this connection is private to the call.
+    pqxx::connection conn(connStr_);
+    if (!conn.is_open()) {
+        throw std::runtime_error("Failed to open PostgreSQL connection");
+    }
+    pqxx::work tx(conn);
+
+    std::string sql;
+    if (conversationKey.empty()) {
+        sql =
+            "DECLARE history_export NO SCROLL CURSOR FOR "
+            "SELECT m.id_messages, c.title AS conversation_key, m.sender_id, m.encrypted_content, "
+            "EXTRACT(EPOCH FROM m.created_at)::bigint AS created_at_unix "
+            "FROM messages m "
+            "JOIN conversations c ON c.id_conversations = m.conversation_id "
+            "WHERE c.deleted_at IS NULL "
+            "ORDER BY m.id_messages ASC";
+    } else {
+        auto rConv = tx.exec_params(
+            "SELECT id_conversations FROM conversations WHERE title = $1 AND deleted_at IS NULL LIMIT 1",
+            conversationKey);
+        if (rConv.empty()) {
+            tx.commit();
+            return;
+        }
+        const int convId = rConv[0][0].as<int>();
+
+        sql =
+            "DECLARE history_export NO SCROLL CURSOR FOR "
+            "SELECT id_messages, NULL::text AS conversation_key, sender_id, encrypted_content, "
+            "EXTRACT(EPOCH FROM created_at)::bigint AS created_at_unix "
+            "FROM messages "
+            "WHERE conversation_id = " + std::to_string(convId) + " "
+            "ORDER BY id_messages ASC";
+    }
+    if (limit > 0) {
+        sql += " LIMIT " + std::to_string(limit);
+    }
+    tx.exec(sql);
+
+    const std::string fetch = "FETCH FORWARD " + std::to_string(batchSize) + " FROM history_export";
+    std::vector<DbMessageRow> batch;
+    batch.reserve(static_cast<size_t>(batchSize));
+    for (;;) {
+        auto r = tx.exec(fetch);
+        if (r.empty()) break;
+
+        batch.clear();
+        for (const auto& row : r) {
+            DbMessageRow m;
+            m.id_messages = row[0].as<int>();
+            m.conversation_key = row[1].is_null() ? conversationKey : row[1].as<std::string>();
+            if (row[2].is_null()) m.sender_id = std::nullopt;
+            else m.sender_id = row[2].as<int>();
+            m.encrypted_content_b64 = row[3].as<std::string>();
+            m.created_at_unix = row[4].as<long long>();
+            batch.push_back(std::move(m));
+        }
+
+        if (!onBatch(batch)) break;
+        if (static_cast<int>(r.size()) < batchSize) break;
+    }
+
+    tx.exec("CLOSE history_export");
+    tx.commit();
+}
+
 int Database::createGroupConversation(const std::string& title) {
-    std::lock_guard<std::mutex> lk(m_);
+    static auto& latency = query_latency("createGroupConversation");
+    const metrics::Timer timer(latency);
+    const tracing::ScopedSpan span("Database::createGroupConversation", tracing::Kind::Client);
+    std::lock_guard<metrics::Mutex> lk(m_);
 
     const auto attempt = [&]() {
         ensureConnectedLocked();
@@ -321,7 +450,10 @@ int Database::createGroupConversation(const std::string& title) {
 }
 
 bool Database::addParticipant(int conversationId, int userId) {
-    std::lock_guard<std::mutex> lk(m_);
+    static auto& latency = query_latency("addParticipant");
+    const metrics::Timer timer(latency);
+    const tracing::ScopedSpan span("Database::addParticipant", tracing::Kind::Client);
+    std::lock_guard<metrics::Mutex> lk(m_);
 
     const auto attempt = [&]() {
         ensureConnectedLocked();
@@ -348,13 +480,18 @@ bool Database::addParticipant(int conversationId, int userId) {
 }
 
 bool Database::isParticipant(int conversationId, int userId) {
-    std::lock_guard<std::mutex> lk(m_);
+    static auto& latency = query_latency("isParticipant");
+    const metrics::Timer timer(latency);
+    const tracing::ScopedSpan span("Database::isParticipant", tracing::Kind::Client);
+    std::lock_guard<metrics::Mutex> lk(m_);
 
     const auto attempt = [&]() {
         ensureConnectedLocked();
         pqxx::work tx(conn_);
         auto r = tx.exec_params(
-            "SELECT 1 FROM conversation_participant WHERE id_conversations = $1 AND id_users = $2 LIMIT 1",
+            "SELECT 1 FROM conversation_participant cp "
+            "JOIN conversations c ON c.id_conversations = cp.id_conversations AND c.deleted_at IS NULL "
+            "WHERE cp.id_conversations = $1 AND cp.id_users = $2 LIMIT 1",
             conversationId,
             userId);
         const bool ok = !r.empty();
@@ -376,7 +513,10 @@ bool Database::isParticipant(int conversationId, int userId) {
 }
 
 std::vector<DbConversationRow> Database::listConversationsForUser(int userId, int limit) {
-    std::lock_guard<std::mutex> lk(m_);
+    static auto& latency = query_latency("listConversationsForUser");
+    const metrics::Timer timer(latency);
+    const tracing::ScopedSpan span("Database::listConversationsForUser", tracing::Kind::Client);
+    std::lock_guard<metrics::Mutex> lk(m_);
 
     const auto attempt = [&]() {
         ensureConnectedLocked();
@@ -388,7 +528,7 @@ std::vector<DbConversationRow> Database::listConversationsForUser(int userId, in
             "FROM conversations c "
             "JOIN conversation_participant cp ON cp.id_conversations = c.id_conversations "
             "LEFT JOIN messages m ON m.conversation_id = c.id_conversations "
-            "WHERE cp.id_users = $1 "
+            "WHERE cp.id_users = $1 AND c.deleted_at IS NULL "
             "GROUP BY c.id_conversations, c.title, c.type "
             "ORDER BY last_ts DESC, c.id_conversations DESC";
         if (limit > 0) {
@@ -428,17 +568,133 @@ std::vector<DbConversationRow> Database::listConversationsForUser(int userId, in
     }
 }
 
-bool Database::deleteConversationById(int conversationId) {
-    std::lock_guard<std::mutex> lk(m_);
+long long Database::getDataVersion(const std::string& name) {
+    static auto& latency = query_latency("getDataVersion");
+    const metrics::Timer timer(latency);
+    const tracing::ScopedSpan span("Database::getDataVersion", tracing::Kind::Client);
+    std::lock_guard<metrics::Mutex> lk(m_);
+
+    const auto attempt = [&]() {
+        ensureConnectedLocked();
+        pqxx::work tx(conn_);
+        auto r = tx.exec_params("SELECT version FROM data_versions WHERE name = $1", name);
+        const long long version = r.empty() ? 0 : r[0][0].as<long long>();
+        tx.commit();
+        return version;
+    };
+
+    try {
+        return attempt();
+    } catch (const pqxx::failure& e) {
+        if (!conn_.is_open() || is_likely_connection_loss(e.what())) {
+            reconnectLocked();
+            return attempt();
+        }
+        throw;
+    }
+}
+
+long long Database::latestMessageId(const std::string& conversationKey) {
+    static auto& latency = query_latency("latestMessageId");
+    const metrics::Timer timer(latency);
+    const tracing::ScopedSpan span("Database::latestMessageId", tracing::Kind::Client);
+    std::lock_guard<metrics::Mutex> lk(m_);
+
+    const auto attempt = [&]() {
+        ensureConnectedLocked();
+        pqxx::work tx(conn_);
+        // Index-only probe per partition on (conversation_id, id_messages).
+        auto r = tx.exec_params(
+            "SELECT COALESCE(MAX(m.id_messages), 0) FROM messages m "
+            "WHERE m.conversation_id = ("
+            "  SELECT id_conversations FROM conversations WHERE title = $1 AND deleted_at IS NULL LIMIT 1"
+            ")",
+            conversationKey);
+        const long long id = r.empty() ? 0 : r[0][0].as<long long>();
+        tx.commit();
+        return id;
+    };
+
+    try {
+        return attempt();
+    } catch (const pqxx::failure& e) {
+        if (!conn_.is_open() || is_likely_connection_loss(e.what())) {
+            reconnectLocked();
+            return attempt();
+        }
+        throw;
+    }
+}
+
+namespace {
+// Conversation rows making up room:<id>: the group row itself and the message-store row keyed by
+// its client-facing id. $1 is the room id.
+const char* const kRoomConversationIdsSql =
+    "SELECT id_conversations FROM conversations "
+    "WHERE id_conversations = $1 OR title = 'room:' || $1::text";
+}
+
+bool Database::requestConversationDeletion(int conversationId) {
+    static auto& latency = query_latency("requestConversationDeletion");
+    const metrics::Timer timer(latency);
+    const tracing::ScopedSpan span("Database::requestConversationDeletion", tracing::Kind::Client);
+    std::lock_guard<metrics::Mutex> lk(m_);
 
     const auto attempt = [&]() {
         ensureConnectedLocked();
         pqxx::work tx(conn_);
-        pqxx::result r = tx.exec_params(
-            "DELETE FROM conversations WHERE id_conversations = $1",
+
+        auto r = tx.exec_params(
+            "SELECT 1 FROM conversations WHERE id_conversations = $1 FOR UPDATE",
+            conversationId);
+        if (r.empty()) {
+            tx.commit();
+            return false;
+        }
+
+        // Cheap and immediate: hide the room, the purge job does the heavy lifting.
+        tx.exec_params(
+            std::string("UPDATE conversations SET deleted_at = COALESCE(deleted_at, NOW()) "
+                        "WHERE id_conversations IN (") + kRoomConversationIdsSql + ")",
             conversationId);
+        tx.exec_params(
+            "INSERT INTO conversation_deletion_jobs(id_conversations) VALUES ($1) "
+            "ON CONFLICT (id_conversations) DO NOTHING",
+            conversationId);
+        tx.commit();
+        return true;
+    };
+
+    try {
+        return attempt();
+    } catch (const pqxx::failure& e) {
+        if (!conn_.is_open() || is_likely_connection_loss(e.what())) {
+            reconnectLocked();
+            return attempt();
+        }
+        throw;
+    }
+}
+
+std::vector<int> Database::listPendingConversationDeletions(int limit) {
+    static auto& latency = query_latency("listPendingConversationDeletions");
+    const metrics::Timer timer(latency);
+    const tracing::ScopedSpan span("Database::listPendingConversationDeletions", tracing::Kind::Client);
+    std::lock_guard<metrics::Mutex> lk(m_);
+
+    const auto attempt = [&]() {
+        ensureConnectedLocked();
+        pqxx::work tx(conn_);
+        auto r = tx.exec_params(
+            "SELECT id_conversations FROM conversation_deletion_jobs "
+            "WHERE status IN ('pending', 'running') "
+            "ORDER BY requested_at ASC LIMIT $1",
+            limit);
+        std::vector<int> out;
+        out.reserve(r.size());
+        for (const auto& row : r) out.push_back(row[0].as<int>());
         tx.commit();
-        return r.affected_rows() > 0;
+        return out;
     };
 
     try {
@@ -451,3 +707,517 @@ bool Database::deleteConversationById(int conversationId) {
         throw;
     }
 }
+
+void Database::startConversationDeletion(int conversationId) {
+    static auto& latency = query_latency("startConversationDeletion");
+    const metrics::Timer timer(latency);
+    const tracing::ScopedSpan span("Database::startConversationDeletion", tracing::Kind::Client);
+    std::lock_guard<metrics::Mutex> lk(m_);
+
+    const auto attempt = [&]() {
+        ensureConnectedLocked();
+        pqxx::work tx(conn_);
+        // The total is counted once, off the request path (index-only on idx_messages_conversation_pending).
+        tx.exec_params(
+            std::string("UPDATE conversation_deletion_jobs SET status = 'running', "
+                        "started_at = COALESCE(started_at, NOW()), "
+                        "messages_total = COALESCE(messages_total, "
+                        "(SELECT COUNT(*) FROM messages WHERE conversation_id IN (") + kRoomConversationIdsSql + "))) "
+                        "WHERE id_conversations = $1",
+            conversationId);
+        tx.commit();
+    };
+
+    try {
+        attempt();
+    } catch (const pqxx::failure& e) {
+        if (!conn_.is_open() || is_likely_connection_loss(e.what())) {
+            reconnectLocked();
+            attempt();
+            return;
+        }
+        throw;
+    }
+}
+
+int Database::purgeConversationMessagesBatch(int conversationId, int batchSize) {
+    static auto& latency = query_latency("purgeConversationMessagesBatch");
+    const metrics::Timer timer(latency);
+    const tracing::ScopedSpan span("Database::purgeConversationMessagesBatch", tracing::Kind::Client);
+    std::lock_guard<metrics::Mutex> lk(m_);
+
+    const auto attempt = [&]() {
+        ensureConnectedLocked();
+        pqxx::work tx(conn_);
+
+        // Keyed on the primary key (id_messages, created_at): ctid is not unique across partitions.
+        auto r = tx.exec_params(
+            std::string("WITH victims AS (\n"
+                        "  SELECT id_messages, created_at FROM messages\n"
+                        "  WHERE conversation_id IN (") + kRoomConversationIdsSql + ")\n"
+                        "  LIMIT $2\n"
+                        ")\n"
+                        "DELETE FROM messages m USING victims v\n"
+                        "WHERE m.id_messages = v.id_messages AND m.created_at = v.created_at",
+            conversationId,
+            batchSize);
+        const int deleted = static_cast<int>(r.affected_rows());
+
+        tx.exec_params(
+            "UPDATE conversation_deletion_jobs SET messages_deleted = messages_deleted + $2, last_error = NULL "
+            "WHERE id_conversations = $1",
+            conversationId,
+            deleted);
+        tx.commit();
+        return deleted;
+    };
+
+    try {
+        return attempt();
+    } catch (const pqxx::failure& e) {
+        if (!conn_.is_open() || is_likely_connection_loss(e.what())) {
+            reconnectLocked();
+            return attempt();
+        }
+        throw;
+    }
+}
+
+void Database::finishConversationDeletion(int conversationId) {
+    static auto& latency = query_latency("finishConversationDeletion");
+    const metrics::Timer timer(latency);
+    const tracing::ScopedSpan span("Database::finishConversationDeletion", tracing::Kind::Client);
+    std::lock_guard<metrics::Mutex> lk(m_);
+
+    const auto attempt = [&]() {
+        ensureConnectedLocked();
+        pqxx::work tx(conn_);
+        // Only participants (and messages inserted since the last batch) are left to cascade.
+        tx.exec_params(
+            std::string("DELETE FROM conversations WHERE id_conversations IN (") + kRoomConversationIdsSql + ")",
+            conversationId);
+        tx.exec_params(
+            "UPDATE conversation_deletion_jobs SET status = 'done', finished_at = NOW() "
+            "WHERE id_conversations = $1",
+            conversationId);
+        tx.commit();
+    };
+
+    try {
+        attempt();
+    } catch (const pqxx::failure& e) {
+        if (!conn_.is_open() || is_likely_connection_loss(e.what())) {
+            reconnectLocked();
+            attempt();
+            return;
+        }
+        throw;
+    }
+}
+
+void Database::recordConversationDeletionError(int conversationId, const std::string& error) {
+    static auto& latency = query_latency("recordConversationDeletionError");
+    const metrics::Timer timer(latency);
+    const tracing::ScopedSpan span("Database::recordConversationDeletionError", tracing::Kind::Client);
+    std::lock_guard<metrics::Mutex> lk(m_);
+
+    try {
+        ensureConnectedLocked();
+        pqxx::work tx(conn_);
+        tx.exec_params(
+            "UPDATE conversation_deletion_jobs SET last_error = $2 WHERE id_conversations = $1",
+            conversationId,
+            error);
+        tx.commit();
+    } catch (...) {
+        // best-effort: the job is retried on the next pass anyway
+    }
+}
+
+std::optional<DbDeletionJobRow> Database::getConversationDeletion(int conversationId) {
+    static auto& latency = query_latency("getConversationDeletion");
+    const metrics::Timer timer(latency);
+    const tracing::ScopedSpan span("Database::getConversationDeletion", tracing::Kind::Client);
+    std::lock_guard<metrics::Mutex> lk(m_);
+
+    const auto attempt = [&]() -> std::optional<DbDeletionJobRow> {
+        ensureConnectedLocked();
+        pqxx::work tx(conn_);
+        auto r = tx.exec_params(
+            "SELECT id_conversations, status, messages_total, messages_deleted, COALESCE(last_error, ''), "
+            "EXTRACT(EPOCH FROM requested_at)::bigint, "
+            "COALESCE(EXTRACT(EPOCH FROM finished_at)::bigint, 0) "
+            "FROM conversation_deletion_jobs WHERE id_conversations = $1",
+            conversationId);
+        tx.commit();
+        if (r.empty()) return std::nullopt;
+
+        DbDeletionJobRow j;
+        j.id_conversations = r[0][0].as<int>();
+        j.status = r[0][1].as<std::string>();
+        if (!r[0][2].is_null()) j.messages_total = r[0][2].as<long long>();
+        j.messages_deleted = r[0][3].as<long long>();
+        j.last_error = r[0][4].as<std::string>();
+        j.requested_at_unix = r[0][5].as<long long>();
+        j.finished_at_unix = r[0][6].as<long long>();
+        return j;
+    };
+
+    try {
+        return attempt();
+    } catch (const pqxx::failure& e) {
+        if (!conn_.is_open() || is_likely_connection_loss(e.what())) {
+            reconnectLocked();
+            return attempt();
+        }
+        throw;
+    }
+}
+
+
+DeliveryCursor Database::getOrInitDeliveryCursor(int userId, const std::string& deviceId) {
+    static auto& latency = query_latency("getOrInitDeliveryCursor");
+    const metrics::Timer timer(latency);
+    const tracing::ScopedSpan span("Database::getOrInitDeliveryCursor", tracing::Kind::Client);
+    std::lock_guard<metrics::Mutex> lk(m_);
+
+    const auto attempt = [&]() {
+        ensureConnectedLocked();
+        pqxx::work tx(conn_);
+
+        // A device seen for the first time starts at the current horizon: everything committed
+        // below it is covered by the regular history fetch, only later messages are "pending".
+        auto r = tx.exec_params(
+            "WITH existing AS (\n"
+            "  SELECT last_tx_id, last_message_id FROM device_delivery_cursor\n"
+            "  WHERE id_users = $1 AND device_id = $2\n"
+            "),\n"
+            "inserted AS (\n"
+            "  INSERT INTO device_delivery_cursor(id_users, device_id, last_tx_id, last_message_id)\n"
+            "  SELECT $1, $2, pg_snapshot_xmin(pg_current_snapshot()), 0\n"
+            "  WHERE NOT EXISTS (SELECT 1 FROM existing)\n"
+            "  ON CONFLICT (id_users, device_id) DO NOTHING\n"
+            "  RETURNING last_tx_id, last_message_id\n"
+            ")\n"
+            "SELECT last_tx_id::text, last_message_id FROM inserted\n"
+            "UNION ALL\n"
+            "SELECT last_tx_id::text, last_message_id FROM existing\n"
+            "LIMIT 1",
+            userId,
+            deviceId);
+
+        if (r.empty()) {
+            throw std::runtime_error("Failed to resolve delivery cursor");
+        }
+        DeliveryCursor cursor;
+        cursor.txId = r[0][0].as<std::uint64_t>();
+        cursor.messageId = r[0][1].as<int>();
+        tx.commit();
+        return cursor;
+    };
+
+    try {
+        return attempt();
+    } catch (const pqxx::failure& e) {
+        if (!conn_.is_open() || is_likely_connection_loss(e.what())) {
+            reconnectLocked();
+            return attempt();
+        }
+        throw;
+    }
+}
+
+bool Database::advanceDeliveryCursor(int userId, const std::string& deviceId, const DeliveryCursor& cursor) {
+    static auto& latency = query_latency("advanceDeliveryCursor");
+    const metrics::Timer timer(latency);
+    const tracing::ScopedSpan span("Database::advanceDeliveryCursor", tracing::Kind::Client);
+    std::lock_guard<metrics::Mutex> lk(m_);
+
+    const auto attempt = [&]() {
+        ensureConnectedLocked();
+        pqxx::work tx(conn_);
+        tx.exec_params(
+            "INSERT INTO device_delivery_cursor(id_users, device_id, last_tx_id, last_message_id)\n"
+            "VALUES ($1, $2, $3::xid8, $4)\n"
+            "ON CONFLICT (id_users, device_id) DO UPDATE\n"
+            "SET last_tx_id = EXCLUDED.last_tx_id,\n"
+            "    last_message_id = EXCLUDED.last_message_id,\n"
+            "    updated_at = CURRENT_TIMESTAMP\n"
+            "WHERE (device_delivery_cursor.last_tx_id, device_delivery_cursor.last_message_id)\n"
+            "    < (EXCLUDED.last_tx_id, EXCLUDED.last_message_id)",
+            userId,
+            deviceId,
+            std::to_string(cursor.txId),
+            cursor.messageId);
+        tx.commit();
+        return true;
+    };
+
+    try {
+        return attempt();
+    } catch (const pqxx::failure& e) {
+        if (!conn_.is_open() || is_likely_connection_loss(e.what())) {
+            reconnectLocked();
+            return attempt();
+        }
+        throw;
+    }
+}
+
+std::vector<DbMessageRow> Database::getPendingForUser(int userId, const DeliveryCursor& after, int limit) {
+    static auto& latency = query_latency("getPendingForUser");
+    const metrics::Timer timer(latency);
+    const tracing::ScopedSpan span("Database::getPendingForUser", tracing::Kind::Client);
+    std::lock_guard<metrics::Mutex> lk(m_);
+
+    const auto attempt = [&]() {
+        ensureConnectedLocked();
+        pqxx::work tx(conn_);
+
+        // Conversations the user can read, with their client-facing key: the DM rows they take
+        // part in, and for each room they are a member of (participants live on the group row)
+        // the message-store row titled room:<groupId>. Then one index range scan per
+        // conversation on idx_messages_conversation_delivery (conversation_id, tx, id_messages)
+        // instead of a per-room history fetch. Rows of transactions at or above the snapshot
+        // xmin wait for the next drain: an older transaction still running could commit a row
+        // that sorts before them. Read-only transactions (exports) hold no xid and never delay it.
+        auto r = tx.exec_params(
+            "WITH readable AS (\n"
+            "  SELECT c.id_conversations, c.title AS conversation_key\n"
+            "  FROM conversation_participant cp\n"
+            "  JOIN conversations c ON c.id_conversations = cp.id_conversations\n"
+            "  WHERE cp.id_users = $1 AND c.type <> 'group' AND c.title NOT LIKE 'room:%'\n"
+            "    AND c.deleted_at IS NULL\n"
+            "  UNION ALL\n"
+            "  SELECT s.id_conversations, s.title\n"
+            "  FROM conversation_participant cp\n"
+            "  JOIN conversations g ON g.id_conversations = cp.id_conversations\n"
+            "  JOIN conversations s ON s.title = 'room:' || g.id_conversations::text\n"
+            "  WHERE cp.id_users = $1 AND g.type = 'group'\n"
+            "    AND g.deleted_at IS NULL AND s.deleted_at IS NULL\n"
+            ")\n"
+            "SELECT m.id_messages, r.conversation_key, m.sender_id, m.encrypted_content,\n"
+            "       EXTRACT(EPOCH FROM m.created_at)::bigint AS created_at_unix,\n"
+            "       COALESCE(m.tx_id, '0'::xid8)::text AS tx_id\n"
+            "FROM readable r\n"
+            "JOIN messages m ON m.conversation_id = r.id_conversations\n"
+            " AND (COALESCE(m.tx_id, '0'::xid8), m.id_messages) > ($2::xid8, $3)\n"
+            " AND COALESCE(m.tx_id, '0'::xid8) < pg_snapshot_xmin(pg_current_snapshot())\n"
+            "ORDER BY COALESCE(m.tx_id, '0'::xid8) ASC, m.id_messages ASC\n"
+            "LIMIT $4",
+            userId,
+            std::to_string(after.txId),
+            after.messageId,
+            limit);
+
+        std::vector<DbMessageRow> out;
+        out.reserve(r.size());
+        for (const auto& row : r) {
+            DbMessageRow m;
+            m.id_messages = row[0].as<int>();
+            m.conversation_key = row[1].is_null() ? std::string() : row[1].as<std::string>();
+            if (row[2].is_null()) m.sender_id = std::nullopt;
+            else m.sender_id = row[2].as<int>();
+            m.encrypted_content_b64 = row[3].as<std::string>();
+            m.created_at_unix = row[4].as<long long>();
+            m.tx_id = row[5].as<std::uint64_t>();
+            out.push_back(std::move(m));
+        }
+
+        tx.commit();
+        return out;
+    };
+
+    try {
+        return attempt();
+    } catch (const pqxx::failure& e) {
+        if (!conn_.is_open() || is_likely_connection_loss(e.what())) {
+            reconnectLocked();
+            return attempt();
+        }
+        throw;
+    }
+}
+
+
+bool Database::messagesTableIsPartitioned() {
+    static auto& latency = query_latency("messagesTableIsPartitioned");
+    const metrics::Timer timer(latency);
+    const tracing::ScopedSpan span("Database::messagesTableIsPartitioned", tracing::Kind::Client);
+    std::lock_guard<metrics::Mutex> lk(maintenanceM_);
+
+    pqxx::work tx(maintenanceConnectionLocked());
+    auto r = tx.exec(
+        "SELECT c.relkind FROM pg_class c "
+        "WHERE c.oid = to_regclass('messages')");
+    const bool partitioned = !r.empty() && r[0][0].as<std::string>() == "p";
+    tx.commit();
+    return partitioned;
+}
+
+std::vector<std::string> Database::ensureMessagePartitions(int monthsAhead) {
+    static auto& latency = query_latency("ensureMessagePartitions");
+    const metrics::Timer timer(latency);
+    const tracing::ScopedSpan span("Database::ensureMessagePartitions", tracing::Kind::Client);
+    std::lock_guard<metrics::Mutex> lk(maintenanceM_);
+    pqxx::connection& conn = maintenanceConnectionLocked();
+
+    std::vector<std::string> created;
+    // Month boundaries come from the server clock, the same one that fills created_at. Each month
+    // is checked against the bounds of the existing partitions (pg_get_expr(relpartbound)): any
+    // overlap, e.g. messages_legacy after migration 002 or a hand-made partition, would make the
+    // CREATE fail, so the month is skipped instead of erroring on every pass.
+    pqxx::result months;
+    std::string defaultPartition;
+    {
+        pqxx::work tx(conn);
+        months = tx.exec_params(
+            "WITH bounds AS (\n"
+            "  SELECT c.relname, regexp_match(pg_get_expr(c.relpartbound, c.oid),\n"
+            "                                 '^FOR VALUES FROM \\((.+)\\) TO \\((.+)\\)$') AS b\n"
+            "  FROM pg_partition_tree('messages') t\n"
+            "  JOIN pg_class c ON c.oid = t.relid\n"
+            "  WHERE t.level = 1\n"
+            "),\n"
+            "ranges AS (\n"
+            "  SELECT relname,\n"
+            "         CASE WHEN b[1] = 'MINVALUE' THEN '-infinity'::timestamp\n"
+            "              ELSE btrim(b[1], '''')::timestamp END AS lo,\n"
+            "         CASE WHEN b[2] = 'MAXVALUE' THEN 'infinity'::timestamp\n"
+            "              ELSE btrim(b[2], '''')::timestamp END AS hi\n"
+            "  FROM bounds\n"
+            "  WHERE b IS NOT NULL\n"
+            ")\n"
+            "SELECT to_char(d, 'YYYYMM'), to_char(d, 'YYYY-MM-DD'), to_char(d + interval '1 month', 'YYYY-MM-DD'),\n"
+            "       (SELECT string_agg(r.relname, ',') FROM ranges r\n"
+            "        WHERE r.lo < d + interval '1 month' AND r.hi > d)\n"
+            "FROM generate_series(date_trunc('month', CURRENT_TIMESTAMP::timestamp),\n"
+            "                     date_trunc('month', CURRENT_TIMESTAMP::timestamp) + make_interval(months => $1),\n"
+            "                     interval '1 month') AS d",
+            monthsAhead);
+        auto r = tx.exec(
+            "SELECT c.relname FROM pg_partition_tree('messages') t "
+            "JOIN pg_class c ON c.oid = t.relid "
+            "WHERE t.level = 1 AND pg_get_expr(c.relpartbound, c.oid) = 'DEFAULT'");
+        if (!r.empty()) defaultPartition = r[0][0].as<std::string>();
+        tx.commit();
+    }
+
+    for (const auto& row : months) {
+        const std::string name = "messages_p" + row[0].as<std::string>();
+        if (!row[3].is_null()) {
+            logging::debug("messaging-service", "PartitionCovered",
+                           {{"partition", name}, {"by", row[3].as<std::string>()}});
+            continue;
+        }
+        // One transaction per month, so one failure does not block the others.
+        try {
+            pqxx::work tx(conn);
+            // Rows of that month already sitting in the default partition would make the CREATE
+            // fail as well; they have to be moved by hand first.
+            if (!defaultPartition.empty() &&
+                !tx.exec_params("SELECT 1 FROM " + tx.quote_name(defaultPartition) +
+                                    " WHERE created_at >= $1::timestamp AND created_at < $2::timestamp LIMIT 1",
+                                row[1].as<std::string>(),
+                                row[2].as<std::string>())
+                     .empty()) {
+                tx.commit();
+                logging::warn("messaging-service", "PartitionBlocked",
+                              {{"partition", name}, {"reason", "rows in " + defaultPartition}});
+                continue;
+            }
+            tx.exec(
+                "CREATE TABLE IF NOT EXISTS " + tx.quote_name(name) + " PARTITION OF messages "
+                "FOR VALUES FROM (" + tx.quote(row[1].as<std::string>()) + ") "
+                "TO (" + tx.quote(row[2].as<std::string>()) + ")");
+            tx.commit();
+            created.push_back(name);
+        } catch (const pqxx::sql_error& e) {
+            logging::error("messaging-service", "PartitionCreate", {{"partition", name}, {"error", e.what()}});
+        }
+    }
+    return created;
+}
+
+std::vector<std::string> Database::retireMessagePartitions(int retentionMonths, bool drop) {
+    static auto& latency = query_latency("retireMessagePartitions");
+    const metrics::Timer timer(latency);
+    const tracing::ScopedSpan span("Database::retireMessagePartitions", tracing::Kind::Client);
+    std::lock_guard<metrics::Mutex> lk(maintenanceM_);
+
+    std::vector<std::string> retired;
+    if (retentionMonths <= 0) return retired;
+    pqxx::connection& conn = maintenanceConnectionLocked();
+
+    pqxx::result expired;
+    bool hasDefault = false;
+    {
+        pqxx::work tx(conn);
+        // Only managed monthly partitions are candidates; messages_legacy / messages_default never
+        // are. One left "detach pending" by an interrupted DETACH ... CONCURRENTLY is still
+        // listed, and finalized below.
+        expired = tx.exec_params(
+            "SELECT c.relname, i.inhdetachpending FROM pg_inherits i "
+            "JOIN pg_class c ON c.oid = i.inhrelid "
+            "WHERE i.inhparent = 'messages'::regclass "
+            "AND c.relname ~ '^messages_p[0-9]{6}$' "
+            "AND substring(c.relname from 11) < "
+            "to_char(date_trunc('month', CURRENT_TIMESTAMP::timestamp) - make_interval(months => $1), 'YYYYMM') "
+            "ORDER BY c.relname",
+            retentionMonths);
+        hasDefault = !tx.exec(
+                            "SELECT 1 FROM pg_partition_tree('messages') t "
+                            "JOIN pg_class c ON c.oid = t.relid "
+                            "WHERE t.level = 1 AND pg_get_expr(c.relpartbound, c.oid) = 'DEFAULT'")
+                          .empty();
+        tx.commit();
+    }
+
+    for (const auto& row : expired) {
+        const std::string name = row[0].as<std::string>();
+        try {
+            // DETACH ... CONCURRENTLY only takes SHARE UPDATE EXCLUSIVE on messages, so inserts and
+            // history reads keep going; it cannot run inside a transaction block. PostgreSQL
+            // refuses it while a default partition exists: then a plain DETACH in a short
+            // transaction that gives up after lock_timeout (retried on the next pass) rather than
+            // queueing every request behind its ACCESS EXCLUSIVE lock.
+            if (row[1].as<bool>()) {
+                pqxx::nontransaction ntx(conn);
+                ntx.exec("ALTER TABLE messages DETACH PARTITION " + ntx.quote_name(name) + " FINALIZE");
+            } else if (!hasDefault) {
+                pqxx::nontransaction ntx(conn);
+                ntx.exec("ALTER TABLE messages DETACH PARTITION " + ntx.quote_name(name) + " CONCURRENTLY");
+            } else {
+                pqxx::work tx(conn);
+                tx.exec("SET LOCAL lock_timeout = '5s'");
+                tx.exec("ALTER TABLE messages DETACH PARTITION " + tx.quote_name(name));
+                tx.commit();
+            }
+
+            // Detached: nothing reads it through messages any more.
+            pqxx::work tx(conn);
+            if (drop) {
+                tx.exec("DROP TABLE " + tx.quote_name(name));
+            } else {
+                tx.exec("CREATE SCHEMA IF NOT EXISTS messages_archive");
+                tx.exec("ALTER TABLE " + tx.quote_name(name) + " SET SCHEMA messages_archive");
+            }
+            tx.commit();
+            retired.push_back(name);
+        } catch (const pqxx::sql_error& e) {
+            logging::error("messaging-service", "PartitionRetire", {{"partition", name}, {"error", e.what()}});
+        }
+    }
+
+    // Invalidates history ETags: pages reaching into retired months changed without a new message.
+    if (!retired.empty()) {
+        try {
+            pqxx::work tx(conn);
+            tx.exec("UPDATE data_versions SET version = version + 1 WHERE name = 'retention'");
+            tx.commit();
+        } catch (const pqxx::sql_error& e) {
+            logging::error("messaging-service", "RetentionVersion", {{"error", e.what()}});
+        }
+    }
+    return retired;
+}
@@ -1,9 +1,16 @@
 #pragma once
 
+#include "ProfiledMutex.h"
+
 #include <pqxx/pqxx>
 
+#include <atomic>
+#include <cstdint>
+#include <functional>
+#include <memory>
 #include <mutex>
 #include <optional>
+#include <stdexcept>
 #include <string>
 #include <vector>
 
@@ -13,6 +20,14 @@ struct DbMessageRow {
     std::optional<int> sender_id;
     std::string encrypted_content_b64;
     long long created_at_unix = 0;
+    std::uint64_t tx_id = 0;  // inserting transaction, set by getPendingForUser only
+};
+
+// Position in the store-and-forward order (tx_id, id_messages): messages become visible in the
+// order their transactions commit, not in id order, so the cursor follows the inserting xid.
+struct DeliveryCursor {
+    std::uint64_t txId = 0;
+    int messageId = 0;
 };
 
 struct DbConversationRow {
@@ -22,9 +37,30 @@ struct DbConversationRow {
     long long last_timestamp_unix = 0;
 };
 
+struct DbDeletionJobRow {
+    int id_conversations = 0;
+    std::string status;
+    std::optional<long long> messages_total;
+    long long messages_deleted = 0;
+    std::string last_error;
+    long long requested_at_unix = 0;
+    long long finished_at_unix = 0;
+};
+
+// streamHistory refused: maxStreams dedicated connections are already open.
+struct StreamLimitReached : std::runtime_error {
+    using std::runtime_error::runtime_error;
+};
+
+// getHistory refused: the pagination cursor is a message of another conversation.
+struct ForeignCursor : std::invalid_argument {
+    using std::invalid_argument::invalid_argument;
+};
+
 class Database {
 public:
-    explicit Database(std::string connStr);
+    // maxStreams bounds the dedicated connections opened by streamHistory (exports).
+    explicit Database(std::string connStr, int maxStreams = 4);
 
     int ensureConversationId(const std::string& conversationKey);
 
@@ -32,20 +68,80 @@ public:
                       std::optional<int> senderId,
                       const std::string& encryptedContentB64);
 
-    std::vector<DbMessageRow> getHistory(const std::string& conversationKey, int limit);
+    // Newest-first, ordered by (created_at, id_messages). beforeMessageId is the pagination
+    // cursor: the oldest message of the previous page, excluded. Throws ForeignCursor when it
+    // belongs to another conversation.
+    std::vector<DbMessageRow> getHistory(const std::string& conversationKey,
+                                         int limit,
+                                         std::optional<int> beforeMessageId = std::nullopt);
+
+    // Oldest-first history through a server-side cursor on a dedicated connection, so a
+    // long export neither buffers the result nor holds the shared connection.
+    // onBatch receives at most batchSize rows at a time; returning false stops the scan.
+    // Throws StreamLimitReached, without waiting, when maxStreams exports are running.
+    void streamHistory(const std::string& conversationKey,
+                       int limit,
+                       int batchSize,
+                       const std::function<bool(const std::vector<DbMessageRow>&)>& onBatch);
+
+    // Conditional GET validators (gateway ETags).
+    // data_versions counter maintained by triggers; 0 if the row is missing.
+    long long getDataVersion(const std::string& name);
+    // Newest message id of a live conversation, 0 when it has none or does not exist.
+    long long latestMessageId(const std::string& conversationKey);
 
     int createGroupConversation(const std::string& title);
     bool addParticipant(int conversationId, int userId);
     bool isParticipant(int conversationId, int userId);
     std::vector<DbConversationRow> listConversationsForUser(int userId, int limit);
 
-    bool deleteConversationById(int conversationId);
+    // Asynchronous room deletion (see ConversationPurger). A room covers both its group row and
+    // the 'room:<id>' message-store row.
+    // Tombstones the room and queues its purge job; false if the room does not exist.
+    bool requestConversationDeletion(int conversationId);
+    // Jobs still pending or interrupted mid-run, oldest request first.
+    std::vector<int> listPendingConversationDeletions(int limit);
+    void startConversationDeletion(int conversationId);
+    // Deletes at most batchSize messages of the room; returns how many were removed.
+    int purgeConversationMessagesBatch(int conversationId, int batchSize);
+    // Removes the conversation rows themselves (participants cascade) and closes the job.
+    void finishConversationDeletion(int conversationId);
+    void recordConversationDeletionError(int conversationId, const std::string& error);
+    std::optional<DbDeletionJobRow> getConversationDeletion(int conversationId);
+
+    // Store-and-forward: per-device delivery cursor over (messages.tx_id, messages.id_messages).
+    // Returns the cursor, creating it at the current horizon when the device is new.
+    DeliveryCursor getOrInitDeliveryCursor(int userId, const std::string& deviceId);
+    // Monotonic: never moves the cursor backwards.
+    bool advanceDeliveryCursor(int userId, const std::string& deviceId, const DeliveryCursor& cursor);
+    // Messages after `after` in every conversation the user participates in, in commit order.
+    // Only rows below pg_snapshot_xmin are returned: every transaction that could still commit a
+    // row sorting before them has finished, so a cursor moved past them never skips one.
+    // conversation_key is the client-facing id (room:<id> for groups, title for DMs).
+    std::vector<DbMessageRow> getPendingForUser(int userId, const DeliveryCursor& after, int limit);
+
+    // Partition management (see PartitionManager). No-ops on a non-partitioned legacy schema.
+    // Runs on its own connection: DDL waiting for locks never holds m_ or the request connection.
+    bool messagesTableIsPartitioned();
+    // Creates messages_pYYYYMM for the current month and the next monthsAhead months, skipping
+    // months an existing partition already overlaps (messages_legacy) or that rows sitting in
+    // the default partition would block.
+    std::vector<std::string> ensureMessagePartitions(int monthsAhead);
+    // Detaches monthly partitions older than retentionMonths, then drops them or moves them
+    // to the messages_archive schema.
+    std::vector<std::string> retireMessagePartitions(int retentionMonths, bool drop);
 
 private:
     void ensureConnectedLocked();
     void reconnectLocked();
+    pqxx::connection& maintenanceConnectionLocked();
 
     std::string connStr_;
     pqxx::connection conn_;
-    std::mutex m_;
+    const int maxStreams_;
+    std::atomic<int> activeStreams_{0};
+    metrics::Mutex m_{"Database::m_"};
+    // Partition maintenance connection, opened on first use.
+    std::unique_ptr<pqxx::connection> maintenanceConn_;
+    metrics::Mutex maintenanceM_{"Database::maintenanceM_"};
 };
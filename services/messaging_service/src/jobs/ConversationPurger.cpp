@@ -0,0 +1,124 @@
+#include "ConversationPurger.h"
+
+#include "utils/EnvLoader.h"
+#include "Logger.h"
+#include "Metrics.h"
+
+#include <algorithm>
+#include <string>
+#include <vector>
+
+namespace {
+int env_int(const std::string& key, int fallback) {
+    const std::string v = EnvLoader::get(key);
+    if (v.empty()) return fallback;
+    try {
+        return std::stoi(v);
+    } catch (...) {
+        return fallback;
+    }
+}
+}
+
+ConversationPurger::ConversationPurger(Database& db, Options opts) : db_(db), opts_(opts) {}
+
+ConversationPurger::~ConversationPurger() {
+    stop();
+}
+
+ConversationPurger::Options ConversationPurger::optionsFromEnv() {
+    Options o;
+    o.batchSize = std::max(1, std::min(50000, env_int("CONVERSATION_PURGE_BATCH_SIZE", o.batchSize)));
+    o.pause = std::chrono::milliseconds(
+        std::max(0, env_int("CONVERSATION_PURGE_PAUSE_MS", static_cast<int>(o.pause.count()))));
+    return o;
+}
+
+void ConversationPurger::start() {
+    std::lock_guard<std::mutex> lk(m_);
+    if (worker_.joinable()) return;
+    stopping_ = false;
+    // Resume jobs interrupted by a restart right away.
+    notified_ = true;
+    worker_ = std::thread([this]() { loop(); });
+}
+
+void ConversationPurger::stop() {
+    {
+        std::lock_guard<std::mutex> lk(m_);
+        stopping_ = true;
+    }
+    cv_.notify_all();
+    if (worker_.joinable()) worker_.join();
+}
+
+void ConversationPurger::notify() {
+    {
+        std::lock_guard<std::mutex> lk(m_);
+        notified_ = true;
+    }
+    cv_.notify_all();
+}
+
+bool ConversationPurger::pauseFor(std::chrono::milliseconds d) {
+    std::unique_lock<std::mutex> lk(m_);
+    return !cv_.wait_for(lk, d, [this]() { return stopping_; });
+}
+
+void ConversationPurger::loop() {
+    for (;;) {
+        {
+            std::unique_lock<std::mutex> lk(m_);
+            cv_.wait_for(lk, opts_.idleInterval, [this]() { return stopping_ || notified_; });
+            if (stopping_) return;
+            notified_ = false;
+        }
+
+        std::vector<int> jobs;
+        try {
+            jobs = db_.listPendingConversationDeletions(16);
+        } catch (const std::exception& e) {
+            logging::error("messaging-service", "Purge", {{"result", "cannot_list_jobs"}, {"error", e.what()}});
+            continue;
+        }
+
+        static auto& pending = metrics::registry().gauge("messaging_purge_jobs_pending",
+                                                         "Room deletions picked up by the last purge pass (at most 16)");
+        pending.set(static_cast<std::int64_t>(jobs.size()));
+
+        bool allDone = true;
+        for (int convId : jobs) {
+            allDone = purge(convId) && allDone;
+            if (!pauseFor(opts_.pause)) return;
+        }
+
+        // More queued than one pass handles: go again without waiting for the idle interval
+        // (failed jobs wait for the next tick instead of spinning).
+        if (allDone && jobs.size() == 16) notify();
+    }
+}
+
+bool ConversationPurger::purge(int conversationId) {
+    try {
+        db_.startConversationDeletion(conversationId);
+
+        static auto& purged = metrics::registry().counter("messaging_purged_messages_total",
+                                                          "Messages deleted by the conversation purger");
+        long long total = 0;
+        for (;;) {
+            const int n = db_.purgeConversationMessagesBatch(conversationId, opts_.batchSize);
+            total += n;
+            purged.inc(static_cast<std::uint64_t>(n));
+            if (n < opts_.batchSize) break;
+            if (!pauseFor(opts_.pause)) return false; // stopping: the job stays 'running' and resumes later
+        }
+
+        db_.finishConversationDeletion(conversationId);
+        logging::info("messaging-service", "Purge", {{"room", conversationId}, {"deleted_messages", total}});
+        return true;
+    } catch (const std::exception& e) {
+        logging::error("messaging-service", "Purge", {{"room", conversationId}, {"error", e.what()}});
+        db_.recordConversationDeletionError(conversationId, e.what());
+        return false;
+    }
+}
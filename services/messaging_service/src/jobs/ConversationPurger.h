@@ -0,0 +1,51 @@
+#pragma once
+
+#include "db/Database.h"
+
+#include <chrono>
+#include <condition_variable>
+#include <mutex>
+#include <thread>
+
+// Background purge of tombstoned rooms: messages are removed in bounded batches with a pause
+// between them, so a large room never holds locks (or the shared DB connection) for long.
+class ConversationPurger {
+public:
+    struct Options {
+        int batchSize = 1000;
+        // Throttle between two batches of the same room.
+        std::chrono::milliseconds pause{50};
+        // Fallback poll when nobody calls notify() (e.g. jobs left over by a restart).
+        std::chrono::seconds idleInterval{30};
+    };
+
+    ConversationPurger(Database& db, Options opts);
+    ~ConversationPurger();
+
+    ConversationPurger(const ConversationPurger&) = delete;
+    ConversationPurger& operator=(const ConversationPurger&) = delete;
+
+    void start();
+    void stop();
+
+    // Wakes the worker after a new deletion request.
+    void notify();
+
+    // Reads CONVERSATION_PURGE_BATCH_SIZE and CONVERSATION_PURGE_PAUSE_MS.
+    static Options optionsFromEnv();
+
+private:
+    void loop();
+    // Runs one room to completion; false if it failed or was interrupted.
+    bool purge(int conversationId);
+    // Sleeps for d unless stop() is called; returns false when stopping.
+    bool pauseFor(std::chrono::milliseconds d);
+
+    Database& db_;
+    const Options opts_;
+    std::thread worker_;
+    std::mutex m_;
+    std::condition_variable cv_;
+    bool stopping_ = false;
+    bool notified_ = false;
+};
@@ -0,0 +1,82 @@
+#include "PartitionManager.h"
+
+#include "utils/EnvLoader.h"
+#include "Logger.h"
+
+#include <algorithm>
+#include <string>
+
+namespace {
+int env_int(const std::string& key, int fallback) {
+    const std::string v = EnvLoader::get(key);
+    if (v.empty()) return fallback;
+    try {
+        return std::stoi(v);
+    } catch (...) {
+        return fallback;
+    }
+}
+}
+
+PartitionManager::PartitionManager(Database& db, Options opts) : db_(db), opts_(opts) {}
+
+PartitionManager::~PartitionManager() {
+    stop();
+}
+
+PartitionManager::Options PartitionManager::optionsFromEnv() {
+    Options o;
+    o.monthsAhead = std::max(1, env_int("MESSAGES_PARTITION_MONTHS_AHEAD", o.monthsAhead));
+    o.retentionMonths = std::max(0, env_int("MESSAGES_RETENTION_MONTHS", o.retentionMonths));
+    o.dropExpired = EnvLoader::get("MESSAGES_RETENTION_ACTION") == "drop";
+    o.interval = std::chrono::seconds(std::max(60, env_int("MESSAGES_PARTITION_INTERVAL_SECONDS",
+                                                           static_cast<int>(o.interval.count()))));
+    return o;
+}
+
+void PartitionManager::start() {
+    runOnce();
+    std::lock_guard<std::mutex> lk(m_);
+    if (worker_.joinable()) return;
+    stopping_ = false;
+    worker_ = std::thread([this]() { loop(); });
+}
+
+void PartitionManager::stop() {
+    {
+        std::lock_guard<std::mutex> lk(m_);
+        stopping_ = true;
+    }
+    cv_.notify_all();
+    if (worker_.joinable()) worker_.join();
+}
+
+void PartitionManager::runOnce() {
+    try {
+        if (!db_.messagesTableIsPartitioned()) {
+            logging::warn("messaging-service", "Partitions",
+                          {{"result", "skipped"},
+                           {"reason", "messages is not partitioned (apply init/migrations/002_partition_messages.sql)"}});
+            return;
+        }
+
+        for (const auto& name : db_.ensureMessagePartitions(opts_.monthsAhead)) {
+            logging::info("messaging-service", "Partitions", {{"created", name}});
+        }
+        for (const auto& name : db_.retireMessagePartitions(opts_.retentionMonths, opts_.dropExpired)) {
+            logging::info("messaging-service", "Partitions", {{opts_.dropExpired ? "dropped" : "archived", name}});
+        }
+    } catch (const std::exception& e) {
+        logging::error("messaging-service", "Partitions", {{"result", "maintenance_failed"}, {"error", e.what()}});
+    }
+}
+
+void PartitionManager::loop() {
+    std::unique_lock<std::mutex> lk(m_);
+    while (!stopping_) {
+        if (cv_.wait_for(lk, opts_.interval, [this]() { return stopping_; })) break;
+        lk.unlock();
+        runOnce();
+        lk.lock();
+    }
+}
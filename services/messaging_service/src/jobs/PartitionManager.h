@@ -0,0 +1,48 @@
+#pragma once
+
+#include "db/Database.h"
+
+#include <chrono>
+#include <condition_variable>
+#include <mutex>
+#include <thread>
+
+// Background maintenance of the monthly messages partitions: keeps the upcoming months
+// created ahead of time and retires old ones according to the retention policy.
+class PartitionManager {
+public:
+    struct Options {
+        int monthsAhead = 3;
+        // 0 => keep everything
+        int retentionMonths = 0;
+        // false => detach + move to messages_archive, true => detach + drop
+        bool dropExpired = false;
+        std::chrono::seconds interval{3600};
+    };
+
+    PartitionManager(Database& db, Options opts);
+    ~PartitionManager();
+
+    PartitionManager(const PartitionManager&) = delete;
+    PartitionManager& operator=(const PartitionManager&) = delete;
+
+    void start();
+    void stop();
+
+    // One maintenance pass (also run synchronously at start so inserts never hit a missing month).
+    void runOnce();
+
+    // Reads MESSAGES_PARTITION_MONTHS_AHEAD, MESSAGES_RETENTION_MONTHS,
+    // MESSAGES_RETENTION_ACTION (archive|drop) and MESSAGES_PARTITION_INTERVAL_SECONDS.
+    static Options optionsFromEnv();
+
+private:
+    void loop();
+
+    Database& db_;
+    const Options opts_;
+    std::thread worker_;
+    std::mutex m_;
+    std::condition_variable cv_;
+    bool stopping_ = false;
+};
@@ -1,7 +1,9 @@
+#include <algorithm>
 #include <atomic>
 #include <chrono>
+#include <cstdlib>
 #include <ctime>
-#include <iostream>
+#include <limits>
 #include <mutex>
 #include <optional>
 #include <thread>
@@ -18,9 +20,18 @@
 #endif
 
 #include "db/Database.h"
+#include "jobs/ConversationPurger.h"
+#include "jobs/PartitionManager.h"
 #include "utils/Base64.h"
 #include "utils/EnvLoader.h"
+#include "AllocStats.h"
+#include "GrpcMetrics.h"
+#include "GrpcTracing.h"
+#include "Logger.h"
+#include "ProfiledMutex.h"
 #include <grpcpp/grpcpp.h>
+#include <grpcpp/health_check_service_interface.h>
+#include <google/protobuf/arena.h>
 #include "messaging.grpc.pb.h"
 #include "messaging.pb.h"
 
@@ -28,7 +39,7 @@ using namespace securecloud::messaging;
 
 class MessagingServiceImpl final : public MessagingService::Service {
 private:
-    std::mutex m_;
+    metrics::Mutex m_{"MessagingServiceImpl::m_"};
     struct ActiveStream {
         grpc::ServerReaderWriter<EncryptedMessage, EncryptedMessage>* stream;
         std::atomic<bool> alive{true};
@@ -36,6 +47,7 @@ private:
     std::vector<ActiveStream*> active_streams_;
 
     Database& db_;
+    ConversationPurger& purger_;
 
     static bool parse_room_id(const std::string& conversationId, int* outConvId) {
         if (!outConvId) return false;
@@ -75,8 +87,88 @@ private:
         }
     }
 
+    static std::optional<int> parse_db_message_id(const std::string& messageId) {
+        const std::string prefix = "db_";
+        if (messageId.rfind(prefix, 0) != 0) return std::nullopt;
+        return parse_int(messageId.substr(prefix.size()));
+    }
+
+    // EncryptedMessage.delivery_cursor: "<tx_id>:<id_messages>".
+    static std::string format_delivery_cursor(const DbMessageRow& row) {
+        return std::to_string(row.tx_id) + ":" + std::to_string(row.id_messages);
+    }
+
+    static std::optional<DeliveryCursor> parse_delivery_cursor(const std::string& s) {
+        const size_t colon = s.find(':');
+        if (colon == std::string::npos || colon == 0) return std::nullopt;
+        const std::string tx = s.substr(0, colon);
+        if (tx.find_first_not_of("0123456789") != std::string::npos) return std::nullopt;
+        const auto id = parse_int(s.substr(colon + 1));
+        if (!id.has_value() || *id < 0) return std::nullopt;
+        try {
+            DeliveryCursor c;
+            c.txId = std::stoull(tx);
+            c.messageId = *id;
+            return c;
+        } catch (...) {
+            return std::nullopt;
+        }
+    }
+
+    static void fill_message(const DbMessageRow& row, const std::string& conversationId, EncryptedMessage* m) {
+        m->set_message_id("db_" + std::to_string(row.id_messages));
+        m->set_conversation_id(conversationId);
+        if (row.sender_id.has_value()) {
+            m->set_sender_id(std::to_string(*row.sender_id));
+        }
+        m->set_ciphertext(safe_b64_decode(row.encrypted_content_b64));
+        m->set_timestamp_unix(static_cast<long long>(row.created_at_unix));
+    }
+
+    // Arena reused across the batches of one stream: Reset() after each Write() hands the
+    // blocks back, so steady-state batches allocate nothing for the messages themselves.
+    static google::protobuf::ArenaOptions stream_arena_options(std::vector<char>* initialBlock) {
+        google::protobuf::ArenaOptions opts;
+        opts.initial_block = initialBlock->data();
+        opts.initial_block_size = initialBlock->size();
+        opts.max_block_size = 1024 * 1024;
+        return opts;
+    }
+
+    // MESSAGING_ALLOC_STATS=1: report the handler's heap allocations as trailing metadata
+    // (x-alloc-count / x-alloc-bytes); the gateway surfaces them with GATEWAY_ALLOC_STATS=1.
+    static void add_alloc_trailers(grpc::ServerContext* ctx, const AllocStats::Scope& scope) {
+        static const bool enabled = EnvLoader::get("MESSAGING_ALLOC_STATS") == "1";
+        if (!enabled || !ctx) return;
+        const auto d = scope.delta();
+        ctx->AddTrailingMetadata("x-alloc-count", std::to_string(d.allocations));
+        ctx->AddTrailingMetadata("x-alloc-bytes", std::to_string(d.bytes));
+    }
+
+    // Access control (rooms): if requester_id is provided and conversation_id is a room:<id>,
+    // require that requester is a participant.
+    grpc::Status check_history_access(const HistoryRequest& req) {
+        if (!req.requester_id().empty() && !req.conversation_id().empty()) {
+            const auto requesterId = parse_int(req.requester_id());
+            int roomConvId = 0;
+            if (requesterId.has_value() && parse_room_id(req.conversation_id(), &roomConvId)) {
+                if (!db_.isParticipant(roomConvId, *requesterId)) {
+                    return grpc::Status(grpc::StatusCode::PERMISSION_DENIED, "Not a participant");
+                }
+            }
+        }
+        return grpc::Status::OK;
+    }
+
+    static metrics::Gauge& chat_subscribers() {
+        static auto& g = metrics::registry().gauge("messaging_chat_subscribers", "ChatStream subscribers receiving broadcasts");
+        return g;
+    }
+
     void broadcast(const EncryptedMessage& msg) {
-        std::lock_guard<std::mutex> lk(m_);
+        static auto& writes = metrics::registry().counter("messaging_broadcast_writes_total",
+                                                          "Messages written to ChatStream subscribers");
+        std::lock_guard<metrics::Mutex> lk(m_);
         // Purge streams morts
         for (auto it = active_streams_.begin(); it != active_streams_.end();) {
             if (!(*it)->alive) it = active_streams_.erase(it);
@@ -85,6 +177,7 @@ private:
         for (auto* s : active_streams_) {
             if (s->alive) {
                 s->stream->Write(msg); // best-effort
+                writes.inc();
             }
         }
     }
@@ -116,7 +209,7 @@ private:
     }
 
 public:
-    explicit MessagingServiceImpl(Database& db) : db_(db) {}
+    MessagingServiceImpl(Database& db, ConversationPurger& purger) : db_(db), purger_(purger) {}
 
     grpc::Status SendMessage(grpc::ServerContext*,
                              const EncryptedMessage* request,
@@ -134,45 +227,118 @@ public:
         return grpc::Status::OK;
     }
 
-    grpc::Status GetHistory(grpc::ServerContext*,
+    grpc::Status GetHistory(grpc::ServerContext* ctx,
                             const HistoryRequest* req,
                             HistoryResponse* resp) override {
         if (!req || !resp) {
             return grpc::Status(grpc::StatusCode::INTERNAL, "Internal error");
         }
+        const AllocStats::Scope allocScope;
 
-        // Access control (rooms): if requester_id is provided and conversation_id is a room:<id>,
-        // require that requester is a participant.
-        if (!req->requester_id().empty() && !req->conversation_id().empty()) {
-            const auto requesterId = parse_int(req->requester_id());
-            int roomConvId = 0;
-            if (requesterId.has_value() && parse_room_id(req->conversation_id(), &roomConvId)) {
-                if (!db_.isParticipant(roomConvId, *requesterId)) {
-                    return grpc::Status(grpc::StatusCode::PERMISSION_DENIED, "Not a participant");
-                }
-            }
+        const auto access = check_history_access(*req);
+        if (!access.ok()) return access;
+
+        std::optional<int> before;
+        if (!req->before_message_id().empty()) {
+            before = parse_db_message_id(req->before_message_id());
+            if (!before) return grpc::Status(grpc::StatusCode::INVALID_ARGUMENT, "Invalid before_message_id");
         }
 
         std::vector<DbMessageRow> rows;
         try {
-            rows = db_.getHistory(req->conversation_id(), req->limit());
+            rows = db_.getHistory(req->conversation_id(), req->limit(), before);
+        } catch (const ForeignCursor& e) {
+            return grpc::Status(grpc::StatusCode::INVALID_ARGUMENT, e.what());
         } catch (const std::exception& e) {
             return grpc::Status(grpc::StatusCode::INTERNAL, std::string("DB error: ") + e.what());
         }
+        // The sync API owns resp (heap); at least size the repeated field once.
+        resp->mutable_messages()->Reserve(static_cast<int>(rows.size()));
         for (const auto& row : rows) {
-            auto* m = resp->add_messages();
-            m->set_message_id("db_" + std::to_string(row.id_messages));
-            m->set_conversation_id(req->conversation_id().empty() ? row.conversation_key : req->conversation_id());
-            if (row.sender_id.has_value()) {
-                m->set_sender_id(std::to_string(*row.sender_id));
-            }
-            m->set_ciphertext(safe_b64_decode(row.encrypted_content_b64));
-            m->set_timestamp_unix(static_cast<long long>(row.created_at_unix));
+            fill_message(row, req->conversation_id().empty() ? row.conversation_key : req->conversation_id(),
+                         resp->add_messages());
         }
 
+        add_alloc_trailers(ctx, allocScope);
         return grpc::Status::OK;
     }
 
+    grpc::Status GetDataVersion(grpc::ServerContext*,
+                                const DataVersionRequest* req,
+                                DataVersionResponse* resp) override {
+        if (!req || !resp) {
+            return grpc::Status(grpc::StatusCode::INTERNAL, "Internal error");
+        }
+
+        HistoryRequest scope;
+        scope.set_conversation_id(req->conversation_id());
+        scope.set_requester_id(req->requester_id());
+        const auto access = check_history_access(scope);
+        if (!access.ok()) return access;
+
+        try {
+            resp->set_membership_version(db_.getDataVersion("membership"));
+            resp->set_retention_version(db_.getDataVersion("retention"));
+            if (!req->conversation_id().empty()) {
+                resp->set_history_version(db_.latestMessageId(req->conversation_id()));
+            }
+        } catch (const std::exception& e) {
+            return grpc::Status(grpc::StatusCode::INTERNAL, std::string("DB error: ") + e.what());
+        }
+        return grpc::Status::OK;
+    }
+
+    grpc::Status StreamHistory(grpc::ServerContext* ctx,
+                               const HistoryRequest* req,
+                               grpc::ServerWriter<HistoryResponse>* writer) override {
+        if (!req || !writer) {
+            return grpc::Status(grpc::StatusCode::INTERNAL, "Internal error");
+        }
+
+        const auto access = check_history_access(*req);
+        if (!access.ok()) return access;
+
+        const int batchSize = req->batch_size() <= 0 ? 500 : std::max(1, std::min(5000, req->batch_size()));
+
+        std::vector<char> arenaBlock(64 * 1024);
+        google::protobuf::Arena arena(stream_arena_options(&arenaBlock));
+
+        // One batch in flight: the next FETCH only runs once Write() has handed the previous
+        // batch to the transport, so a slow reader throttles the DB scan (gRPC flow control).
+        bool clientGone = false;
+        try {
+            db_.streamHistory(req->conversation_id(), req->limit(), batchSize,
+                              [&](const std::vector<DbMessageRow>& rows) {
+                                  if (ctx && ctx->IsCancelled()) {
+                                      clientGone = true;
+                                      return false;
+                                  }
+                                  auto* chunk = google::protobuf::Arena::CreateMessage<HistoryResponse>(&arena);
+                                  chunk->mutable_messages()->Reserve(static_cast<int>(rows.size()));
+                                  for (const auto& row : rows) {
+                                      fill_message(row,
+                                                   req->conversation_id().empty() ? row.conversation_key
+                                                                                  : req->conversation_id(),
+                                                   chunk->add_messages());
+                                  }
+                                  const bool written = writer->Write(*chunk);
+                                  arena.Reset();
+                                  if (!written) {
+                                      clientGone = true;
+                                      return false;
+                                  }
+                                  return true;
+                              });
+        } catch (const StreamLimitReached& e) {
+            return grpc::Status(grpc::StatusCode::RESOURCE_EXHAUSTED, e.what());
+        } catch (const std::exception& e) {
+            return grpc::Status(grpc::StatusCode::INTERNAL, std::string("DB error: ") + e.what());
+        }
+
+        return clientGone ? grpc::Status(grpc::StatusCode::CANCELLED, "Client went away")
+                          : grpc::Status::OK;
+    }
+
     grpc::Status CreateConversation(grpc::ServerContext*,
                                    const CreateConversationRequest* req,
                                    CreateConversationResponse* resp) override {
@@ -292,34 +458,173 @@ public:
         }
 
         try {
-            const bool ok = db_.deleteConversationById(convId);
+            // Tombstone + queued purge: returns before any message is deleted.
+            const bool ok = db_.requestConversationDeletion(convId);
             if (!ok) {
                 resp->set_success(false);
                 resp->set_message("Room not found");
                 return grpc::Status(grpc::StatusCode::NOT_FOUND, "Not found");
             }
-            resp->set_success(true);
-            resp->set_message("OK");
-            return grpc::Status::OK;
         } catch (const std::exception& e) {
             resp->set_success(false);
             resp->set_message(std::string("DB error: ") + e.what());
             return grpc::Status(grpc::StatusCode::INTERNAL, "DB error");
         }
+
+        purger_.notify();
+        resp->set_success(true);
+        resp->set_message("Deletion scheduled");
+        resp->set_status("pending");
+        return grpc::Status::OK;
+    }
+
+    grpc::Status GetDeletionStatus(grpc::ServerContext*,
+                                   const DeletionStatusRequest* req,
+                                   DeletionStatusResponse* resp) override {
+        if (!req || !resp) {
+            return grpc::Status(grpc::StatusCode::INTERNAL, "Internal error");
+        }
+
+        int convId = 0;
+        if (!parse_room_id(req->conversation_id(), &convId)) {
+            return grpc::Status(grpc::StatusCode::INVALID_ARGUMENT, "Invalid conversation_id");
+        }
+
+        std::optional<DbDeletionJobRow> job;
+        try {
+            job = db_.getConversationDeletion(convId);
+        } catch (const std::exception& e) {
+            return grpc::Status(grpc::StatusCode::INTERNAL, std::string("DB error: ") + e.what());
+        }
+        if (!job.has_value()) {
+            return grpc::Status(grpc::StatusCode::NOT_FOUND, "No deletion requested for this room");
+        }
+
+        resp->set_conversation_id(req->conversation_id());
+        resp->set_status(job->status);
+        resp->set_messages_total(job->messages_total.value_or(-1));
+        resp->set_messages_deleted(job->messages_deleted);
+        resp->set_requested_at_unix(job->requested_at_unix);
+        resp->set_finished_at_unix(job->finished_at_unix);
+        resp->set_last_error(job->last_error);
+        return grpc::Status::OK;
     }
 
-    grpc::Status ChatStream(grpc::ServerContext*,
+    grpc::Status DrainPending(grpc::ServerContext* ctx,
+                              const DrainPendingRequest* req,
+                              grpc::ServerWriter<EncryptedMessage>* writer) override {
+        if (!req || !writer) {
+            return grpc::Status(grpc::StatusCode::INTERNAL, "Internal error");
+        }
+        const auto userId = parse_int(req->user_id());
+        if (!userId.has_value()) {
+            return grpc::Status(grpc::StatusCode::INVALID_ARGUMENT, "Invalid user_id");
+        }
+        if (req->device_id().empty()) {
+            return grpc::Status(grpc::StatusCode::INVALID_ARGUMENT, "Missing device_id");
+        }
+
+        const int batchSize = req->batch_size() <= 0 ? 500 : std::max(1, std::min(5000, req->batch_size()));
+        // Callers page the backlog (gateway /sync) so one response always fits its deadline.
+        int remaining = req->limit() <= 0 ? std::numeric_limits<int>::max() : req->limit();
+
+        DeliveryCursor cursor;
+        try {
+            cursor = db_.getOrInitDeliveryCursor(*userId, req->device_id());
+        } catch (const std::exception& e) {
+            return grpc::Status(grpc::StatusCode::INTERNAL, std::string("DB error: ") + e.what());
+        }
+
+        // Page through the backlog. Nothing moves the cursor here: a successful Write only means
+        // the message reached the gRPC transport, not the device. The client acks the
+        // delivery_cursor of what it actually stored through AckDelivered, and until then the
+        // same backlog is drained again.
+        std::vector<char> arenaBlock(64 * 1024);
+        google::protobuf::Arena arena(stream_arena_options(&arenaBlock));
+
+        DeliveryCursor lastSent = cursor;
+        bool interrupted = false;
+        while (!interrupted && remaining > 0) {
+            if (ctx && ctx->IsCancelled()) {
+                interrupted = true;
+                break;
+            }
+
+            const int pageSize = std::min(batchSize, remaining);
+            std::vector<DbMessageRow> rows;
+            try {
+                rows = db_.getPendingForUser(*userId, lastSent, pageSize);
+            } catch (const std::exception& e) {
+                return grpc::Status(grpc::StatusCode::INTERNAL, std::string("DB error: ") + e.what());
+            }
+
+            for (const auto& row : rows) {
+                auto* m = google::protobuf::Arena::CreateMessage<EncryptedMessage>(&arena);
+                fill_message(row, row.conversation_key, m);
+                m->set_delivery_cursor(format_delivery_cursor(row));
+                if (!writer->Write(*m)) {
+                    interrupted = true;
+                    break;
+                }
+                lastSent.txId = row.tx_id;
+                lastSent.messageId = row.id_messages;
+                --remaining;
+            }
+            arena.Reset();
+
+            if (static_cast<int>(rows.size()) < pageSize) break;
+        }
+
+        return interrupted ? grpc::Status(grpc::StatusCode::CANCELLED, "Client went away")
+                           : grpc::Status::OK;
+    }
+
+    grpc::Status AckDelivered(grpc::ServerContext*,
+                              const AckDeliveredRequest* req,
+                              AckDeliveredResponse* resp) override {
+        if (!req || !resp) {
+            return grpc::Status(grpc::StatusCode::INTERNAL, "Internal error");
+        }
+        const auto userId = parse_int(req->user_id());
+        const auto cursor = parse_delivery_cursor(req->cursor());
+        if (!userId.has_value() || !cursor.has_value() || req->device_id().empty()) {
+            resp->set_success(false);
+            return grpc::Status(grpc::StatusCode::INVALID_ARGUMENT, "Invalid user_id/device_id/cursor");
+        }
+
+        try {
+            resp->set_success(db_.advanceDeliveryCursor(*userId, req->device_id(), *cursor));
+        } catch (const std::exception& e) {
+            resp->set_success(false);
+            return grpc::Status(grpc::StatusCode::INTERNAL, std::string("DB error: ") + e.what());
+        }
+        return grpc::Status::OK;
+    }
+
+    grpc::Status ChatStream(grpc::ServerContext* ctx,
                             grpc::ServerReaderWriter<EncryptedMessage, EncryptedMessage>* stream) override {
         ActiveStream self{stream};
         {
-            std::lock_guard<std::mutex> lk(m_);
+            std::lock_guard<metrics::Mutex> lk(m_);
             active_streams_.push_back(&self);
+            chat_subscribers().set(static_cast<std::int64_t>(active_streams_.size()));
+            // Initial metadata tells the client (gateway ChatHub) that no later broadcast can be
+            // missed. Sent under m_ so it cannot race a broadcast Write().
+            ctx->AddInitialMetadata("x-stream-registered", "1");
+            stream->SendInitialMetadata();
         }
         EncryptedMessage incoming;
         while (stream->Read(&incoming)) {
             (void)persist_and_broadcast(&incoming);
         }
-        self.alive = false;
+        {
+            // `self` lives on this frame: unregister before returning.
+            std::lock_guard<metrics::Mutex> lk(m_);
+            self.alive = false;
+            active_streams_.erase(std::remove(active_streams_.begin(), active_streams_.end(), &self),
+                                  active_streams_.end());
+            chat_subscribers().set(static_cast<std::int64_t>(active_streams_.size()));
+        }
         return grpc::Status::OK;
     }
 };
@@ -388,32 +693,59 @@ int main(int argc, char** argv) {
         }
         if (masked.rfind("postgresql://", 0) == 0 || masked.rfind("postgres://", 0) == 0) {
             // don't try to parse URL; just avoid dumping secrets in logs
-            std::cout << "[messaging-service] Using POSTGRES_CONN (url, masked in logs)" << std::endl;
+            logging::info("messaging-service", "Database", {{"conn", "POSTGRES_CONN (url, masked)"}});
         } else {
-            std::cout << "[messaging-service] ConnStr(masked): " << masked << std::endl;
+            logging::info("messaging-service", "Database", {{"conn", masked}});
         }
     }
 
     std::unique_ptr<Database> database;
     try {
-        database = std::make_unique<Database>(connStr);
+        // MESSAGING_MAX_HISTORY_STREAMS: concurrent exports, each on its own connection.
+        int maxStreams = 4;
+        try {
+            const std::string v = EnvLoader::get("MESSAGING_MAX_HISTORY_STREAMS");
+            if (!v.empty()) maxStreams = std::stoi(v);
+        } catch (...) {
+        }
+        database = std::make_unique<Database>(connStr, maxStreams);
     } catch (const std::exception& e) {
-        std::cerr << "[messaging-service] DB connection failed: " << e.what() << std::endl;
+        logging::error("messaging-service", "Database", {{"result", "connection_failed"}, {"error", e.what()}});
         return 1;
     }
 
-    MessagingServiceImpl service(*database);
+    if (tracing::initFromEnv("messaging-service")) {
+        logging::info("messaging-service", "Tracing", {{"file", std::getenv("TRACE_EXPORT_FILE")}});
+    }
+
+    PartitionManager partitions(*database, PartitionManager::optionsFromEnv());
+    partitions.start();
+
+    ConversationPurger purger(*database, ConversationPurger::optionsFromEnv());
+    purger.start();
+
+    MessagingServiceImpl service(*database, purger);
+    // grpc.health.v1 for the gateway's client-side health checks (replicas in rotation).
+    grpc::EnableDefaultHealthCheckService(true);
     grpc::ServerBuilder builder;
     int selectedPort = 0;
     builder.AddListeningPort(addr, grpc::InsecureServerCredentials(), &selectedPort);
     builder.RegisterService(&service);
+    auto interceptors = metrics::serverInterceptors();
+    interceptors.push_back(tracing::serverInterceptorFactory());
+    builder.experimental().SetInterceptorCreators(std::move(interceptors));
     auto server = builder.BuildAndStart();
     if (!server || selectedPort == 0) {
-        std::cerr << "[messaging-service] Failed to bind/listen on " << addr
-                  << " (is the port already in use?)" << std::endl;
+        logging::error("messaging-service", "Listen", {{"addr", addr}, {"result", "bind_failed"}});
         return 2;
     }
-    std::cout << "[messaging-service] listening on " << addr << std::endl;
+    logging::info("messaging-service", "Listen", {{"addr", addr}});
+    // GET /metrics on a side port (METRICS_PORT, 0 disables).
+    if (const int metricsPort = metrics::serveFromEnv(9102)) {
+        logging::info("messaging-service", "Metrics", {{"port", metricsPort}});
+    } else {
+        logging::warn("messaging-service", "Metrics", {{"result", "disabled_or_bind_failed"}});
+    }
     server->Wait();
     return 0;
 }
\ No newline at end of file
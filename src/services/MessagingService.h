@@ -13,13 +13,19 @@
 #include <QNetworkReply>
 #include <QNetworkRequest>
 #include <QPromise>
+#include <QSet>
+#include <QSettings>
 #include <QStringList>
+#include <QTimer>
 #include <QUrl>
 #include <QUrlQuery>
+#include <QUuid>
+#include <algorithm>
 #include <functional>
 #include <memory>
 #include "../models/Contact.h"
 #include "../models/Message.h"
+#include "../utils/GatewayProto.h"
 #include "AuthService.h"
 
 /**
@@ -28,6 +34,11 @@
  * Version "propre": le front appelle le Gateway HTTP, qui proxy vers gRPC messaging_service.
  * L'UI reste synchrone (getContacts/getMessages) mais les données sont mises en cache et
  * alimentées via refreshContacts/refreshMessages.
+ * Une fois connecté, les nouveaux messages arrivent en direct via le flux SSE GET /events
+ * (une seule connexion pour toutes les conversations); le polling ne sert que de repli.
+ * Les messages reçus hors connexion sont récupérés par pages GET /sync, chaque page étant
+ * acquittée (POST /sync/ack) une fois en cache: le serveur garde un curseur par appareil, que
+ * seul /sync fait avancer (le flux SSE peut perdre des messages).
  */
 class MessagingService : public QObject {
     Q_OBJECT
@@ -67,6 +78,11 @@ public:
 
     QString lastError() const { return m_lastError; }
 
+    /**
+     * @brief true tant que le flux temps réel (GET /events) est ouvert
+     */
+    bool liveUpdatesActive() const { return m_eventsLive; }
+
     /**
      * @brief Crée un salon (room) via le gateway (admin seulement)
      * @return Future<bool> true si création OK
@@ -105,16 +121,21 @@ signals:
     void contactStatusChanged(const QString& contactId, const QString& status);
     void messagesUpdated(const QString& conversationId);
     void errorOccurred(const QString& error);
+    void liveUpdatesChanged(bool active);
     
 private:
     MessagingService() {
         connect(&AuthService::instance(), &AuthService::userLoggedIn, this, [this](const User&) {
-            ensureMe();
-            refreshContacts();
+            startEventStream();
+            bootstrap(/*hasRetried*/ false);
         });
         connect(&AuthService::instance(), &AuthService::userLoggedOut, this, [this]() {
+            stopEventStream();
+            m_syncInFlight = false;
+            m_syncAgain = false;
             m_contacts.clear();
             m_messagesByConversation.clear();
+            m_validatorCache.clear();
             m_currentUserId.clear();
             emit contactsUpdated();
         });
@@ -134,6 +155,44 @@ private:
         return req;
     }
 
+    // Réponse en protobuf binaire plutôt qu'en JSON (listes volumineuses: historiques, annuaire).
+    // Un gateway qui ne le gère pas répond en JSON: le décodage suit le Content-Type reçu.
+    static void acceptProtobuf(QNetworkRequest* req) {
+        req->setRawHeader("Accept", QByteArray(GatewayProto::kContentType) + ", application/json;q=0.5");
+    }
+
+    // GET conditionnel: renvoie l'ETag du dernier corps reçu pour cette URL.
+    void addValidator(QNetworkRequest* req) const {
+        const auto it = m_validatorCache.constFind(req->url().toString());
+        if (it != m_validatorCache.constEnd()) {
+            req->setRawHeader("If-None-Match", it->etag);
+        }
+    }
+
+    // Corps effectif d'une réponse GET: sur 304, le corps mémorisé (et *httpStatus passe à 200);
+    // sur 200 avec ETag, le corps est mémorisé pour la prochaine revalidation.
+    // *protobuf indique l'encodage du corps renvoyé (Content-Type, ou celui du corps mémorisé).
+    QByteArray resolveConditional(const QNetworkReply* reply, int* httpStatus, const QByteArray& raw, bool* protobuf) {
+        const QString key = reply->request().url().toString();
+        *protobuf = GatewayProto::isProtobufContentType(reply->header(QNetworkRequest::ContentTypeHeader).toByteArray());
+        if (*httpStatus == 304) {
+            const auto it = m_validatorCache.constFind(key);
+            if (it == m_validatorCache.constEnd()) {
+                return raw;
+            }
+            *httpStatus = 200;
+            *protobuf = it->protobuf;
+            return it->body;
+        }
+        const QByteArray etag = reply->rawHeader("ETag");
+        if (*httpStatus == 200 && !etag.isEmpty()) {
+            m_validatorCache.insert(key, CachedBody{etag, raw, *protobuf});
+        } else if (*httpStatus == 200) {
+            m_validatorCache.remove(key);
+        }
+        return raw;
+    }
+
     void refreshAccessTokenThen(const std::function<void(bool)>& cont) {
         auto* watcher = new QFutureWatcher<bool>(this);
         QObject::connect(watcher, &QFutureWatcher<bool>::finished, this, [watcher, cont]() {
@@ -190,17 +249,23 @@ private:
 
             reply->deleteLater();
             emit messageSent(cid, bodyContent);
-            refreshMessages(cid);
-            refreshContacts();
+            if (!m_eventsLive) {
+                // Sans flux temps réel, le message stocké (id, horodatage) n'arrive que par un rechargement.
+                refreshMessages(cid);
+                refreshContacts();
+            }
         });
     }
 
     void refreshContactsImpl(bool hasRetried) {
-        const QNetworkRequest req = makeRequest(QStringLiteral("/users"));
+        QNetworkRequest req = makeRequest(QStringLiteral("/users"));
+        acceptProtobuf(&req);
+        addValidator(&req);
         QNetworkReply* reply = m_network.get(req);
         QObject::connect(reply, &QNetworkReply::finished, this, [this, reply, hasRetried]() {
-            const int httpStatus = reply->attribute(QNetworkRequest::HttpStatusCodeAttribute).toInt();
-            const QByteArray raw = reply->readAll();
+            int httpStatus = reply->attribute(QNetworkRequest::HttpStatusCodeAttribute).toInt();
+            bool protobuf = false;
+            const QByteArray raw = resolveConditional(reply, &httpStatus, reply->readAll(), &protobuf);
 
             auto isHttpOk = [&](int status) {
                 return status >= 200 && status < 300;
@@ -228,54 +293,55 @@ private:
                 return;
             }
 
-            QJsonObject obj;
-            QString parseError;
-            if (!parseJsonObject(raw, &obj, &parseError)) {
-                fail(parseError.isEmpty() ? QStringLiteral("Réponse users invalide") : parseError);
-                return;
+            QList<GatewayProto::HttpUser> users;
+            if (protobuf) {
+                if (!GatewayProto::decodeList(raw, &users)) {
+                    fail(QStringLiteral("Réponse users invalide"));
+                    return;
+                }
+            } else {
+                QJsonObject obj;
+                QString parseError;
+                if (!parseJsonObject(raw, &obj, &parseError)) {
+                    fail(parseError.isEmpty() ? QStringLiteral("Réponse users invalide") : parseError);
+                    return;
+                }
+                users = usersFromJson(obj.value("users").toArray());
             }
 
-            const QJsonArray users = obj.value("users").toArray();
             QList<Contact> contacts;
-            contacts.reserve(users.size());
-            for (const auto& item : users) {
-                const QJsonObject obj = item.toObject();
-                const QString userId = obj.value("userId").toString(obj.value("user_id").toString());
-                if (userId.isEmpty()) continue;
-
-                const QString fullName = obj.value("fullName").toString(obj.value("full_name").toString());
-                const QString email = obj.value("email").toString();
-                const QString role = obj.value("role").toString();
-                const QString name = !fullName.isEmpty() ? fullName : (!email.isEmpty() ? email : userId);
-
-                contacts.push_back(Contact(userId, name, role.isEmpty() ? QStringLiteral("—") : role, email));
-            }
+            appendUserContacts(&contacts, users);
 
             // Fetch rooms (non-fatal if it fails; users list remains available)
-            const QNetworkRequest roomsReq = makeRequest(QStringLiteral("/rooms"));
+            QNetworkRequest roomsReq = makeRequest(QStringLiteral("/rooms"));
+            acceptProtobuf(&roomsReq);
+            addValidator(&roomsReq);
             QNetworkReply* roomsReply = m_network.get(roomsReq);
             QObject::connect(roomsReply, &QNetworkReply::finished, this, [this, roomsReply, contacts]() mutable {
-                const int roomsHttp = roomsReply->attribute(QNetworkRequest::HttpStatusCodeAttribute).toInt();
-                const QByteArray roomsRaw = roomsReply->readAll();
+                int roomsHttp = roomsReply->attribute(QNetworkRequest::HttpStatusCodeAttribute).toInt();
+                bool roomsProtobuf = false;
+                const QByteArray roomsRaw = resolveConditional(roomsReply, &roomsHttp, roomsReply->readAll(), &roomsProtobuf);
 
                 auto isHttpOk2 = [&](int status) {
                     return status >= 200 && status < 300;
                 };
 
                 if (roomsReply->error() == QNetworkReply::NoError && isHttpOk2(roomsHttp)) {
-                    QJsonObject roomsObj;
-                    QString parseError;
-                    if (parseJsonObject(roomsRaw, &roomsObj, &parseError)) {
-                        const QJsonArray rooms = roomsObj.value("rooms").toArray();
-                        contacts.reserve(contacts.size() + rooms.size());
-                        for (const auto& item : rooms) {
-                            const QJsonObject r = item.toObject();
-                            const QString roomId = r.value("roomId").toString(r.value("room_id").toString());
-                            if (roomId.isEmpty()) continue;
-                            const QString title = r.value("title").toString();
-                            contacts.push_back(Contact(roomId, title.isEmpty() ? roomId : title, QStringLiteral("Room")));
+                    QList<GatewayProto::RoomSummary> rooms;
+                    bool parsed = false;
+                    if (roomsProtobuf) {
+                        parsed = GatewayProto::decodeList(roomsRaw, &rooms);
+                    } else {
+                        QJsonObject roomsObj;
+                        QString parseError;
+                        parsed = parseJsonObject(roomsRaw, &roomsObj, &parseError);
+                        if (parsed) {
+                            rooms = roomsFromJson(roomsObj.value("rooms").toArray());
                         }
                     }
+                    if (parsed) {
+                        appendRoomContacts(&contacts, rooms);
+                    }
                 }
 
                 m_contacts = contacts;
@@ -306,11 +372,14 @@ private:
         if (!token.isEmpty()) {
             req.setRawHeader("Authorization", QStringLiteral("Bearer %1").arg(token).toUtf8());
         }
+        acceptProtobuf(&req);
+        addValidator(&req);
 
         QNetworkReply* reply = m_network.get(req);
         QObject::connect(reply, &QNetworkReply::finished, this, [this, reply, cid, limit, hasRetried]() {
-            const int httpStatus = reply->attribute(QNetworkRequest::HttpStatusCodeAttribute).toInt();
-            const QByteArray raw = reply->readAll();
+            int httpStatus = reply->attribute(QNetworkRequest::HttpStatusCodeAttribute).toInt();
+            bool protobuf = false;
+            const QByteArray raw = resolveConditional(reply, &httpStatus, reply->readAll(), &protobuf);
 
             auto isHttpOk = [&](int status) {
                 return status >= 200 && status < 300;
@@ -338,42 +407,241 @@ private:
                 return;
             }
 
-            QJsonObject obj;
-            QString parseError;
-            if (!parseJsonObject(raw, &obj, &parseError)) {
-                fail(parseError.isEmpty() ? QStringLiteral("Réponse messages invalide") : parseError);
-                return;
+            QList<GatewayProto::HttpMessage> messages;
+            if (protobuf) {
+                if (!GatewayProto::decodeList(raw, &messages)) {
+                    fail(QStringLiteral("Réponse messages invalide"));
+                    return;
+                }
+            } else {
+                QJsonObject obj;
+                QString parseError;
+                if (!parseJsonObject(raw, &obj, &parseError)) {
+                    fail(parseError.isEmpty() ? QStringLiteral("Réponse messages invalide") : parseError);
+                    return;
+                }
+                messages = messagesFromJson(obj);
             }
 
-            const QJsonArray messages = obj.value("messages").toArray();
             QList<Message> out;
             out.reserve(messages.size());
-            for (const auto& item : messages) {
-                const QJsonObject obj = item.toObject();
-                const QString content = obj.value("content").toString();
-                const QString senderId = obj.value("senderId").toString();
-                const QString messageId = obj.value("messageId").toString();
-                const qint64 ts = static_cast<qint64>(obj.value("timestampUnix").toDouble(0));
-
-                Message::Type type = Message::Type::Received;
-                if (!m_currentUserId.isEmpty() && !senderId.isEmpty() && senderId == m_currentUserId) {
-                    type = Message::Type::Sent;
+            QSet<QString> ids;
+            for (const auto& m : messages) {
+                out.push_back(toMessage(m));
+                ids.insert(m.messageId);
+            }
+            // Les messages déjà en cache hors de cette page (reçus par /sync, donc acquittés,
+            // ou plus anciens que la page) sont conservés.
+            bool merged = false;
+            for (const Message& cached : m_messagesByConversation.value(cid)) {
+                if (!cached.messageId().isEmpty() && !ids.contains(cached.messageId())) {
+                    out.push_back(cached);
+                    merged = true;
                 }
-                out.push_back(Message(
-                    content,
-                    type,
-                    QDateTime::fromSecsSinceEpoch(ts > 0 ? ts : QDateTime::currentSecsSinceEpoch()),
-                    senderId,
-                    messageId
-                ));
+            }
+            if (merged) {
+                std::stable_sort(out.begin(), out.end(), [](const Message& a, const Message& b) {
+                    return a.timestamp() < b.timestamp();
+                });
             }
 
             m_messagesByConversation.insert(cid, out);
+            rememberConversation(cid);
             reply->deleteLater();
             emit messagesUpdated(cid);
         });
     }
 
+    static GatewayProto::HttpUser userFromJson(const QJsonObject& obj) {
+        GatewayProto::HttpUser u;
+        u.userId = obj.value("userId").toString(obj.value("user_id").toString());
+        u.fullName = obj.value("fullName").toString(obj.value("full_name").toString());
+        u.email = obj.value("email").toString();
+        u.role = obj.value("role").toString();
+        return u;
+    }
+
+    static QList<GatewayProto::HttpUser> usersFromJson(const QJsonArray& items) {
+        QList<GatewayProto::HttpUser> users;
+        users.reserve(items.size());
+        for (const auto& item : items) {
+            users.push_back(userFromJson(item.toObject()));
+        }
+        return users;
+    }
+
+    static QList<GatewayProto::RoomSummary> roomsFromJson(const QJsonArray& items) {
+        QList<GatewayProto::RoomSummary> rooms;
+        rooms.reserve(items.size());
+        for (const auto& item : items) {
+            const QJsonObject r = item.toObject();
+            GatewayProto::RoomSummary room;
+            room.roomId = r.value("roomId").toString(r.value("room_id").toString());
+            room.title = r.value("title").toString();
+            rooms.push_back(room);
+        }
+        return rooms;
+    }
+
+    static void appendUserContacts(QList<Contact>* contacts, const QList<GatewayProto::HttpUser>& users) {
+        contacts->reserve(contacts->size() + users.size());
+        for (const auto& u : users) {
+            if (u.userId.isEmpty()) continue;
+            const QString name = !u.fullName.isEmpty() ? u.fullName : (!u.email.isEmpty() ? u.email : u.userId);
+            contacts->push_back(Contact(u.userId, name, u.role.isEmpty() ? QStringLiteral("—") : u.role, u.email));
+        }
+    }
+
+    static void appendRoomContacts(QList<Contact>* contacts, const QList<GatewayProto::RoomSummary>& rooms) {
+        contacts->reserve(contacts->size() + rooms.size());
+        for (const auto& room : rooms) {
+            if (room.roomId.isEmpty()) continue;
+            contacts->push_back(Contact(room.roomId, room.title.isEmpty() ? room.roomId : room.title, QStringLiteral("Room")));
+        }
+    }
+
+    // --- Démarrage (GET /bootstrap) ---
+
+    // Conversations ouvertes récemment, par compte: /bootstrap renvoie leur dernière page dès la
+    // connexion, sans attendre que l'utilisateur les rouvre.
+    static constexpr int kRecentConversations = 8;
+    static constexpr int kBootstrapPageLimit = 200;  // comme refreshMessages
+
+    static QString recentConversationsKey() {
+        const QString account = AuthService::instance().currentUser().email().trimmed().toLower();
+        return QStringLiteral("bootstrap/recent/%1").arg(account);
+    }
+
+    static void rememberConversation(const QString& cid) {
+        QSettings settings;
+        QStringList recent = settings.value(recentConversationsKey()).toStringList();
+        if (!recent.isEmpty() && recent.first() == cid) return;
+        recent.removeAll(cid);
+        recent.prepend(cid);
+        while (recent.size() > kRecentConversations) recent.removeLast();
+        settings.setValue(recentConversationsKey(), recent);
+    }
+
+    static void forgetConversation(const QString& cid) {
+        QSettings settings;
+        QStringList recent = settings.value(recentConversationsKey()).toStringList();
+        if (recent.removeAll(cid) > 0) settings.setValue(recentConversationsKey(), recent);
+    }
+
+    // La séquence de connexion en un aller-retour: /me, /users, /rooms et la dernière page des
+    // conversations récentes (ETag: 304 si rien n'a changé depuis la dernière connexion).
+    // Sur un gateway sans /bootstrap, ou en erreur, repli sur les appels séparés. Le rattrapage
+    // hors connexion (/sync) suit, une fois les conversations en cache.
+    void bootstrap(bool hasRetried) {
+        if (AuthService::instance().accessToken().isEmpty()) {
+            return;
+        }
+        QNetworkRequest req = makeRequest(QStringLiteral("/bootstrap"));
+        QUrl url = req.url();
+        QUrlQuery q;
+        q.addQueryItem(QStringLiteral("limit"), QString::number(kBootstrapPageLimit));
+        const QStringList recent = QSettings().value(recentConversationsKey()).toStringList();
+        if (!recent.isEmpty()) {
+            q.addQueryItem(QStringLiteral("conversations"), recent.join(QLatin1Char(',')));
+        }
+        url.setQuery(q);
+        req.setUrl(url);
+        acceptProtobuf(&req);
+        addValidator(&req);
+
+        const quint64 generation = m_eventsGeneration;
+        QNetworkReply* reply = m_network.get(req);
+        QObject::connect(reply, &QNetworkReply::finished, this, [this, reply, generation, hasRetried]() {
+            int httpStatus = reply->attribute(QNetworkRequest::HttpStatusCodeAttribute).toInt();
+            bool protobuf = false;
+            const QByteArray raw = resolveConditional(reply, &httpStatus, reply->readAll(), &protobuf);
+            const bool networkOk = reply->error() == QNetworkReply::NoError;
+            reply->deleteLater();
+            if (generation != m_eventsGeneration) {
+                return;  // déconnecté entre-temps
+            }
+
+            if (httpStatus == 401 && !hasRetried) {
+                refreshAccessTokenThen([this, generation](bool ok) {
+                    if (generation != m_eventsGeneration) return;
+                    if (!ok) {
+                        emit errorOccurred(sessionExpiredMessage());
+                        return;
+                    }
+                    bootstrap(/*hasRetried*/ true);
+                });
+                return;
+            }
+
+            GatewayProto::BootstrapResponse boot;
+            const bool parsed = networkOk && httpStatus == 200 &&
+                                (protobuf ? GatewayProto::decode(raw, &boot) : bootstrapFromJson(raw, &boot));
+            if (!parsed) {
+                ensureMe();
+                refreshContacts();
+                syncPending();
+                return;
+            }
+            applyBootstrap(boot);
+            syncPending();
+        });
+    }
+
+    static bool bootstrapFromJson(const QByteArray& raw, GatewayProto::BootstrapResponse* out) {
+        QJsonObject obj;
+        if (!parseJsonObject(raw, &obj, nullptr)) {
+            return false;
+        }
+        out->me = userFromJson(obj.value("me").toObject());
+        out->users = usersFromJson(obj.value("users").toArray());
+        out->rooms = roomsFromJson(obj.value("rooms").toArray());
+        for (const auto& item : obj.value("conversations").toArray()) {
+            const QJsonObject c = item.toObject();
+            GatewayProto::ConversationPage page;
+            page.conversationId = c.value("conversationId").toString();
+            page.messages = messagesFromJson(c);
+            page.status = c.value("status").toInt();
+            page.error = c.value("error").toString();
+            out->conversations.push_back(page);
+        }
+        return true;
+    }
+
+    void applyBootstrap(const GatewayProto::BootstrapResponse& boot) {
+        if (!boot.me.userId.isEmpty()) {
+            m_currentUserId = boot.me.userId;
+        }
+
+        QList<Contact> contacts;
+        appendUserContacts(&contacts, boot.users);
+        appendRoomContacts(&contacts, boot.rooms);
+        m_contacts = contacts;
+        emit contactsUpdated();
+
+        for (const auto& page : boot.conversations) {
+            if (page.conversationId.isEmpty()) continue;
+            if (page.status == 403) {
+                // Salon quitté ou supprimé depuis.
+                forgetConversation(page.conversationId);
+                continue;
+            }
+            if (page.status != 200) continue;  // rechargée à l'ouverture
+            QList<Message> out;
+            out.reserve(page.messages.size());
+            for (const auto& m : page.messages) {
+                out.push_back(toMessage(m));
+            }
+            m_messagesByConversation.insert(page.conversationId, out);
+            emit messagesUpdated(page.conversationId);
+        }
+
+        if (!m_pendingConversationRefresh.isEmpty()) {
+            const QString cid = m_pendingConversationRefresh;
+            m_pendingConversationRefresh.clear();
+            refreshMessages(cid);
+        }
+    }
+
     void createRoomAsAdminImpl(const QString& title,
                               const QStringList& participantEmails,
                               bool hasRetried,
@@ -613,6 +881,357 @@ private:
         });
     }
 
+    // --- Flux temps réel (Server-Sent Events) ---
+
+    void startEventStream() {
+        if (m_eventsReply || AuthService::instance().accessToken().isEmpty()) {
+            return;
+        }
+        const quint64 generation = m_eventsGeneration;
+        QNetworkRequest req = makeRequest(QStringLiteral("/events"));
+        req.setRawHeader("Accept", "text/event-stream");
+        req.setAttribute(QNetworkRequest::CacheLoadControlAttribute, QNetworkRequest::AlwaysNetwork);
+        m_eventsBuffer.clear();
+        m_eventsReply = m_network.get(req);
+        QNetworkReply* reply = m_eventsReply;
+
+        QObject::connect(reply, &QNetworkReply::readyRead, this, [this, reply, generation]() {
+            if (generation != m_eventsGeneration) return;
+            const int httpStatus = reply->attribute(QNetworkRequest::HttpStatusCodeAttribute).toInt();
+            if (httpStatus != 200) return;
+            if (!m_eventsLive) {
+                m_eventsBackoffMs = 1000;
+                setEventsLive(true);
+                if (m_eventsResyncOnConnect) {
+                    m_eventsResyncOnConnect = false;
+                    resyncFromServer();
+                }
+            }
+            m_eventsBuffer.append(reply->readAll());
+            parseEventFrames();
+        });
+
+        QObject::connect(reply, &QNetworkReply::finished, this, [this, reply, generation]() {
+            const int httpStatus = reply->attribute(QNetworkRequest::HttpStatusCodeAttribute).toInt();
+            reply->deleteLater();
+            if (generation != m_eventsGeneration) return;
+            m_eventsReply = nullptr;
+            setEventsLive(false);
+            m_eventsResyncOnConnect = true;
+
+            if (httpStatus == 401) {
+                refreshAccessTokenThen([this, generation](bool ok) {
+                    if (ok && generation == m_eventsGeneration) startEventStream();
+                });
+                return;
+            }
+
+            // Reconnexion avec backoff; le polling des contacts prend le relais entre-temps.
+            const int delay = m_eventsBackoffMs;
+            m_eventsBackoffMs = std::min(m_eventsBackoffMs * 2, 30000);
+            QTimer::singleShot(delay, this, [this, generation]() {
+                if (generation == m_eventsGeneration) startEventStream();
+            });
+        });
+    }
+
+    void stopEventStream() {
+        ++m_eventsGeneration;
+        m_eventsBackoffMs = 1000;
+        if (m_eventsReply) {
+            QNetworkReply* reply = m_eventsReply;
+            m_eventsReply = nullptr;
+            reply->abort();
+        }
+        m_eventsBuffer.clear();
+        m_eventsResyncOnConnect = false;
+        setEventsLive(false);
+    }
+
+    // Des messages ont pu être manqués (flux coupé): recharger ce qui est en cache et
+    // récupérer le reste par /sync.
+    void resyncFromServer() {
+        syncPending();
+        refreshContacts();
+        for (const QString& cid : m_messagesByConversation.keys()) {
+            refreshMessages(cid);
+        }
+    }
+
+    void setEventsLive(bool live) {
+        if (m_eventsLive == live) return;
+        m_eventsLive = live;
+        emit liveUpdatesChanged(live);
+    }
+
+    // Frames "event: <type>\ndata: <json>\n\n"; lines starting with ':' are keepalives.
+    void parseEventFrames() {
+        for (;;) {
+            const int end = m_eventsBuffer.indexOf("\n\n");
+            if (end < 0) return;
+            const QByteArray frame = m_eventsBuffer.left(end);
+            m_eventsBuffer.remove(0, end + 2);
+
+            QByteArray eventType = "message";
+            QByteArray data;
+            for (const QByteArray& rawLine : frame.split('\n')) {
+                const QByteArray line = rawLine.endsWith('\r') ? rawLine.chopped(1) : rawLine;
+                if (line.isEmpty() || line.startsWith(':')) continue;
+                if (line.startsWith("event:")) {
+                    eventType = line.mid(6).trimmed();
+                } else if (line.startsWith("data:")) {
+                    if (!data.isEmpty()) data.append('\n');
+                    data.append(line.mid(5).trimmed());
+                }
+            }
+
+            if (eventType == "resync") {
+                resyncFromServer();
+            } else if (eventType == "message" && !data.isEmpty()) {
+                handleLiveMessage(data);
+            }
+        }
+    }
+
+    void handleLiveMessage(const QByteArray& raw) {
+        QJsonObject obj;
+        if (!parseJsonObject(raw, &obj, nullptr)) {
+            return;
+        }
+        const GatewayProto::HttpMessage m = messageFromJson(obj);
+        bool unknownConversation = false;
+        if (storeMessage(m, &unknownConversation)) {
+            emit messagesUpdated(m.conversationId);
+        }
+        if (unknownConversation) {
+            // Nouveau salon ou nouvel utilisateur.
+            refreshContacts();
+        }
+        // Pas d'acquittement ici: le flux direct n'est pas exhaustif (coupures), seul /sync
+        // fait avancer le curseur de livraison.
+    }
+
+    // Ajoute un message au cache de sa conversation (sans doublon).
+    // false si rien n'a changé: déjà connu, ou conversation jamais ouverte (chargée à
+    // l'ouverture) sauf avec createConversation, où son cache est créé avec ce message.
+    bool storeMessage(const GatewayProto::HttpMessage& m, bool* unknownConversation, bool createConversation = false) {
+        const QString& cid = m.conversationId;
+        if (cid.isEmpty()) {
+            return false;
+        }
+
+        bool knownConversation = false;
+        for (const auto& c : m_contacts) {
+            if (c.id() == cid) {
+                knownConversation = true;
+                break;
+            }
+        }
+        if (!knownConversation) {
+            *unknownConversation = true;
+        }
+
+        auto it = m_messagesByConversation.find(cid);
+        if (it == m_messagesByConversation.end()) {
+            if (!createConversation) {
+                return false;
+            }
+            it = m_messagesByConversation.insert(cid, {});
+        }
+        for (const auto& existing : *it) {
+            if (!m.messageId.isEmpty() && existing.messageId() == m.messageId) {
+                return false;
+            }
+        }
+        it->push_back(toMessage(m));
+        return true;
+    }
+
+    Message toMessage(const GatewayProto::HttpMessage& m) const {
+        Message::Type type = Message::Type::Received;
+        if (!m_currentUserId.isEmpty() && !m.senderId.isEmpty() && m.senderId == m_currentUserId) {
+            type = Message::Type::Sent;
+        }
+        const qint64 ts = m.timestampUnix;
+        return Message(
+            m.content,
+            type,
+            QDateTime::fromSecsSinceEpoch(ts > 0 ? ts : QDateTime::currentSecsSinceEpoch()),
+            m.senderId,
+            m.messageId
+        );
+    }
+
+    static GatewayProto::HttpMessage messageFromJson(const QJsonObject& obj) {
+        GatewayProto::HttpMessage m;
+        m.messageId = obj.value("messageId").toString();
+        m.conversationId = obj.value("conversationId").toString();
+        m.senderId = obj.value("senderId").toString();
+        m.content = obj.value("content").toString();
+        // int64 arrive en chaîne (mapping JSON proto3)
+        const QJsonValue ts = obj.value("timestampUnix");
+        m.timestampUnix = ts.isString() ? ts.toString().toLongLong() : static_cast<qint64>(ts.toDouble(0));
+        return m;
+    }
+
+    // {"messages":[...]} (ListMessagesResponse en JSON)
+    static QList<GatewayProto::HttpMessage> messagesFromJson(const QJsonObject& obj) {
+        const QJsonArray items = obj.value("messages").toArray();
+        QList<GatewayProto::HttpMessage> messages;
+        messages.reserve(items.size());
+        for (const auto& item : items) {
+            messages.push_back(messageFromJson(item.toObject()));
+        }
+        return messages;
+    }
+
+    // --- Store-and-forward (GET /sync, POST /sync/ack) ---
+
+    // Identifiant stable de cette installation: le serveur garde un curseur de livraison par appareil.
+    static QString deviceId() {
+        QSettings settings;
+        QString id = settings.value(QStringLiteral("sync/deviceId")).toString();
+        if (id.isEmpty()) {
+            id = QUuid::createUuid().toString(QUuid::WithoutBraces);
+            settings.setValue(QStringLiteral("sync/deviceId"), id);
+        }
+        return id;
+    }
+
+    // Messages arrivés pendant l'absence de cet appareil, toutes conversations confondues.
+    // Une seule synchronisation à la fois; une demande pendant celle-ci la relance à la fin.
+    void syncPending() {
+        if (AuthService::instance().accessToken().isEmpty()) {
+            return;
+        }
+        if (m_syncInFlight) {
+            m_syncAgain = true;
+            return;
+        }
+        m_syncInFlight = true;
+        m_syncAgain = false;
+        fetchSyncPage(/*hasRetried*/ false);
+    }
+
+    void finishSync() {
+        m_syncInFlight = false;
+        if (m_syncAgain) {
+            syncPending();
+        }
+    }
+
+    // Une page GET /sync: chaque message est mis en cache (celui de sa conversation est créé au
+    // besoin), puis la page est acquittée par son curseur et la suivante demandée tant que
+    // hasMore. Le curseur serveur n'avance qu'à l'acquittement: une page perdue est rejouée.
+    void fetchSyncPage(bool hasRetried) {
+        QNetworkRequest req = makeRequest(QStringLiteral("/sync"));
+        QUrl url = req.url();
+        QUrlQuery q;
+        q.addQueryItem(QStringLiteral("deviceId"), deviceId());
+        url.setQuery(q);
+        req.setUrl(url);
+        acceptProtobuf(&req);
+
+        const quint64 generation = m_eventsGeneration;
+        QNetworkReply* reply = m_network.get(req);
+        QObject::connect(reply, &QNetworkReply::finished, this, [this, reply, generation, hasRetried]() {
+            const int httpStatus = reply->attribute(QNetworkRequest::HttpStatusCodeAttribute).toInt();
+            const bool protobuf = GatewayProto::isProtobufContentType(reply->header(QNetworkRequest::ContentTypeHeader).toByteArray());
+            const QByteArray raw = reply->readAll();
+            const bool networkOk = reply->error() == QNetworkReply::NoError;
+            reply->deleteLater();
+            if (generation != m_eventsGeneration) {
+                return;  // déconnecté entre-temps
+            }
+
+            if (httpStatus == 401 && !hasRetried) {
+                refreshAccessTokenThen([this, generation](bool ok) {
+                    if (generation != m_eventsGeneration) return;
+                    if (ok) fetchSyncPage(/*hasRetried*/ true);
+                    else finishSync();
+                });
+                return;
+            }
+            // Non bloquant: l'historique se recharge de toute façon à l'ouverture des conversations.
+            if (!networkOk || httpStatus != 200) {
+                finishSync();
+                return;
+            }
+
+            GatewayProto::SyncResponse page;
+            if (protobuf) {
+                if (!GatewayProto::decode(raw, &page)) {
+                    finishSync();
+                    return;
+                }
+            } else {
+                QJsonObject obj;
+                if (!parseJsonObject(raw, &obj, nullptr)) {
+                    finishSync();
+                    return;
+                }
+                page.messages = messagesFromJson(obj);
+                page.hasMore = obj.value("hasMore").toBool();
+                page.cursor = obj.value("cursor").toString();
+            }
+
+            // Un message sans conversation ne peut pas être mis en cache; tout le reste l'est
+            // (ou l'était déjà), la page entière peut donc être acquittée.
+            bool unknownConversation = false;
+            QSet<QString> updated;
+            for (const auto& m : page.messages) {
+                if (storeMessage(m, &unknownConversation, /*createConversation*/ true)) {
+                    updated.insert(m.conversationId);
+                }
+            }
+            if (unknownConversation) {
+                refreshContacts();
+            }
+            for (const QString& cid : updated) {
+                emit messagesUpdated(cid);
+            }
+
+            if (page.cursor.isEmpty()) {
+                finishSync();
+                return;
+            }
+            ackSyncPage(page.cursor, page.hasMore, /*hasRetried*/ false);
+        });
+    }
+
+    // En cas d'échec le prochain /sync renverra la page (dédoublonnée par messageId); la suivante
+    // n'est demandée qu'une fois celle-ci acquittée, sinon le serveur renverrait la même.
+    void ackSyncPage(const QString& cursor, bool hasMore, bool hasRetried) {
+        const QNetworkRequest req = makeRequest(QStringLiteral("/sync/ack"));
+        const QJsonObject payload{
+            {"deviceId", deviceId()},
+            {"cursor", cursor},
+        };
+        const quint64 generation = m_eventsGeneration;
+        QNetworkReply* reply = m_network.post(req, QJsonDocument(payload).toJson(QJsonDocument::Compact));
+        QObject::connect(reply, &QNetworkReply::finished, this, [this, reply, generation, cursor, hasMore, hasRetried]() {
+            const int httpStatus = reply->attribute(QNetworkRequest::HttpStatusCodeAttribute).toInt();
+            const bool networkOk = reply->error() == QNetworkReply::NoError;
+            reply->deleteLater();
+            if (generation != m_eventsGeneration) {
+                return;
+            }
+            if (httpStatus == 401 && !hasRetried) {
+                refreshAccessTokenThen([this, generation, cursor, hasMore](bool ok) {
+                    if (generation != m_eventsGeneration) return;
+                    if (ok) ackSyncPage(cursor, hasMore, /*hasRetried*/ true);
+                    else finishSync();
+                });
+                return;
+            }
+            if (networkOk && httpStatus == 200 && hasMore) {
+                fetchSyncPage(/*hasRetried*/ false);
+                return;
+            }
+            finishSync();
+        });
+    }
+
     static QString formatNetworkError(const QNetworkReply* reply, const QByteArray& raw) {
         const QString detail = QString::fromUtf8(raw).trimmed();
         if (!detail.isEmpty()) {
@@ -640,8 +1259,26 @@ private:
     QString m_gatewayBaseUrl = QStringLiteral("http://localhost:8080");
     QList<Contact> m_contacts;
     QHash<QString, QList<Message>> m_messagesByConversation;
+    // ETag + corps du dernier 200, par URL (/users, /rooms, historiques)
+    struct CachedBody {
+        QByteArray etag;
+        QByteArray body;
+        bool protobuf = false;
+    };
+    QHash<QString, CachedBody> m_validatorCache;
     QString m_currentUserId;
     QString m_lastError;
     bool m_meFetchInFlight = false;
     QString m_pendingConversationRefresh;
+
+    QNetworkReply* m_eventsReply = nullptr;
+    QByteArray m_eventsBuffer;
+    quint64 m_eventsGeneration = 0;
+    int m_eventsBackoffMs = 1000;
+    bool m_eventsLive = false;
+    bool m_eventsResyncOnConnect = false;
+
+    // Pages GET /sync en cours (une seule chaîne à la fois), relancée à la fin si redemandée
+    bool m_syncInFlight = false;
+    bool m_syncAgain = false;
 };
@@ -105,10 +105,18 @@ public:
         reloadContacts();
         MessagingService::instance().refreshContacts();
 
+        // Repli: polling uniquement tant que le flux temps réel (/events) n'est pas ouvert.
         auto* timer = new QTimer(this);
         timer->setInterval(5000);
         connect(timer, &QTimer::timeout, &MessagingService::instance(), &MessagingService::refreshContacts);
-        timer->start();
+        connect(&MessagingService::instance(), &MessagingService::liveUpdatesChanged,
+            timer, [timer](bool active) {
+                if (active) timer->stop();
+                else timer->start();
+            });
+        if (!MessagingService::instance().liveUpdatesActive()) {
+            timer->start();
+        }
     }
     
 signals:
@@ -0,0 +1,264 @@
+#pragma once
+
+#include <QByteArray>
+#include <QList>
+#include <QString>
+#include <QtGlobal>
+#include <utility>
+
+/**
+ * @brief Décodage binaire (application/x-protobuf) des réponses du gateway
+ *
+ * Lecteur minimal du format protobuf pour les quelques messages de gateway.proto que le client
+ * lit (historique, utilisateurs, salons), sans dépendre de libprotobuf ni de protoc côté client.
+ * Les numéros de champs doivent rester alignés sur gateway_service/proto/gateway.proto; les
+ * champs inconnus sont ignorés (compatibilité avec un gateway plus récent).
+ */
+namespace GatewayProto {
+
+constexpr const char* kContentType = "application/x-protobuf";
+
+inline bool isProtobufContentType(const QByteArray& contentType) {
+    const int semi = contentType.indexOf(';');
+    return (semi < 0 ? contentType : contentType.left(semi)).trimmed().toLower() == kContentType;
+}
+
+// Lecture champ par champ: while (r.next()) { switch (r.field()) ... }, puis r.ok().
+class WireReader {
+public:
+    WireReader(const char* data, qsizetype size) : m_p(data), m_end(data + size) {}
+    explicit WireReader(const QByteArray& data) : WireReader(data.constData(), data.size()) {}
+
+    bool next() {
+        if (!m_ok || m_p == m_end) return false;
+        quint64 tag = 0;
+        if (!readVarint(&tag) || (tag >> 3) == 0) return fail();
+        m_field = static_cast<int>(tag >> 3);
+        m_varint = 0;
+        m_data = nullptr;
+        m_size = 0;
+        switch (tag & 7) {
+        case 0: // varint
+            return readVarint(&m_varint) || fail();
+        case 1: // fixed64
+            return skip(8);
+        case 2: { // length-delimited
+            quint64 len = 0;
+            if (!readVarint(&len) || len > static_cast<quint64>(m_end - m_p)) return fail();
+            m_data = m_p;
+            m_size = static_cast<qsizetype>(len);
+            m_p += len;
+            return true;
+        }
+        case 5: // fixed32
+            return skip(4);
+        default:
+            return fail();
+        }
+    }
+
+    bool ok() const { return m_ok; }
+    int field() const { return m_field; }
+    qint64 int64() const { return static_cast<qint64>(m_varint); }
+    QString string() const { return QString::fromUtf8(m_data, m_size); }
+    WireReader message() const { return WireReader(m_data, m_size); }
+
+private:
+    bool readVarint(quint64* out) {
+        quint64 v = 0;
+        for (int shift = 0; shift < 64 && m_p != m_end; shift += 7) {
+            const auto byte = static_cast<unsigned char>(*m_p++);
+            v |= static_cast<quint64>(byte & 0x7f) << shift;
+            if (!(byte & 0x80)) {
+                *out = v;
+                return true;
+            }
+        }
+        return false;
+    }
+
+    bool skip(qsizetype n) {
+        if (m_end - m_p < n) return fail();
+        m_p += n;
+        return true;
+    }
+
+    bool fail() {
+        m_ok = false;
+        return false;
+    }
+
+    const char* m_p;
+    const char* m_end;
+    bool m_ok = true;
+    int m_field = 0;
+    quint64 m_varint = 0;
+    const char* m_data = nullptr;
+    qsizetype m_size = 0;
+};
+
+// message HttpMessage
+struct HttpMessage {
+    QString messageId;      // 1
+    QString conversationId; // 2
+    QString senderId;       // 3
+    QString content;        // 4
+    qint64 timestampUnix = 0; // 5
+};
+
+// message HttpUser
+struct HttpUser {
+    QString userId;   // 1
+    QString fullName; // 2
+    QString email;    // 3
+    QString role;     // 4
+};
+
+// message RoomSummary
+struct RoomSummary {
+    QString roomId; // 1
+    QString title;  // 2
+};
+
+inline bool decode(WireReader r, HttpMessage* out) {
+    while (r.next()) {
+        switch (r.field()) {
+        case 1: out->messageId = r.string(); break;
+        case 2: out->conversationId = r.string(); break;
+        case 3: out->senderId = r.string(); break;
+        case 4: out->content = r.string(); break;
+        case 5: out->timestampUnix = r.int64(); break;
+        default: break;
+        }
+    }
+    return r.ok();
+}
+
+inline bool decode(WireReader r, HttpUser* out) {
+    while (r.next()) {
+        switch (r.field()) {
+        case 1: out->userId = r.string(); break;
+        case 2: out->fullName = r.string(); break;
+        case 3: out->email = r.string(); break;
+        case 4: out->role = r.string(); break;
+        default: break;
+        }
+    }
+    return r.ok();
+}
+
+inline bool decode(WireReader r, RoomSummary* out) {
+    while (r.next()) {
+        switch (r.field()) {
+        case 1: out->roomId = r.string(); break;
+        case 2: out->title = r.string(); break;
+        default: break;
+        }
+    }
+    return r.ok();
+}
+
+// message ConversationPage
+struct ConversationPage {
+    QString conversationId;      // 1
+    QList<HttpMessage> messages; // 2
+    int status = 0;              // 3
+    QString error;               // 4
+};
+
+// message BootstrapResponse (GET /bootstrap)
+struct BootstrapResponse {
+    HttpUser me;                           // 1
+    QList<HttpUser> users;                 // 2
+    QList<RoomSummary> rooms;              // 3
+    QList<ConversationPage> conversations; // 4
+};
+
+inline bool decode(WireReader r, ConversationPage* out) {
+    while (r.next()) {
+        switch (r.field()) {
+        case 1: out->conversationId = r.string(); break;
+        case 2: {
+            HttpMessage m;
+            if (!decode(r.message(), &m)) return false;
+            out->messages.push_back(std::move(m));
+            break;
+        }
+        case 3: out->status = static_cast<int>(r.int64()); break;
+        case 4: out->error = r.string(); break;
+        default: break;
+        }
+    }
+    return r.ok();
+}
+
+inline bool decode(const QByteArray& raw, BootstrapResponse* out) {
+    WireReader r(raw);
+    while (r.next()) {
+        switch (r.field()) {
+        case 1:
+            if (!decode(r.message(), &out->me)) return false;
+            break;
+        case 2: {
+            HttpUser u;
+            if (!decode(r.message(), &u)) return false;
+            out->users.push_back(std::move(u));
+            break;
+        }
+        case 3: {
+            RoomSummary room;
+            if (!decode(r.message(), &room)) return false;
+            out->rooms.push_back(std::move(room));
+            break;
+        }
+        case 4: {
+            ConversationPage page;
+            if (!decode(r.message(), &page)) return false;
+            out->conversations.push_back(std::move(page));
+            break;
+        }
+        default: break;
+        }
+    }
+    return r.ok();
+}
+// message SyncHttpResponse (GET /sync)
+struct SyncResponse {
+    QList<HttpMessage> messages; // 1
+    bool hasMore = false;        // 2
+    QString cursor;              // 3
+};
+
+inline bool decode(const QByteArray& raw, SyncResponse* out) {
+    WireReader r(raw);
+    while (r.next()) {
+        switch (r.field()) {
+        case 1: {
+            HttpMessage m;
+            if (!decode(r.message(), &m)) return false;
+            out->messages.push_back(std::move(m));
+            break;
+        }
+        case 2: out->hasMore = r.int64() != 0; break;
+        case 3: out->cursor = r.string(); break;
+        default: break;
+        }
+    }
+    return r.ok();
+}
+
+// Listes (ListMessagesResponse.messages, ListUsersHttpResponse.users, ListRoomsResponse.rooms):
+// le champ répété est toujours le numéro 1.
+template <typename T>
+bool decodeList(const QByteArray& raw, QList<T>* out) {
+    WireReader r(raw);
+    while (r.next()) {
+        if (r.field() != 1) continue;
+        T item;
+        if (!decode(r.message(), &item)) return false;
+        out->push_back(std::move(item));
+    }
+    return r.ok();
+}
+
+} // namespace GatewayProto
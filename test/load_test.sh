@@ -0,0 +1,84 @@
+#!/bin/bash
+# Test de charge de bout en bout : gateway -> auth/messaging -> Postgres.
+#
+# Prérequis : un Postgres local (DATABASE_URL) et les services + la gateway démarrés dessus.
+#   ./test/load_test.sh --init          applique init/schema.sql, les migrations et l'admin de bootstrap
+#   ./test/load_test.sh                 crée les comptes / salons de charge puis lance le scénario
+#
+# Variables : GATEWAY_URL (http://127.0.0.1:8080), LOAD_VUS (50), LOAD_RATE (100 scénarios/s, 0 = boucle fermée),
+# LOAD_DURATION (60 s), LOAD_MIX, LOAD_MAX_P99_MS (500), LOAD_MAX_ERROR_RATE (0.01), LOAD_JSON (load_result.json).
+# Code de sortie 2 si le p99 corrigé ou le taux d'erreur dépasse le seuil : utilisable en CI.
+
+set -e
+
+RED='\033[0;31m'
+GREEN='\033[0;32m'
+YELLOW='\033[1;33m'
+BLUE='\033[0;34m'
+NC='\033[0m'
+
+PROJECT_DIR="$(cd "$(dirname "${BASH_SOURCE[0]}")/.." && pwd)"
+BUILD_DIR="$PROJECT_DIR/gateway_service/build"
+LOAD_GEN="$BUILD_DIR/gateway_load_gen"
+
+GATEWAY_URL="${GATEWAY_URL:-http://127.0.0.1:8080}"
+LOAD_VUS="${LOAD_VUS:-50}"
+LOAD_RATE="${LOAD_RATE:-100}"
+LOAD_DURATION="${LOAD_DURATION:-60}"
+LOAD_MIX="${LOAD_MIX:-60:history,send;30:sync;10:directory,rooms}"
+LOAD_MAX_P99_MS="${LOAD_MAX_P99_MS:-500}"
+LOAD_MAX_ERROR_RATE="${LOAD_MAX_ERROR_RATE:-0.01}"
+LOAD_JSON="${LOAD_JSON:-load_result.json}"
+ADMIN_EMAIL="${ADMIN_EMAIL:-admin@wizzmania.com}"
+ADMIN_PASSWORD="${ADMIN_PASSWORD:-AdminPass123!}"
+
+echo -e "${BLUE}🧙‍♂️ Test de charge - Gateway${NC}"
+echo -e "${BLUE}============================${NC}"
+
+if [ "$1" = "--init" ]; then
+    if [ -z "$DATABASE_URL" ]; then
+        echo -e "${RED}❌ DATABASE_URL non défini${NC}"
+        exit 1
+    fi
+    echo -e "${YELLOW}🗄️  Initialisation de la base...${NC}"
+    psql "$DATABASE_URL" -v ON_ERROR_STOP=1 -q -f "$PROJECT_DIR/init/schema.sql"
+    for m in "$PROJECT_DIR"/init/migrations/*.sql; do
+        psql "$DATABASE_URL" -v ON_ERROR_STOP=1 -q -f "$m"
+    done
+    psql "$DATABASE_URL" -v ON_ERROR_STOP=1 -q -f "$PROJECT_DIR/init/bootstrap_admin.sql"
+    echo -e "${GREEN}✅ Schéma, migrations et admin appliqués${NC}"
+    exit 0
+fi
+
+echo -e "${YELLOW}🔧 Compilation du générateur de charge...${NC}"
+if cmake -S "$PROJECT_DIR/gateway_service" -B "$BUILD_DIR" -DCMAKE_BUILD_TYPE=Release > /dev/null &&
+   cmake --build "$BUILD_DIR" --target gateway_load_gen -j > /dev/null; then
+    echo -e "${GREEN}✅ Build gateway_load_gen OK${NC}"
+else
+    echo -e "${RED}❌ Échec de compilation de gateway_load_gen${NC}"
+    exit 1
+fi
+
+if ! curl -sf "$GATEWAY_URL/health" > /dev/null; then
+    echo -e "${RED}❌ Gateway injoignable sur $GATEWAY_URL${NC}"
+    exit 1
+fi
+
+USERS=$((LOAD_VUS + 5))
+echo -e "${YELLOW}👥 Création de $USERS comptes et des salons de charge...${NC}"
+"$LOAD_GEN" --setup --users "$USERS" --admin-email "$ADMIN_EMAIL" --admin-password "$ADMIN_PASSWORD" \
+    --rooms 20 --room-size 10 "$GATEWAY_URL"
+
+echo -e "${YELLOW}🚀 $LOAD_VUS utilisateurs, $LOAD_RATE scénarios/s pendant ${LOAD_DURATION}s...${NC}"
+set +e
+"$LOAD_GEN" -u "$LOAD_VUS" -r "$LOAD_RATE" -d "$LOAD_DURATION" -w 10 -m "$LOAD_MIX" --users "$USERS" --events 5 \
+    --json "$LOAD_JSON" --max-p99-ms "$LOAD_MAX_P99_MS" --max-error-rate "$LOAD_MAX_ERROR_RATE" "$GATEWAY_URL"
+rc=$?
+set -e
+
+if [ $rc -eq 0 ]; then
+    echo -e "${GREEN}✅ Test de charge OK (résultats : $LOAD_JSON)${NC}"
+else
+    echo -e "${RED}❌ Seuils dépassés ou aucun scénario exécuté (code $rc, résultats : $LOAD_JSON)${NC}"
+fi
+exit $rc